@@ -0,0 +1,156 @@
+// Copyright (c) 2026 The NetBSD Foundation, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+// CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+// IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstddef>
+#include <new>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "atf-c++/detail/test_helpers.hpp"
+#include "atf-c++/utils.hpp"
+
+// Keeps the compiler from eliding the allocations of the tests.
+static void* volatile Sink;
+
+// ------------------------------------------------------------------------
+// Auxiliary functions.
+// ------------------------------------------------------------------------
+
+static
+void
+new_and_delete(const std::size_t size)
+{
+    Sink = new char[size];
+    delete[] static_cast< char* >(Sink);
+}
+
+// ------------------------------------------------------------------------
+// Auxiliary test cases.
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE(h_require_allocs_le);
+ATF_TEST_CASE_HEAD(h_require_allocs_le)
+{
+    set_md_var("descr", "Helper test case");
+}
+ATF_TEST_CASE_BODY(h_require_allocs_le)
+{
+    if (get_config_var("what") == "ok")
+        ATF_REQUIRE_ALLOCS_LE(1, new_and_delete(10));
+    else if (get_config_var("what") == "fail")
+        ATF_REQUIRE_ALLOCS_LE(1, (new_and_delete(10), new_and_delete(20)));
+}
+
+// ------------------------------------------------------------------------
+// Test cases for the allocation tracker.
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE_WITHOUT_HEAD(available);
+ATF_TEST_CASE_BODY(available)
+{
+    ATF_REQUIRE(atf_alloc_available());
+}
+
+ATF_TEST_CASE_WITHOUT_HEAD(new_delete);
+ATF_TEST_CASE_BODY(new_delete)
+{
+    atf_alloc_region_t region;
+    atf_alloc_stats_t stats;
+
+    atf_alloc_region_begin(&region);
+    Sink = new int(5);
+    delete static_cast< int* >(Sink);
+    new_and_delete(100);
+    Sink = new (std::nothrow) char[50];
+    delete[] static_cast< char* >(Sink);
+    atf_alloc_region_end(&region, &stats);
+
+    ATF_REQUIRE_EQ(3, stats.m_count);
+    ATF_REQUIRE_EQ(sizeof(int) + 150, stats.m_bytes);
+    ATF_REQUIRE(stats.m_peak >= 100);
+}
+
+ATF_TEST_CASE_WITHOUT_HEAD(containers);
+ATF_TEST_CASE_BODY(containers)
+{
+    atf_alloc_region_t region;
+    atf_alloc_stats_t stats;
+
+    atf_alloc_region_begin(&region);
+    {
+        std::string s(1000, 'x');
+        Sink = &s;
+    }
+    atf_alloc_region_end(&region, &stats);
+
+    ATF_REQUIRE(stats.m_count >= 1);
+    ATF_REQUIRE(stats.m_bytes >= 1000);
+    ATF_REQUIRE(stats.m_peak >= 1000);
+}
+
+// ------------------------------------------------------------------------
+// Test cases for the macros.
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE(require_allocs_le);
+ATF_TEST_CASE_HEAD(require_allocs_le)
+{
+    set_md_var("descr", "Tests the ATF_REQUIRE_ALLOCS_LE macro");
+}
+ATF_TEST_CASE_BODY(require_allocs_le)
+{
+    ATF_REQUIRE_ALLOCS_LE(0, (void)0);
+    ATF_REQUIRE_ALLOCS_LE(1, new_and_delete(10));
+
+    atf::tests::vars_map config;
+
+    config["what"] = "ok";
+    ATF_TEST_CASE_USE(h_require_allocs_le);
+    run_h_tc< ATF_TEST_CASE_NAME(h_require_allocs_le) >(config);
+    ATF_REQUIRE(atf::utils::grep_file("^passed$", "result"));
+
+    config["what"] = "fail";
+    run_h_tc< ATF_TEST_CASE_NAME(h_require_allocs_le) >(config);
+    ATF_REQUIRE(atf::utils::grep_file("^failed: .*alloc_test.cpp:[0-9]+: "
+        "Expected at most 1 allocations in \\(new_and_delete\\(10\\), "
+        "new_and_delete\\(20\\)\\), got 2 \\(30 bytes, [0-9]+ bytes at "
+        "peak\\)$", "result"));
+}
+
+// ------------------------------------------------------------------------
+// Main.
+// ------------------------------------------------------------------------
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    // Add the test cases for the allocation tracker.
+    ATF_ADD_TEST_CASE(tcs, available);
+    ATF_ADD_TEST_CASE(tcs, new_delete);
+    ATF_ADD_TEST_CASE(tcs, containers);
+
+    // Add the test cases for the macros.
+    ATF_ADD_TEST_CASE(tcs, require_allocs_le);
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2026 The NetBSD Foundation, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+// CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+// IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// The allocation tracker of the C++ runtime, built as the libatf-c++-alloc
+// library.
+//
+// Test programs enable it by linking with the library, after which the
+// operators defined here replace the global operator new and operator
+// delete.  They record every allocation and deallocation in the counters
+// of libatf-c and get their memory from malloc and free, whose own
+// tracker, if present, does not record it again.
+
+extern "C" {
+#include "atf-c/detail/alloc.h"
+}
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if __cplusplus >= 201103L
+#   define ATFU_NOEXCEPT noexcept
+#   define ATFU_THROW_BAD_ALLOC
+#else
+#   define ATFU_NOEXCEPT throw()
+#   define ATFU_THROW_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+// ------------------------------------------------------------------------
+// Auxiliary functions.
+// ------------------------------------------------------------------------
+
+namespace {
+
+static
+void*
+allocate(const std::size_t size)
+{
+    atf_alloc_hold();
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    atf_alloc_release();
+
+    atf_alloc_record_alloc(ptr, size);
+    return ptr;
+}
+
+static
+void*
+allocate_or_throw(const std::size_t size)
+{
+    for (;;) {
+        void* ptr = allocate(size);
+        if (ptr != NULL)
+            return ptr;
+
+        const std::new_handler handler = std::set_new_handler(NULL);
+        std::set_new_handler(handler);
+        if (handler == NULL)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+static
+void*
+allocate_or_null(const std::size_t size)
+{
+    try {
+        return allocate_or_throw(size);
+    } catch (const std::bad_alloc&) {
+        return NULL;
+    }
+}
+
+static
+void
+deallocate(void* ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    atf_alloc_record_free(ptr);
+
+    atf_alloc_hold();
+    std::free(ptr);
+    atf_alloc_release();
+}
+
+} // anonymous namespace
+
+// ------------------------------------------------------------------------
+// Replacements of the global allocation functions.
+// ------------------------------------------------------------------------
+
+void*
+operator new(std::size_t size) ATFU_THROW_BAD_ALLOC
+{
+    return allocate_or_throw(size);
+}
+
+void*
+operator new[](std::size_t size) ATFU_THROW_BAD_ALLOC
+{
+    return allocate_or_throw(size);
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) ATFU_NOEXCEPT
+{
+    return allocate_or_null(size);
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) ATFU_NOEXCEPT
+{
+    return allocate_or_null(size);
+}
+
+void
+operator delete(void* ptr) ATFU_NOEXCEPT
+{
+    deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr) ATFU_NOEXCEPT
+{
+    deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, const std::nothrow_t&) ATFU_NOEXCEPT
+{
+    deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, const std::nothrow_t&) ATFU_NOEXCEPT
+{
+    deallocate(ptr);
+}
+
+#if defined(__cpp_sized_deallocation)
+void
+operator delete(void* ptr, std::size_t) ATFU_NOEXCEPT
+{
+    deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t) ATFU_NOEXCEPT
+{
+    deallocate(ptr);
+}
+#endif
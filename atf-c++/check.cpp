@@ -83,6 +83,27 @@ impl::check_result::termsig(void)
     return atf_check_result_termsig(&m_result);
 }
 
+int64_t
+impl::check_result::maxrss(void)
+    const
+{
+    return atf_check_result_maxrss(&m_result);
+}
+
+int64_t
+impl::check_result::cpu_time(void)
+    const
+{
+    return atf_check_result_cputime(&m_result);
+}
+
+int64_t
+impl::check_result::wall_time(void)
+    const
+{
+    return atf_check_result_walltime(&m_result);
+}
+
 const std::string
 impl::check_result::stdout_path(void) const
 {
@@ -95,6 +116,52 @@ impl::check_result::stderr_path(void) const
     return atf_check_result_stderr(&m_result);
 }
 
+bool
+impl::check_result::stdout_digested(void)
+    const
+{
+    return atf_check_result_stdout_digest(&m_result) != NULL;
+}
+
+const std::string
+impl::check_result::stdout_digest(void)
+    const
+{
+    PRE(stdout_digested());
+    return atf_check_result_stdout_digest(&m_result);
+}
+
+int64_t
+impl::check_result::stdout_size(void)
+    const
+{
+    PRE(stdout_digested());
+    return atf_check_result_stdout_size(&m_result);
+}
+
+bool
+impl::check_result::stderr_digested(void)
+    const
+{
+    return atf_check_result_stderr_digest(&m_result) != NULL;
+}
+
+const std::string
+impl::check_result::stderr_digest(void)
+    const
+{
+    PRE(stderr_digested());
+    return atf_check_result_stderr_digest(&m_result);
+}
+
+int64_t
+impl::check_result::stderr_size(void)
+    const
+{
+    PRE(stderr_digested());
+    return atf_check_result_stderr_size(&m_result);
+}
+
 // ------------------------------------------------------------------------
 // Free functions.
 // ------------------------------------------------------------------------
@@ -143,10 +210,19 @@ impl::build_cxx_o(const std::string& sfile, const std::string& ofile,
 
 std::auto_ptr< impl::check_result >
 impl::exec(const atf::process::argv_array& argva)
+{
+    return exec(argva, false, false);
+}
+
+std::auto_ptr< impl::check_result >
+impl::exec(const atf::process::argv_array& argva, const bool digest_stdout,
+           const bool digest_stderr)
 {
     atf_check_result_t result;
 
-    atf_error_t err = atf_check_exec_array(argva.exec_argv(), &result);
+    atf_error_t err = atf_check_exec_array_digest(argva.exec_argv(),
+                                                  digest_stdout,
+                                                  digest_stderr, &result);
     if (atf_is_error(err))
         throw_atf_error(err);
 
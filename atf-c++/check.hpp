@@ -72,6 +72,8 @@ class check_result {
 
     friend check_result test_constructor(const char* const*);
     friend std::auto_ptr< check_result > exec(const atf::process::argv_array&);
+    friend std::auto_ptr< check_result > exec(const atf::process::argv_array&,
+                                              const bool, const bool);
 
 public:
     //!
@@ -99,6 +101,22 @@ public:
     //!
     int termsig(void) const;
 
+    //!
+    //! \brief Returns the peak resident set size of the command, in bytes.
+    //!
+    int64_t maxrss(void) const;
+
+    //!
+    //! \brief Returns the CPU time (user plus system) of the command, in
+    //! microseconds.
+    //!
+    int64_t cpu_time(void) const;
+
+    //!
+    //! \brief Returns the wall-clock time of the command, in microseconds.
+    //!
+    int64_t wall_time(void) const;
+
     //!
     //! \brief Returns the path to file contaning command's stdout.
     //!
@@ -108,6 +126,38 @@ public:
     //! \brief Returns the path to file contaning command's stderr.
     //!
     const std::string stderr_path(void) const;
+
+    //!
+    //! \brief Returns whether the command's stdout was digested instead of
+    //! being saved to a file.
+    //!
+    bool stdout_digested(void) const;
+
+    //!
+    //! \brief Returns the SHA-256 digest of the command's stdout.
+    //!
+    const std::string stdout_digest(void) const;
+
+    //!
+    //! \brief Returns the size of the command's stdout, in bytes.
+    //!
+    int64_t stdout_size(void) const;
+
+    //!
+    //! \brief Returns whether the command's stderr was digested instead of
+    //! being saved to a file.
+    //!
+    bool stderr_digested(void) const;
+
+    //!
+    //! \brief Returns the SHA-256 digest of the command's stderr.
+    //!
+    const std::string stderr_digest(void) const;
+
+    //!
+    //! \brief Returns the size of the command's stderr, in bytes.
+    //!
+    int64_t stderr_size(void) const;
 };
 
 // ------------------------------------------------------------------------
@@ -121,6 +171,8 @@ bool build_cpp(const std::string&, const std::string&,
 bool build_cxx_o(const std::string&, const std::string&,
                  const atf::process::argv_array&);
 std::auto_ptr< check_result > exec(const atf::process::argv_array&);
+std::auto_ptr< check_result > exec(const atf::process::argv_array&,
+                                   const bool, const bool);
 
 // Useful for testing only.
 check_result test_constructor(void);
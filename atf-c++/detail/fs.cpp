@@ -36,6 +36,7 @@ extern "C" {
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <unistd.h>
 }
@@ -43,8 +44,11 @@ extern "C" {
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 extern "C" {
+#include "atf-c/defs.h"
+#include "atf-c/detail/prog_cache.h"
 #include "atf-c/error.h"
 }
 
@@ -101,6 +105,270 @@ safe_access(const impl::path& p, int mode, int experr)
     return ok;
 }
 
+//!
+//! \brief Gets the type of a directory entry without stat'ing it.
+//!
+//! \return The type of the entry, or -1 if the file system does not
+//! report it.
+//!
+static
+int
+dirent_type(const struct dirent* de)
+{
+#if defined(DT_UNKNOWN)
+    switch (de->d_type) {
+    case DT_BLK:  return atf_fs_stat_blk_type;
+    case DT_CHR:  return atf_fs_stat_chr_type;
+    case DT_DIR:  return atf_fs_stat_dir_type;
+    case DT_FIFO: return atf_fs_stat_fifo_type;
+    case DT_LNK:  return atf_fs_stat_lnk_type;
+    case DT_REG:  return atf_fs_stat_reg_type;
+    case DT_SOCK: return atf_fs_stat_sock_type;
+#if defined(DT_WHT)
+    case DT_WHT:  return atf_fs_stat_wht_type;
+#endif
+    default:      break;
+    }
+#endif
+    return -1;
+}
+
+static
+bool
+is_dot_or_dotdot(const char* name)
+{
+    return name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+//!
+//! \brief Opens a directory relative to another one without following
+//! symbolic links.
+//!
+//! If fix_perms is true and the directory cannot be searched, its
+//! permissions are relaxed before trying again.
+//!
+//! \return The descriptor of the directory, or -1 and errno on failure.
+//!
+static
+int
+open_dir_at(const int dirfd, const char* name, const bool fix_perms)
+{
+    const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+    int fd = ::openat(dirfd, name, flags);
+    if (fd == -1 && errno == EACCES && fix_perms) {
+        if (::fchmodat(dirfd, name, 0700, 0) != -1)
+            fd = ::openat(dirfd, name, flags);
+        else
+            errno = EACCES;
+    }
+    return fd;
+}
+
+//!
+//! \brief A version of unlinkat(2) that makes the parent directory
+//! writable if it was not.
+//!
+static
+int
+unlink_at(const int dirfd, const char* name, const int flags)
+{
+    int ret = ::unlinkat(dirfd, name, flags);
+    if (ret == -1 && errno == EACCES) {
+        if (::fchmod(dirfd, 0700) != -1)
+            ret = ::unlinkat(dirfd, name, flags);
+        else
+            errno = EACCES;
+    }
+    return ret;
+}
+
+//!
+//! \brief Raises the error of a failed remove_tree call.
+//!
+static void remove_error(const impl::path&, const std::string&, const int)
+    ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+remove_error(const impl::path& root, const std::string& what,
+             const int errnum)
+{
+    throw atf::system_error(IMPL_NAME "::remove_tree(" + root.str() + ")",
+                            what, errnum);
+}
+
+static void remove_contents(const int, const impl::path&);
+
+//!
+//! \brief Removes an entry of a directory, including all its contents if
+//! it is a directory itself.
+//!
+//! \param type The type of the entry, or -1 if not known yet.
+//! \param root The root of the removal, only used to report errors.
+//!
+static
+void
+remove_entry(const int dirfd, const char* name, int type,
+             const impl::path& root)
+{
+    if (type == -1) {
+        struct stat sb;
+        if (::fstatat(dirfd, name, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
+            if (errno == ENOENT)
+                return;
+            remove_error(root, std::string("fstatat(2) failed on ") + name,
+                         errno);
+        }
+        type = S_ISDIR(sb.st_mode) ? atf_fs_stat_dir_type :
+            atf_fs_stat_reg_type;
+    }
+
+    if (type != atf_fs_stat_dir_type) {
+        if (unlink_at(dirfd, name, 0) == -1 && errno != ENOENT)
+            remove_error(root, std::string("unlinkat(2) failed on ") + name,
+                         errno);
+        return;
+    }
+
+    // Entries created while the directory is being emptied, or missed by
+    // readdir(3) because of the concurrent removals, are caught by reading
+    // the directory again.
+    for (int tries = 0; ; tries++) {
+        const int fd = open_dir_at(dirfd, name, true);
+        if (fd == -1) {
+            if (errno == ENOENT)
+                return;
+            remove_error(root, std::string("openat(2) failed on ") + name,
+                         errno);
+        }
+        remove_contents(fd, root);
+
+        if (unlink_at(dirfd, name, AT_REMOVEDIR) != -1 || errno == ENOENT)
+            return;
+        if ((errno != ENOTEMPTY && errno != EEXIST) || tries == 2)
+            remove_error(root, std::string("unlinkat(2) failed on ") + name,
+                         errno);
+    }
+}
+
+//!
+//! \brief Removes all the entries of a directory.
+//!
+//! The directory descriptor is closed on return.
+//!
+static
+void
+remove_contents(const int fd, const impl::path& root)
+{
+    DIR* dp = ::fdopendir(fd);
+    if (dp == NULL) {
+        const int original_errno = errno;
+        ::close(fd);
+        remove_error(root, "fdopendir(3) failed", original_errno);
+    }
+
+    try {
+        struct dirent* de;
+        while ((errno = 0, de = ::readdir(dp)) != NULL) {
+            if (!is_dot_or_dotdot(de->d_name))
+                remove_entry(fd, de->d_name, dirent_type(de), root);
+        }
+        if (errno != 0)
+            remove_error(root, "readdir(3) failed", errno);
+    } catch (...) {
+        ::closedir(dp);
+        throw;
+    }
+    ::closedir(dp);
+}
+
+//!
+//! \brief Removes the subdirectories of a directory from several
+//! processes.
+//!
+//! Errors are ignored because whatever is left is removed, and reported
+//! if necessary, by the caller afterwards.
+//!
+static
+void
+remove_subdirs_parallel(const int fd, const unsigned int jobs,
+                        const impl::path& root)
+{
+    std::vector< std::string > subdirs;
+    {
+        // Use a separate open file so that its offset is not shared.
+        const int fd2 = ::openat(fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd2 == -1)
+            return;
+        DIR* dp = ::fdopendir(fd2);
+        if (dp == NULL) {
+            ::close(fd2);
+            return;
+        }
+        struct dirent* de;
+        while ((de = ::readdir(dp)) != NULL) {
+            const int type = dirent_type(de);
+            if (!is_dot_or_dotdot(de->d_name) &&
+                (type == -1 || type == atf_fs_stat_dir_type))
+                subdirs.push_back(de->d_name);
+        }
+        ::closedir(dp);
+    }
+    if (subdirs.size() < 2)
+        return;
+
+    std::vector< pid_t > pids;
+    for (unsigned int i = 0; i < jobs && i < subdirs.size(); i++) {
+        const pid_t pid = ::fork();
+        if (pid == -1)
+            break;
+        else if (pid == 0) {
+            int exitcode = EXIT_SUCCESS;
+            for (std::vector< std::string >::size_type j = i;
+                 j < subdirs.size(); j += jobs) {
+                try {
+                    remove_entry(fd, subdirs[j].c_str(), -1, root);
+                } catch (...) {
+                    exitcode = EXIT_FAILURE;
+                }
+            }
+            ::_exit(exitcode);
+        }
+        pids.push_back(pid);
+    }
+
+    for (std::vector< pid_t >::const_iterator iter = pids.begin();
+         iter != pids.end(); iter++) {
+        int status;
+        while (::waitpid(*iter, &status, 0) == -1 && errno == EINTR)
+            continue;
+    }
+}
+
+//!
+//! \brief Opens a directory stream on a descriptor returned by open(2).
+//!
+static
+DIR*
+fdopen_dir(const int fd, const impl::path& p)
+{
+    if (fd == -1)
+        throw atf::system_error(IMPL_NAME "::directory_iterator(" +
+                                p.str() + ")", "open(2) failed", errno);
+
+    DIR* dp = ::fdopendir(fd);
+    if (dp == NULL) {
+        const int original_errno = errno;
+        ::close(fd);
+        throw atf::system_error(IMPL_NAME "::directory_iterator(" +
+                                p.str() + ")", "fdopendir(3) failed",
+                                original_errno);
+    }
+    return dp;
+}
+
 // ------------------------------------------------------------------------
 // The "path" class.
 // ------------------------------------------------------------------------
@@ -126,6 +394,20 @@ impl::path::path(const atf_fs_path_t *p)
         throw_atf_error(err);
 }
 
+impl::path::path(atf_fs_path_t* p, adopt_tag)
+{
+    atf_fs_path_move(&m_path, p);
+    atf_fs_path_fini(p);
+}
+
+#if __cplusplus >= 201103L
+impl::path::path(path&& p)
+    noexcept
+{
+    atf_fs_path_move(&m_path, &p.m_path);
+}
+#endif
+
 impl::path::~path(void)
 {
     atf_fs_path_fini(&m_path);
@@ -177,25 +459,16 @@ impl::path::branch_path(void)
     if (atf_is_error(err))
         throw_atf_error(err);
 
-    path p(atf_fs_path_cstring(&bp));
-    atf_fs_path_fini(&bp);
-    return p;
+    return path(&bp, adopt_tag());
 }
 
 std::string
 impl::path::leaf_name(void)
     const
 {
-    atf_dynstr_t ln;
-    atf_error_t err;
-
-    err = atf_fs_path_leaf_name(&m_path, &ln);
-    if (atf_is_error(err))
-        throw_atf_error(err);
-
-    std::string s(atf_dynstr_cstring(&ln));
-    atf_dynstr_fini(&ln);
-    return s;
+    const char* str = c_str();
+    const char* slash = std::strrchr(str, '/');
+    return slash == NULL ? str : slash + 1;
 }
 
 impl::path
@@ -208,26 +481,41 @@ impl::path::to_absolute(void)
     if (atf_is_error(err))
         throw_atf_error(err);
 
-    path p(atf_fs_path_cstring(&pa));
-    atf_fs_path_fini(&pa);
-    return p;
+    return path(&pa, adopt_tag());
 }
 
 impl::path&
 impl::path::operator=(const path& p)
 {
-    atf_fs_path_t tmp;
+    if (this != &p) {
+        atf_fs_path_t tmp;
 
-    atf_error_t err = atf_fs_path_init_fmt(&tmp, "%s", p.c_str());
-    if (atf_is_error(err))
-        throw_atf_error(err);
-    else {
+        atf_error_t err = atf_fs_path_copy(&tmp, &p.m_path);
+        if (atf_is_error(err))
+            throw_atf_error(err);
+        else {
+            atf_fs_path_fini(&m_path);
+            atf_fs_path_move(&m_path, &tmp);
+            atf_fs_path_fini(&tmp);
+        }
+    }
+
+    return *this;
+}
+
+#if __cplusplus >= 201103L
+impl::path&
+impl::path::operator=(path&& p)
+    noexcept
+{
+    if (this != &p) {
         atf_fs_path_fini(&m_path);
-        m_path = tmp;
+        atf_fs_path_move(&m_path, &p.m_path);
     }
 
     return *this;
 }
+#endif
 
 bool
 impl::path::operator==(const path& p)
@@ -262,8 +550,7 @@ impl::path::operator/(const path& p)
 {
     path p2 = *this;
 
-    atf_error_t err = atf_fs_path_append_fmt(&p2.m_path, "%s",
-                                             atf_fs_path_cstring(&p.m_path));
+    atf_error_t err = atf_fs_path_append_path(&p2.m_path, &p.m_path);
     if (atf_is_error(err))
         throw_atf_error(err);
 
@@ -301,6 +588,11 @@ impl::file_info::file_info(const path& p)
         throw_atf_error(err);
 }
 
+impl::file_info::file_info(const atf_fs_stat_t* st)
+{
+    atf_fs_stat_copy(&m_stat, st);
+}
+
 impl::file_info::file_info(const file_info& fi)
 {
     atf_fs_stat_copy(&m_stat, &fi.m_stat);
@@ -410,25 +702,134 @@ impl::file_info::is_other_executable(void)
 }
 
 // ------------------------------------------------------------------------
-// The "directory" class.
+// The "directory_iterator" class.
 // ------------------------------------------------------------------------
 
-impl::directory::directory(const path& p)
+struct impl::directory_iterator::dir_impl {
+    DIR* m_dir;
+    path m_path;
+    std::string m_name;
+    int m_type;
+
+    dir_impl(DIR* dir, const path& p) :
+        m_dir(dir),
+        m_path(p),
+        m_type(-1)
+    {
+    }
+};
+
+impl::directory_iterator::directory_iterator(const path& p)
+{
+    DIR* dp = fdopen_dir(::open(p.c_str(), O_RDONLY | O_DIRECTORY |
+                                O_CLOEXEC), p);
+    try {
+        m_pimpl = new dir_impl(dp, p);
+    } catch (...) {
+        ::closedir(dp);
+        throw;
+    }
+}
+
+impl::directory_iterator::directory_iterator(const directory_iterator& parent,
+                                             const std::string& name)
+{
+    const path p = parent.m_pimpl->m_path / name;
+    DIR* dp = fdopen_dir(open_dir_at(::dirfd(parent.m_pimpl->m_dir),
+                                     name.c_str(), false), p);
+    try {
+        m_pimpl = new dir_impl(dp, p);
+    } catch (...) {
+        ::closedir(dp);
+        throw;
+    }
+}
+
+impl::directory_iterator::~directory_iterator(void)
 {
-    DIR* dp = ::opendir(p.c_str());
-    if (dp == NULL)
-        throw system_error(IMPL_NAME "::directory::directory(" +
-                           p.str() + ")", "opendir(3) failed", errno);
+    ::closedir(m_pimpl->m_dir);
+    delete m_pimpl;
+}
 
-    struct dirent* dep;
-    while ((dep = ::readdir(dp)) != NULL) {
-        path entryp = p / dep->d_name;
-        insert(value_type(dep->d_name, file_info(entryp)));
+bool
+impl::directory_iterator::next(void)
+{
+    struct dirent* de;
+    while ((errno = 0, de = ::readdir(m_pimpl->m_dir)) != NULL) {
+        if (!is_dot_or_dotdot(de->d_name)) {
+            m_pimpl->m_name = de->d_name;
+            m_pimpl->m_type = dirent_type(de);
+            return true;
+        }
     }
+    if (errno != 0)
+        throw system_error(IMPL_NAME "::directory_iterator::next(" +
+                           m_pimpl->m_path.str() + ")", "readdir(3) failed",
+                           errno);
+
+    m_pimpl->m_name.clear();
+    return false;
+}
+
+const std::string&
+impl::directory_iterator::name(void)
+    const
+{
+    PRE(!m_pimpl->m_name.empty());
+    return m_pimpl->m_name;
+}
+
+impl::path
+impl::directory_iterator::entry_path(void)
+    const
+{
+    PRE(!m_pimpl->m_name.empty());
+    return m_pimpl->m_path / m_pimpl->m_name;
+}
+
+int
+impl::directory_iterator::type(void)
+    const
+{
+    PRE(!m_pimpl->m_name.empty());
+    if (m_pimpl->m_type == -1)
+        m_pimpl->m_type = info().get_type();
+    return m_pimpl->m_type;
+}
+
+impl::file_info
+impl::directory_iterator::info(void)
+    const
+{
+    PRE(!m_pimpl->m_name.empty());
 
-    if (::closedir(dp) == -1)
-        throw system_error(IMPL_NAME "::directory::directory(" +
-                           p.str() + ")", "closedir(3) failed", errno);
+    atf_fs_stat_t st;
+    atf_error_t err = atf_fs_stat_init_at(&st, ::dirfd(m_pimpl->m_dir),
+                                          m_pimpl->m_name.c_str());
+    if (atf_is_error(err))
+        throw_atf_error(err);
+
+    const file_info fi(&st);
+    atf_fs_stat_fini(&st);
+    return fi;
+}
+
+impl::tree_visitor::~tree_visitor(void)
+{
+}
+
+// ------------------------------------------------------------------------
+// The "directory" class.
+// ------------------------------------------------------------------------
+
+impl::directory::directory(const path& p)
+{
+    directory_iterator iter(p);
+
+    insert(value_type(".", file_info(p)));
+    insert(value_type("..", file_info(p / "..")));
+    while (iter.next())
+        insert(value_type(iter.name(), iter.info()));
 }
 
 std::set< std::string >
@@ -447,6 +848,31 @@ impl::directory::names(void)
 // Free functions.
 // ------------------------------------------------------------------------
 
+void
+impl::copy_file(const path& source, const path& destination)
+{
+    const int input = ::open(source.c_str(), O_RDONLY);
+    if (input == -1)
+        throw atf::system_error(IMPL_NAME "::copy_file",
+                                "open(" + source.str() + ") failed", errno);
+
+    const int output = ::open(destination.c_str(),
+                              O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (output == -1) {
+        const int original_errno = errno;
+        ::close(input);
+        throw atf::system_error(IMPL_NAME "::copy_file",
+                                "open(" + destination.str() + ") failed",
+                                original_errno);
+    }
+
+    atf_error_t err = atf_fs_copy_fd(input, output);
+    ::close(output);
+    ::close(input);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+}
+
 bool
 impl::exists(const path& p)
 {
@@ -469,18 +895,33 @@ impl::have_prog_in_path(const std::string& prog)
     // there something is broken in the user's environment.
     if (!atf::env::has("PATH"))
         throw std::runtime_error("PATH not defined in the environment");
-    std::vector< std::string > dirs =
-        atf::text::split(atf::env::get("PATH"), ":");
 
-    bool found = false;
-    for (std::vector< std::string >::const_iterator iter = dirs.begin();
-         !found && iter != dirs.end(); iter++) {
-        const path& dir = path(*iter);
+    bool found;
+    atf_error_t err = atf_prog_cache_find(atf::env::get("PATH").c_str(),
+                                          prog.c_str(), NULL, &found);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+    return found;
+}
 
-        if (is_executable(dir / prog))
-            found = true;
+std::string
+impl::find_missing_prog(const std::vector< std::string >& progs)
+{
+    std::vector< const char* > argv;
+    for (std::vector< std::string >::const_iterator iter = progs.begin();
+         iter != progs.end(); iter++) {
+        PRE((*iter)[0] == '/' || (*iter).find('/') == std::string::npos);
+        argv.push_back((*iter).c_str());
     }
-    return found;
+    argv.push_back(NULL);
+
+    const std::string path = atf::env::get("PATH", "");
+    const char* missing;
+    atf_error_t err = atf_prog_cache_find_all(path.c_str(), &argv[0],
+                                              &missing);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+    return missing == NULL ? "" : missing;
 }
 
 bool
@@ -504,6 +945,30 @@ impl::remove(const path& p)
                                 errno);
 }
 
+void
+impl::remove_tree(const path& p, const unsigned int jobs)
+{
+    struct stat sb;
+    if (::lstat(p.c_str(), &sb) == -1)
+        remove_error(p, "lstat(2) failed", errno);
+
+    if (!S_ISDIR(sb.st_mode)) {
+        if (::unlink(p.c_str()) == -1)
+            remove_error(p, "unlink(2) failed", errno);
+        return;
+    }
+
+    const int fd = open_dir_at(AT_FDCWD, p.c_str(), true);
+    if (fd == -1)
+        remove_error(p, "open(2) failed", errno);
+    if (jobs > 1)
+        remove_subdirs_parallel(fd, jobs, p);
+    remove_contents(fd, p);
+
+    if (::rmdir(p.c_str()) == -1)
+        remove_error(p, "rmdir(2) failed", errno);
+}
+
 void
 impl::rmdir(const path& p)
 {
@@ -511,3 +976,24 @@ impl::rmdir(const path& p)
     if (atf_is_error(err))
         throw_atf_error(err);
 }
+
+static
+void
+walk_aux(impl::directory_iterator& iter, impl::tree_visitor& visitor,
+         const unsigned int depth)
+{
+    while (iter.next()) {
+        if (visitor.visit(iter, depth) &&
+            iter.type() == impl::file_info::dir_type) {
+            impl::directory_iterator subiter(iter, iter.name());
+            walk_aux(subiter, visitor, depth + 1);
+        }
+    }
+}
+
+void
+impl::walk(const path& p, tree_visitor& visitor)
+{
+    directory_iterator iter(p);
+    walk_aux(iter, visitor, 0);
+}
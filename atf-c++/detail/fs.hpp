@@ -36,6 +36,7 @@ extern "C" {
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 extern "C" {
 #include "atf-c/detail/fs.h"
@@ -70,6 +71,13 @@ class path {
     //!
     atf_fs_path_t m_path;
 
+    struct adopt_tag {};
+
+    //!
+    //! \brief Takes ownership of an initialized C path.
+    //!
+    path(atf_fs_path_t*, adopt_tag);
+
 public:
     //! \brief Constructs a new path from a user-provided string.
     //!
@@ -92,6 +100,15 @@ public:
     //!
     path(const atf_fs_path_t *);
 
+#if __cplusplus >= 201103L
+    //!
+    //! \brief Move constructor.
+    //!
+    //! The moved-from path can only be destroyed or assigned to.
+    //!
+    path(path&&) noexcept;
+#endif
+
     //!
     //! \brief Destructor for the path class.
     //!
@@ -159,6 +176,13 @@ public:
     //!
     path& operator=(const path&);
 
+#if __cplusplus >= 201103L
+    //!
+    //! \brief Move assignment operator.
+    //!
+    path& operator=(path&&) noexcept;
+#endif
+
     //!
     //! \brief Checks if two paths are equal.
     //!
@@ -232,6 +256,11 @@ public:
     //!
     explicit file_info(const path&);
 
+    //!
+    //! \brief Constructs a new file_info from already gathered data.
+    //!
+    explicit file_info(const atf_fs_stat_t*);
+
     //!
     //! \brief The copy constructor.
     //!
@@ -319,6 +348,97 @@ public:
     bool is_other_executable(void) const;
 };
 
+// ------------------------------------------------------------------------
+// The "directory_iterator" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief A lazy iterator over the entries of a directory.
+//!
+//! The entries are read one at a time as the iterator advances, and the
+//! "." and ".." entries are skipped.  The type of every entry is taken from
+//! the directory itself when the file system reports it, so an entry is
+//! only stat'ed if its type is unknown or if its full information is
+//! requested.  All lookups are relative to the open directory.
+//!
+class directory_iterator {
+    struct dir_impl;
+    dir_impl* m_pimpl;
+
+    // Non-copyable.
+    directory_iterator(const directory_iterator&);
+    directory_iterator& operator=(const directory_iterator&);
+
+public:
+    //!
+    //! \brief Opens the given directory.
+    //!
+    //! The iterator is positioned before the first entry, so next must be
+    //! called before querying it.
+    //!
+    explicit directory_iterator(const path&);
+
+    //!
+    //! \brief Opens a subdirectory of the entry of another iterator.
+    //!
+    //! The subdirectory is looked up relative to the directory of the
+    //! parent iterator and symbolic links to directories are not followed.
+    //!
+    directory_iterator(const directory_iterator&, const std::string&);
+
+    //!
+    //! \brief Closes the directory.
+    //!
+    ~directory_iterator(void);
+
+    //!
+    //! \brief Moves to the next entry.
+    //!
+    //! Returns false once all the entries have been visited.
+    //!
+    bool next(void);
+
+    //!
+    //! \brief Returns the leaf name of the current entry.
+    //!
+    const std::string& name(void) const;
+
+    //!
+    //! \brief Returns the path to the current entry.
+    //!
+    path entry_path(void) const;
+
+    //!
+    //! \brief Returns the type of the current entry.
+    //!
+    //! This only stats the entry if the file system does not report types
+    //! in its directory entries.
+    //!
+    int type(void) const;
+
+    //!
+    //! \brief Returns the information of the current entry.
+    //!
+    file_info info(void) const;
+};
+
+//!
+//! \brief A callback for the walk function.
+//!
+class tree_visitor {
+public:
+    virtual ~tree_visitor(void);
+
+    //!
+    //! \brief Visits an entry of the tree.
+    //!
+    //! The depth of the entries directly within the root of the walk is
+    //! zero.  Returning false prevents the walk from descending into the
+    //! entry if it is a directory.
+    //!
+    virtual bool visit(const directory_iterator&, const unsigned int) = 0;
+};
+
 // ------------------------------------------------------------------------
 // The "directory" class.
 // ------------------------------------------------------------------------
@@ -353,6 +473,14 @@ public:
 // Free functions.
 // ------------------------------------------------------------------------
 
+//!
+//! \brief Copies the contents of a file into another one.
+//!
+//! The destination file is created if it does not exist yet and is
+//! truncated otherwise.
+//!
+void copy_file(const path&, const path&);
+
 //!
 //! \brief Checks if the given path exists.
 //!
@@ -366,6 +494,15 @@ bool exists(const path&);
 //!
 bool have_prog_in_path(const std::string&);
 
+//!
+//! \brief Looks for all the given programs, as in require.progs.
+//!
+//! Every program is either an absolute path or a name to look for in the
+//! PATH.  Returns the first one that cannot be found, or an empty string
+//! if all of them are available.
+//!
+std::string find_missing_prog(const std::vector< std::string >&);
+
 //!
 //! \brief Checks if the given path exists, is accessible and is executable.
 //!
@@ -376,11 +513,26 @@ bool is_executable(const path&);
 //!
 void remove(const path&);
 
+//!
+//! \brief Removes a file or a whole directory tree.
+//!
+//! Directories without write or search permissions are made accessible
+//! before removing their contents, and symbolic links are removed without
+//! following them.  If jobs is greater than one, the subdirectories of the
+//! given directory are removed by up to that many processes in parallel.
+//!
+void remove_tree(const path&, const unsigned int = 1);
+
 //!
 //! \brief Removes an empty directory.
 //!
 void rmdir(const path&);
 
+//!
+//! \brief Visits all the entries below the given directory, in pre-order.
+//!
+void walk(const path&, tree_visitor&);
+
 } // namespace fs
 } // namespace atf
 
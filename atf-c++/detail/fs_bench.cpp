@@ -0,0 +1,118 @@
+// Copyright (c) 2026 The NetBSD Foundation, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+// CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+// IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the cost of the most common operations on atf::fs::path
+// objects.  This is not a test; build it with "make
+// atf-c++/detail/fs_bench" and compare its results before and after
+// changing the path code.
+
+extern "C" {
+#include <sys/time.h>
+}
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "atf-c++/detail/fs.hpp"
+
+namespace {
+
+static const char* const components[] = {
+    "tmp", "kyua.XXXXXX", "work", "atf-c++", "detail", "fs_test", "files",
+};
+static const std::size_t ncomponents =
+    sizeof(components) / sizeof(components[0]);
+
+static double
+now(void)
+{
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+report(const char* name, const double start, const unsigned long iterations,
+       const std::size_t checksum)
+{
+    const double ns = (now() - start) * 1000000000.0 / iterations;
+    std::cout << name << ": " << static_cast< unsigned long >(ns)
+              << " ns/op (checksum " << checksum << ")\n";
+}
+
+} // anonymous namespace
+
+int
+main(int argc, char** argv)
+{
+    const unsigned long iterations =
+        argc > 1 ? std::strtoul(argv[1], NULL, 10) : 1000000;
+    const atf::fs::path base("/tmp/kyua.XXXXXX/work/atf-c++/detail");
+    std::size_t checksum;
+    double start;
+
+    checksum = 0;
+    start = now();
+    for (unsigned long i = 0; i < iterations; i++) {
+        const atf::fs::path p("/tmp//kyua.XXXXXX/work/atf-c++/detail/");
+        checksum += p.str().length();
+    }
+    report("build", start, iterations, checksum);
+
+    checksum = 0;
+    start = now();
+    for (unsigned long i = 0; i < iterations; i++) {
+        const atf::fs::path p = base / components[i % ncomponents];
+        checksum += std::strlen(p.c_str());
+    }
+    report("append", start, iterations, checksum);
+
+    checksum = 0;
+    start = now();
+    for (unsigned long i = 0; i < iterations / ncomponents; i++) {
+        atf::fs::path p("/");
+        for (std::size_t j = 0; j < ncomponents; j++)
+            p = p / components[j];
+        checksum += std::strlen(p.c_str());
+    }
+    report("append-chain", start, iterations / ncomponents * ncomponents,
+           checksum);
+
+    checksum = 0;
+    start = now();
+    for (unsigned long i = 0; i < iterations; i++)
+        checksum += std::strlen(base.branch_path().c_str());
+    report("branch", start, iterations, checksum);
+
+    checksum = 0;
+    start = now();
+    for (unsigned long i = 0; i < iterations; i++)
+        checksum += base.leaf_name().length();
+    report("leaf", start, iterations, checksum);
+
+    return EXIT_SUCCESS;
+}
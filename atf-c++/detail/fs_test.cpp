@@ -28,15 +28,22 @@
 extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 }
 
 #include <fstream>
 #include <cerrno>
 #include <cstdio>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
+#include "atf-c++/detail/env.hpp"
 #include "atf-c++/detail/exceptions.hpp"
+#include "atf-c++/detail/text.hpp"
 
 // ------------------------------------------------------------------------
 // Auxiliary functions.
@@ -59,6 +66,35 @@ create_files(void)
     // situation.
 }
 
+static
+void
+create_tree(const std::string& root, const int width, const int depth)
+{
+    ::mkdir(root.c_str(), 0755);
+    for (int i = 0; i < width; i++) {
+        std::ostringstream name;
+        name << root << "/" << i;
+        std::ofstream os((name.str() + ".file").c_str());
+        os.close();
+        if (depth > 1)
+            create_tree(name.str(), width, depth - 1);
+    }
+}
+
+class recording_visitor : public atf::fs::tree_visitor {
+public:
+    std::set< std::string > visited;
+
+    bool
+    visit(const atf::fs::directory_iterator& iter, const unsigned int depth)
+    {
+        std::ostringstream entry;
+        entry << depth << " " << iter.entry_path().str();
+        visited.insert(entry.str());
+        return iter.name() != "skip";
+    }
+};
+
 // ------------------------------------------------------------------------
 // Test cases for the "path" class.
 // ------------------------------------------------------------------------
@@ -334,6 +370,82 @@ ATF_TEST_CASE_BODY(directory_names)
     ATF_REQUIRE(ns.find("reg") != ns.end());
 }
 
+// ------------------------------------------------------------------------
+// Test cases for the "directory_iterator" class.
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE(directory_iterator_read);
+ATF_TEST_CASE_HEAD(directory_iterator_read)
+{
+    set_md_var("descr", "Tests that the directory_iterator class returns "
+               "all the entries of a directory and their types");
+}
+ATF_TEST_CASE_BODY(directory_iterator_read)
+{
+    using atf::fs::directory_iterator;
+    using atf::fs::file_info;
+    using atf::fs::path;
+
+    create_files();
+
+    std::set< std::string > names;
+    directory_iterator iter(path("files"));
+    while (iter.next()) {
+        names.insert(iter.name());
+        if (iter.name() == "dir") {
+            ATF_REQUIRE_EQ(file_info::dir_type, iter.type());
+            ATF_REQUIRE_EQ(file_info::dir_type, iter.info().get_type());
+        } else {
+            ATF_REQUIRE_EQ(file_info::reg_type, iter.type());
+            ATF_REQUIRE_EQ(file_info::reg_type, iter.info().get_type());
+        }
+        ATF_REQUIRE(iter.entry_path() == path("files") / iter.name());
+    }
+    ATF_REQUIRE(!iter.next());
+
+    ATF_REQUIRE_EQ(2, names.size());
+    ATF_REQUIRE_IN("dir", names);
+    ATF_REQUIRE_IN("reg", names);
+
+    ATF_REQUIRE_THROW(atf::system_error, directory_iterator(path("missing")));
+}
+
+ATF_TEST_CASE(directory_iterator_subdir);
+ATF_TEST_CASE_HEAD(directory_iterator_subdir)
+{
+    set_md_var("descr", "Tests that the directory_iterator class opens "
+               "subdirectories relative to their parent without following "
+               "symbolic links");
+}
+ATF_TEST_CASE_BODY(directory_iterator_subdir)
+{
+    using atf::fs::directory_iterator;
+    using atf::fs::file_info;
+    using atf::fs::path;
+
+    create_files();
+    ::mkdir("files/dir/sub", 0755);
+    ATF_REQUIRE(::symlink("dir", "files/lnk") != -1);
+
+    directory_iterator iter(path("files"));
+    bool found = false;
+    while (iter.next()) {
+        if (iter.name() == "dir") {
+            directory_iterator subiter(iter, iter.name());
+            ATF_REQUIRE(subiter.next());
+            ATF_REQUIRE_EQ("sub", subiter.name());
+            ATF_REQUIRE_EQ("files/dir/sub", subiter.entry_path().str());
+            ATF_REQUIRE(!subiter.next());
+            found = true;
+        } else if (iter.name() == "lnk") {
+            ATF_REQUIRE_EQ(file_info::lnk_type, iter.type());
+            ATF_REQUIRE_THROW(atf::system_error,
+                              directory_iterator(iter, iter.name()));
+        }
+    }
+    ATF_REQUIRE(found);
+}
+
 // ------------------------------------------------------------------------
 // Test cases for the "file_info" class.
 // ------------------------------------------------------------------------
@@ -486,6 +598,64 @@ ATF_TEST_CASE_BODY(is_executable)
     ATF_REQUIRE( is_executable(path("files/reg")));
 }
 
+ATF_TEST_CASE(have_prog_in_path);
+ATF_TEST_CASE_HEAD(have_prog_in_path)
+{
+    set_md_var("descr", "Tests the have_prog_in_path and find_missing_prog "
+               "functions");
+}
+ATF_TEST_CASE_BODY(have_prog_in_path)
+{
+    using atf::fs::find_missing_prog;
+    using atf::fs::have_prog_in_path;
+
+    create_files();
+    ATF_REQUIRE(::chmod("files/reg", 0755) != -1);
+    atf::env::set("PATH", "/non-existent:" +
+                  atf::fs::path("files").to_absolute().str());
+
+    ATF_REQUIRE( have_prog_in_path("reg"));
+    ATF_REQUIRE(!have_prog_in_path("foo"));
+
+    std::vector< std::string > progs;
+    ATF_REQUIRE_EQ("", find_missing_prog(progs));
+    progs.push_back("reg");
+    progs.push_back("/bin/sh");
+    ATF_REQUIRE_EQ("", find_missing_prog(progs));
+    progs.push_back("foo");
+    progs.push_back("/non-existent/foo");
+    ATF_REQUIRE_EQ("foo", find_missing_prog(progs));
+
+    ATF_REQUIRE(::chmod("files/reg", 0644) != -1);
+    ATF_REQUIRE(!have_prog_in_path("reg"));
+    ATF_REQUIRE_EQ("reg", find_missing_prog(progs));
+}
+
+ATF_TEST_CASE(copy_file);
+ATF_TEST_CASE_HEAD(copy_file)
+{
+    set_md_var("descr", "Tests the copy_file function");
+}
+ATF_TEST_CASE_BODY(copy_file)
+{
+    using atf::fs::copy_file;
+    using atf::fs::path;
+
+    std::string contents;
+    for (int i = 0; i < 100000; i++)
+        contents += "Line " + atf::text::to_string(i) + "\n";
+    atf::utils::create_file("src", contents);
+    atf::utils::create_file("dst", "old contents that are longer\n");
+
+    copy_file(path("src"), path("dst"));
+    ATF_REQUIRE(atf::utils::compare_file("dst", contents));
+
+    ATF_REQUIRE_THROW(atf::system_error,
+                      copy_file(path("missing"), path("dst2")));
+    ATF_REQUIRE_THROW(atf::system_error,
+                      copy_file(path("src"), path("missing/dst2")));
+}
+
 ATF_TEST_CASE(remove);
 ATF_TEST_CASE_HEAD(remove)
 {
@@ -508,6 +678,83 @@ ATF_TEST_CASE_BODY(remove)
     ATF_REQUIRE( exists(path("files/dir")));
 }
 
+ATF_TEST_CASE(remove_tree);
+ATF_TEST_CASE_HEAD(remove_tree)
+{
+    set_md_var("descr", "Tests the remove_tree function");
+}
+ATF_TEST_CASE_BODY(remove_tree)
+{
+    using atf::fs::exists;
+    using atf::fs::path;
+    using atf::fs::remove_tree;
+
+    create_tree("root", 3, 4);
+    ::mkdir("outside", 0755);
+    std::ofstream os("outside/file");
+    os.close();
+    ATF_REQUIRE(::symlink("../../outside", "root/1/lnk") != -1);
+    ATF_REQUIRE(::chmod("root/0/1", 0555) != -1);
+    ATF_REQUIRE(::chmod("root/2", 0) != -1);
+
+    remove_tree(path("root"));
+    ATF_REQUIRE(!exists(path("root")));
+    ATF_REQUIRE(exists(path("outside/file")));
+
+    remove_tree(path("outside/file"));
+    ATF_REQUIRE(!exists(path("outside/file")));
+
+    ATF_REQUIRE_THROW(atf::system_error, remove_tree(path("missing")));
+}
+
+ATF_TEST_CASE(remove_tree_parallel);
+ATF_TEST_CASE_HEAD(remove_tree_parallel)
+{
+    set_md_var("descr", "Tests the remove_tree function with multiple "
+               "processes");
+}
+ATF_TEST_CASE_BODY(remove_tree_parallel)
+{
+    using atf::fs::exists;
+    using atf::fs::path;
+    using atf::fs::remove_tree;
+
+    create_tree("root", 6, 3);
+    ATF_REQUIRE(::chmod("root/3", 0555) != -1);
+
+    remove_tree(path("root"), 4);
+    ATF_REQUIRE(!exists(path("root")));
+}
+
+ATF_TEST_CASE(walk);
+ATF_TEST_CASE_HEAD(walk)
+{
+    set_md_var("descr", "Tests the walk function");
+}
+ATF_TEST_CASE_BODY(walk)
+{
+    using atf::fs::path;
+    using atf::fs::walk;
+
+    ::mkdir("root", 0755);
+    ::mkdir("root/a", 0755);
+    ::mkdir("root/a/b", 0755);
+    ::mkdir("root/skip", 0755);
+    ::mkdir("root/skip/hidden", 0755);
+    std::ofstream os("root/a/b/file");
+    os.close();
+
+    recording_visitor visitor;
+    walk(path("root"), visitor);
+
+    std::set< std::string > exp;
+    exp.insert("0 root/a");
+    exp.insert("1 root/a/b");
+    exp.insert("2 root/a/b/file");
+    exp.insert("0 root/skip");
+    ATF_REQUIRE(visitor.visited == exp);
+}
+
 // ------------------------------------------------------------------------
 // Main.
 // ------------------------------------------------------------------------
@@ -535,8 +782,17 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, directory_names);
     ATF_ADD_TEST_CASE(tcs, directory_file_info);
 
+    // Add the tests for the "directory_iterator" class.
+    ATF_ADD_TEST_CASE(tcs, directory_iterator_read);
+    ATF_ADD_TEST_CASE(tcs, directory_iterator_subdir);
+
     // Add the tests for the free functions.
+    ATF_ADD_TEST_CASE(tcs, copy_file);
     ATF_ADD_TEST_CASE(tcs, exists);
     ATF_ADD_TEST_CASE(tcs, is_executable);
+    ATF_ADD_TEST_CASE(tcs, have_prog_in_path);
     ATF_ADD_TEST_CASE(tcs, remove);
+    ATF_ADD_TEST_CASE(tcs, remove_tree);
+    ATF_ADD_TEST_CASE(tcs, remove_tree_parallel);
+    ATF_ADD_TEST_CASE(tcs, walk);
 }
@@ -26,18 +26,35 @@
 #if !defined(ATF_CXX_MACROS_HPP)
 #define ATF_CXX_MACROS_HPP
 
+#include <cstddef>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
 
 #include <atf-c++/tests.hpp>
 
+// Records describing the test cases are emitted into the atf_tcs section
+// of ELF binaries so that their list can be extracted without executing
+// them; see atf-test-program(1).
+#define ATFU_STRINGIFY(x) #x
+#define ATFU_STRINGIFY_VALUE(x) ATFU_STRINGIFY(x)
+
+#if defined(__ELF__) && defined(__GNUC__)
+#   define ATFU_RECORD(name, text) \
+    static const char name[] __attribute__((__section__("atf_tcs"), \
+                                            __used__)) = text
+#else
+#   define ATFU_RECORD(name, text) \
+    extern const char name[]
+#endif
+
 // Do not define inline methods for the test case classes.  Doing so
 // significantly increases the memory requirements of GNU G++ during
 // compilation.
 
 #define ATF_TEST_CASE_WITHOUT_HEAD(name) \
     namespace { \
+    ATFU_RECORD(atfu_record_ ## name, "tc: " #name "\n"); \
     class atfu_tc_ ## name : public atf::tests::tc { \
         void body(void) const; \
     public: \
@@ -49,6 +66,7 @@
 
 #define ATF_TEST_CASE(name) \
     namespace { \
+    ATFU_RECORD(atfu_record_ ## name, "tc-dynamic: " #name "\n"); \
     class atfu_tc_ ## name : public atf::tests::tc { \
         void head(void); \
         void body(void) const; \
@@ -61,6 +79,7 @@
 
 #define ATF_TEST_CASE_WITH_CLEANUP(name) \
     namespace { \
+    ATFU_RECORD(atfu_record_ ## name, "tc-dynamic: " #name "\n"); \
     class atfu_tc_ ## name : public atf::tests::tc { \
         void head(void); \
         void body(void) const; \
@@ -72,6 +91,68 @@
     atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::tc(#name, true) {} \
     }
 
+// Test cases whose metadata is known at build time.  The metadata is a
+// string literal with one "name: value" line per property, which is also
+// recorded in the binary.
+#define ATF_TEST_CASE_STATIC(name, md) \
+    namespace { \
+    ATFU_RECORD(atfu_record_ ## name, "tc: " #name "\n" md); \
+    class atfu_tc_ ## name : public atf::tests::tc { \
+        void head(void); \
+        void body(void) const; \
+    public: \
+        atfu_tc_ ## name(void); \
+    }; \
+    static atfu_tc_ ## name* atfu_tcptr_ ## name; \
+    atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::tc(#name, false) {} \
+    void atfu_tc_ ## name::head(void) \
+    { \
+        atf::tests::detail::set_md_text(*this, md); \
+    } \
+    }
+
+#define ATF_TEST_CASE_STATIC_WITH_CLEANUP(name, md) \
+    namespace { \
+    ATFU_RECORD(atfu_record_ ## name, \
+                "tc: " #name "\nhas.cleanup: true\n" md); \
+    class atfu_tc_ ## name : public atf::tests::tc { \
+        void head(void); \
+        void body(void) const; \
+        void cleanup(void) const; \
+    public: \
+        atfu_tc_ ## name(void); \
+    }; \
+    static atfu_tc_ ## name* atfu_tcptr_ ## name; \
+    atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::tc(#name, true) {} \
+    void atfu_tc_ ## name::head(void) \
+    { \
+        atf::tests::detail::set_md_text(*this, md); \
+    } \
+    }
+
+// Parametrized test cases, which become one test case per row of a table.
+// The first member of the row type must be an atf::tests::tc_row.
+#define ATF_TEST_CASE_PARAM(name, row_type, rows) \
+    namespace { \
+    ATFU_RECORD(atfu_record_ ## name, "tc-dynamic: " #name "\n"); \
+    typedef row_type atfu_row_ ## name; \
+    class atfu_tc_ ## name : public atf::tests::param_tc< row_type > { \
+        void head(void); \
+        void row_body(const row_type&) const; \
+    public: \
+        atfu_tc_ ## name(const row_type&); \
+    }; \
+    static const row_type* const atfu_rows_ ## name = (rows); \
+    static const std::size_t atfu_nrows_ ## name = \
+        sizeof(rows) / sizeof((rows)[0]); \
+    atfu_tc_ ## name::atfu_tc_ ## name(const row_type& row) : \
+        atf::tests::param_tc< row_type >(#name, row) {} \
+    }
+
+#define ATF_TEST_CASE_PARAM_WITHOUT_HEAD(name, row_type, rows) \
+    ATF_TEST_CASE_PARAM(name, row_type, rows) \
+    void atfu_tc_ ## name::head(void) {}
+
 #define ATF_TEST_CASE_NAME(name) atfu_tc_ ## name
 #define ATF_TEST_CASE_USE(name) (atfu_tcptr_ ## name) = NULL
 
@@ -89,31 +170,34 @@
     atfu_tc_ ## name::cleanup(void) \
         const
 
+#define ATF_TEST_CASE_PARAM_BODY(name, row) \
+    void \
+    atfu_tc_ ## name::row_body(const atfu_row_ ## name& row) \
+        const
+
 #define ATF_FAIL(reason) atf::tests::tc::fail(reason)
 
 #define ATF_SKIP(reason) atf::tests::tc::skip(reason)
 
 #define ATF_PASS() atf::tests::tc::pass()
 
+// The assertions only evaluate a predicted-not-taken condition inline.
+// The failure reports are built by out-of-line functions, which receive
+// the values through type-erased printers so that no formatting code is
+// emitted at the call sites.
 #define ATF_REQUIRE(expression) \
     do { \
-        if (!(expression)) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": " << #expression \
-                    << " not met"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
-        } \
+        if (ATF_DEFS_UNLIKELY(!(expression))) \
+            atf::tests::detail::fail_require(__LINE__, #expression); \
     } while (false)
 
 #define ATF_REQUIRE_EQ(expected, actual) \
     do { \
-        if ((expected) != (actual)) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": " \
-                    << #expected << " != " << #actual \
-                    << " (" << (expected) << " != " << (actual) << ")"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
-        } \
+        if (ATF_DEFS_UNLIKELY((expected) != (actual))) \
+            atf::tests::detail::fail_eq( \
+                __LINE__, #expected, #actual, \
+                atf::tests::detail::printer(expected), \
+                atf::tests::detail::printer(actual)); \
     } while (false)
 
 #define ATF_REQUIRE_IN(element, collection) \
@@ -124,35 +208,27 @@
 
 #define ATF_REQUIRE_MATCH(regexp, string) \
     do { \
-        if (!atf::tests::detail::match(regexp, string)) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": '" << string << "' does not " \
-                    << "match regexp '" << regexp << "'"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
-        } \
+        if (ATF_DEFS_UNLIKELY(!atf::tests::detail::match(regexp, string))) \
+            atf::tests::detail::fail_match( \
+                __LINE__, atf::tests::detail::printer(regexp), \
+                atf::tests::detail::printer(string)); \
     } while (false)
 
 #define ATF_REQUIRE_THROW(expected_exception, statement) \
     do { \
         try { \
             statement; \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ \
-                    << ": " #statement " did not throw " #expected_exception \
-                       " as expected"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
+            atf::tests::detail::fail_not_thrown( \
+                __LINE__, #statement, #expected_exception); \
+        } catch (const atf::tests::detail::row_stopped&) { \
+            throw; \
         } catch (const expected_exception&) { \
         } catch (const std::exception& atfu_e) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": " #statement " threw an " \
-                       "unexpected error (not " #expected_exception "): " \
-                    << atfu_e.what(); \
-            atf::tests::tc::fail(atfu_ss.str()); \
+            atf::tests::detail::fail_unexpected_throw( \
+                __LINE__, #statement, #expected_exception, atfu_e.what()); \
         } catch (...) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": " #statement " threw an " \
-                       "unexpected error (not " #expected_exception ")"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
+            atf::tests::detail::fail_unexpected_throw( \
+                __LINE__, #statement, #expected_exception, NULL); \
         } \
     } while (false)
 
@@ -160,31 +236,22 @@
     do { \
         try { \
             statement; \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ \
-                    << ": " #statement " did not throw " #expected_exception \
-                       " as expected"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
+            atf::tests::detail::fail_not_thrown( \
+                __LINE__, #statement, #expected_exception); \
+        } catch (const atf::tests::detail::row_stopped&) { \
+            throw; \
         } catch (const expected_exception& e) { \
-            if (!atf::tests::detail::match(regexp, e.what())) { \
-                std::ostringstream atfu_ss; \
-                atfu_ss << "Line " << __LINE__ \
-                        << ": " #statement " threw " #expected_exception "(" \
-                        << e.what() << "), but does not match '" << regexp \
-                        << "'"; \
-                atf::tests::tc::fail(atfu_ss.str()); \
-            } \
+            if (ATF_DEFS_UNLIKELY(!atf::tests::detail::match(regexp, \
+                                                             e.what()))) \
+                atf::tests::detail::fail_throw_mismatch( \
+                    __LINE__, #statement, #expected_exception, e.what(), \
+                    atf::tests::detail::printer(regexp)); \
         } catch (const std::exception& atfu_e) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": " #statement " threw an " \
-                        "unexpected error (not " #expected_exception "): " \
-                    << atfu_e.what(); \
-            atf::tests::tc::fail(atfu_ss.str()); \
+            atf::tests::detail::fail_unexpected_throw( \
+                __LINE__, #statement, #expected_exception, atfu_e.what()); \
         } catch (...) { \
-            std::ostringstream atfu_ss; \
-            atfu_ss << "Line " << __LINE__ << ": " #statement " threw an " \
-                        "unexpected error (not " #expected_exception ")"; \
-            atf::tests::tc::fail(atfu_ss.str()); \
+            atf::tests::detail::fail_unexpected_throw( \
+                __LINE__, #statement, #expected_exception, NULL); \
         } \
     } while (false)
 
@@ -196,6 +263,30 @@
     atf::tests::tc::require_errno(__FILE__, __LINE__, expected_errno, \
                                   #bool_expr, bool_expr)
 
+// Count the allocations made by the statement, which requires linking the
+// test program with libatf-c++-alloc or libatf-c-alloc.
+#define ATF_CHECK_ALLOCS_LE(max, statement) \
+    do { \
+        atf_alloc_region_t atfu_region; \
+        atf_alloc_region_begin(&atfu_region); \
+        statement; \
+        atf::tests::tc::check_allocs(__FILE__, __LINE__, max, #statement, \
+                                     atfu_region); \
+    } while (false)
+
+#define ATF_REQUIRE_ALLOCS_LE(max, statement) \
+    do { \
+        atf_alloc_region_t atfu_region; \
+        atf_alloc_region_begin(&atfu_region); \
+        statement; \
+        atf::tests::tc::require_allocs(__FILE__, __LINE__, max, #statement, \
+                                       atfu_region); \
+    } while (false)
+
+#define ATF_TP_FIXTURE(fixture, config) \
+    static void \
+    atfu_fixture_ ## fixture(const atf::tests::vars_map& config)
+
 #define ATF_INIT_TEST_CASES(tcs) \
     namespace atf { \
         namespace tests { \
@@ -204,6 +295,7 @@
         } \
     } \
     \
+    ATFU_RECORD(atfu_tp_record, "tp: c++\n"); \
     static void atfu_init_tcs(std::vector< atf::tests::tc * >&); \
     \
     int \
@@ -218,8 +310,26 @@
 
 #define ATF_ADD_TEST_CASE(tcs, tcname) \
     do { \
+        ATFU_RECORD(atfu_add_record, "add: " \
+                    ATFU_STRINGIFY_VALUE(__LINE__) " " #tcname "\n"); \
         atfu_tcptr_ ## tcname = new atfu_tc_ ## tcname(); \
         (tcs).push_back(atfu_tcptr_ ## tcname); \
     } while (0);
 
+#define ATF_ADD_TEST_CASE_PARAM(tcs, tcname) \
+    do { \
+        ATFU_RECORD(atfu_add_record, "add: " \
+                    ATFU_STRINGIFY_VALUE(__LINE__) " " #tcname "\n"); \
+        for (std::size_t atfu_i = 0; atfu_i < atfu_nrows_ ## tcname; \
+             atfu_i++) \
+            (tcs).push_back(new atfu_tc_ ## tcname( \
+                atfu_rows_ ## tcname[atfu_i])); \
+    } while (0);
+
+#define ATF_ADD_FIXTURE(tcs, fixture) \
+    do { \
+        (void)(tcs); \
+        atf::tests::detail::set_fixture(atfu_fixture_ ## fixture); \
+    } while (0);
+
 #endif // !defined(ATF_CXX_MACROS_HPP)
@@ -0,0 +1,117 @@
+// Copyright (c) 2026 The NetBSD Foundation, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+// CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+// IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+extern "C" {
+#include "atf-c/detail/tp_static.h"
+#include "atf-c/error.h"
+}
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "atf-c++/check.hpp"
+#include "atf-c++/detail/exceptions.hpp"
+#include "atf-c++/detail/process.hpp"
+#include "atf-c++/utils.hpp"
+
+// All the test cases of this program are static, so that it can check its
+// own listing.
+
+// ------------------------------------------------------------------------
+// Test cases for the static macros.
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE_STATIC(list_self,
+    "descr: Checks that the static listing of a program matches the "
+        "output of its -l flag\n"
+    "timeout: 30\n"
+    "X-property: value: with colons\n");
+ATF_TEST_CASE_BODY(list_self)
+{
+    const std::string program = get_config_var("srcdir") +
+        "/macros_static_test";
+
+    atf_dynstr_t listing;
+    bool found;
+    atf_error_t err = atf_tp_static_list(program.c_str(), &listing, &found);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    ATF_REQUIRE(found);
+    const std::string str = atf_dynstr_cstring(&listing);
+    atf_dynstr_fini(&listing);
+
+    std::vector< std::string > argv;
+    argv.push_back(program);
+    argv.push_back("-l");
+    atf::process::argv_array argva(argv);
+    std::auto_ptr< atf::check::check_result > r = atf::check::exec(argva);
+    ATF_REQUIRE(r->exited());
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, r->exitcode());
+    if (!atf::utils::compare_file(r->stdout_path(), str)) {
+        std::cout << "Static listing:\n" << str << "Output of -l:\n";
+        atf::utils::cat_file(r->stdout_path(), "");
+        ATF_FAIL("The static listing does not match the output of -l");
+    }
+
+    // The properties of C++ test cases are listed in alphabetical order.
+    ATF_REQUIRE(atf::utils::grep_string(
+        "ident: list_self\nX-property: .*\ndescr: .*\ntimeout: 30\n", str));
+    ATF_REQUIRE(atf::utils::grep_string(
+        "ident: with_cleanup\ndescr: .*\nhas.cleanup: true\n", str));
+    ATF_REQUIRE(atf::utils::grep_string("ident: without_head\n", str));
+}
+
+ATF_TEST_CASE_STATIC_WITH_CLEANUP(with_cleanup,
+    "descr: Checks that the cleanup routine of a static test case runs\n");
+ATF_TEST_CASE_BODY(with_cleanup)
+{
+    atf::utils::create_file("cookie", "");
+}
+ATF_TEST_CASE_CLEANUP(with_cleanup)
+{
+    ATF_REQUIRE(atf::utils::file_exists("cookie"));
+}
+
+ATF_TEST_CASE_WITHOUT_HEAD(without_head);
+ATF_TEST_CASE_BODY(without_head)
+{
+    ATF_REQUIRE(!has_md_var("descr"));
+}
+
+// ------------------------------------------------------------------------
+// Main.
+// ------------------------------------------------------------------------
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, list_self);
+    ATF_ADD_TEST_CASE(tcs, with_cleanup);
+    ATF_ADD_TEST_CASE(tcs, without_head);
+}
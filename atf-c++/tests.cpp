@@ -52,6 +52,9 @@ extern "C" {
 #include <vector>
 
 extern "C" {
+#include "atf-c/detail/history.h"
+#include "atf-c/detail/shard.h"
+#include "atf-c/detail/tp_server.h"
 #include "atf-c/error.h"
 #include "atf-c/tc.h"
 #include "atf-c/utils.h"
@@ -62,6 +65,7 @@ extern "C" {
 #include "atf-c++/detail/env.hpp"
 #include "atf-c++/detail/exceptions.hpp"
 #include "atf-c++/detail/fs.hpp"
+#include "atf-c++/detail/process.hpp"
 #include "atf-c++/detail/sanity.hpp"
 #include "atf-c++/detail/text.hpp"
 
@@ -113,12 +117,100 @@ detail::atf_tp_writer::tc_meta_data(const std::string& name,
     m_os.flush();
 }
 
+// ------------------------------------------------------------------------
+// Failure reports of the macros.
+// ------------------------------------------------------------------------
+
+void
+detail::printer::print_string(std::ostream& os, const void* value)
+{
+    os << static_cast< const char* >(value);
+}
+
+std::ostream&
+detail::operator<<(std::ostream& os, const printer& p)
+{
+    p.m_print(os, p.m_value);
+    return os;
+}
+
+void
+detail::fail_require(const int line, const char* expression)
+{
+    std::ostringstream ss;
+    ss << "Line " << line << ": " << expression << " not met";
+    impl::tc::fail(ss.str());
+}
+
+void
+detail::fail_eq(const int line, const char* expected_str,
+                const char* actual_str, const printer& expected,
+                const printer& actual)
+{
+    std::ostringstream ss;
+    ss << "Line " << line << ": " << expected_str << " != " << actual_str
+       << " (" << expected << " != " << actual << ")";
+    impl::tc::fail(ss.str());
+}
+
+void
+detail::fail_match(const int line, const printer& regexp,
+                   const printer& string)
+{
+    std::ostringstream ss;
+    ss << "Line " << line << ": '" << string << "' does not match regexp '"
+       << regexp << "'";
+    impl::tc::fail(ss.str());
+}
+
+void
+detail::fail_not_thrown(const int line, const char* statement,
+                        const char* exception)
+{
+    std::ostringstream ss;
+    ss << "Line " << line << ": " << statement << " did not throw "
+       << exception << " as expected";
+    impl::tc::fail(ss.str());
+}
+
+//!
+//! \brief Reports that a statement threw an exception other than the
+//! expected one.
+//!
+//! \param what The message of the exception, or NULL if it is not derived
+//! from std::exception.
+//!
+void
+detail::fail_unexpected_throw(const int line, const char* statement,
+                              const char* exception, const char* what)
+{
+    std::ostringstream ss;
+    ss << "Line " << line << ": " << statement << " threw an unexpected "
+       << "error (not " << exception << ")";
+    if (what != NULL)
+        ss << ": " << what;
+    impl::tc::fail(ss.str());
+}
+
+void
+detail::fail_throw_mismatch(const int line, const char* statement,
+                            const char* exception, const char* what,
+                            const printer& regexp)
+{
+    std::ostringstream ss;
+    ss << "Line " << line << ": " << statement << " threw " << exception
+       << "(" << what << "), but does not match '" << regexp << "'";
+    impl::tc::fail(ss.str());
+}
+
 // ------------------------------------------------------------------------
 // Free helper functions.
 // ------------------------------------------------------------------------
 
 std::string Program_Name;
 
+static void (*Fixture)(const impl::vars_map&) = NULL;
+
 static void
 set_program_name(const char* argv0)
 {
@@ -138,6 +230,33 @@ detail::match(const std::string& regexp, const std::string& str)
     return atf::text::match(str, regexp);
 }
 
+//!
+//! \brief Sets the properties given as "name: value" lines, which is the
+//! format of the metadata of the ATF_TEST_CASE_STATIC macros.
+//!
+void
+detail::set_md_text(impl::tc& tc, const std::string& text)
+{
+    const std::vector< std::string > lines = atf::text::split(text, "\n");
+    for (std::vector< std::string >::const_iterator iter = lines.begin();
+         iter != lines.end(); iter++) {
+        const std::string::size_type pos = (*iter).find(": ");
+        if (pos == std::string::npos || pos == 0)
+            throw std::runtime_error("Invalid metadata line `" + *iter + "'");
+        tc.set_md_var((*iter).substr(0, pos), (*iter).substr(pos + 2));
+    }
+}
+
+//!
+//! \brief Sets the fixture that runs once per process before the body of
+//! the first test case; see ATF_TP_FIXTURE.
+//!
+void
+detail::set_fixture(void (*fixture)(const impl::vars_map&))
+{
+    Fixture = fixture;
+}
+
 // ------------------------------------------------------------------------
 // The "tc" class.
 // ------------------------------------------------------------------------
@@ -155,10 +274,13 @@ public:
     std::string m_ident;
     atf_tc_t m_tc;
     bool m_has_cleanup;
+    bool m_is_row;
+    atf_tc_row m_row;
 
     tc_impl(const std::string& ident, const bool has_cleanup) :
         m_ident(ident),
-        m_has_cleanup(has_cleanup)
+        m_has_cleanup(has_cleanup),
+        m_is_row(false)
     {
     }
 
@@ -194,6 +316,14 @@ impl::tc::tc(const std::string& ident, const bool has_cleanup) :
 {
 }
 
+impl::tc::tc(const std::string& table, const tc_row& row) :
+    pimpl(new tc_impl(table, false))
+{
+    pimpl->m_is_row = true;
+    pimpl->m_row.m_id = row.id;
+    pimpl->m_row.m_md = row.md;
+}
+
 impl::tc::~tc(void)
 {
     cwraps.erase(&pimpl->m_tc);
@@ -220,11 +350,20 @@ impl::tc::init(const vars_map& config)
     wraps[&pimpl->m_tc] = this;
     cwraps[&pimpl->m_tc] = this;
 
-    err = atf_tc_init(&pimpl->m_tc, pimpl->m_ident.c_str(), pimpl->wrap_head,
-        pimpl->wrap_body, pimpl->m_has_cleanup ? pimpl->wrap_cleanup : NULL,
-        array.get());
+    if (pimpl->m_is_row) {
+        atf_tc_pack pack;
+        pack.m_ident = pimpl->m_ident.c_str();
+        pack.m_config = NULL;
+        pack.m_head = pimpl->wrap_head;
+        pack.m_body = pimpl->wrap_body;
+        pack.m_cleanup = NULL;
+        err = atf_tc_init_row(&pimpl->m_tc, &pack, &pimpl->m_row, array.get());
+    } else
+        err = atf_tc_init(&pimpl->m_tc, pimpl->m_ident.c_str(),
+            pimpl->wrap_head, pimpl->wrap_body,
+            pimpl->m_has_cleanup ? pimpl->wrap_cleanup : NULL, array.get());
     if (atf_is_error(err))
-        throw_atf_error(err);
+        atf::throw_atf_error(err);
 }
 
 bool
@@ -262,6 +401,18 @@ impl::tc::get_md_var(const std::string& var)
     return atf_tc_get_md_var(&pimpl->m_tc, var.c_str());
 }
 
+//!
+//! \brief Returns the name of the parametrized test case to which the
+//! test case belongs as a row, or an empty string if it is not a row.
+//!
+const std::string
+impl::tc::get_table(void)
+    const
+{
+    const char* table = atf_tc_get_table(&pimpl->m_tc);
+    return table == NULL ? "" : table;
+}
+
 const impl::vars_map
 impl::tc::get_md_vars(void)
     const
@@ -286,7 +437,7 @@ impl::tc::set_md_var(const std::string& var, const std::string& val)
 {
     atf_error_t err = atf_tc_set_md_var(&pimpl->m_tc, var.c_str(), val.c_str());
     if (atf_is_error(err))
-        throw_atf_error(err);
+        atf::throw_atf_error(err);
 }
 
 void
@@ -295,7 +446,39 @@ impl::tc::run(const std::string& resfile)
 {
     atf_error_t err = atf_tc_run(&pimpl->m_tc, resfile.c_str());
     if (atf_is_error(err))
-        throw_atf_error(err);
+        atf::throw_atf_error(err);
+}
+
+namespace {
+
+static void
+stop_row(void)
+{
+    throw detail::row_stopped();
+}
+
+} // anonymous namespace
+
+//!
+//! \brief Runs the body of a row of a parametrized test case within the
+//! calling process.
+//!
+//! Returns false if the row failed.  Rows that exit, crash or expect to do
+//! so take the calling process down with them.
+//!
+bool
+impl::tc::run_row(const std::string& resfile)
+    const
+{
+    bool failed = false;
+    try {
+        atf_error_t err = atf_tc_run_row(&pimpl->m_tc, resfile.c_str(),
+                                         stop_row, &failed);
+        if (atf_is_error(err))
+            atf::throw_atf_error(err);
+    } catch (const detail::row_stopped&) {
+    }
+    return !failed;
 }
 
 void
@@ -304,7 +487,7 @@ impl::tc::run_cleanup(void)
 {
     atf_error_t err = atf_tc_cleanup(&pimpl->m_tc);
     if (atf_is_error(err))
-        throw_atf_error(err);
+        atf::throw_atf_error(err);
 }
 
 void
@@ -363,6 +546,21 @@ impl::tc::require_errno(const char* file, const int line, const int exp_errno,
     atf_tc_require_errno(file, line, exp_errno, expr_str, result);
 }
 
+void
+impl::tc::check_allocs(const char* file, const int line, const std::size_t max,
+                       const char* expr_str, const atf_alloc_region_t& region)
+{
+    atf_tc_check_allocs(file, line, max, expr_str, &region);
+}
+
+void
+impl::tc::require_allocs(const char* file, const int line,
+                         const std::size_t max, const char* expr_str,
+                         const atf_alloc_region_t& region)
+{
+    atf_tc_require_allocs(file, line, max, expr_str, &region);
+}
+
 void
 impl::tc::expect_pass(void)
 {
@@ -461,10 +659,109 @@ init_tcs(void (*add_tcs)(tc_vector&), tc_vector& tcs,
     }
 }
 
+//!
+//! \brief Runs the fixture of the test program, if any.
+//!
+//! A failing fixture leaves no test case to run, so the program exits.
+//!
+static void
+run_fixture(const atf::tests::vars_map& vars)
+{
+    if (Fixture == NULL)
+        return;
+
+    try {
+        Fixture(vars);
+    } catch (const std::exception& e) {
+        std::cerr << Program_Name << ": ERROR: Fixture failed: " << e.what()
+                  << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+//!
+//! \brief Loads the durations recorded for the test cases of a program.
+//!
+//! Returns an empty map if durations are not being recorded or if the
+//! history cannot be read, as these are only hints.
+//!
+static std::map< std::string, long >
+load_duration_hints(const char* program)
+{
+    std::map< std::string, long > hints;
+
+    const char* file = atf_history_file();
+    if (file == NULL)
+        return hints;
+
+    atf_history_t history;
+    atf_error_t err = atf_history_init(&history, file, program);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        return hints;
+    }
+    for (size_t i = 0; i < atf_history_count(&history); i++)
+        hints[atf_history_ident(&history, i)] = atf_history_msec(&history, i);
+    atf_history_fini(&history);
+
+    return hints;
+}
+
+//!
+//! \brief Returns the test cases that belong to a shard.
+//!
+//! The duration hints of the test cases are taken from their
+//! X-duration-hint-ms property or, if not defined, from the history.
+//!
+static tc_vector
+select_shard(const tc_vector& tcs, const char* program, const size_t index,
+             const size_t count)
+{
+    const std::map< std::string, long > history =
+        load_duration_hints(program);
+
+    std::vector< std::string > names;
+    std::vector< const char* > idents;
+    std::vector< long > hints;
+    for (tc_vector::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++)
+        names.push_back((*iter)->get_md_var("ident"));
+    for (tc_vector::size_type i = 0; i < tcs.size(); i++) {
+        idents.push_back(names[i].c_str());
+
+        long hint = -1;
+        if (tcs[i]->has_md_var("X-duration-hint-ms")) {
+            try {
+                hint = atf::text::to_type< long >(
+                    tcs[i]->get_md_var("X-duration-hint-ms"));
+            } catch (const std::runtime_error&) {
+            }
+        } else if (history.find(names[i]) != history.end())
+            hint = (*history.find(names[i])).second;
+        hints.push_back(hint < 0 ? -1 : hint);
+    }
+
+    atf::auto_array< bool > selected(new bool[tcs.size() + 1]);
+    atf_error_t err = atf_shard_select(index, count, tcs.size(),
+                                       idents.empty() ? NULL : &idents[0],
+                                       hints.empty() ? NULL : &hints[0],
+                                       selected.get());
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+
+    tc_vector shard;
+    for (tc_vector::size_type i = 0; i < tcs.size(); i++) {
+        if (selected[i])
+            shard.push_back(tcs[i]);
+    }
+    return shard;
+}
+
 static int
-list_tcs(const tc_vector& tcs)
+list_tcs(const tc_vector& tcs, const char* program)
 {
     detail::atf_tp_writer writer(std::cout);
+    const std::map< std::string, long > hints = load_duration_hints(program);
 
     for (tc_vector::const_iterator iter = tcs.begin();
          iter != tcs.end(); iter++) {
@@ -483,6 +780,16 @@ list_tcs(const tc_vector& tcs)
                 writer.tc_meta_data(key, (*iter2).second);
         }
 
+        if (vars.find("X-duration-hint-ms") == vars.end()) {
+            std::map< std::string, long >::const_iterator hint =
+                hints.find((*vars.find("ident")).second);
+            if (hint != hints.end()) {
+                std::ostringstream value;
+                value << (*hint).second;
+                writer.tc_meta_data("X-duration-hint-ms", value.str());
+            }
+        }
+
         writer.end_tc();
     }
 
@@ -523,13 +830,9 @@ process_tcarg(const std::string& tcarg)
     }
 }
 
-static int
-run_tc(tc_vector& tcs, const std::string& tcarg, const atf::fs::path& resfile)
+static void
+warn_if_unsupervised(void)
 {
-    const std::pair< std::string, tc_part > fields = process_tcarg(tcarg);
-
-    impl::tc* tc = find_tc(tcs, fields.first);
-
     if (!atf::env::has("__RUNNING_INSIDE_ATF_RUN") || atf::env::get(
         "__RUNNING_INSIDE_ATF_RUN") != "internal-yes-value")
     {
@@ -539,10 +842,138 @@ run_tc(tc_vector& tcs, const std::string& tcarg, const atf::fs::path& resfile)
             "control is being applied; you may get unexpected failures; see "
             "atf-test-case(4)\n";
     }
+}
+
+static bool
+has_table(const tc_vector& tcs, const std::string& name)
+{
+    for (tc_vector::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++) {
+        if ((*iter)->get_table() == name)
+            return true;
+    }
+    return false;
+}
+
+//!
+//! \brief A row of a parametrized test case run by a subprocess of
+//! run_table.
+//!
+struct table_child {
+    impl::tc* tc;
+    std::string resfile;
+};
+
+static void run_table_child(void*) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static void
+run_table_child(void* v)
+{
+    const table_child* child = static_cast< const table_child* >(v);
+
+    child->tc->run(child->resfile);
+    std::exit(EXIT_SUCCESS);
+}
+
+//!
+//! \brief Runs a function in a subprocess.
+//!
+//! Returns true if the subprocess succeeds.
+//!
+static bool
+run_part(void (*start)(void*), void* data)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    atf::process::child proc = atf::process::fork(
+        start, atf::process::stream_inherit(),
+        atf::process::stream_inherit(), data);
+    const atf::process::status status = proc.wait();
+    return status.exited() && status.exitstatus() == EXIT_SUCCESS;
+}
+
+//!
+//! \brief Runs every row of a parametrized test case, one after the other.
+//!
+//! The rows run in the current process, except for those with the
+//! X-isolated property set, which get a subprocess each.  If a results
+//! directory was given with -R, a results file named after each row is
+//! created in it; otherwise, the results go to the standard output
+//! prefixed by the name of their test case.  The program fails if any row
+//! fails.
+//!
+static int
+run_table(const tc_vector& tcs, const std::string& table,
+          const atf::fs::path* resdir, const atf::tests::vars_map& vars)
+{
+    if (resdir != NULL && !atf::fs::exists(*resdir))
+        throw std::runtime_error("Results directory `" + resdir->str() +
+                                 "' does not exist");
+    const atf::fs::path absresdir = resdir == NULL ? atf::fs::path("/") :
+        resdir->to_absolute();
+
+    warn_if_unsupervised();
+
+    run_fixture(vars);
+
+    std::size_t failures = 0, rows = 0;
+    for (tc_vector::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++) {
+        if ((*iter)->get_table() != table)
+            continue;
+
+        const std::string ident = (*iter)->get_md_var("ident");
+        const std::string resfile = resdir == NULL ? "/dev/stdout" :
+            (absresdir / ident.substr(table.length() + 1)).str();
+
+        bool ok;
+        if ((*iter)->has_md_var("X-isolated") &&
+            (*iter)->get_md_var("X-isolated") == "true") {
+            table_child child;
+            child.tc = *iter;
+            child.resfile = resfile;
+            ok = run_part(run_table_child, &child);
+        } else
+            ok = (*iter)->run_row(resfile);
+
+        rows++;
+        if (!ok)
+            failures++;
+    }
+
+    if (failures > 0)
+        std::cerr << Program_Name << ": " << failures << " of " << rows
+                  << " rows of " << table << " failed\n";
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int
+run_tc(tc_vector& tcs, const std::string& tcarg, const atf::fs::path* resdir,
+       const atf::fs::path* resfile, const atf::tests::vars_map& vars,
+       const char* program)
+{
+    const std::pair< std::string, tc_part > fields = process_tcarg(tcarg);
+
+    if (fields.second == BODY && has_table(tcs, fields.first)) {
+        if (resfile != NULL)
+            throw usage_error("-r cannot be used with the parametrized test "
+                              "case `%s'; use -R to give a results "
+                              "directory", fields.first.c_str());
+        return run_table(tcs, fields.first, resdir, vars);
+    }
+
+    impl::tc* tc = find_tc(tcs, fields.first);
+    if (resdir != NULL)
+        throw usage_error("-R can only be used with -S or a parametrized "
+                          "test case");
+
+    warn_if_unsupervised();
 
     switch (fields.second) {
     case BODY:
-        tc->run(resfile.str());
+        run_fixture(vars);
+        atf_history_track(program, fields.first.c_str());
+        tc->run(resfile == NULL ? "/dev/stdout" : resfile->str());
         break;
     case CLEANUP:
         tc->run_cleanup();
@@ -553,14 +984,238 @@ run_tc(tc_vector& tcs, const std::string& tcarg, const atf::fs::path& resfile)
     return EXIT_SUCCESS;
 }
 
+//!
+//! \brief The part of a test case run by a subprocess of run_shard.
+//!
+struct shard_child {
+    impl::tc* tc;
+    const char* program;
+    std::string tcname;
+    std::string workdir;
+    tc_part part;
+    std::string resfile;
+};
+
+static void run_shard_child(void*) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+//!
+//! \brief Creates a directory unless it already exists.
+//!
+static void
+make_dir(const std::string& path, const char* kind)
+{
+    if (::mkdir(path.c_str(), 0755) == -1 && errno != EEXIST)
+        throw std::runtime_error(std::string("Cannot create ") + kind +
+                                 " directory `" + path + "': " +
+                                 std::strerror(errno));
+}
+
+//!
+//! \brief Creates the private directory that holds the work directories
+//! of the test cases of a shard.
+//!
+static atf::fs::path
+make_work_root(void)
+{
+    char buf[] = "atf-shard.XXXXXX";
+    if (::mkdtemp(buf) == NULL)
+        throw std::runtime_error(std::string("Cannot create work directory "
+                                             "`") + buf + "': " +
+                                 std::strerror(errno));
+    return atf::fs::path(buf).to_absolute();
+}
+
+//!
+//! \brief Removes a work directory and everything in it.
+//!
+//! Failures only deserve a warning because the results of the test cases
+//! are already known.
+//!
+static void
+remove_work_dir(const atf::fs::path& dir)
+{
+    try {
+        atf::fs::remove_tree(dir);
+    } catch (const std::runtime_error& e) {
+        std::cerr << Program_Name << ": WARNING: Cannot remove work "
+                  << "directory `" << dir.str() << "': " << e.what() << "\n";
+    }
+}
+
+static void
+run_shard_child(void* v)
+{
+    const shard_child* child = static_cast< const shard_child* >(v);
+
+    if (child->part == BODY)
+        atf_history_track(child->program, child->tcname.c_str());
+
+    if (::chdir(child->workdir.c_str()) == -1) {
+        std::cerr << Program_Name << ": ERROR: Cannot enter work directory `"
+                  << child->workdir << "': " << std::strerror(errno) << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (child->part == BODY)
+        child->tc->run(child->resfile);
+    else
+        child->tc->run_cleanup();
+    std::exit(EXIT_SUCCESS);
+}
+
+//!
+//! \brief Runs the body and the cleanup routine of every test case in a
+//! shard, one after the other.
+//!
+//! Every test case runs in a subprocess within a work directory named
+//! after it, which lives in a private directory created with mkdtemp(3) in
+//! the current directory and is removed once the cleanup routine of the
+//! test case has run.  If a results directory was given with -R, a results
+//! file named after each test case is created in it.  The rows of
+//! parametrized test cases get a directory named after their test case in
+//! both.  The fixture of the test program runs beforehand, so all the test
+//! cases inherit its results.
+//!
+static int
+run_shard(const tc_vector& tcs, const atf::fs::path* resdir,
+          const atf::tests::vars_map& vars, const char* program)
+{
+    if (resdir != NULL && !atf::fs::exists(*resdir))
+        throw std::runtime_error("Results directory `" + resdir->str() +
+                                 "' does not exist");
+    const atf::fs::path absresdir = resdir == NULL ? atf::fs::path("/") :
+        resdir->to_absolute();
+
+    warn_if_unsupervised();
+
+    if (!tcs.empty())
+        run_fixture(vars);
+
+    const atf::fs::path workroot = make_work_root();
+    bool ok = true;
+    for (tc_vector::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++) {
+        shard_child child;
+        child.tc = *iter;
+        child.program = program;
+        child.tcname = (*iter)->get_md_var("ident");
+        child.part = BODY;
+        child.workdir = (workroot / child.tcname).str();
+        child.resfile = resdir == NULL ? "/dev/stdout" :
+            (absresdir / child.tcname).str();
+
+        const std::string table = (*iter)->get_table();
+        if (!table.empty()) {
+            make_dir((workroot / table).str(), "work");
+            if (resdir != NULL)
+                make_dir((absresdir / table).str(), "results");
+        }
+        make_dir(child.workdir, "work");
+
+        if (!run_part(run_shard_child, &child))
+            ok = false;
+
+        if ((*iter)->has_md_var("has.cleanup") &&
+            (*iter)->get_md_var("has.cleanup") == "true") {
+            child.part = CLEANUP;
+            if (!run_part(run_shard_child, &child))
+                ok = false;
+        }
+
+        remove_work_dir(atf::fs::path(child.workdir));
+    }
+    remove_work_dir(workroot);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//!
+//! \brief The state of the server shared with its subprocesses.
+//!
+struct server_data {
+    tc_vector* tcs;
+    void (*add_tcs)(tc_vector&);
+    const atf::tests::vars_map* vars;
+    const char* program;
+};
+
+//!
+//! \brief Runs a request received by the server in its subprocess.
+//!
+//! The test cases are registered again, thus running their heads, only
+//! if the request overrides the configuration variables.
+//!
+static int
+serve_request(const atf_tp_server_request_t* req, void* v)
+{
+    const server_data* data = static_cast< const server_data* >(v);
+
+    try {
+        tc_vector reinit;
+        tc_vector* tcs = data->tcs;
+        if (atf_map_size(&req->m_config) > 0) {
+            atf::tests::vars_map vars = *data->vars;
+            atf_map_citer_t iter;
+            atf_map_for_each_c(iter, &req->m_config)
+                vars[atf_map_citer_key(iter)] =
+                    static_cast< const char* >(atf_map_citer_data(iter));
+            init_tcs(data->add_tcs, reinit, vars);
+            tcs = &reinit;
+        }
+
+        impl::tc* tc = find_tc(*tcs, req->m_tcname);
+
+        warn_if_unsupervised();
+
+        if (!req->m_cleanup) {
+            atf_history_track(data->program, req->m_tcname);
+            tc->run(req->m_resfile != NULL ? req->m_resfile : "/dev/stdout");
+        } else
+            tc->run_cleanup();
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << Program_Name << ": ERROR: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+}
+
+//!
+//! \brief Runs as a server for the test cases of the program until the
+//! requests stop coming.
+//!
+//! The fixture of the test program runs before serving, so the
+//! subprocesses of all requests inherit its results.
+//!
+static int
+run_server(tc_vector& tcs, void (*add_tcs)(tc_vector&),
+           const atf::tests::vars_map& vars, const char* program)
+{
+    server_data data;
+    data.tcs = &tcs;
+    data.add_tcs = add_tcs;
+    data.vars = &vars;
+    data.program = program;
+
+    run_fixture(vars);
+    atf_error_t err = atf_tp_server_serve(STDIN_FILENO, STDOUT_FILENO,
+                                          serve_request, &data);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    return EXIT_SUCCESS;
+}
+
 static int
 safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
 {
     const char* argv0 = argv[0];
 
     bool lflag = false;
+    bool rflag = false;
+    bool Rflag = false;
+    bool zflag = false;
     atf::fs::path resfile("/dev/stdout");
+    atf::fs::path resdir(".");
     std::string srcdir_arg;
+    size_t shard_index = 0, shard_count = 0;
     atf::tests::vars_map vars;
 
     int ch;
@@ -568,7 +1223,7 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
 
     old_opterr = opterr;
     ::opterr = 0;
-    while ((ch = ::getopt(argc, argv, GETOPT_POSIX ":lr:s:v:")) != -1) {
+    while ((ch = ::getopt(argc, argv, GETOPT_POSIX ":lr:R:s:S:v:Z")) != -1) {
         switch (ch) {
         case 'l':
             lflag = true;
@@ -576,16 +1231,34 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
 
         case 'r':
             resfile = atf::fs::path(::optarg);
+            rflag = true;
+            break;
+
+        case 'R':
+            resdir = atf::fs::path(::optarg);
+            Rflag = true;
             break;
 
         case 's':
             srcdir_arg = ::optarg;
             break;
 
+        case 'S':
+            if (!atf_shard_parse(::optarg, &shard_index, &shard_count))
+                throw usage_error("Invalid shard `%s'; must be of the form "
+                                  "index/count with 1 <= index <= count <= "
+                                  "32767",
+                                  ::optarg);
+            break;
+
         case 'v':
             parse_vflag(::optarg, vars);
             break;
 
+        case 'Z':
+            zflag = true;
+            break;
+
         case ':':
             throw usage_error("Option -%c requires an argument.", ::optopt);
             break;
@@ -610,12 +1283,35 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
     int errcode;
 
     tc_vector tcs;
-    if (lflag) {
+    if (zflag) {
+        if (lflag || rflag || Rflag || shard_count > 0)
+            throw usage_error("-Z cannot be combined with -l, -r, -R or -S");
+        if (argc > 0)
+            throw usage_error("Cannot provide test case names with -Z");
+
+        init_tcs(add_tcs, tcs, vars);
+        errcode = run_server(tcs, add_tcs, vars, argv0);
+    } else if (lflag) {
         if (argc > 0)
             throw usage_error("Cannot provide test case names with -l");
 
         init_tcs(add_tcs, tcs, vars);
-        errcode = list_tcs(tcs);
+        if (shard_count > 0)
+            errcode = list_tcs(select_shard(tcs, argv0, shard_index,
+                                            shard_count), argv0);
+        else
+            errcode = list_tcs(tcs, argv0);
+    } else if (shard_count > 0) {
+        if (argc > 0)
+            throw usage_error("Cannot provide test case names with -S");
+        if (rflag)
+            throw usage_error("-r cannot be combined with -S; use -R to give "
+                              "a results directory");
+
+        init_tcs(add_tcs, tcs, vars);
+        errcode = run_shard(select_shard(tcs, argv0, shard_index,
+                                         shard_count),
+                            Rflag ? &resdir : NULL, vars, argv0);
     } else {
         if (argc == 0)
             throw usage_error("Must provide a test case name");
@@ -624,7 +1320,8 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
         INV(argc == 1);
 
         init_tcs(add_tcs, tcs, vars);
-        errcode = run_tc(tcs, argv[0], resfile);
+        errcode = run_tc(tcs, argv[0], Rflag ? &resdir : NULL,
+                         rflag ? &resfile : NULL, vars, argv0);
     }
     for (tc_vector::iterator iter = tcs.begin(); iter != tcs.end(); iter++) {
         impl::tc* tc = *iter;
@@ -26,11 +26,14 @@
 #if !defined(ATF_CXX_TESTS_HPP)
 #define ATF_CXX_TESTS_HPP
 
+#include <cstddef>
+#include <iosfwd>
 #include <map>
 #include <memory>
 #include <string>
 
 extern "C" {
+#include <atf-c/alloc.h>
 #include <atf-c/defs.h>
 }
 
@@ -54,6 +57,69 @@ public:
 
 bool match(const std::string&, const std::string&);
 
+//!
+//! \brief Unwinds a row of a parametrized test case once its result is
+//! written.
+//!
+//! Row bodies run within the process of the test program and this is how
+//! they stop, so they must let it through: catching all exceptions in a
+//! row body leaves it running after its result is reported.
+//!
+struct row_stopped {
+};
+
+//!
+//! \brief A reference to a value that can be printed without knowing its
+//! type, so that the failure reports of the macros are built out of line.
+//!
+class printer {
+    const void* m_value;
+    void (*m_print)(std::ostream&, const void*);
+
+    template< class T >
+    static void
+    print(std::ostream& os, const void* value)
+    {
+        os << *static_cast< const T* >(value);
+    }
+
+    static void print_string(std::ostream&, const void*);
+
+public:
+    template< class T >
+    printer(const T& value) :
+        m_value(&value),
+        m_print(print< T >)
+    {
+    }
+
+    template< std::size_t N >
+    printer(const char (&value)[N]) :
+        m_value(value),
+        m_print(print_string)
+    {
+    }
+
+    friend std::ostream& operator<<(std::ostream&, const printer&);
+};
+
+std::ostream& operator<<(std::ostream&, const printer&);
+
+void fail_require(const int, const char*)
+    ATF_DEFS_ATTRIBUTE_COLD ATF_DEFS_ATTRIBUTE_NORETURN;
+void fail_eq(const int, const char*, const char*, const printer&,
+             const printer&)
+    ATF_DEFS_ATTRIBUTE_COLD ATF_DEFS_ATTRIBUTE_NORETURN;
+void fail_match(const int, const printer&, const printer&)
+    ATF_DEFS_ATTRIBUTE_COLD ATF_DEFS_ATTRIBUTE_NORETURN;
+void fail_not_thrown(const int, const char*, const char*)
+    ATF_DEFS_ATTRIBUTE_COLD ATF_DEFS_ATTRIBUTE_NORETURN;
+void fail_unexpected_throw(const int, const char*, const char*, const char*)
+    ATF_DEFS_ATTRIBUTE_COLD ATF_DEFS_ATTRIBUTE_NORETURN;
+void fail_throw_mismatch(const int, const char*, const char*, const char*,
+                         const printer&)
+    ATF_DEFS_ATTRIBUTE_COLD ATF_DEFS_ATTRIBUTE_NORETURN;
+
 } // namespace
 
 // ------------------------------------------------------------------------
@@ -62,6 +128,16 @@ bool match(const std::string&, const std::string&);
 
 typedef std::map< std::string, std::string > vars_map;
 
+// ------------------------------------------------------------------------
+// The "tc_row" struct.
+// ------------------------------------------------------------------------
+
+// The first member of the rows of a parametrized test case.
+struct tc_row {
+    const char* id;
+    const char* md;
+};
+
 // ------------------------------------------------------------------------
 // The "tc" class.
 // ------------------------------------------------------------------------
@@ -86,6 +162,7 @@ protected:
 
 public:
     tc(const std::string&, const bool);
+    tc(const std::string&, const tc_row&);
     virtual ~tc(void);
 
     void init(const vars_map&);
@@ -96,10 +173,12 @@ public:
     const std::string get_md_var(const std::string&) const;
     const vars_map get_md_vars(void) const;
     bool has_config_var(const std::string&) const;
+    const std::string get_table(void) const;
     bool has_md_var(const std::string&) const;
     void set_md_var(const std::string&, const std::string&);
 
     void run(const std::string&) const;
+    bool run_row(const std::string&) const;
     void run_cleanup(void) const;
 
     // To be called from the child process only.
@@ -111,6 +190,10 @@ public:
                             const bool);
     static void require_errno(const char*, const int, const int, const char*,
                               const bool);
+    static void check_allocs(const char*, const int, const std::size_t,
+                             const char*, const atf_alloc_region_t&);
+    static void require_allocs(const char*, const int, const std::size_t,
+                               const char*, const atf_alloc_region_t&);
     static void expect_pass(void);
     static void expect_fail(const std::string&);
     static void expect_exit(const int, const std::string&);
@@ -119,6 +202,39 @@ public:
     static void expect_timeout(const std::string&);
 };
 
+// ------------------------------------------------------------------------
+// The "param_tc" class.
+// ------------------------------------------------------------------------
+
+template< class Row >
+class param_tc : public tc {
+    const Row& m_row;
+
+    void
+    body(void)
+        const
+    {
+        row_body(m_row);
+    }
+
+protected:
+    virtual void row_body(const Row&) const = 0;
+
+public:
+    param_tc(const std::string& table, const Row& row) :
+        tc(table, reinterpret_cast< const tc_row& >(row)),
+        m_row(row)
+    {
+    }
+};
+
+namespace detail {
+
+void set_md_text(tc&, const std::string&);
+void set_fixture(void (*)(const vars_map&));
+
+} // namespace detail
+
 } // namespace tests
 } // namespace atf
 
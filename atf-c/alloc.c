@@ -0,0 +1,167 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/alloc.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#if defined(HAVE_MALLOC_H)
+#include <malloc.h>
+#endif
+#if defined(HAVE_MALLOC_NP_H)
+#include <malloc_np.h>
+#endif
+#include <stdint.h>
+
+#include "atf-c/detail/alloc.h"
+#include "atf-c/detail/sanity.h"
+
+/*
+ * The counters of the allocation tracker.
+ *
+ * They are only updated by the allocators of libatf-c-alloc and
+ * libatf-c++-alloc, which replace those of the C library and of the C++
+ * runtime respectively in the test programs linked with them or that
+ * preload them.  Test programs that do neither pay nothing for the
+ * tracker; the regions just see no allocations and atf_alloc_available
+ * reports so.
+ *
+ * The live bytes account for the size of the blocks as reported by the
+ * allocator, which may be larger than requested.  If the allocator cannot
+ * tell the size of a block, frees are not accounted for and the peak is
+ * the total of the bytes allocated so far.
+ *
+ * The counters are not protected against concurrent updates, so the
+ * allocations made by several threads at once may be miscounted.
+ */
+static struct tracker {
+    bool m_available;
+    int m_held;
+    size_t m_count;
+    size_t m_bytes;
+    int64_t m_live;
+    int64_t m_peak;
+} Tracker;
+
+#if defined(HAVE_MALLOC_USABLE_SIZE)
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+int64_t
+block_size(const void *ptr)
+{
+    return (int64_t)malloc_usable_size((void *)(uintptr_t)ptr);
+}
+#endif
+
+/* ---------------------------------------------------------------------
+ * Hooks for the allocation trackers.
+ * --------------------------------------------------------------------- */
+
+void
+atf_alloc_hold(void)
+{
+    Tracker.m_held++;
+}
+
+void
+atf_alloc_release(void)
+{
+    PRE(Tracker.m_held > 0);
+    Tracker.m_held--;
+}
+
+void
+atf_alloc_record_alloc(const void *ptr, const size_t size)
+{
+    Tracker.m_available = true;
+    if (Tracker.m_held > 0 || ptr == NULL)
+        return;
+
+    Tracker.m_count++;
+    Tracker.m_bytes += size;
+#if defined(HAVE_MALLOC_USABLE_SIZE)
+    Tracker.m_live += block_size(ptr);
+#else
+    Tracker.m_live += (int64_t)size;
+#endif
+    if (Tracker.m_live > Tracker.m_peak)
+        Tracker.m_peak = Tracker.m_live;
+}
+
+void
+atf_alloc_record_free(const void *ptr)
+{
+    if (Tracker.m_held > 0 || ptr == NULL)
+        return;
+
+#if defined(HAVE_MALLOC_USABLE_SIZE)
+    Tracker.m_live -= block_size(ptr);
+#endif
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+bool
+atf_alloc_available(void)
+{
+    return Tracker.m_available;
+}
+
+void
+atf_alloc_region_begin(atf_alloc_region_t *region)
+{
+    region->m_count = Tracker.m_count;
+    region->m_bytes = Tracker.m_bytes;
+    region->m_live = Tracker.m_live;
+    region->m_outer_peak = Tracker.m_peak;
+
+    Tracker.m_peak = Tracker.m_live;
+}
+
+/*
+ * Leaves a region and stores the allocations made within it in stats.
+ * The peak is relative to the live bytes when entering the region; the
+ * peak of the enclosing region, if any, accounts for it too.
+ */
+void
+atf_alloc_region_end(const atf_alloc_region_t *region,
+                     atf_alloc_stats_t *stats)
+{
+    const int64_t peak = Tracker.m_peak - region->m_live;
+
+    stats->m_count = Tracker.m_count - region->m_count;
+    stats->m_bytes = Tracker.m_bytes - region->m_bytes;
+    stats->m_peak = peak > 0 ? (size_t)peak : 0;
+
+    if (region->m_outer_peak > Tracker.m_peak)
+        Tracker.m_peak = region->m_outer_peak;
+}
@@ -0,0 +1,266 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/alloc.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/test_helpers.h"
+
+/* Keeps the compiler from eliding the allocations of the tests. */
+static void *volatile Sink;
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+alloc_and_free(const size_t size)
+{
+    Sink = malloc(size);
+    free(Sink);
+}
+
+static
+void
+init_and_run_h_tc(const char *name, void (*head)(atf_tc_t *),
+                  void (*body)(const atf_tc_t *))
+{
+    atf_tc_t tc;
+    const char *const config[] = { NULL };
+
+    RE(atf_tc_init(&tc, name, head, body, NULL, config));
+    run_h_tc(&tc, "output", "error", "result");
+    atf_tc_fini(&tc);
+}
+
+/* ---------------------------------------------------------------------
+ * Helper test cases.
+ * --------------------------------------------------------------------- */
+
+#define H_DEF(id, macro) \
+    ATF_TC_HEAD(h_ ## id, tc) \
+    { \
+        atf_tc_set_md_var(tc, "descr", "Helper test case"); \
+    } \
+    ATF_TC_BODY(h_ ## id, tc) \
+    { \
+        macro; \
+    }
+
+H_DEF(check_ok, ATF_CHECK_ALLOCS_LE(1, alloc_and_free(10)));
+H_DEF(check_fail, ATF_CHECK_ALLOCS_LE(1, (alloc_and_free(10),
+                                          alloc_and_free(20))));
+H_DEF(require_ok, ATF_REQUIRE_ALLOCS_LE(2, alloc_and_free(10)));
+H_DEF(require_fail, ATF_REQUIRE_ALLOCS_LE(0, alloc_and_free(10)));
+
+/* ---------------------------------------------------------------------
+ * Test cases for the allocation tracker.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(available);
+ATF_TC_BODY(available, tc)
+{
+    ATF_REQUIRE(atf_alloc_available());
+}
+
+ATF_TC_WITHOUT_HEAD(region_counts);
+ATF_TC_BODY(region_counts, tc)
+{
+    atf_alloc_region_t region;
+    atf_alloc_stats_t stats;
+    void *p1, *p2, *p3;
+
+    atf_alloc_region_begin(&region);
+    p1 = Sink = malloc(100);
+    p2 = Sink = calloc(2, 50);
+    p3 = Sink = realloc(NULL, 30);
+    p3 = Sink = realloc(p3, 60);
+    free(p1);
+    free(p2);
+    free(p3);
+    atf_alloc_region_end(&region, &stats);
+
+    ATF_REQUIRE_EQ(4, stats.m_count);
+    ATF_REQUIRE_EQ(290, stats.m_bytes);
+    ATF_REQUIRE(stats.m_peak >= 230);
+}
+
+ATF_TC_WITHOUT_HEAD(region_empty);
+ATF_TC_BODY(region_empty, tc)
+{
+    atf_alloc_region_t region;
+    atf_alloc_stats_t stats;
+
+    atf_alloc_region_begin(&region);
+    atf_alloc_region_end(&region, &stats);
+
+    ATF_REQUIRE_EQ(0, stats.m_count);
+    ATF_REQUIRE_EQ(0, stats.m_bytes);
+    ATF_REQUIRE_EQ(0, stats.m_peak);
+}
+
+ATF_TC_WITHOUT_HEAD(region_nested);
+ATF_TC_BODY(region_nested, tc)
+{
+    atf_alloc_region_t outer, inner;
+    atf_alloc_stats_t outer_stats, inner_stats;
+    void *p;
+
+    atf_alloc_region_begin(&outer);
+    p = Sink = malloc(1000);
+    free(p);
+
+    atf_alloc_region_begin(&inner);
+    alloc_and_free(10);
+    atf_alloc_region_end(&inner, &inner_stats);
+
+    atf_alloc_region_end(&outer, &outer_stats);
+
+    ATF_REQUIRE_EQ(1, inner_stats.m_count);
+    ATF_REQUIRE_EQ(10, inner_stats.m_bytes);
+    ATF_REQUIRE(inner_stats.m_peak >= 10);
+    ATF_REQUIRE(inner_stats.m_peak < 1000);
+
+    ATF_REQUIRE_EQ(2, outer_stats.m_count);
+    ATF_REQUIRE_EQ(1010, outer_stats.m_bytes);
+    ATF_REQUIRE(outer_stats.m_peak >= 1000);
+}
+
+ATF_TC_WITHOUT_HEAD(region_peak);
+ATF_TC_BODY(region_peak, tc)
+{
+    atf_alloc_region_t region;
+    atf_alloc_stats_t stats;
+    void *p1, *p2;
+
+    p1 = Sink = malloc(5000);
+    atf_alloc_region_begin(&region);
+    p2 = Sink = malloc(200);
+    free(p2);
+    atf_alloc_region_end(&region, &stats);
+    free(p1);
+
+    ATF_REQUIRE_EQ(1, stats.m_count);
+    ATF_REQUIRE(stats.m_peak >= 200);
+    ATF_REQUIRE(stats.m_peak < 5000);
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the macros.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(check_allocs_le);
+ATF_TC_HEAD(check_allocs_le, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the ATF_CHECK_ALLOCS_LE macro");
+}
+ATF_TC_BODY(check_allocs_le, tc)
+{
+    init_and_run_h_tc("h_check_ok", ATF_TC_HEAD_NAME(h_check_ok),
+                      ATF_TC_BODY_NAME(h_check_ok));
+    ATF_REQUIRE(atf_utils_grep_file("^passed$", "result"));
+
+    init_and_run_h_tc("h_check_fail", ATF_TC_HEAD_NAME(h_check_fail),
+                      ATF_TC_BODY_NAME(h_check_fail));
+    ATF_REQUIRE(atf_utils_grep_file("^failed", "result"));
+    ATF_REQUIRE(atf_utils_grep_file("alloc_test.c:[0-9]+: Expected at most "
+        "1 allocations in \\(alloc_and_free\\(10\\), alloc_and_free\\(20\\)"
+        "\\), got 2 \\(30 bytes, [0-9]+ bytes at peak\\)$", "error"));
+}
+
+ATF_TC(require_allocs_le);
+ATF_TC_HEAD(require_allocs_le, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the ATF_REQUIRE_ALLOCS_LE macro");
+}
+ATF_TC_BODY(require_allocs_le, tc)
+{
+    init_and_run_h_tc("h_require_ok", ATF_TC_HEAD_NAME(h_require_ok),
+                      ATF_TC_BODY_NAME(h_require_ok));
+    ATF_REQUIRE(atf_utils_grep_file("^passed$", "result"));
+
+    init_and_run_h_tc("h_require_fail", ATF_TC_HEAD_NAME(h_require_fail),
+                      ATF_TC_BODY_NAME(h_require_fail));
+    ATF_REQUIRE(atf_utils_grep_file("^failed: .*alloc_test.c:[0-9]+: Expected "
+        "at most 0 allocations in alloc_and_free\\(10\\), got 1 \\(10 "
+        "bytes, [0-9]+ bytes at peak\\)$", "result"));
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the report of the allocations of test cases.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(report);
+ATF_TC_HEAD(report, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that the allocations of the body "
+                      "of a test case follow its result if ATF_ALLOC_STATS "
+                      "is set");
+}
+ATF_TC_BODY(report, tc)
+{
+    RE(atf_env_set("ATF_ALLOC_STATS", "yes"));
+    init_and_run_h_tc("h_require_ok", ATF_TC_HEAD_NAME(h_require_ok),
+                      ATF_TC_BODY_NAME(h_require_ok));
+    ATF_REQUIRE(atf_utils_grep_file("^passed$", "result"));
+    ATF_REQUIRE(atf_utils_grep_file("^allocations: 1 calls, 10 bytes, "
+                                    "[0-9]+ bytes at peak$", "result"));
+
+    init_and_run_h_tc("h_require_fail", ATF_TC_HEAD_NAME(h_require_fail),
+                      ATF_TC_BODY_NAME(h_require_fail));
+    ATF_REQUIRE(atf_utils_grep_file("^failed: ", "result"));
+    ATF_REQUIRE(atf_utils_grep_file("^allocations: ", "result"));
+
+    RE(atf_env_set("ATF_ALLOC_STATS", ""));
+    init_and_run_h_tc("h_require_ok", ATF_TC_HEAD_NAME(h_require_ok),
+                      ATF_TC_BODY_NAME(h_require_ok));
+    ATF_REQUIRE(atf_utils_compare_file("result", "passed\n"));
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, available);
+    ATF_TP_ADD_TC(tp, region_counts);
+    ATF_TP_ADD_TC(tp, region_empty);
+    ATF_TP_ADD_TC(tp, region_nested);
+    ATF_TP_ADD_TC(tp, region_peak);
+
+    ATF_TP_ADD_TC(tp, check_allocs_le);
+    ATF_TP_ADD_TC(tp, require_allocs_le);
+
+    ATF_TP_ADD_TC(tp, report);
+
+    return atf_no_error();
+}
@@ -0,0 +1,245 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+/*
+ * The allocation tracker of the C library allocator, built as the
+ * libatf-c-alloc library.
+ *
+ * Test programs enable it by linking with the library or by preloading
+ * it, after which the allocation functions defined here replace those of
+ * the C library.  They record every allocation and free in the counters
+ * of libatf-c and forward the call to the next definition of the
+ * function, found with dlsym.
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atf-c/detail/alloc.h"
+
+typedef void *(*malloc_func)(size_t);
+typedef void *(*calloc_func)(size_t, size_t);
+typedef void *(*realloc_func)(void *, size_t);
+typedef void (*free_func)(void *);
+typedef int (*posix_memalign_func)(void **, size_t, size_t);
+typedef void *(*aligned_alloc_func)(size_t, size_t);
+
+static malloc_func Next_Malloc;
+static calloc_func Next_Calloc;
+static realloc_func Next_Realloc;
+static free_func Next_Free;
+static posix_memalign_func Next_Posix_Memalign;
+static aligned_alloc_func Next_Aligned_Alloc;
+
+/* Serves the allocations that dlsym itself may make while looking up the
+ * functions above.  Its blocks are never released. */
+static struct {
+    bool m_resolving;
+    size_t m_used;
+    union {
+        char m_bytes[4096];
+        long double m_align;
+    } m_pool;
+} Bootstrap;
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+resolve(void)
+{
+    Bootstrap.m_resolving = true;
+    Next_Malloc = (malloc_func)dlsym(RTLD_NEXT, "malloc");
+    Next_Calloc = (calloc_func)dlsym(RTLD_NEXT, "calloc");
+    Next_Realloc = (realloc_func)dlsym(RTLD_NEXT, "realloc");
+    Next_Free = (free_func)dlsym(RTLD_NEXT, "free");
+    Next_Posix_Memalign = (posix_memalign_func)dlsym(RTLD_NEXT,
+                                                     "posix_memalign");
+    Next_Aligned_Alloc = (aligned_alloc_func)dlsym(RTLD_NEXT,
+                                                   "aligned_alloc");
+    Bootstrap.m_resolving = false;
+
+    if (Next_Malloc == NULL || Next_Calloc == NULL || Next_Realloc == NULL ||
+        Next_Free == NULL)
+        abort();
+}
+
+static
+bool
+ready(void)
+{
+    if (Next_Malloc == NULL) {
+        if (Bootstrap.m_resolving)
+            return false;
+        resolve();
+    }
+    return true;
+}
+
+static
+void *
+bootstrap_alloc(const size_t size)
+{
+    const size_t align = sizeof(Bootstrap.m_pool.m_align);
+    const size_t rounded = (size + align - 1) / align * align;
+    void *ptr;
+
+    if (rounded < size ||
+        rounded > sizeof(Bootstrap.m_pool.m_bytes) - Bootstrap.m_used) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ptr = &Bootstrap.m_pool.m_bytes[Bootstrap.m_used];
+    Bootstrap.m_used += rounded;
+    return ptr;
+}
+
+static
+bool
+is_bootstrap(const void *ptr)
+{
+    const char *p = ptr;
+
+    return p >= Bootstrap.m_pool.m_bytes &&
+           p < Bootstrap.m_pool.m_bytes + sizeof(Bootstrap.m_pool.m_bytes);
+}
+
+/* ---------------------------------------------------------------------
+ * Replacements of the allocation functions.
+ * --------------------------------------------------------------------- */
+
+void *
+malloc(size_t size)
+{
+    void *ptr;
+
+    if (!ready())
+        return bootstrap_alloc(size);
+
+    ptr = Next_Malloc(size);
+    atf_alloc_record_alloc(ptr, size);
+    return ptr;
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    void *ptr;
+
+    if (!ready()) {
+        /* The pool is zeroed and never reused. */
+        if (size != 0 && nmemb > (size_t)-1 / size) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        return bootstrap_alloc(nmemb * size);
+    }
+
+    ptr = Next_Calloc(nmemb, size);
+    atf_alloc_record_alloc(ptr, nmemb * size);
+    return ptr;
+}
+
+void *
+realloc(void *old, size_t size)
+{
+    void *ptr;
+
+    if (!ready())
+        return old == NULL ? bootstrap_alloc(size) : NULL;
+
+    if (is_bootstrap(old)) {
+        const size_t avail = (size_t)(Bootstrap.m_pool.m_bytes +
+            sizeof(Bootstrap.m_pool.m_bytes) - (const char *)old);
+
+        ptr = malloc(size);
+        if (ptr != NULL)
+            memcpy(ptr, old, size < avail ? size : avail);
+        return ptr;
+    }
+
+    /* The size of the old block is only known before reallocating it.  If
+     * that fails for lack of memory, the block stays alive but is no
+     * longer accounted for. */
+    atf_alloc_record_free(old);
+    ptr = Next_Realloc(old, size);
+    atf_alloc_record_alloc(ptr, size);
+    return ptr;
+}
+
+void
+free(void *ptr)
+{
+    if (ptr == NULL || is_bootstrap(ptr) || !ready())
+        return;
+
+    atf_alloc_record_free(ptr);
+    Next_Free(ptr);
+}
+
+int
+posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    int ret;
+
+    if (!ready() || Next_Posix_Memalign == NULL)
+        return ENOMEM;
+
+    ret = Next_Posix_Memalign(ptr, alignment, size);
+    if (ret == 0)
+        atf_alloc_record_alloc(*ptr, size);
+    return ret;
+}
+
+#if defined(HAVE_ALIGNED_ALLOC)
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if (!ready() || Next_Aligned_Alloc == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ptr = Next_Aligned_Alloc(alignment, size);
+    atf_alloc_record_alloc(ptr, size);
+    return ptr;
+}
+#endif
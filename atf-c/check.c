@@ -25,10 +25,13 @@
 
 #include "atf-c/check.h"
 
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +46,7 @@
 #include "atf-c/detail/list.h"
 #include "atf-c/detail/process.h"
 #include "atf-c/detail/sanity.h"
+#include "atf-c/detail/sha256.h"
 #include "atf-c/error.h"
 #include "atf-c/utils.h"
 
@@ -126,18 +130,46 @@ init_sb(const atf_fs_path_t *path, atf_process_stream_t *sb)
     return err;
 }
 
+/* Digests a stream of the child process while it runs instead of spooling
+ * it to a file. */
+struct stream_digest {
+    bool m_enabled;
+    atf_sha256_t m_sha256;
+    char m_hex[ATF_SHA256_HEX_LENGTH];
+};
+
+static
+bool
+digest_enabled(const struct stream_digest *sd)
+{
+    return sd != NULL && sd->m_enabled;
+}
+
+static
+atf_error_t
+init_digest_sb(const atf_fs_path_t *path, const struct stream_digest *sd,
+               atf_process_stream_t *sb)
+{
+    if (digest_enabled(sd))
+        return atf_process_stream_init_capture(sb);
+    else
+        return init_sb(path, sb);
+}
+
 static
 atf_error_t
-init_sbs(const atf_fs_path_t *outfile, atf_process_stream_t *outsb,
-         const atf_fs_path_t *errfile, atf_process_stream_t *errsb)
+init_sbs(const atf_fs_path_t *outfile, const struct stream_digest *outsd,
+         atf_process_stream_t *outsb,
+         const atf_fs_path_t *errfile, const struct stream_digest *errsd,
+         atf_process_stream_t *errsb)
 {
     atf_error_t err;
 
-    err = init_sb(outfile, outsb);
+    err = init_digest_sb(outfile, outsd, outsb);
     if (atf_is_error(err))
         goto out;
 
-    err = init_sb(errfile, errsb);
+    err = init_digest_sb(errfile, errsd, errsb);
     if (atf_is_error(err)) {
         atf_process_stream_fini(outsb);
         goto out;
@@ -147,6 +179,62 @@ out:
     return err;
 }
 
+static
+atf_error_t
+drain_digests(atf_process_child_t *child, struct stream_digest *outsd,
+              struct stream_digest *errsd)
+{
+    atf_error_t err = atf_no_error();
+    struct pollfd fds[2];
+    struct stream_digest *sds[2];
+    nfds_t nfds = 0;
+    char buf[65536];
+
+    if (digest_enabled(outsd)) {
+        fds[nfds].fd = atf_process_child_stdout(child);
+        fds[nfds].events = POLLIN;
+        sds[nfds++] = outsd;
+    }
+    if (digest_enabled(errsd)) {
+        fds[nfds].fd = atf_process_child_stderr(child);
+        fds[nfds].events = POLLIN;
+        sds[nfds++] = errsd;
+    }
+
+    while (nfds > 0) {
+        nfds_t i;
+
+        if (poll(fds, nfds, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            err = atf_libc_error(errno, "Failed to poll the output of the "
+                                 "child process");
+            break;
+        }
+
+        for (i = 0; i < nfds; i++) {
+            ssize_t n;
+
+            if (fds[i].revents == 0)
+                continue;
+
+            n = read(fds[i].fd, buf, sizeof(buf));
+            if (n > 0)
+                atf_sha256_update(&sds[i]->m_sha256, buf, (size_t)n);
+            else if (n == -1 && errno == EINTR)
+                continue;
+            else {
+                fds[i] = fds[nfds - 1];
+                sds[i] = sds[nfds - 1];
+                nfds--;
+                i--;
+            }
+        }
+    }
+
+    return err;
+}
+
 struct exec_data {
     const char *const *m_argv;
 };
@@ -167,14 +255,15 @@ exec_child(void *v)
 static
 atf_error_t
 fork_and_wait(const char *const *argv, const atf_fs_path_t *outfile,
-              const atf_fs_path_t *errfile, atf_process_status_t *status)
+              struct stream_digest *outsd, const atf_fs_path_t *errfile,
+              struct stream_digest *errsd, atf_process_status_t *status)
 {
     atf_error_t err;
     atf_process_child_t child;
     atf_process_stream_t outsb, errsb;
     struct exec_data ea = { argv };
 
-    err = init_sbs(outfile, &outsb, errfile, &errsb);
+    err = init_sbs(outfile, outsd, &outsb, errfile, errsd, &errsb);
     if (atf_is_error(err))
         goto out;
 
@@ -182,6 +271,17 @@ fork_and_wait(const char *const *argv, const atf_fs_path_t *outfile,
     if (atf_is_error(err))
         goto out_sbs;
 
+    err = drain_digests(&child, outsd, errsd);
+    if (atf_is_error(err)) {
+        atf_process_status_t dummy;
+        atf_error_t err2 = atf_process_child_wait(&child, &dummy);
+        if (atf_is_error(err2))
+            atf_error_free(err2);
+        else
+            atf_process_status_fini(&dummy);
+        goto out_sbs;
+    }
+
     err = atf_process_child_wait(&child, status);
 
 out_sbs:
@@ -191,6 +291,13 @@ out:
     return err;
 }
 
+static
+int64_t
+timeval_to_usec(const struct timeval *tv)
+{
+    return (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
 static
 void
 update_success_from_status(const char *progname,
@@ -268,7 +375,7 @@ check_build_run(const char *const *argv, bool *success)
 
     print_array(argv, ">");
 
-    err = fork_and_wait(argv, NULL, NULL, &status);
+    err = fork_and_wait(argv, NULL, NULL, NULL, NULL, &status);
     if (atf_is_error(err))
         goto out;
 
@@ -290,12 +397,25 @@ struct atf_check_result_impl {
     atf_fs_path_t m_stdout;
     atf_fs_path_t m_stderr;
     atf_process_status_t m_status;
+    int64_t m_walltime;
+    struct stream_digest m_stdout_digest;
+    struct stream_digest m_stderr_digest;
 };
 
+static
+void
+stream_digest_init(struct stream_digest *sd, const bool enabled)
+{
+    sd->m_enabled = enabled;
+    atf_sha256_init(&sd->m_sha256);
+    sd->m_hex[0] = '\0';
+}
+
 static
 atf_error_t
 atf_check_result_init(atf_check_result_t *r, const char *const *argv,
-                      const atf_fs_path_t *dir)
+                      const atf_fs_path_t *dir, const bool digest_stdout,
+                      const bool digest_stderr)
 {
     atf_error_t err;
 
@@ -303,6 +423,9 @@ atf_check_result_init(atf_check_result_t *r, const char *const *argv,
     if (r->pimpl == NULL)
         return atf_no_memory_error();
 
+    stream_digest_init(&r->pimpl->m_stdout_digest, digest_stdout);
+    stream_digest_init(&r->pimpl->m_stderr_digest, digest_stderr);
+
     err = array_to_list(argv, &r->pimpl->m_argv);
     if (atf_is_error(err))
         goto out;
@@ -386,6 +509,69 @@ atf_check_result_termsig(const atf_check_result_t *r)
     return atf_process_status_termsig(&r->pimpl->m_status);
 }
 
+/* Returns the SHA-256 digest of the stdout of the command as a hexadecimal
+ * string, or NULL if stdout was spooled to a file instead. */
+const char *
+atf_check_result_stdout_digest(const atf_check_result_t *r)
+{
+    if (!r->pimpl->m_stdout_digest.m_enabled)
+        return NULL;
+    return r->pimpl->m_stdout_digest.m_hex;
+}
+
+/* Returns the size of the digested stdout of the command, in bytes. */
+int64_t
+atf_check_result_stdout_size(const atf_check_result_t *r)
+{
+    PRE(r->pimpl->m_stdout_digest.m_enabled);
+    return atf_sha256_length(&r->pimpl->m_stdout_digest.m_sha256);
+}
+
+/* Returns the SHA-256 digest of the stderr of the command as a hexadecimal
+ * string, or NULL if stderr was spooled to a file instead. */
+const char *
+atf_check_result_stderr_digest(const atf_check_result_t *r)
+{
+    if (!r->pimpl->m_stderr_digest.m_enabled)
+        return NULL;
+    return r->pimpl->m_stderr_digest.m_hex;
+}
+
+/* Returns the size of the digested stderr of the command, in bytes. */
+int64_t
+atf_check_result_stderr_size(const atf_check_result_t *r)
+{
+    PRE(r->pimpl->m_stderr_digest.m_enabled);
+    return atf_sha256_length(&r->pimpl->m_stderr_digest.m_sha256);
+}
+
+/* Returns the peak resident set size of the command, in bytes. */
+int64_t
+atf_check_result_maxrss(const atf_check_result_t *r)
+{
+    const struct rusage *ru = atf_process_status_rusage(&r->pimpl->m_status);
+#if defined(__APPLE__)
+    return (int64_t)ru->ru_maxrss;
+#else
+    return (int64_t)ru->ru_maxrss * 1024;
+#endif
+}
+
+/* Returns the user plus system CPU time of the command, in microseconds. */
+int64_t
+atf_check_result_cputime(const atf_check_result_t *r)
+{
+    const struct rusage *ru = atf_process_status_rusage(&r->pimpl->m_status);
+    return timeval_to_usec(&ru->ru_utime) + timeval_to_usec(&ru->ru_stime);
+}
+
+/* Returns the elapsed wall-clock time of the command, in microseconds. */
+int64_t
+atf_check_result_walltime(const atf_check_result_t *r)
+{
+    return r->pimpl->m_walltime;
+}
+
 /* ---------------------------------------------------------------------
  * Free functions.
  * --------------------------------------------------------------------- */
@@ -455,27 +641,46 @@ out:
 
 atf_error_t
 atf_check_exec_array(const char *const *argv, atf_check_result_t *r)
+{
+    return atf_check_exec_array_digest(argv, false, false, r);
+}
+
+atf_error_t
+atf_check_exec_array_digest(const char *const *argv, const bool digest_stdout,
+                            const bool digest_stderr, atf_check_result_t *r)
 {
     atf_error_t err;
     atf_fs_path_t dir;
+    struct timeval start, end;
 
     err = create_tmpdir(&dir);
     if (atf_is_error(err))
         goto out;
 
-    err = atf_check_result_init(r, argv, &dir);
+    err = atf_check_result_init(r, argv, &dir, digest_stdout, digest_stderr);
     if (atf_is_error(err)) {
         atf_error_t err2 = atf_fs_rmdir(&dir);
         INV(!atf_is_error(err2));
         goto out;
     }
 
-    err = fork_and_wait(argv, &r->pimpl->m_stdout, &r->pimpl->m_stderr,
+    (void)gettimeofday(&start, NULL);
+    err = fork_and_wait(argv, &r->pimpl->m_stdout, &r->pimpl->m_stdout_digest,
+                        &r->pimpl->m_stderr, &r->pimpl->m_stderr_digest,
                         &r->pimpl->m_status);
+    (void)gettimeofday(&end, NULL);
     if (atf_is_error(err)) {
         atf_check_result_fini(r);
         goto out;
     }
+    r->pimpl->m_walltime = timeval_to_usec(&end) - timeval_to_usec(&start);
+
+    if (digest_stdout)
+        atf_sha256_final_hex(&r->pimpl->m_stdout_digest.m_sha256,
+                             r->pimpl->m_stdout_digest.m_hex);
+    if (digest_stderr)
+        atf_sha256_final_hex(&r->pimpl->m_stderr_digest.m_sha256,
+                             r->pimpl->m_stderr_digest.m_hex);
 
     INV(!atf_is_error(err));
 
@@ -27,6 +27,7 @@
 #define ATF_C_CHECK_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <atf-c/error_fwd.h>
 
@@ -50,6 +51,13 @@ bool atf_check_result_exited(const atf_check_result_t *);
 int atf_check_result_exitcode(const atf_check_result_t *);
 bool atf_check_result_signaled(const atf_check_result_t *);
 int atf_check_result_termsig(const atf_check_result_t *);
+const char *atf_check_result_stdout_digest(const atf_check_result_t *);
+int64_t atf_check_result_stdout_size(const atf_check_result_t *);
+const char *atf_check_result_stderr_digest(const atf_check_result_t *);
+int64_t atf_check_result_stderr_size(const atf_check_result_t *);
+int64_t atf_check_result_maxrss(const atf_check_result_t *);
+int64_t atf_check_result_cputime(const atf_check_result_t *);
+int64_t atf_check_result_walltime(const atf_check_result_t *);
 
 /* ---------------------------------------------------------------------
  * Free functions.
@@ -65,5 +73,7 @@ atf_error_t atf_check_build_cxx_o(const char *, const char *,
                                   const char *const [],
                                   bool *);
 atf_error_t atf_check_exec_array(const char *const *, atf_check_result_t *);
+atf_error_t atf_check_exec_array_digest(const char *const *, const bool,
+                                        const bool, atf_check_result_t *);
 
 #endif /* !defined(ATF_C_CHECK_H) */
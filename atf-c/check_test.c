@@ -353,6 +353,41 @@ ATF_TC_BODY(exec_cleanup, tc)
     atf_fs_path_fini(&out);
 }
 
+ATF_TC(exec_digest);
+ATF_TC_HEAD(exec_digest, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that atf_check_exec_array_digest "
+                      "hashes the requested streams instead of saving them");
+}
+ATF_TC_BODY(exec_digest, tc)
+{
+    const char *argv[] = { "/bin/sh", "-c", NULL, NULL };
+    atf_check_result_t result;
+
+    argv[2] = "echo foo; echo bar 1>&2";
+    RE(atf_check_exec_array_digest(argv, true, false, &result));
+    ATF_CHECK(atf_check_result_exited(&result));
+    ATF_CHECK_STREQ("b5bb9d8014a0f9b1d61e21e796d78dccdf1352f23cd32812f4850b878"
+                    "ae4944c", atf_check_result_stdout_digest(&result));
+    ATF_CHECK_EQ(4, atf_check_result_stdout_size(&result));
+    ATF_CHECK(atf_check_result_stderr_digest(&result) == NULL);
+    ATF_CHECK(atf_utils_grep_file("bar", atf_check_result_stderr(&result)));
+    atf_check_result_fini(&result);
+
+    /* Larger than a pipe buffer and written to both streams. */
+    argv[2] = "i=0; while [ $i -lt 20 ]; do echo bar 1>&2; i=$((i+1)); done;"
+        "yes | head -n 500000";
+    RE(atf_check_exec_array_digest(argv, true, true, &result));
+    ATF_CHECK(atf_check_result_exited(&result));
+    ATF_CHECK_EQ(EXIT_SUCCESS, atf_check_result_exitcode(&result));
+    ATF_CHECK_STREQ("f893c2c2c50aec163cf36deb88e21b61c336fa93c0482b945337862cf"
+                    "feca280", atf_check_result_stdout_digest(&result));
+    ATF_CHECK_EQ(1000000, atf_check_result_stdout_size(&result));
+    ATF_CHECK(atf_check_result_stderr_digest(&result) != NULL);
+    ATF_CHECK_EQ(80, atf_check_result_stderr_size(&result));
+    atf_check_result_fini(&result);
+}
+
 ATF_TC(exec_exitstatus);
 ATF_TC_HEAD(exec_exitstatus, tc)
 {
@@ -390,6 +425,26 @@ ATF_TC_BODY(exec_exitstatus, tc)
     }
 }
 
+ATF_TC(exec_rusage);
+ATF_TC_HEAD(exec_rusage, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that atf_check_exec_array "
+                      "records the resources consumed by the executed "
+                      "command");
+}
+ATF_TC_BODY(exec_rusage, tc)
+{
+    atf_check_result_t result;
+
+    do_exec(tc, "exit-success", &result);
+    ATF_CHECK(atf_check_result_exited(&result));
+    ATF_CHECK(atf_check_result_maxrss(&result) > 0);
+    ATF_CHECK(atf_check_result_cputime(&result) >= 0);
+    ATF_CHECK(atf_check_result_walltime(&result) > 0);
+    ATF_CHECK(atf_check_result_walltime(&result) < 60 * 1000000);
+    atf_check_result_fini(&result);
+}
+
 ATF_TC(exec_stdout_stderr);
 ATF_TC_HEAD(exec_stdout_stderr, tc)
 {
@@ -512,7 +567,9 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, build_cxx_o);
     ATF_TP_ADD_TC(tp, exec_array);
     ATF_TP_ADD_TC(tp, exec_cleanup);
+    ATF_TP_ADD_TC(tp, exec_digest);
     ATF_TP_ADD_TC(tp, exec_exitstatus);
+    ATF_TP_ADD_TC(tp, exec_rusage);
     ATF_TP_ADD_TC(tp, exec_stdout_stderr);
     ATF_TP_ADD_TC(tp, exec_umask);
     ATF_TP_ADD_TC(tp, exec_unknown);
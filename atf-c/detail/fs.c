@@ -23,6 +23,11 @@
  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
 
+/* Needed to get the copy_file_range(2) prototype from glibc. */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "atf-c/detail/fs.h"
 
 #if defined(HAVE_CONFIG_H)
@@ -30,13 +35,21 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <sys/param.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
+#if defined(HAVE_LINUX_FS_H)
+#include <linux/fs.h>
+#endif
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -56,10 +69,18 @@
 
 static bool check_umask(const mode_t, const mode_t);
 static atf_error_t copy_contents(const atf_fs_path_t *, char **);
+static bool copy_fd_clone(const int, const int, atf_error_t *);
+static bool copy_fd_range(const int, const int, atf_error_t *);
+static bool copy_fd_sendfile(const int, const int, atf_error_t *);
+static atf_error_t copy_fd_buffered(const int, const int);
 static mode_t current_umask(void);
 static atf_error_t do_mkdtemp(char *);
-static atf_error_t normalize(atf_dynstr_t *, char *);
-static atf_error_t normalize_ap(atf_dynstr_t *, const char *, va_list);
+static atf_error_t path_append_ap(atf_fs_path_t *, const char *, va_list);
+static atf_error_t path_append_normalized(atf_fs_path_t *, const char *);
+static char *path_data(atf_fs_path_t *);
+static void path_init_empty(atf_fs_path_t *);
+static atf_error_t path_init_raw(atf_fs_path_t *, const char *, const size_t);
+static atf_error_t path_reserve(atf_fs_path_t *, const size_t);
 static void replace_contents(atf_fs_path_t *, const char *);
 static const char *stat_type_to_string(const int);
 
@@ -177,11 +198,11 @@ copy_contents(const atf_fs_path_t *p, char **buf)
     atf_error_t err;
     char *str;
 
-    str = (char *)malloc(atf_dynstr_length(&p->m_data) + 1);
+    str = (char *)malloc(p->m_length + 1);
     if (str == NULL)
         err = atf_no_memory_error();
     else {
-        strcpy(str, atf_dynstr_cstring(&p->m_data));
+        memcpy(str, atf_fs_path_cstring(p), p->m_length + 1);
         *buf = str;
         err = atf_no_error();
     }
@@ -234,59 +255,166 @@ do_mkstemp(char *tmpl, int *fdout)
     return err;
 }
 
+/*
+ * Formats a string and appends its normalized form to the path.  The
+ * common "%s" format is special-cased to skip formatting altogether, and
+ * other formats are expanded into a stack buffer if they fit in it.
+ */
 static
 atf_error_t
-normalize(atf_dynstr_t *d, char *p)
+path_append_ap(atf_fs_path_t *p, const char *fmt, va_list ap)
 {
-    const char *ptr;
-    char *last;
+    char buf[ATF_FS_PATH_INLINE_SIZE];
+    char *str;
     atf_error_t err;
-    bool first;
+    va_list ap2;
 
-    PRE(strlen(p) > 0);
-    PRE(atf_dynstr_length(d) == 0);
+    str = NULL;
+    if (strcmp(fmt, "%s") == 0) {
+        va_copy(ap2, ap);
+        err = path_append_normalized(p, va_arg(ap2, const char *));
+        va_end(ap2);
+    } else {
+        int len;
+
+        va_copy(ap2, ap);
+        len = vsnprintf(buf, sizeof(buf), fmt, ap2);
+        va_end(ap2);
+        if (len >= 0 && (size_t)len < sizeof(buf))
+            err = path_append_normalized(p, buf);
+        else {
+            va_copy(ap2, ap);
+            err = atf_text_format_ap(&str, fmt, ap2);
+            va_end(ap2);
+            if (!atf_is_error(err)) {
+                err = path_append_normalized(p, str);
+                free(str);
+            }
+        }
+    }
 
-    if (p[0] == '/')
-        err = atf_dynstr_append_fmt(d, "/");
-    else
-        err = atf_no_error();
+    return err;
+}
+
+/*
+ * Appends the components of src to the path, copying them straight into
+ * the storage of the path: repeated delimiters are collapsed and trailing
+ * ones are dropped.  A leading delimiter is only kept if the path was
+ * empty.  src may point into the path itself.
+ */
+static
+atf_error_t
+path_append_normalized(atf_fs_path_t *p, const char *src)
+{
+    const size_t srclen = strlen(src);
+    const char *data = path_data(p);
+    const bool inside = src >= data && src <= data + p->m_length;
+    const size_t offset = inside ? (size_t)(src - data) : 0;
+    atf_error_t err;
 
-    first = true;
-    last = NULL; /* Silence GCC warning. */
-    ptr = strtok_r(p, "/", &last);
-    while (!atf_is_error(err) && ptr != NULL) {
-        if (strlen(ptr) > 0) {
-            err = atf_dynstr_append_fmt(d, "%s%s", first ? "" : "/", ptr);
-            first = false;
+    PRE(srclen > 0);
+
+    /* The normalized string is never longer than the original one. */
+    err = path_reserve(p, p->m_length + 1 + srclen);
+    if (!atf_is_error(err)) {
+        char *dst = path_data(p);
+        size_t len = p->m_length;
+        size_t i = 0;
+
+        if (inside)
+            src = dst + offset;
+
+        if (len == 0 && src[0] == '/')
+            dst[len++] = '/';
+        while (i < srclen) {
+            while (i < srclen && src[i] == '/')
+                i++;
+            if (i == srclen)
+                break;
+
+            if (len > 0 && dst[len - 1] != '/')
+                dst[len++] = '/';
+            while (i < srclen && src[i] != '/')
+                dst[len++] = src[i++];
         }
+        dst[len] = '\0';
+        p->m_length = len;
+    }
 
-        ptr = strtok_r(NULL, "/", &last);
+    return err;
+}
+
+static
+char *
+path_data(atf_fs_path_t *p)
+{
+    return p->m_heap != NULL ? p->m_heap : p->m_inline;
+}
+
+static
+void
+path_init_empty(atf_fs_path_t *p)
+{
+    p->m_heap = NULL;
+    p->m_heapsize = 0;
+    p->m_length = 0;
+    p->m_inline[0] = '\0';
+}
+
+/*
+ * Initializes a path from a string that is already normalized.
+ */
+static
+atf_error_t
+path_init_raw(atf_fs_path_t *p, const char *str, const size_t length)
+{
+    atf_error_t err;
+
+    path_init_empty(p);
+    err = path_reserve(p, length);
+    if (!atf_is_error(err)) {
+        char *dst = path_data(p);
+
+        memcpy(dst, str, length);
+        dst[length] = '\0';
+        p->m_length = length;
     }
 
     return err;
 }
 
+/*
+ * Ensures that the path can hold a string of the given length.  Paths are
+ * kept in the buffer embedded in atf_fs_path_t and only move to the heap
+ * once they outgrow it.
+ */
 static
 atf_error_t
-normalize_ap(atf_dynstr_t *d, const char *p, va_list ap)
+path_reserve(atf_fs_path_t *p, const size_t length)
 {
-    char *str;
     atf_error_t err;
-    va_list ap2;
+    size_t size;
+    char *buf;
 
-    err = atf_dynstr_init(d);
-    if (atf_is_error(err))
+    size = p->m_heap != NULL ? p->m_heapsize : sizeof(p->m_inline);
+    if (length < size) {
+        err = atf_no_error();
         goto out;
+    }
 
-    va_copy(ap2, ap);
-    err = atf_text_format_ap(&str, p, ap2);
-    va_end(ap2);
-    if (atf_is_error(err))
-        atf_dynstr_fini(d);
-    else {
-        err = normalize(d, str);
-        free(str);
+    while (size <= length)
+        size *= 2;
+
+    buf = (char *)realloc(p->m_heap, size);
+    if (buf == NULL) {
+        err = atf_no_memory_error();
+        goto out;
     }
+    if (p->m_heap == NULL)
+        memcpy(buf, p->m_inline, p->m_length + 1);
+    p->m_heap = buf;
+    p->m_heapsize = size;
+    err = atf_no_error();
 
 out:
     return err;
@@ -296,14 +424,9 @@ static
 void
 replace_contents(atf_fs_path_t *p, const char *buf)
 {
-    atf_error_t err;
+    PRE(p->m_length == strlen(buf));
 
-    PRE(atf_dynstr_length(&p->m_data) == strlen(buf));
-
-    atf_dynstr_clear(&p->m_data);
-    err = atf_dynstr_append_fmt(&p->m_data, "%s", buf);
-
-    INV(!atf_is_error(err));
+    memcpy(path_data(p), buf, p->m_length + 1);
 }
 
 static
@@ -336,6 +459,162 @@ stat_type_to_string(const int type)
     return str;
 }
 
+/*
+ * Tries to share the extents of the whole input file with the output
+ * file.  This is only possible if nothing has been consumed from the
+ * input yet, if the output is still empty and if both files live in a
+ * file system supporting reflinks.  Returns false without touching err
+ * if nothing was cloned.  Otherwise, the data is in place and err tells
+ * whether the file offsets could be left at the end of both files as if
+ * the data had been copied; the caller must not copy it again either way.
+ */
+static
+bool
+copy_fd_clone(const int in, const int out, atf_error_t *err)
+{
+#if defined(FICLONE)
+    struct stat sb;
+
+    if (lseek(in, 0, SEEK_CUR) != 0 || fstat(out, &sb) == -1 ||
+        !S_ISREG(sb.st_mode) || sb.st_size != 0)
+        return false;
+
+    if (ioctl(out, FICLONE, in) == -1)
+        return false;
+
+    if (fstat(in, &sb) == -1 || lseek(in, sb.st_size, SEEK_SET) == -1 ||
+        lseek(out, sb.st_size, SEEK_SET) == -1)
+        *err = atf_libc_error(errno, "Cannot seek past cloned data");
+    else
+        *err = atf_no_error();
+    return true;
+#else
+    (void)in;
+    (void)out;
+    (void)err;
+    return false;
+#endif
+}
+
+/*
+ * Copies data between the two files within the kernel.  Returns false
+ * without touching err if the files do not support this operation and
+ * nothing was copied, in which case the caller has to fall back to a
+ * different mechanism.
+ */
+static
+bool
+copy_fd_range(const int in, const int out, atf_error_t *err)
+{
+#if defined(HAVE_COPY_FILE_RANGE)
+    ssize_t n;
+    bool copied = false;
+
+    while ((n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0)) != 0) {
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (!copied && (errno == EXDEV || errno == EINVAL ||
+                            errno == ENOSYS || errno == EOPNOTSUPP ||
+                            errno == EBADF))
+                return false;
+            *err = atf_libc_error(errno, "Failed to copy file data");
+            return true;
+        }
+        copied = true;
+    }
+
+    *err = atf_no_error();
+    return true;
+#else
+    (void)in;
+    (void)out;
+    (void)err;
+    return false;
+#endif
+}
+
+/*
+ * Same as copy_fd_range but using sendfile(2), which supports some
+ * combinations of file descriptors that copy_file_range(2) rejects.
+ */
+static
+bool
+copy_fd_sendfile(const int in, const int out, atf_error_t *err)
+{
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+    ssize_t n;
+    bool copied = false;
+
+    while ((n = sendfile(out, in, NULL, 1 << 30)) != 0) {
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (!copied && (errno == EINVAL || errno == ENOSYS ||
+                            errno == EOPNOTSUPP))
+                return false;
+            *err = atf_libc_error(errno, "Failed to copy file data");
+            return true;
+        }
+        copied = true;
+    }
+
+    *err = atf_no_error();
+    return true;
+#else
+    (void)in;
+    (void)out;
+    (void)err;
+    return false;
+#endif
+}
+
+/*
+ * Copies data between the two files through a user-space buffer.  This
+ * works for any kind of file descriptors.
+ */
+static
+atf_error_t
+copy_fd_buffered(const int in, const int out)
+{
+    const size_t bufsize = 128 * 1024;
+    atf_error_t err;
+    char *buf;
+    ssize_t n;
+
+    buf = malloc(bufsize);
+    if (buf == NULL)
+        return atf_no_memory_error();
+
+    err = atf_no_error();
+    while ((n = read(in, buf, bufsize)) != 0) {
+        ssize_t done;
+
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            err = atf_libc_error(errno, "Failed to read file data");
+            break;
+        }
+
+        done = 0;
+        while (done < n) {
+            const ssize_t w = write(out, buf + done, n - done);
+            if (w == -1) {
+                if (errno == EINTR)
+                    continue;
+                err = atf_libc_error(errno, "Failed to write file data");
+                goto out;
+            }
+            done += w;
+        }
+    }
+
+out:
+    free(buf);
+    return err;
+}
+
 /* ---------------------------------------------------------------------
  * The "atf_fs_path" type.
  * --------------------------------------------------------------------- */
@@ -350,9 +629,13 @@ atf_fs_path_init_ap(atf_fs_path_t *p, const char *fmt, va_list ap)
     atf_error_t err;
     va_list ap2;
 
+    path_init_empty(p);
+
     va_copy(ap2, ap);
-    err = normalize_ap(&p->m_data, fmt, ap2);
+    err = path_append_ap(p, fmt, ap2);
     va_end(ap2);
+    if (atf_is_error(err))
+        atf_fs_path_fini(p);
 
     return err;
 }
@@ -373,13 +656,25 @@ atf_fs_path_init_fmt(atf_fs_path_t *p, const char *fmt, ...)
 atf_error_t
 atf_fs_path_copy(atf_fs_path_t *dest, const atf_fs_path_t *src)
 {
-    return atf_dynstr_copy(&dest->m_data, &src->m_data);
+    return path_init_raw(dest, atf_fs_path_cstring(src), src->m_length);
+}
+
+/*
+ * Initializes dest with the contents of src without copying them if they
+ * live in the heap.  src is left as an empty path that must still be
+ * finalized.
+ */
+void
+atf_fs_path_move(atf_fs_path_t *dest, atf_fs_path_t *src)
+{
+    *dest = *src;
+    path_init_empty(src);
 }
 
 void
 atf_fs_path_fini(atf_fs_path_t *p)
 {
-    atf_dynstr_fini(&p->m_data);
+    free(p->m_heap);
 }
 
 /*
@@ -389,19 +684,22 @@ atf_fs_path_fini(atf_fs_path_t *p)
 atf_error_t
 atf_fs_path_branch_path(const atf_fs_path_t *p, atf_fs_path_t *bp)
 {
-    const size_t endpos = atf_dynstr_rfind_ch(&p->m_data, '/');
+    const char *str = atf_fs_path_cstring(p);
+    size_t endpos = p->m_length;
     atf_error_t err;
 
-    if (endpos == atf_dynstr_npos)
-        err = atf_fs_path_init_fmt(bp, ".");
-    else if (endpos == 0)
-        err = atf_fs_path_init_fmt(bp, "/");
+    while (endpos > 0 && str[endpos - 1] != '/')
+        endpos--;
+
+    if (endpos == 0)
+        err = path_init_raw(bp, ".", 1);
+    else if (endpos == 1)
+        err = path_init_raw(bp, "/", 1);
     else
-        err = atf_dynstr_init_substr(&bp->m_data, &p->m_data, 0, endpos);
+        err = path_init_raw(bp, str, endpos - 1);
 
 #if defined(HAVE_CONST_DIRNAME)
-    INV(atf_equal_dynstr_cstring(&bp->m_data,
-                                 dirname(atf_dynstr_cstring(&p->m_data))));
+    INV(strcmp(atf_fs_path_cstring(bp), dirname(str)) == 0);
 #endif /* defined(HAVE_CONST_DIRNAME) */
 
     return err;
@@ -410,25 +708,23 @@ atf_fs_path_branch_path(const atf_fs_path_t *p, atf_fs_path_t *bp)
 const char *
 atf_fs_path_cstring(const atf_fs_path_t *p)
 {
-    return atf_dynstr_cstring(&p->m_data);
+    return p->m_heap != NULL ? p->m_heap : p->m_inline;
 }
 
 atf_error_t
 atf_fs_path_leaf_name(const atf_fs_path_t *p, atf_dynstr_t *ln)
 {
-    size_t begpos = atf_dynstr_rfind_ch(&p->m_data, '/');
+    const char *str = atf_fs_path_cstring(p);
+    size_t begpos = p->m_length;
     atf_error_t err;
 
-    if (begpos == atf_dynstr_npos)
-        begpos = 0;
-    else
-        begpos++;
+    while (begpos > 0 && str[begpos - 1] != '/')
+        begpos--;
 
-    err = atf_dynstr_init_substr(ln, &p->m_data, begpos, atf_dynstr_npos);
+    err = atf_dynstr_init_raw(ln, str + begpos, p->m_length - begpos);
 
 #if defined(HAVE_CONST_BASENAME)
-    INV(atf_equal_dynstr_cstring(ln,
-                                 basename(atf_dynstr_cstring(&p->m_data))));
+    INV(atf_equal_dynstr_cstring(ln, basename(str)));
 #endif /* defined(HAVE_CONST_BASENAME) */
 
     return err;
@@ -437,13 +733,13 @@ atf_fs_path_leaf_name(const atf_fs_path_t *p, atf_dynstr_t *ln)
 bool
 atf_fs_path_is_absolute(const atf_fs_path_t *p)
 {
-    return atf_dynstr_cstring(&p->m_data)[0] == '/';
+    return atf_fs_path_cstring(p)[0] == '/';
 }
 
 bool
 atf_fs_path_is_root(const atf_fs_path_t *p)
 {
-    return atf_equal_dynstr_cstring(&p->m_data, "/");
+    return p->m_length == 1 && atf_fs_path_cstring(p)[0] == '/';
 }
 
 /*
@@ -453,22 +749,12 @@ atf_fs_path_is_root(const atf_fs_path_t *p)
 atf_error_t
 atf_fs_path_append_ap(atf_fs_path_t *p, const char *fmt, va_list ap)
 {
-    atf_dynstr_t aux;
     atf_error_t err;
     va_list ap2;
 
     va_copy(ap2, ap);
-    err = normalize_ap(&aux, fmt, ap2);
+    err = path_append_ap(p, fmt, ap2);
     va_end(ap2);
-    if (!atf_is_error(err)) {
-        const char *auxstr = atf_dynstr_cstring(&aux);
-        const bool needslash = auxstr[0] != '/';
-
-        err = atf_dynstr_append_fmt(&p->m_data, "%s%s",
-                                    needslash ? "/" : "", auxstr);
-
-        atf_dynstr_fini(&aux);
-    }
 
     return err;
 }
@@ -489,7 +775,7 @@ atf_fs_path_append_fmt(atf_fs_path_t *p, const char *fmt, ...)
 atf_error_t
 atf_fs_path_append_path(atf_fs_path_t *p, const atf_fs_path_t *p2)
 {
-    return atf_fs_path_append_fmt(p, "%s", atf_dynstr_cstring(&p2->m_data));
+    return path_append_normalized(p, atf_fs_path_cstring(p2));
 }
 
 atf_error_t
@@ -518,7 +804,9 @@ out:
 bool atf_equal_fs_path_fs_path(const atf_fs_path_t *p1,
                                const atf_fs_path_t *p2)
 {
-    return atf_equal_dynstr_dynstr(&p1->m_data, &p2->m_data);
+    return p1->m_length == p2->m_length &&
+           memcmp(atf_fs_path_cstring(p1), atf_fs_path_cstring(p2),
+                  p1->m_length) == 0;
 }
 
 /* ---------------------------------------------------------------------
@@ -538,6 +826,36 @@ const int atf_fs_stat_reg_type  = 6;
 const int atf_fs_stat_sock_type = 7;
 const int atf_fs_stat_wht_type  = 8;
 
+/*
+ * Auxiliary functions.
+ */
+
+static
+atf_error_t
+set_stat_type(atf_fs_stat_t *st, const char *pstr)
+{
+    atf_error_t err;
+    int type = st->m_sb.st_mode & S_IFMT;
+
+    err = atf_no_error();
+    switch (type) {
+        case S_IFBLK:  st->m_type = atf_fs_stat_blk_type;  break;
+        case S_IFCHR:  st->m_type = atf_fs_stat_chr_type;  break;
+        case S_IFDIR:  st->m_type = atf_fs_stat_dir_type;  break;
+        case S_IFIFO:  st->m_type = atf_fs_stat_fifo_type; break;
+        case S_IFLNK:  st->m_type = atf_fs_stat_lnk_type;  break;
+        case S_IFREG:  st->m_type = atf_fs_stat_reg_type;  break;
+        case S_IFSOCK: st->m_type = atf_fs_stat_sock_type; break;
+#if defined(S_IFWHT)
+        case S_IFWHT:  st->m_type = atf_fs_stat_wht_type;  break;
+#endif
+        default:
+            err = unknown_type_error(pstr, type);
+    }
+
+    return err;
+}
+
 /*
  * Constructors/destructors.
  */
@@ -551,24 +869,27 @@ atf_fs_stat_init(atf_fs_stat_t *st, const atf_fs_path_t *p)
     if (lstat(pstr, &st->m_sb) == -1) {
         err = atf_libc_error(errno, "Cannot get information of %s; "
                              "lstat(2) failed", pstr);
-    } else {
-        int type = st->m_sb.st_mode & S_IFMT;
-        err = atf_no_error();
-        switch (type) {
-            case S_IFBLK:  st->m_type = atf_fs_stat_blk_type;  break;
-            case S_IFCHR:  st->m_type = atf_fs_stat_chr_type;  break;
-            case S_IFDIR:  st->m_type = atf_fs_stat_dir_type;  break;
-            case S_IFIFO:  st->m_type = atf_fs_stat_fifo_type; break;
-            case S_IFLNK:  st->m_type = atf_fs_stat_lnk_type;  break;
-            case S_IFREG:  st->m_type = atf_fs_stat_reg_type;  break;
-            case S_IFSOCK: st->m_type = atf_fs_stat_sock_type; break;
-#if defined(S_IFWHT)
-            case S_IFWHT:  st->m_type = atf_fs_stat_wht_type;  break;
-#endif
-            default:
-                err = unknown_type_error(pstr, type);
-        }
-    }
+    } else
+        err = set_stat_type(st, pstr);
+
+    return err;
+}
+
+/*
+ * Same as atf_fs_stat_init, but looks up the file by its name relative to
+ * the open directory dirfd, which avoids resolving the whole path again
+ * when walking a tree.  Symbolic links are not followed either.
+ */
+atf_error_t
+atf_fs_stat_init_at(atf_fs_stat_t *st, const int dirfd, const char *name)
+{
+    atf_error_t err;
+
+    if (fstatat(dirfd, name, &st->m_sb, AT_SYMLINK_NOFOLLOW) == -1) {
+        err = atf_libc_error(errno, "Cannot get information of %s; "
+                             "fstatat(2) failed", name);
+    } else
+        err = set_stat_type(st, name);
 
     return err;
 }
@@ -682,6 +1003,27 @@ const int atf_fs_access_r = 1 << 1;
 const int atf_fs_access_w = 1 << 2;
 const int atf_fs_access_x = 1 << 3;
 
+/*
+ * Copies the contents of the in file descriptor, starting at its current
+ * offset, to the out file descriptor.  The cheapest mechanism supported
+ * by the system and the file descriptors is used: extent sharing if the
+ * file system supports it, in-kernel copies with copy_file_range(2) or
+ * sendfile(2), and read/write with a large buffer as the last resort.
+ */
+atf_error_t
+atf_fs_copy_fd(const int in, const int out)
+{
+    atf_error_t err;
+
+    if (copy_fd_clone(in, out, &err))
+        return err;
+    if (copy_fd_range(in, out, &err))
+        return err;
+    if (copy_fd_sendfile(in, out, &err))
+        return err;
+    return copy_fd_buffered(in, out);
+}
+
 /*
  * An implementation of access(2) but using the effective user value
  * instead of the real one.  Also avoids false positives for root when
@@ -789,6 +1131,40 @@ out:
     return err;
 }
 
+/*
+ * Resolves a path against the current directory and returns it in a newly
+ * allocated string, so that it keeps referring to the same file after a
+ * chdir(2).  Absolute paths are returned unchanged, apart from their
+ * normalization.
+ */
+atf_error_t
+atf_fs_make_absolute(const char *path, char **abspath)
+{
+    atf_error_t err;
+    atf_fs_path_t p, pa;
+
+    err = atf_fs_path_init_fmt(&p, "%s", path);
+    if (atf_is_error(err))
+        goto out;
+
+    if (atf_fs_path_is_absolute(&p))
+        *abspath = strdup(atf_fs_path_cstring(&p));
+    else {
+        err = atf_fs_path_to_absolute(&p, &pa);
+        if (atf_is_error(err))
+            goto out_p;
+        *abspath = strdup(atf_fs_path_cstring(&pa));
+        atf_fs_path_fini(&pa);
+    }
+    if (*abspath == NULL)
+        err = atf_no_memory_error();
+
+out_p:
+    atf_fs_path_fini(&p);
+out:
+    return err;
+}
+
 atf_error_t
 atf_fs_mkdtemp(atf_fs_path_t *p)
 {
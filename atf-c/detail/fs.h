@@ -39,8 +39,14 @@
  * The "atf_fs_path" type.
  * --------------------------------------------------------------------- */
 
+/* Paths shorter than this are stored without allocating memory. */
+#define ATF_FS_PATH_INLINE_SIZE 128
+
 struct atf_fs_path {
-    atf_dynstr_t m_data;
+    char *m_heap;
+    size_t m_heapsize;
+    size_t m_length;
+    char m_inline[ATF_FS_PATH_INLINE_SIZE];
 };
 typedef struct atf_fs_path atf_fs_path_t;
 
@@ -48,6 +54,7 @@ typedef struct atf_fs_path atf_fs_path_t;
 atf_error_t atf_fs_path_init_ap(atf_fs_path_t *, const char *, va_list);
 atf_error_t atf_fs_path_init_fmt(atf_fs_path_t *, const char *, ...);
 atf_error_t atf_fs_path_copy(atf_fs_path_t *, const atf_fs_path_t *);
+void atf_fs_path_move(atf_fs_path_t *, atf_fs_path_t *);
 void atf_fs_path_fini(atf_fs_path_t *);
 
 /* Getters. */
@@ -89,6 +96,7 @@ extern const int atf_fs_stat_wht_type;
 
 /* Constructors/destructors. */
 atf_error_t atf_fs_stat_init(atf_fs_stat_t *, const atf_fs_path_t *);
+atf_error_t atf_fs_stat_init_at(atf_fs_stat_t *, const int, const char *);
 void atf_fs_stat_copy(atf_fs_stat_t *, const atf_fs_stat_t *);
 void atf_fs_stat_fini(atf_fs_stat_t *);
 
@@ -117,9 +125,11 @@ extern const int atf_fs_access_r;
 extern const int atf_fs_access_w;
 extern const int atf_fs_access_x;
 
+atf_error_t atf_fs_copy_fd(const int, const int);
 atf_error_t atf_fs_eaccess(const atf_fs_path_t *, int);
 atf_error_t atf_fs_exists(const atf_fs_path_t *, bool *);
 atf_error_t atf_fs_getcwd(atf_fs_path_t *);
+atf_error_t atf_fs_make_absolute(const char *, char **);
 atf_error_t atf_fs_mkdtemp(atf_fs_path_t *);
 atf_error_t atf_fs_mkstemp(atf_fs_path_t *, int *);
 atf_error_t atf_fs_rmdir(const atf_fs_path_t *);
@@ -27,6 +27,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -335,6 +336,8 @@ ATF_TC_BODY(path_append, tc)
         { "foo/", "/bar", "foo/bar" },
         { "foo/", "/bar/baz", "foo/bar/baz" },
         { "foo/", "///bar///baz", "foo/bar/baz" }, /* NO_CHECK_STYLE */
+        { "/", "bar", "/bar" },
+        { "foo", "/", "foo" },
 
         { NULL, NULL, NULL }
     };
@@ -360,6 +363,74 @@ ATF_TC_BODY(path_append, tc)
     }
 }
 
+ATF_TC(path_append_long);
+ATF_TC_HEAD(path_append_long, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the concatenation of paths "
+                      "that outgrow the storage embedded in atf_fs_path_t");
+}
+ATF_TC_BODY(path_append_long, tc)
+{
+    atf_fs_path_t p;
+    char exp[4096];
+    int i;
+
+    RE(atf_fs_path_init_fmt(&p, "/root"));
+    strcpy(exp, "/root");
+    for (i = 0; i < 200; i++) {
+        char comp[32];
+
+        snprintf(comp, sizeof(comp), "//component%d/", i);
+        if (i % 2 == 0)
+            RE(atf_fs_path_append_fmt(&p, "%s", comp));
+        else
+            RE(atf_fs_path_append_fmt(&p, "//component%d/", i));
+        snprintf(comp, sizeof(comp), "/component%d", i);
+        strcat(exp, comp);
+
+        ATF_REQUIRE_STREQ(exp, atf_fs_path_cstring(&p));
+    }
+    atf_fs_path_fini(&p);
+
+    /* The formatted string does not fit in the stack buffer either. */
+    RE(atf_fs_path_init_fmt(&p, "%s//%s", exp, exp));
+    ATF_REQUIRE_EQ(strlen(exp) * 2, strlen(atf_fs_path_cstring(&p)));
+    atf_fs_path_fini(&p);
+
+    /* Appending a path to itself. */
+    RE(atf_fs_path_init_fmt(&p, "a/b"));
+    for (i = 0; i < 8; i++)
+        RE(atf_fs_path_append_fmt(&p, "%s", atf_fs_path_cstring(&p)));
+    ATF_REQUIRE_EQ(256 * 4 - 1, strlen(atf_fs_path_cstring(&p)));
+    atf_fs_path_fini(&p);
+}
+
+ATF_TC(path_move);
+ATF_TC_HEAD(path_move, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_path_move function");
+}
+ATF_TC_BODY(path_move, tc)
+{
+    const char *lengths[] = { "short", NULL };
+    atf_fs_path_t src, dest, longp;
+    size_t i;
+
+    RE(atf_fs_path_init_fmt(&longp, "%0200d", 0));
+    lengths[1] = atf_fs_path_cstring(&longp);
+
+    for (i = 0; i < 2; i++) {
+        RE(atf_fs_path_init_fmt(&src, "%s", lengths[i]));
+        atf_fs_path_move(&dest, &src);
+        ATF_REQUIRE_STREQ(lengths[i], atf_fs_path_cstring(&dest));
+        ATF_REQUIRE_STREQ("", atf_fs_path_cstring(&src));
+        atf_fs_path_fini(&src);
+        atf_fs_path_fini(&dest);
+    }
+
+    atf_fs_path_fini(&longp);
+}
+
 ATF_TC(path_to_absolute);
 ATF_TC_HEAD(path_to_absolute, tc)
 {
@@ -481,6 +552,42 @@ ATF_TC_BODY(stat_type, tc)
     atf_fs_path_fini(&p);
 }
 
+ATF_TC(stat_init_at);
+ATF_TC_HEAD(stat_init_at, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_stat_init_at "
+                      "constructor");
+}
+ATF_TC_BODY(stat_init_at, tc)
+{
+    atf_fs_stat_t st;
+    atf_error_t err;
+    int dirfd;
+
+    create_dir("dir", 0755);
+    create_file("dir/reg", 0644);
+    ATF_REQUIRE(symlink("reg", "dir/lnk") != -1);
+
+    dirfd = open("dir", O_RDONLY);
+    ATF_REQUIRE(dirfd != -1);
+
+    RE(atf_fs_stat_init_at(&st, dirfd, "reg"));
+    ATF_REQUIRE_EQ(atf_fs_stat_get_type(&st), atf_fs_stat_reg_type);
+    atf_fs_stat_fini(&st);
+
+    RE(atf_fs_stat_init_at(&st, dirfd, "lnk"));
+    ATF_REQUIRE_EQ(atf_fs_stat_get_type(&st), atf_fs_stat_lnk_type);
+    atf_fs_stat_fini(&st);
+
+    err = atf_fs_stat_init_at(&st, dirfd, "missing");
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    ATF_REQUIRE_EQ(atf_libc_error_code(err), ENOENT);
+    atf_error_free(err);
+
+    close(dirfd);
+}
+
 ATF_TC(stat_perms);
 ATF_TC_HEAD(stat_perms, tc)
 {
@@ -735,6 +842,123 @@ ATF_TC_BODY(getcwd, tc)
     atf_fs_path_fini(&cwd1);
 }
 
+ATF_TC(make_absolute);
+ATF_TC_HEAD(make_absolute, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_make_absolute "
+                      "function");
+}
+ATF_TC_BODY(make_absolute, tc)
+{
+    atf_fs_path_t cwd;
+    char *abspath, *expected;
+
+    create_dir("root", 0755);
+    RE(atf_fs_getcwd(&cwd));
+
+    RE(atf_fs_make_absolute("/a/b/", &abspath));
+    ATF_REQUIRE_STREQ("/a/b", abspath);
+    free(abspath);
+
+    RE(atf_fs_make_absolute("dir/file", &abspath));
+    ATF_REQUIRE(chdir("root") != -1);
+    RE(atf_fs_path_append_fmt(&cwd, "dir/file"));
+    expected = strdup(atf_fs_path_cstring(&cwd));
+    ATF_REQUIRE(expected != NULL);
+    ATF_REQUIRE_STREQ(expected, abspath);
+    free(expected);
+    free(abspath);
+
+    atf_fs_path_fini(&cwd);
+}
+
+static
+void
+check_copied_file(const char *path, const char *prefix, const char *data,
+                  const size_t size)
+{
+    const size_t prefix_len = strlen(prefix);
+    char *buf;
+    struct stat sb;
+    ssize_t n;
+    int fd;
+
+    ATF_REQUIRE(stat(path, &sb) != -1);
+    ATF_REQUIRE_EQ(prefix_len + size, (size_t)sb.st_size);
+
+    buf = malloc(prefix_len + size);
+    ATF_REQUIRE(buf != NULL);
+    ATF_REQUIRE((fd = open(path, O_RDONLY)) != -1);
+    n = read(fd, buf, prefix_len + size);
+    ATF_REQUIRE_EQ(prefix_len + size, (size_t)n);
+    close(fd);
+
+    ATF_REQUIRE(memcmp(buf, prefix, prefix_len) == 0);
+    ATF_REQUIRE(memcmp(buf + prefix_len, data, size) == 0);
+    free(buf);
+}
+
+ATF_TC(copy_fd);
+ATF_TC_HEAD(copy_fd, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_copy_fd function");
+}
+ATF_TC_BODY(copy_fd, tc)
+{
+    /* Larger than the internal buffers and not a multiple of them. */
+    const size_t size = 3 * 1024 * 1024 + 17;
+    char *data;
+    size_t i;
+    int fds[2], in, out, status;
+    pid_t pid;
+
+    data = malloc(size);
+    ATF_REQUIRE(data != NULL);
+    for (i = 0; i < size; i++)
+        data[i] = (char)(i * 31 + i / 4096);
+
+    ATF_REQUIRE((out = open("src", O_WRONLY | O_CREAT, 0644)) != -1);
+    ATF_REQUIRE_EQ(size, (size_t)write(out, data, size));
+    close(out);
+
+    printf("Copying a whole file into an empty one\n");
+    ATF_REQUIRE((in = open("src", O_RDONLY)) != -1);
+    ATF_REQUIRE((out = open("dst1", O_WRONLY | O_CREAT, 0644)) != -1);
+    RE(atf_fs_copy_fd(in, out));
+    close(out);
+    close(in);
+    check_copied_file("dst1", "", data, size);
+
+    printf("Copying part of a file into a non-empty one\n");
+    ATF_REQUIRE((in = open("src", O_RDONLY)) != -1);
+    ATF_REQUIRE(lseek(in, 1000, SEEK_SET) == 1000);
+    atf_utils_create_file("dst2", "head");
+    ATF_REQUIRE((out = open("dst2", O_WRONLY | O_APPEND)) != -1);
+    RE(atf_fs_copy_fd(in, out));
+    close(out);
+    close(in);
+    check_copied_file("dst2", "head", data + 1000, size - 1000);
+
+    printf("Copying from a pipe\n");
+    ATF_REQUIRE(pipe(fds) != -1);
+    ATF_REQUIRE((pid = fork()) != -1);
+    if (pid == 0) {
+        close(fds[0]);
+        exit(write(fds[1], data, size) == (ssize_t)size ?
+             EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(fds[1]);
+    ATF_REQUIRE((out = open("dst3", O_WRONLY | O_CREAT, 0644)) != -1);
+    RE(atf_fs_copy_fd(fds[0], out));
+    close(out);
+    close(fds[0]);
+    ATF_REQUIRE(waitpid(pid, &status, 0) != -1);
+    ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    check_copied_file("dst3", "", data, size);
+
+    free(data);
+}
+
 ATF_TC(rmdir_empty);
 ATF_TC_HEAD(rmdir_empty, tc)
 {
@@ -1060,18 +1284,23 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, path_branch_path);
     ATF_TP_ADD_TC(tp, path_leaf_name);
     ATF_TP_ADD_TC(tp, path_append);
+    ATF_TP_ADD_TC(tp, path_append_long);
+    ATF_TP_ADD_TC(tp, path_move);
     ATF_TP_ADD_TC(tp, path_to_absolute);
     ATF_TP_ADD_TC(tp, path_equal);
 
     /* Add the tests for the "atf_fs_stat" type. */
     ATF_TP_ADD_TC(tp, stat_mode);
     ATF_TP_ADD_TC(tp, stat_type);
+    ATF_TP_ADD_TC(tp, stat_init_at);
     ATF_TP_ADD_TC(tp, stat_perms);
 
     /* Add the tests for the free functions. */
+    ATF_TP_ADD_TC(tp, copy_fd);
     ATF_TP_ADD_TC(tp, eaccess);
     ATF_TP_ADD_TC(tp, exists);
     ATF_TP_ADD_TC(tp, getcwd);
+    ATF_TP_ADD_TC(tp, make_absolute);
     ATF_TP_ADD_TC(tp, rmdir_empty);
     ATF_TP_ADD_TC(tp, rmdir_enotempty);
     ATF_TP_ADD_TC(tp, rmdir_eperm);
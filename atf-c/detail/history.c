@@ -0,0 +1,506 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/history.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/*
+ * The history is a single file shared by all test programs.  It starts
+ * with a magic string followed by one variable-length record per test
+ * case:
+ *
+ *     8 bytes: hash of the absolute path to the test program.
+ *     4 bytes: duration of the test case in milliseconds.
+ *     2 bytes: number of recorded samples, saturated.
+ *     2 bytes: length of the identifier of the test case.
+ *     N bytes: identifier of the test case, not NUL-terminated.
+ *
+ * All integers are little-endian.  Records are updated in place while
+ * holding a lock on the whole file, so that test programs running
+ * concurrently can share it.  A corrupt file is treated as empty.
+ */
+
+static const char magic[8] = { 'A', 'T', 'F', 'H', 'I', 'S', 'T', '1' };
+
+#define RECORD_HEADER_SIZE 16
+
+/* The recorded duration is a moving average over this many samples. */
+#define SAMPLES_WINDOW 4
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+uint64_t
+get_le(const unsigned char *p, const size_t bytes)
+{
+    uint64_t value;
+    size_t i;
+
+    value = 0;
+    for (i = bytes; i > 0; i--)
+        value = (value << 8) | p[i - 1];
+    return value;
+}
+
+static
+void
+put_le(unsigned char *p, uint64_t value, const size_t bytes)
+{
+    size_t i;
+
+    for (i = 0; i < bytes; i++) {
+        p[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+/* FNV-1a hash of the canonical path to the test program. */
+static
+uint64_t
+program_key(const char *program)
+{
+    char resolved[PATH_MAX];
+    const unsigned char *p;
+    uint64_t hash;
+
+    if (realpath(program, resolved) != NULL)
+        program = resolved;
+
+    hash = UINT64_C(14695981039346656037);
+    for (p = (const unsigned char *)program; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+static
+atf_error_t
+lock_file(const int fd, const short type)
+{
+    struct flock fl;
+
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &fl) == -1) {
+        if (errno != EINTR)
+            return atf_libc_error(errno, "Cannot lock the history file");
+    }
+    return atf_no_error();
+}
+
+static
+atf_error_t
+read_all(const int fd, unsigned char **buf, size_t *len)
+{
+    struct stat sb;
+    size_t done;
+
+    if (fstat(fd, &sb) == -1)
+        return atf_libc_error(errno, "Cannot stat the history file");
+
+    *buf = malloc(sb.st_size > 0 ? (size_t)sb.st_size : 1);
+    if (*buf == NULL)
+        return atf_no_memory_error();
+
+    done = 0;
+    while (done < (size_t)sb.st_size) {
+        const ssize_t n = pread(fd, *buf + done, sb.st_size - done, done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    *len = done;
+    return atf_no_error();
+}
+
+static
+bool
+is_valid(const unsigned char *buf, const size_t len)
+{
+    size_t pos;
+
+    if (len < sizeof(magic) || memcmp(buf, magic, sizeof(magic)) != 0)
+        return false;
+
+    pos = sizeof(magic);
+    while (pos < len) {
+        if (len - pos < RECORD_HEADER_SIZE)
+            return false;
+        pos += RECORD_HEADER_SIZE;
+        if (len - pos < get_le(buf + pos - 2, 2))
+            return false;
+        pos += get_le(buf + pos - 2, 2);
+    }
+    return true;
+}
+
+/* Returns the offset of the record for the given test case, or 0. */
+static
+size_t
+find_record(const unsigned char *buf, const size_t len, const uint64_t key,
+            const char *ident)
+{
+    const size_t identlen = strlen(ident);
+    size_t pos;
+
+    for (pos = sizeof(magic); pos < len;
+         pos += RECORD_HEADER_SIZE + get_le(buf + pos + 14, 2)) {
+        if (get_le(buf + pos, 8) == key &&
+            get_le(buf + pos + 14, 2) == identlen &&
+            memcmp(buf + pos + RECORD_HEADER_SIZE, ident, identlen) == 0)
+            return pos;
+    }
+    return 0;
+}
+
+static
+atf_error_t
+write_all(const int fd, const void *buf, const size_t len, const off_t off)
+{
+    if (pwrite(fd, buf, len, off) != (ssize_t)len)
+        return atf_libc_error(errno, "Cannot write to the history file");
+    return atf_no_error();
+}
+
+static
+long
+average(const long old, const unsigned long samples, const long msec)
+{
+    const long window = samples + 1 < SAMPLES_WINDOW ?
+        (long)samples + 1 : SAMPLES_WINDOW;
+    return old + (msec - old) / window;
+}
+
+/* ---------------------------------------------------------------------
+ * The "atf_history" type.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Constructors/destructors.
+ */
+
+atf_error_t
+atf_history_init(atf_history_t *h, const char *file, const char *program)
+{
+    atf_error_t err;
+    unsigned char *buf;
+    size_t len, pos;
+    uint64_t key;
+    int fd;
+
+    h->m_entries = NULL;
+    h->m_count = 0;
+
+    fd = open(file, O_RDONLY);
+    if (fd == -1) {
+        if (errno == ENOENT)
+            return atf_no_error();
+        return atf_libc_error(errno, "Cannot open history file %s", file);
+    }
+
+    err = lock_file(fd, F_RDLCK);
+    if (!atf_is_error(err))
+        err = read_all(fd, &buf, &len);
+    close(fd);
+    if (atf_is_error(err))
+        return err;
+
+    if (!is_valid(buf, len))
+        goto out;
+
+    key = program_key(program);
+    for (pos = sizeof(magic); pos < len;
+         pos += RECORD_HEADER_SIZE + get_le(buf + pos + 14, 2)) {
+        const size_t identlen = get_le(buf + pos + 14, 2);
+        struct atf_history_entry *entries;
+        char *ident;
+
+        if (get_le(buf + pos, 8) != key)
+            continue;
+
+        entries = realloc(h->m_entries, (h->m_count + 1) * sizeof(*entries));
+        ident = malloc(identlen + 1);
+        if (entries == NULL || ident == NULL) {
+            if (entries != NULL)
+                h->m_entries = entries;
+            free(ident);
+            atf_history_fini(h);
+            err = atf_no_memory_error();
+            goto out;
+        }
+        memcpy(ident, buf + pos + RECORD_HEADER_SIZE, identlen);
+        ident[identlen] = '\0';
+
+        h->m_entries = entries;
+        h->m_entries[h->m_count].m_ident = ident;
+        h->m_entries[h->m_count].m_msec = get_le(buf + pos + 8, 4);
+        h->m_count++;
+    }
+
+out:
+    free(buf);
+    return err;
+}
+
+void
+atf_history_fini(atf_history_t *h)
+{
+    size_t i;
+
+    for (i = 0; i < h->m_count; i++)
+        free(h->m_entries[i].m_ident);
+    free(h->m_entries);
+    h->m_entries = NULL;
+    h->m_count = 0;
+}
+
+/*
+ * Getters.
+ */
+
+size_t
+atf_history_count(const atf_history_t *h)
+{
+    return h->m_count;
+}
+
+const char *
+atf_history_ident(const atf_history_t *h, const size_t i)
+{
+    PRE(i < h->m_count);
+    return h->m_entries[i].m_ident;
+}
+
+long
+atf_history_msec(const atf_history_t *h, const size_t i)
+{
+    PRE(i < h->m_count);
+    return h->m_entries[i].m_msec;
+}
+
+bool
+atf_history_get(const atf_history_t *h, const char *ident, long *msec)
+{
+    size_t i;
+
+    for (i = 0; i < h->m_count; i++) {
+        if (strcmp(h->m_entries[i].m_ident, ident) == 0) {
+            *msec = h->m_entries[i].m_msec;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Returns the history file set in ATF_HISTORY_FILE, or NULL if durations
+ * should not be recorded.
+ */
+const char *
+atf_history_file(void)
+{
+    const char *file;
+
+    if (!atf_env_has("ATF_HISTORY_FILE"))
+        return NULL;
+    file = atf_env_get("ATF_HISTORY_FILE");
+    return file[0] == '\0' ? NULL : file;
+}
+
+atf_error_t
+atf_history_record(const char *file, const char *program, const char *ident,
+                   long msec)
+{
+    atf_error_t err;
+    unsigned char *buf;
+    size_t len, identlen, pos;
+    uint64_t key;
+    int fd;
+
+    identlen = strlen(ident);
+    if (identlen > 0xffff)
+        return atf_libc_error(ENAMETOOLONG, "Test case name too long");
+    if (msec < 0)
+        msec = 0;
+    else if ((unsigned long)msec > UINT32_MAX)
+        msec = UINT32_MAX;
+
+    fd = open(file, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+        return atf_libc_error(errno, "Cannot open history file %s", file);
+
+    err = lock_file(fd, F_WRLCK);
+    if (atf_is_error(err))
+        goto out_fd;
+    err = read_all(fd, &buf, &len);
+    if (atf_is_error(err))
+        goto out_fd;
+
+    if (!is_valid(buf, len)) {
+        if (ftruncate(fd, 0) == -1) {
+            err = atf_libc_error(errno, "Cannot truncate history file %s",
+                                 file);
+            goto out_buf;
+        }
+        err = write_all(fd, magic, sizeof(magic), 0);
+        if (atf_is_error(err))
+            goto out_buf;
+        len = sizeof(magic);
+    }
+
+    key = program_key(program);
+    pos = len > sizeof(magic) ? find_record(buf, len, key, ident) : 0;
+    if (pos != 0) {
+        unsigned char update[6];
+        const unsigned long samples = get_le(buf + pos + 12, 2);
+
+        put_le(update, average(get_le(buf + pos + 8, 4), samples, msec), 4);
+        put_le(update + 4, samples < 0xffff ? samples + 1 : samples, 2);
+        err = write_all(fd, update, sizeof(update), pos + 8);
+    } else {
+        unsigned char *record = malloc(RECORD_HEADER_SIZE + identlen);
+        if (record == NULL) {
+            err = atf_no_memory_error();
+            goto out_buf;
+        }
+        put_le(record, key, 8);
+        put_le(record + 8, msec, 4);
+        put_le(record + 12, 1, 2);
+        put_le(record + 14, identlen, 2);
+        memcpy(record + RECORD_HEADER_SIZE, ident, identlen);
+        err = write_all(fd, record, RECORD_HEADER_SIZE + identlen, len);
+        free(record);
+    }
+
+out_buf:
+    free(buf);
+out_fd:
+    close(fd);
+    return err;
+}
+
+static struct {
+    char *file;
+    char *program;
+    char *ident;
+    struct timeval start;
+    pid_t pid;
+    bool registered;
+} tracked;
+
+static
+void
+record_tracked(void)
+{
+    struct timeval now;
+    long msec;
+    atf_error_t err;
+
+    /* Subprocesses of the test case inherit the handler; ignore them. */
+    if (tracked.file == NULL || getpid() != tracked.pid)
+        return;
+
+    gettimeofday(&now, NULL);
+    msec = (now.tv_sec - tracked.start.tv_sec) * 1000 +
+        (now.tv_usec - tracked.start.tv_usec) / 1000;
+
+    err = atf_history_record(tracked.file, tracked.program, tracked.ident,
+                             msec);
+    if (atf_is_error(err))
+        atf_error_free(err);
+}
+
+/*
+ * Records the duration of the given test case in the history when the
+ * process exits, from now until then.  Does nothing if ATF_HISTORY_FILE
+ * is not set.  Only one test case can be tracked per process, although a
+ * subprocess can track a different one.
+ */
+void
+atf_history_track(const char *program, const char *ident)
+{
+    char resolved[PATH_MAX];
+    const char *file;
+    atf_error_t err;
+
+    file = atf_history_file();
+    if (file == NULL || (tracked.file != NULL && tracked.pid == getpid()))
+        return;
+    free(tracked.program);
+    free(tracked.ident);
+    free(tracked.file);
+    tracked.file = NULL;
+
+    if (realpath(program, resolved) != NULL)
+        program = resolved;
+    tracked.program = strdup(program);
+    tracked.ident = strdup(ident);
+
+    err = atf_fs_make_absolute(file, &tracked.file);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        tracked.file = NULL;
+    }
+    if (!tracked.registered && atexit(record_tracked) == 0)
+        tracked.registered = true;
+    if (tracked.program == NULL || tracked.ident == NULL ||
+        tracked.file == NULL || !tracked.registered) {
+        free(tracked.program);
+        free(tracked.ident);
+        free(tracked.file);
+        tracked.program = tracked.ident = tracked.file = NULL;
+        return;
+    }
+
+    gettimeofday(&tracked.start, NULL);
+    tracked.pid = getpid();
+}
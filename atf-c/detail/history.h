@@ -0,0 +1,69 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_HISTORY_H)
+#define ATF_C_DETAIL_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <atf-c/error_fwd.h>
+
+/* ---------------------------------------------------------------------
+ * The "atf_history" type.
+ * --------------------------------------------------------------------- */
+
+/* The durations recorded for the test cases of a single test program. */
+struct atf_history_entry {
+    char *m_ident;
+    long m_msec;
+};
+
+struct atf_history {
+    struct atf_history_entry *m_entries;
+    size_t m_count;
+};
+typedef struct atf_history atf_history_t;
+
+/* Constructors and destructors */
+atf_error_t atf_history_init(atf_history_t *, const char *, const char *);
+void atf_history_fini(atf_history_t *);
+
+/* Getters */
+size_t atf_history_count(const atf_history_t *);
+const char *atf_history_ident(const atf_history_t *, size_t);
+long atf_history_msec(const atf_history_t *, size_t);
+bool atf_history_get(const atf_history_t *, const char *, long *);
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+const char *atf_history_file(void);
+atf_error_t atf_history_record(const char *, const char *, const char *,
+                               long);
+void atf_history_track(const char *, const char *);
+
+#endif /* !defined(ATF_C_DETAIL_HISTORY_H) */
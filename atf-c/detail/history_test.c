@@ -0,0 +1,218 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/history.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+long
+get_msec(const char *file, const char *program, const char *ident)
+{
+    atf_history_t h;
+    long msec;
+
+    RE(atf_history_init(&h, file, program));
+    if (!atf_history_get(&h, ident, &msec))
+        msec = -1;
+    atf_history_fini(&h);
+    return msec;
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the "atf_history" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(init_missing);
+ATF_TC_HEAD(init_missing, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that a missing history file is "
+                      "treated as empty");
+}
+ATF_TC_BODY(init_missing, tc)
+{
+    atf_history_t h;
+
+    RE(atf_history_init(&h, "missing", "prog"));
+    ATF_REQUIRE_EQ(0, atf_history_count(&h));
+    atf_history_fini(&h);
+}
+
+ATF_TC(init_corrupt);
+ATF_TC_HEAD(init_corrupt, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that a corrupt history file is "
+                      "treated as empty and replaced when recording");
+}
+ATF_TC_BODY(init_corrupt, tc)
+{
+    atf_history_t h;
+
+    atf_utils_create_file("history", "ATFHIST1 and some garbage");
+    RE(atf_history_init(&h, "history", "prog"));
+    ATF_REQUIRE_EQ(0, atf_history_count(&h));
+    atf_history_fini(&h);
+
+    RE(atf_history_record("history", "prog", "tc", 123));
+    ATF_REQUIRE_EQ(123, get_msec("history", "prog", "tc"));
+}
+
+ATF_TC(record_and_get);
+ATF_TC_HEAD(record_and_get, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that the durations of the test "
+                      "cases are kept separately for every test program");
+}
+ATF_TC_BODY(record_and_get, tc)
+{
+    atf_history_t h;
+    long msec;
+
+    RE(atf_history_record("history", "/a/prog", "first", 10));
+    RE(atf_history_record("history", "/a/prog", "second", 20));
+    RE(atf_history_record("history", "/b/prog", "first", 30));
+
+    RE(atf_history_init(&h, "history", "/a/prog"));
+    ATF_REQUIRE_EQ(2, atf_history_count(&h));
+    ATF_REQUIRE_STREQ("first", atf_history_ident(&h, 0));
+    ATF_REQUIRE_EQ(10, atf_history_msec(&h, 0));
+    ATF_REQUIRE_STREQ("second", atf_history_ident(&h, 1));
+    ATF_REQUIRE_EQ(20, atf_history_msec(&h, 1));
+    ATF_REQUIRE(atf_history_get(&h, "second", &msec));
+    ATF_REQUIRE_EQ(20, msec);
+    ATF_REQUIRE(!atf_history_get(&h, "third", &msec));
+    atf_history_fini(&h);
+
+    ATF_REQUIRE_EQ(30, get_msec("history", "/b/prog", "first"));
+    ATF_REQUIRE_EQ(-1, get_msec("history", "/c/prog", "first"));
+}
+
+ATF_TC(record_average);
+ATF_TC_HEAD(record_average, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that the recorded duration is a "
+                      "moving average of the last runs");
+}
+ATF_TC_BODY(record_average, tc)
+{
+    int i;
+
+    RE(atf_history_record("history", "prog", "tc", 100));
+    RE(atf_history_record("history", "prog", "tc", 200));
+    ATF_REQUIRE_EQ(150, get_msec("history", "prog", "tc"));
+    RE(atf_history_record("history", "prog", "tc", 300));
+    ATF_REQUIRE_EQ(200, get_msec("history", "prog", "tc"));
+
+    for (i = 0; i < 20; i++)
+        RE(atf_history_record("history", "prog", "tc", 1000));
+    ATF_REQUIRE(get_msec("history", "prog", "tc") > 990);
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(file);
+ATF_TC_HEAD(file, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_history_file function");
+}
+ATF_TC_BODY(file, tc)
+{
+    RE(atf_env_unset("ATF_HISTORY_FILE"));
+    ATF_REQUIRE(atf_history_file() == NULL);
+    RE(atf_env_set("ATF_HISTORY_FILE", ""));
+    ATF_REQUIRE(atf_history_file() == NULL);
+    RE(atf_env_set("ATF_HISTORY_FILE", "the-file"));
+    ATF_REQUIRE_STREQ("the-file", atf_history_file());
+}
+
+ATF_TC(track);
+ATF_TC_HEAD(track, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_history_track records "
+                      "the duration of the process on exit, but not that "
+                      "of its subprocesses");
+}
+ATF_TC_BODY(track, tc)
+{
+    pid_t pid;
+    int status;
+
+    atf_utils_create_file("prog", "%s", "");
+    RE(atf_env_set("ATF_HISTORY_FILE", "history"));
+
+    pid = atf_utils_fork();
+    if (pid == 0) {
+        pid_t subpid;
+
+        atf_history_track("prog", "tc");
+        ATF_REQUIRE(chdir("..") != -1);
+
+        subpid = fork();
+        if (subpid == 0)
+            exit(EXIT_SUCCESS);
+        ATF_REQUIRE(waitpid(subpid, &status, 0) != -1);
+
+        usleep(200000);
+        exit(EXIT_FAILURE);
+    }
+    ATF_REQUIRE(waitpid(pid, &status, 0) != -1);
+
+    ATF_REQUIRE(get_msec("history", "prog", "tc") >= 200);
+    ATF_REQUIRE(get_msec("history", "./prog", "tc") >= 200);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, init_missing);
+    ATF_TP_ADD_TC(tp, init_corrupt);
+    ATF_TP_ADD_TC(tp, record_and_get);
+    ATF_TP_ADD_TC(tp, record_average);
+
+    ATF_TP_ADD_TC(tp, file);
+    ATF_TP_ADD_TC(tp, track);
+
+    return atf_no_error();
+}
@@ -0,0 +1,504 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+/* Needed to get the memfd_create(2) prototype from glibc. */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "atf-c/detail/outbuf.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "atf-c/defs.h"
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/error.h"
+
+/*
+ * When ATF_OUTPUT_BUFFER is set, the stdout and stderr of the body of a
+ * test case go through a pipe to a collector subprocess, which keeps the
+ * most recent bytes in a ring.  The ring lives in a shared memory file so
+ * that the test case can still dump it once the collector is gone: it
+ * does so when it exits or gets a fatal signal, but only if its result is
+ * a failure or is missing.  The test case keeps its process, so runtime
+ * engines see its real exit status.
+ *
+ * Everything that runs on exit is restricted to async-signal-safe calls
+ * because it is shared with the signal handlers.
+ */
+
+struct ring {
+    volatile uint64_t m_total;
+    char m_data[];
+};
+
+static const int fatal_signals[] = {
+    SIGABRT, SIGBUS, SIGFPE, SIGHUP, SIGILL, SIGINT, SIGQUIT, SIGSEGV,
+    SIGSYS, SIGTERM, SIGTRAP, 0
+};
+
+static struct {
+    struct ring *ring;
+    size_t size;
+    char *ident;
+    char *resfile;
+    pid_t pid;
+    pid_t collector;
+    int out;
+    int err;
+    bool active;
+} capture;
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+write_all(const int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        const ssize_t n = write(fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+static
+void
+write_str(const int fd, const char *str)
+{
+    write_all(fd, str, strlen(str));
+}
+
+static
+void
+write_u64(const int fd, uint64_t value)
+{
+    char buf[24];
+    size_t pos = sizeof(buf);
+
+    do {
+        buf[--pos] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    write_all(fd, buf + pos, sizeof(buf) - pos);
+}
+
+/*
+ * Reads the first line of the results file into buf, which is left empty
+ * if the test case did not write any result.
+ */
+static
+void
+read_result(char *buf, const size_t buflen)
+{
+    ssize_t n;
+    char *nl;
+    int fd;
+
+    buf[0] = '\0';
+    fd = open(capture.resfile, O_RDONLY);
+    if (fd == -1)
+        return;
+    do
+        n = read(fd, buf, buflen - 1);
+    while (n == -1 && errno == EINTR);
+    close(fd);
+
+    buf[n > 0 ? n : 0] = '\0';
+    if ((nl = strchr(buf, '\n')) != NULL)
+        *nl = '\0';
+}
+
+static
+bool
+is_failure(const char *result)
+{
+    return result[0] == '\0' || strncmp(result, "failed", 6) == 0 ||
+        strncmp(result, "broken", 6) == 0;
+}
+
+/*
+ * Waits for the collector to drain the pipe.  Subprocesses of the test
+ * case may keep the pipe open, so the wait is bounded and the collector is
+ * killed afterwards; the ring holds whatever it read by then.
+ */
+static
+void
+stop_collector(void)
+{
+    const struct timespec delay = { 0, 10 * 1000 * 1000 };
+    int i, status;
+
+    for (i = 0; i < 200; i++) {
+        const pid_t pid = waitpid(capture.collector, &status, WNOHANG);
+        if (pid == capture.collector || (pid == -1 && errno != EINTR))
+            return;
+        nanosleep(&delay, NULL);
+    }
+    kill(capture.collector, SIGKILL);
+    while (waitpid(capture.collector, &status, 0) == -1 && errno == EINTR)
+        continue;
+}
+
+static
+void
+dump_ring(const char *result, const int signo)
+{
+    const uint64_t total = capture.ring->m_total;
+    const int fd = capture.err;
+
+    write_str(fd, "*** Output of ");
+    write_str(fd, capture.ident);
+    write_str(fd, " (");
+    if (result[0] != '\0')
+        write_str(fd, result);
+    else if (signo != 0) {
+        write_str(fd, "no result; received signal ");
+        write_u64(fd, signo);
+    } else
+        write_str(fd, "no result");
+    write_str(fd, "); ");
+    write_u64(fd, total > capture.size ? total - capture.size : 0);
+    write_str(fd, " bytes discarded\n");
+
+    if (total <= capture.size)
+        write_all(fd, capture.ring->m_data, total);
+    else {
+        const size_t pos = total % capture.size;
+        write_all(fd, capture.ring->m_data + pos, capture.size - pos);
+        write_all(fd, capture.ring->m_data, pos);
+    }
+    if (total > 0 && capture.ring->m_data[(total - 1) % capture.size] != '\n')
+        write_str(fd, "\n");
+
+    write_str(fd, "*** End of output of ");
+    write_str(fd, capture.ident);
+    write_str(fd, "\n");
+}
+
+/*
+ * Restores the original stdout and stderr and reports the captured output
+ * according to the result of the test case.
+ */
+static
+void
+finish(const int signo)
+{
+    char result[256];
+
+    /* Subprocesses of the test case inherit the handlers; ignore them. */
+    if (!capture.active || getpid() != capture.pid)
+        return;
+    capture.active = false;
+
+    dup2(capture.out, STDOUT_FILENO);
+    dup2(capture.err, STDERR_FILENO);
+    stop_collector();
+
+    read_result(result, sizeof(result));
+    if (is_failure(result))
+        dump_ring(result, signo);
+    else if (capture.ring->m_total > 0) {
+        write_str(capture.err, "*** Discarded ");
+        write_u64(capture.err, capture.ring->m_total);
+        write_str(capture.err, " bytes of output of ");
+        write_str(capture.err, capture.ident);
+        write_str(capture.err, " (");
+        write_str(capture.err, result);
+        write_str(capture.err, ")\n");
+    }
+}
+
+static
+void
+finish_on_exit(void)
+{
+    if (capture.active && getpid() == capture.pid)
+        fflush(NULL);
+    finish(0);
+}
+
+static
+void
+finish_on_signal(const int signo)
+{
+    const int olderrno = errno;
+
+    finish(signo);
+    errno = olderrno;
+    raise(signo);
+}
+
+/*
+ * Copies the data read from the test case into the ring, overwriting the
+ * oldest bytes once it is full.
+ */
+static
+void
+append(struct ring *ring, const size_t size, const char *buf, size_t len)
+{
+    uint64_t total = ring->m_total;
+    size_t pos, first;
+
+    if (len > size) {
+        total += len - size;
+        buf += len - size;
+        len = size;
+    }
+    pos = total % size;
+    first = len < size - pos ? len : size - pos;
+    memcpy(ring->m_data + pos, buf, first);
+    memcpy(ring->m_data, buf + first, len - first);
+    ring->m_total = total + len;
+}
+
+static void collect(const int) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+collect(const int fd)
+{
+    char buf[64 * 1024];
+    int null;
+
+    /* Outlive the test case when a terminal interrupts them both. */
+    signal(SIGHUP, SIG_IGN);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTERM, SIG_IGN);
+
+    null = open("/dev/null", O_RDWR);
+    if (null != -1) {
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (null > STDERR_FILENO)
+            close(null);
+    }
+
+    for (;;) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        append(capture.ring, capture.size, buf, n);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+static
+atf_error_t
+map_ring(const size_t size, struct ring **ring)
+{
+    const size_t length = sizeof(struct ring) + size;
+    void *addr;
+
+#if defined(HAVE_MEMFD_CREATE)
+    const int fd = memfd_create("atf-output", MFD_CLOEXEC);
+    if (fd == -1)
+        return atf_libc_error(errno, "Cannot create the output buffer");
+    if (ftruncate(fd, length) == -1) {
+        const int olderrno = errno;
+        close(fd);
+        return atf_libc_error(olderrno, "Cannot size the output buffer");
+    }
+    addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+#else
+    addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON,
+                -1, 0);
+#endif
+    if (addr == MAP_FAILED)
+        return atf_libc_error(errno, "Cannot map the output buffer");
+
+    *ring = addr;
+    (*ring)->m_total = 0;
+    return atf_no_error();
+}
+
+static
+atf_error_t
+start_capture(const size_t size, const char *ident, const char *resfile)
+{
+    struct sigaction sa;
+    const int *sig;
+    atf_error_t err;
+    int fds[2];
+
+    capture.size = size;
+    capture.ident = strdup(ident);
+    if (capture.ident == NULL)
+        return atf_no_memory_error();
+    err = atf_fs_make_absolute(resfile, &capture.resfile);
+    if (atf_is_error(err))
+        return err;
+    err = map_ring(size, &capture.ring);
+    if (atf_is_error(err))
+        return err;
+
+    if (pipe(fds) == -1)
+        return atf_libc_error(errno, "Cannot create the output pipe");
+    capture.out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    capture.err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    if (capture.out == -1 || capture.err == -1) {
+        err = atf_libc_error(errno, "Cannot save the standard output");
+        goto out_fds;
+    }
+
+    fflush(NULL);
+    capture.collector = fork();
+    if (capture.collector == -1) {
+        err = atf_libc_error(errno, "Cannot fork the output collector");
+        goto out_fds;
+    } else if (capture.collector == 0) {
+        close(fds[1]);
+        collect(fds[0]);
+    }
+
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[1]);
+
+    capture.pid = getpid();
+    capture.active = true;
+    atexit(finish_on_exit);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = finish_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+    for (sig = fatal_signals; *sig != 0; sig++) {
+        struct sigaction old;
+
+        /* Respect the signals that the test program chose to ignore. */
+        if (sigaction(*sig, NULL, &old) == 0 && old.sa_handler == SIG_IGN)
+            continue;
+        sigaction(*sig, &sa, NULL);
+    }
+    return atf_no_error();
+
+out_fds:
+    close(fds[0]);
+    close(fds[1]);
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Parses a buffer size given as a number of bytes with an optional k, m
+ * or g suffix.
+ */
+atf_error_t
+atf_outbuf_parse_size(const char *str, size_t *size)
+{
+    unsigned long long value;
+    char *end;
+    int shift;
+
+    errno = 0;
+    value = strtoull(str, &end, 10);
+    if (end == str || str[0] == '-' || errno != 0)
+        return atf_libc_error(EINVAL, "Invalid output buffer size `%s'", str);
+
+    switch (*end) {
+    case '\0': shift = 0; break;
+    case 'k': case 'K': shift = 10; break;
+    case 'm': case 'M': shift = 20; break;
+    case 'g': case 'G': shift = 30; break;
+    default:
+        return atf_libc_error(EINVAL, "Invalid output buffer size `%s'", str);
+    }
+    if (shift != 0 && end[1] != '\0')
+        return atf_libc_error(EINVAL, "Invalid output buffer size `%s'", str);
+    if (value > (SIZE_MAX - sizeof(struct ring)) >> shift)
+        return atf_libc_error(ERANGE, "Output buffer size `%s' too large",
+                              str);
+
+    *size = (size_t)value << shift;
+    return atf_no_error();
+}
+
+/*
+ * Buffers the stdout and stderr of the given test case, from now until the
+ * process exits, if ATF_OUTPUT_BUFFER sets a non-zero size.  The output is
+ * only printed if the results file is left empty or reports a failure.
+ * Results printed to the standard output would end up in the buffer, so
+ * nothing is buffered in that case.  Only one test case can be buffered
+ * per process; problems are reported but leave the output untouched.
+ */
+void
+atf_outbuf_capture(const char *ident, const char *resfile)
+{
+    atf_error_t err;
+    size_t size;
+
+    if (!atf_env_has("ATF_OUTPUT_BUFFER") ||
+        atf_env_get("ATF_OUTPUT_BUFFER")[0] == '\0' ||
+        strcmp(resfile, "/dev/stdout") == 0 ||
+        strcmp(resfile, "/dev/stderr") == 0 || capture.ring != NULL)
+        return;
+
+    err = atf_outbuf_parse_size(atf_env_get("ATF_OUTPUT_BUFFER"), &size);
+    if (!atf_is_error(err) && size > 0)
+        err = start_capture(size, ident, resfile);
+    if (atf_is_error(err)) {
+        char buf[1024];
+
+        atf_error_format(err, buf, sizeof(buf));
+        fprintf(stderr, "WARNING: Not buffering the output of %s: %s\n",
+                ident, buf);
+        atf_error_free(err);
+    }
+}
@@ -0,0 +1,99 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/outbuf.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/test_helpers.h"
+#include "atf-c/error.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+check_invalid(const char *str, const int code)
+{
+    atf_error_t err;
+    size_t size;
+
+    printf("Parsing invalid size `%s'\n", str);
+    err = atf_outbuf_parse_size(str, &size);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    ATF_CHECK_EQ(code, atf_libc_error_code(err));
+    atf_error_free(err);
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(parse_size);
+ATF_TC_BODY(parse_size, tc)
+{
+    size_t size;
+
+    RE(atf_outbuf_parse_size("0", &size));
+    ATF_CHECK_EQ(0, size);
+    RE(atf_outbuf_parse_size("1234", &size));
+    ATF_CHECK_EQ(1234, size);
+    RE(atf_outbuf_parse_size("4k", &size));
+    ATF_CHECK_EQ(4096, size);
+    RE(atf_outbuf_parse_size("3M", &size));
+    ATF_CHECK_EQ(3 * 1024 * 1024, size);
+    RE(atf_outbuf_parse_size("1g", &size));
+    ATF_CHECK_EQ(1024 * 1024 * 1024, size);
+}
+
+ATF_TC_WITHOUT_HEAD(parse_size_invalid);
+ATF_TC_BODY(parse_size_invalid, tc)
+{
+    check_invalid("", EINVAL);
+    check_invalid("k", EINVAL);
+    check_invalid("-1", EINVAL);
+    check_invalid("12x", EINVAL);
+    check_invalid("1kb", EINVAL);
+    check_invalid("99999999999999999999", EINVAL);
+    check_invalid("18446744073709551615g", ERANGE);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, parse_size);
+    ATF_TP_ADD_TC(tp, parse_size_invalid);
+
+    return atf_no_error();
+}
@@ -26,6 +26,8 @@
 #include "atf-c/detail/process.h"
 
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 #include <errno.h>
@@ -40,10 +42,6 @@
 #include "atf-c/detail/sanity.h"
 #include "atf-c/error.h"
 
-/* This prototype is not in the header file because this is a private
- * function; however, we need to access it during testing. */
-atf_error_t atf_process_status_init(atf_process_status_t *, int);
-
 /* ---------------------------------------------------------------------
  * The "stream_prepare" auxiliary type.
  * --------------------------------------------------------------------- */
@@ -186,9 +184,10 @@ atf_process_stream_type(const atf_process_stream_t *sb)
  * --------------------------------------------------------------------- */
 
 atf_error_t
-atf_process_status_init(atf_process_status_t *s, int status)
+atf_process_status_init_raw(atf_process_status_t *s, int status)
 {
     s->m_status = status;
+    memset(&s->m_rusage, 0, sizeof(s->m_rusage));
 
     return atf_no_error();
 }
@@ -240,6 +239,12 @@ atf_process_status_coredump(const atf_process_status_t *s)
 #endif
 }
 
+const struct rusage *
+atf_process_status_rusage(const atf_process_status_t *s)
+{
+    return &s->m_rusage;
+}
+
 /* ---------------------------------------------------------------------
  * The "atf_process_child" type.
  * --------------------------------------------------------------------- */
@@ -270,13 +275,49 @@ atf_process_child_wait(atf_process_child_t *c, atf_process_status_t *s)
 {
     atf_error_t err;
     int status;
+    struct rusage rusage;
 
-    if (waitpid(c->m_pid, &status, 0) == -1)
+    if (wait4(c->m_pid, &status, 0, &rusage) == -1)
         err = atf_libc_error(errno, "Failed waiting for process %d",
                              c->m_pid);
     else {
         atf_process_child_fini(c);
-        err = atf_process_status_init(s, status);
+        err = atf_process_status_init_raw(s, status);
+        if (!atf_is_error(err))
+            s->m_rusage = rusage;
+    }
+
+    return err;
+}
+
+/*
+ * Same as atf_process_child_wait but does not block if the child is still
+ * running, in which case done is set to false and the child remains valid.
+ * Otherwise, done is set to true and the status is initialized.
+ */
+atf_error_t
+atf_process_child_try_wait(atf_process_child_t *c, atf_process_status_t *s,
+                           bool *done)
+{
+    atf_error_t err;
+    int status;
+    struct rusage rusage;
+    pid_t pid;
+
+    pid = wait4(c->m_pid, &status, WNOHANG, &rusage);
+    if (pid == -1)
+        err = atf_libc_error(errno, "Failed waiting for process %d",
+                             c->m_pid);
+    else if (pid == 0) {
+        *done = false;
+        err = atf_no_error();
+    } else {
+        atf_process_child_fini(c);
+        err = atf_process_status_init_raw(s, status);
+        if (!atf_is_error(err)) {
+            s->m_rusage = rusage;
+            *done = true;
+        }
     }
 
     return err;
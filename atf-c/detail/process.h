@@ -27,6 +27,8 @@
 #define ATF_C_DETAIL_PROCESS_H
 
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include <stdbool.h>
 
@@ -77,9 +79,13 @@ int atf_process_stream_type(const atf_process_stream_t *);
 
 struct atf_process_status {
     int m_status;
+    struct rusage m_rusage;
 };
 typedef struct atf_process_status atf_process_status_t;
 
+/* Builds a status from a raw wait(2) status, e.g. one received from another
+ * process, with all its resource usage figures set to zero. */
+atf_error_t atf_process_status_init_raw(atf_process_status_t *, int);
 void atf_process_status_fini(atf_process_status_t *);
 
 bool atf_process_status_exited(const atf_process_status_t *);
@@ -87,6 +93,7 @@ int atf_process_status_exitstatus(const atf_process_status_t *);
 bool atf_process_status_signaled(const atf_process_status_t *);
 int atf_process_status_termsig(const atf_process_status_t *);
 bool atf_process_status_coredump(const atf_process_status_t *);
+const struct rusage *atf_process_status_rusage(const atf_process_status_t *);
 
 /* ---------------------------------------------------------------------
  * The "atf_process_child" type.
@@ -102,6 +109,8 @@ typedef struct atf_process_child atf_process_child_t;
 
 atf_error_t atf_process_child_wait(atf_process_child_t *,
                                    atf_process_status_t *);
+atf_error_t atf_process_child_try_wait(atf_process_child_t *,
+                                       atf_process_status_t *, bool *);
 pid_t atf_process_child_pid(const atf_process_child_t *);
 int atf_process_child_stdout(atf_process_child_t *);
 int atf_process_child_stderr(atf_process_child_t *);
@@ -44,8 +44,6 @@
 #include "atf-c/detail/sanity.h"
 #include "atf-c/detail/test_helpers.h"
 
-atf_error_t atf_process_status_init(atf_process_status_t *, int);
-
 /* ---------------------------------------------------------------------
  * Auxiliary functions for testing of 'atf_process_fork'.
  * --------------------------------------------------------------------- */
@@ -603,7 +601,7 @@ ATF_TC_BODY(status_exited, tc)
     {
         const int rawstatus = fork_and_wait_child(child_exit_success);
         atf_process_status_t s;
-        RE(atf_process_status_init(&s, rawstatus));
+        RE(atf_process_status_init_raw(&s, rawstatus));
         ATF_CHECK(atf_process_status_exited(&s));
         ATF_CHECK_EQ(atf_process_status_exitstatus(&s), EXIT_SUCCESS);
         ATF_CHECK(!atf_process_status_signaled(&s));
@@ -613,7 +611,7 @@ ATF_TC_BODY(status_exited, tc)
     {
         const int rawstatus = fork_and_wait_child(child_exit_failure);
         atf_process_status_t s;
-        RE(atf_process_status_init(&s, rawstatus));
+        RE(atf_process_status_init_raw(&s, rawstatus));
         ATF_CHECK(atf_process_status_exited(&s));
         ATF_CHECK_EQ(atf_process_status_exitstatus(&s), EXIT_FAILURE);
         ATF_CHECK(!atf_process_status_signaled(&s));
@@ -632,7 +630,7 @@ ATF_TC_BODY(status_signaled, tc)
     {
         const int rawstatus = fork_and_wait_child(child_sigkill);
         atf_process_status_t s;
-        RE(atf_process_status_init(&s, rawstatus));
+        RE(atf_process_status_init_raw(&s, rawstatus));
         ATF_CHECK(!atf_process_status_exited(&s));
         ATF_CHECK(atf_process_status_signaled(&s));
         ATF_CHECK_EQ(atf_process_status_termsig(&s), SIGKILL);
@@ -643,7 +641,7 @@ ATF_TC_BODY(status_signaled, tc)
     {
         const int rawstatus = fork_and_wait_child(child_sigterm);
         atf_process_status_t s;
-        RE(atf_process_status_init(&s, rawstatus));
+        RE(atf_process_status_init_raw(&s, rawstatus));
         ATF_CHECK(!atf_process_status_exited(&s));
         ATF_CHECK(atf_process_status_signaled(&s));
         ATF_CHECK_EQ(atf_process_status_termsig(&s), SIGTERM);
@@ -669,7 +667,7 @@ ATF_TC_BODY(status_coredump, tc)
 
     const int rawstatus = fork_and_wait_child(child_sigquit);
     atf_process_status_t s;
-    RE(atf_process_status_init(&s, rawstatus));
+    RE(atf_process_status_init_raw(&s, rawstatus));
     ATF_CHECK(!atf_process_status_exited(&s));
     ATF_CHECK(atf_process_status_signaled(&s));
     ATF_CHECK_EQ(atf_process_status_termsig(&s), SIGQUIT);
@@ -724,6 +722,105 @@ ATF_TC_BODY(child_pid, tc)
     atf_process_stream_fini(&errsb);
 }
 
+static void child_wait_for_input(void *) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+child_wait_for_input(void *v)
+{
+    const int *fds = v;
+    char ch;
+
+    close(fds[1]);
+    exit(read(fds[0], &ch, sizeof(ch)) == 1 ? ch : EXIT_FAILURE);
+}
+
+ATF_TC(child_try_wait);
+ATF_TC_HEAD(child_try_wait, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_process_child_try_wait "
+                      "does not block on running children");
+}
+ATF_TC_BODY(child_try_wait, tc)
+{
+    atf_process_stream_t outsb, errsb;
+    atf_process_child_t child;
+    atf_process_status_t status;
+    bool done;
+    int fds[2];
+
+    RE(atf_process_stream_init_inherit(&outsb));
+    RE(atf_process_stream_init_inherit(&errsb));
+
+    ATF_REQUIRE(pipe(fds) != -1);
+    RE(atf_process_fork(&child, child_wait_for_input, &outsb, &errsb, fds));
+    close(fds[0]);
+
+    RE(atf_process_child_try_wait(&child, &status, &done));
+    ATF_REQUIRE(!done);
+
+    ATF_REQUIRE(write(fds[1], "\5", 1) == 1);
+    close(fds[1]);
+    do {
+        RE(atf_process_child_try_wait(&child, &status, &done));
+        if (!done)
+            usleep(1000);
+    } while (!done);
+    ATF_CHECK(atf_process_status_exited(&status));
+    ATF_CHECK_EQ(5, atf_process_status_exitstatus(&status));
+    atf_process_status_fini(&status);
+
+    atf_process_stream_fini(&outsb);
+    atf_process_stream_fini(&errsb);
+}
+
+static void child_spin(void *) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+child_spin(void *v ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    struct rusage ru;
+
+    do {
+        if (getrusage(RUSAGE_SELF, &ru) == -1)
+            abort();
+    } while (ru.ru_utime.tv_sec == 0 && ru.ru_utime.tv_usec < 100000);
+    exit(EXIT_SUCCESS);
+}
+
+ATF_TC(child_rusage);
+ATF_TC_HEAD(child_rusage, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that waiting for a child "
+                      "records its resource usage");
+}
+ATF_TC_BODY(child_rusage, tc)
+{
+    atf_process_stream_t outsb, errsb;
+    atf_process_child_t child;
+    atf_process_status_t status;
+    const struct rusage *ru;
+
+    RE(atf_process_stream_init_inherit(&outsb));
+    RE(atf_process_stream_init_inherit(&errsb));
+
+    RE(atf_process_fork(&child, child_spin, &outsb, &errsb, NULL));
+    RE(atf_process_child_wait(&child, &status));
+    ATF_CHECK(atf_process_status_exited(&status));
+
+    ru = atf_process_status_rusage(&status);
+    printf("User time: %ld.%06ld\n", (long)ru->ru_utime.tv_sec,
+           (long)ru->ru_utime.tv_usec);
+    printf("Max RSS: %ld\n", (long)ru->ru_maxrss);
+    ATF_CHECK(ru->ru_utime.tv_sec > 0 || ru->ru_utime.tv_usec >= 100000);
+    ATF_CHECK(ru->ru_maxrss > 0);
+    atf_process_status_fini(&status);
+
+    atf_process_stream_fini(&outsb);
+    atf_process_stream_fini(&errsb);
+}
+
 static
 void
 child_loop(void *v ATF_DEFS_ATTRIBUTE_UNUSED)
@@ -1110,6 +1207,8 @@ ATF_TP_ADD_TCS(tp)
 
     /* Add the tests for the "child" type. */
     ATF_TP_ADD_TC(tp, child_pid);
+    ATF_TP_ADD_TC(tp, child_rusage);
+    ATF_TP_ADD_TC(tp, child_try_wait);
     ATF_TP_ADD_TC(tp, child_wait_eintr);
 
     /* Add the tests for the free functions. */
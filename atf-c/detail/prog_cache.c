@@ -0,0 +1,393 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/prog_cache.h"
+
+#include <sys/types.h>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/*
+ * Looking for a program in the PATH used to mean checking every directory
+ * in it for an executable file with the given name, which adds up when a
+ * test case requires many programs and the PATH is long.
+ *
+ * Instead, once a process has done enough lookups for a given PATH, all of
+ * its directories are read once and a sorted index of the names found in
+ * them is kept.  Further lookups for the same PATH only check if the
+ * candidates of the index are executable, which usually takes a single
+ * system call.  If none is, the directories are searched one by one as
+ * before, so that programs created after the index was built are still
+ * found.
+ *
+ * Reading the directories costs far more than probing them for a handful
+ * of programs, so processes that only do a few lookups, like a test
+ * program checking the requirements of a single test case, never build
+ * the index and keep probing the directories one by one.
+ *
+ * There is a single cache per process, reset whenever the PATH given to
+ * a lookup differs from the one it was set up for.
+ */
+
+/* Number of lookups for the same PATH after which the index is built. */
+#define INDEX_THRESHOLD 256
+
+struct prog_entry {
+    size_t m_name; /* Offset of the name in the pool. */
+    size_t m_dir;  /* Index of the directory in the PATH. */
+};
+
+static struct prog_cache {
+    bool m_valid;
+    bool m_indexed;
+    size_t m_lookups;
+    char *m_path;
+    char *m_dirbuf;
+    const char **m_dirs;
+    size_t m_ndirs;
+    char *m_pool;
+    size_t m_poollen;
+    size_t m_poolsize;
+    struct prog_entry *m_entries;
+    size_t m_nentries;
+    size_t m_entriessize;
+} Cache;
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+atf_error_t
+add_entry(const char *name, const size_t dir)
+{
+    const size_t len = strlen(name) + 1;
+
+    if (Cache.m_poollen + len > Cache.m_poolsize) {
+        size_t size = Cache.m_poolsize == 0 ? 4096 : Cache.m_poolsize;
+        char *pool;
+
+        while (size < Cache.m_poollen + len)
+            size *= 2;
+        pool = realloc(Cache.m_pool, size);
+        if (pool == NULL)
+            return atf_no_memory_error();
+        Cache.m_pool = pool;
+        Cache.m_poolsize = size;
+    }
+
+    if (Cache.m_nentries == Cache.m_entriessize) {
+        const size_t size = Cache.m_entriessize == 0 ?
+            256 : Cache.m_entriessize * 2;
+        struct prog_entry *entries;
+
+        entries = realloc(Cache.m_entries, size * sizeof(*entries));
+        if (entries == NULL)
+            return atf_no_memory_error();
+        Cache.m_entries = entries;
+        Cache.m_entriessize = size;
+    }
+
+    memcpy(Cache.m_pool + Cache.m_poollen, name, len);
+    Cache.m_entries[Cache.m_nentries].m_name = Cache.m_poollen;
+    Cache.m_entries[Cache.m_nentries].m_dir = dir;
+    Cache.m_nentries++;
+    Cache.m_poollen += len;
+    return atf_no_error();
+}
+
+static
+atf_error_t
+scan_dir(const size_t dir)
+{
+    atf_error_t err;
+    struct dirent *de;
+    DIR *d;
+
+    /* Directories that cannot be read are only searched one by one. */
+    d = opendir(Cache.m_dirs[dir]);
+    if (d == NULL)
+        return atf_no_error();
+
+    err = atf_no_error();
+    while (!atf_is_error(err) && (de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        err = add_entry(de->d_name, dir);
+    }
+    closedir(d);
+
+    return err;
+}
+
+static
+int
+compare_entries(const void *a, const void *b)
+{
+    const struct prog_entry *ea = a;
+    const struct prog_entry *eb = b;
+    int cmp;
+
+    cmp = strcmp(Cache.m_pool + ea->m_name, Cache.m_pool + eb->m_name);
+    if (cmp != 0)
+        return cmp;
+    return ea->m_dir < eb->m_dir ? -1 : ea->m_dir > eb->m_dir;
+}
+
+static
+atf_error_t
+setup(const char *path)
+{
+    atf_error_t err;
+    const char *p;
+    char *dir;
+    size_t n;
+
+    atf_prog_cache_clear();
+
+    n = 1;
+    for (p = path; *p != '\0'; p++)
+        if (*p == ':')
+            n++;
+
+    Cache.m_path = strdup(path);
+    Cache.m_dirbuf = strdup(path);
+    Cache.m_dirs = malloc(n * sizeof(*Cache.m_dirs));
+    if (Cache.m_path == NULL || Cache.m_dirbuf == NULL ||
+        Cache.m_dirs == NULL) {
+        err = atf_no_memory_error();
+        goto err;
+    }
+
+    /* Empty components are ignored, as atf_text_for_each_word does. */
+    dir = Cache.m_dirbuf;
+    while (dir != NULL) {
+        char *next = strchr(dir, ':');
+
+        if (next != NULL)
+            *next++ = '\0';
+        if (*dir != '\0')
+            Cache.m_dirs[Cache.m_ndirs++] = dir;
+        dir = next;
+    }
+
+    Cache.m_valid = true;
+    return atf_no_error();
+
+err:
+    atf_prog_cache_clear();
+    return err;
+}
+
+static
+atf_error_t
+build_index(void)
+{
+    atf_error_t err;
+    size_t i;
+
+    PRE(Cache.m_valid && !Cache.m_indexed);
+
+    for (i = 0; i < Cache.m_ndirs; i++) {
+        err = scan_dir(i);
+        if (atf_is_error(err)) {
+            atf_prog_cache_clear();
+            return err;
+        }
+    }
+
+    if (Cache.m_nentries > 0)
+        qsort(Cache.m_entries, Cache.m_nentries, sizeof(*Cache.m_entries),
+              compare_entries);
+    Cache.m_indexed = true;
+    return atf_no_error();
+}
+
+/*
+ * Returns the index of the first entry of the cache for the given name,
+ * or the position where it would be.
+ */
+static
+size_t
+first_entry(const char *name)
+{
+    size_t lo, hi;
+
+    lo = 0;
+    hi = Cache.m_nentries;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(Cache.m_pool + Cache.m_entries[mid].m_name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Checks if the candidate is executable and, if so, moves it into p
+ * unless p is NULL.  The candidate is always finalized.
+ */
+static
+void
+check_candidate(atf_fs_path_t *candidate, atf_fs_path_t *p, bool *found)
+{
+    atf_error_t err;
+
+    err = atf_fs_eaccess(candidate, atf_fs_access_x);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        *found = false;
+    } else {
+        if (p != NULL)
+            atf_fs_path_move(p, candidate);
+        *found = true;
+    }
+    atf_fs_path_fini(candidate);
+}
+
+static
+atf_error_t
+check_in_dir(const char *dir, const char *prog, atf_fs_path_t *p,
+             bool *found)
+{
+    atf_error_t err;
+    atf_fs_path_t candidate;
+
+    err = atf_fs_path_init_fmt(&candidate, "%s/%s", dir, prog);
+    if (!atf_is_error(err))
+        check_candidate(&candidate, p, found);
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Looks for the program prog, which must be a plain file name, in the
+ * directories of path, which can be NULL.  If the program is found and
+ * p is not NULL, p is initialized with the full path to it.
+ */
+atf_error_t
+atf_prog_cache_find(const char *path, const char *prog, atf_fs_path_t *p,
+                    bool *found)
+{
+    atf_error_t err;
+    size_t i;
+
+    PRE(prog[0] != '\0' && strchr(prog, '/') == NULL);
+
+    if (path == NULL)
+        path = "";
+    if (!Cache.m_valid || strcmp(Cache.m_path, path) != 0) {
+        err = setup(path);
+        if (atf_is_error(err))
+            return err;
+    }
+    if (!Cache.m_indexed && ++Cache.m_lookups > INDEX_THRESHOLD) {
+        err = build_index();
+        if (atf_is_error(err))
+            return err;
+    }
+
+    *found = false;
+    for (i = first_entry(prog); i < Cache.m_nentries &&
+         strcmp(Cache.m_pool + Cache.m_entries[i].m_name, prog) == 0; i++) {
+        err = check_in_dir(Cache.m_dirs[Cache.m_entries[i].m_dir], prog, p,
+                           found);
+        if (atf_is_error(err) || *found)
+            return err;
+    }
+
+    for (i = 0; i < Cache.m_ndirs; i++) {
+        err = check_in_dir(Cache.m_dirs[i], prog, p, found);
+        if (atf_is_error(err) || *found)
+            return err;
+    }
+
+    return atf_no_error();
+}
+
+/*
+ * Looks for all the programs in the NULL-terminated progs array, as in
+ * the require.progs property of a test case: every one of them is either
+ * an absolute path or a plain file name to look for in path.  On return,
+ * missing points to the first program that could not be found, or is
+ * NULL if all of them were.
+ */
+atf_error_t
+atf_prog_cache_find_all(const char *path, const char *const *progs,
+                        const char **missing)
+{
+    atf_error_t err;
+    bool found;
+
+    err = atf_no_error();
+    found = true;
+    for (; found && *progs != NULL; progs++) {
+        if ((*progs)[0] == '/') {
+            atf_fs_path_t candidate;
+
+            err = atf_fs_path_init_fmt(&candidate, "%s", *progs);
+            if (atf_is_error(err))
+                break;
+            check_candidate(&candidate, NULL, &found);
+        } else {
+            err = atf_prog_cache_find(path, *progs, NULL, &found);
+            if (atf_is_error(err))
+                break;
+        }
+
+        if (!found)
+            *missing = *progs;
+    }
+    if (found)
+        *missing = NULL;
+
+    return err;
+}
+
+/*
+ * Releases the cache.  The next lookups set it up again from scratch.
+ */
+void
+atf_prog_cache_clear(void)
+{
+    free(Cache.m_path);
+    free(Cache.m_dirbuf);
+    free(Cache.m_dirs);
+    free(Cache.m_pool);
+    free(Cache.m_entries);
+    memset(&Cache, 0, sizeof(Cache));
+}
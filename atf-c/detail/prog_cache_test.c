@@ -0,0 +1,259 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/prog_cache.h"
+
+#include <sys/stat.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+create_prog(const char *dir, const char *name, const mode_t mode)
+{
+    char file[1024];
+
+    (void)mkdir(dir, 0755);
+    snprintf(file, sizeof(file), "%s/%s", dir, name);
+    atf_utils_create_file(file, "#!/bin/sh\n");
+    ATF_REQUIRE(chmod(file, mode) != -1);
+}
+
+/*
+ * Builds a PATH with the given directories, which are made absolute
+ * because the test cases run in their own work directory.
+ */
+static
+void
+make_path(char *path, const size_t size, const char *dir1, const char *dir2)
+{
+    char cwd[1024];
+
+    ATF_REQUIRE(getcwd(cwd, sizeof(cwd)) != NULL);
+    snprintf(path, size, "%s/%s::%s/%s", cwd, dir1, cwd, dir2);
+}
+
+static
+void
+check_found(const char *path, const char *prog, const char *exp_dir)
+{
+    atf_fs_path_t p;
+    bool found;
+
+    RE(atf_prog_cache_find(path, prog, &p, &found));
+    ATF_REQUIRE(found);
+    ATF_CHECK_MSG(strstr(atf_fs_path_cstring(&p), exp_dir) != NULL,
+                  "%s not in %s", prog, exp_dir);
+    atf_fs_path_fini(&p);
+}
+
+static
+void
+check_not_found(const char *path, const char *prog)
+{
+    bool found;
+
+    RE(atf_prog_cache_find(path, prog, NULL, &found));
+    ATF_CHECK_MSG(!found, "%s found", prog);
+}
+
+/*
+ * Does enough lookups for the given PATH to make the cache index its
+ * directories, which it only does for callers with many lookups.
+ */
+static
+void
+warm_up(const char *path)
+{
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        bool found;
+
+        RE(atf_prog_cache_find(path, "warm-up", NULL, &found));
+        ATF_REQUIRE(!found);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_prog_cache_find function");
+}
+ATF_TC_BODY(find, tc)
+{
+    char path[4096];
+
+    create_prog("dir1", "prog1", 0755);
+    create_prog("dir1", "prog2", 0644);
+    create_prog("dir2", "prog2", 0755);
+    create_prog("dir2", "prog3", 0755);
+    make_path(path, sizeof(path), "dir1", "dir2");
+
+    atf_prog_cache_clear();
+    check_found(path, "prog1", "/dir1/prog1");
+    check_found(path, "prog2", "/dir2/prog2");
+    check_found(path, "prog3", "/dir2/prog3");
+    check_not_found(path, "prog4");
+    check_not_found(path, "prog");
+}
+
+ATF_TC(find_created_later);
+ATF_TC_HEAD(find_created_later, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_prog_cache_find finds "
+                      "programs created after the cache was built");
+}
+ATF_TC_BODY(find_created_later, tc)
+{
+    char path[4096];
+
+    create_prog("dir1", "prog1", 0755);
+    create_prog("dir2", "prog2", 0644);
+    make_path(path, sizeof(path), "dir1", "dir2");
+
+    atf_prog_cache_clear();
+    check_found(path, "prog1", "/dir1/prog1");
+    check_not_found(path, "prog2");
+
+    ATF_REQUIRE(chmod("dir2/prog2", 0755) != -1);
+    create_prog("dir1", "prog3", 0755);
+    check_found(path, "prog2", "/dir2/prog2");
+    check_found(path, "prog3", "/dir1/prog3");
+
+    ATF_REQUIRE(unlink("dir1/prog1") != -1);
+    check_not_found(path, "prog1");
+}
+
+ATF_TC(find_indexed);
+ATF_TC_HEAD(find_indexed, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests atf_prog_cache_find once the "
+                      "cache has indexed the PATH");
+}
+ATF_TC_BODY(find_indexed, tc)
+{
+    char path[4096];
+
+    create_prog("dir1", "prog1", 0755);
+    create_prog("dir1", "prog2", 0644);
+    create_prog("dir2", "prog2", 0755);
+    make_path(path, sizeof(path), "dir1", "dir2");
+
+    atf_prog_cache_clear();
+    warm_up(path);
+    check_found(path, "prog1", "/dir1/prog1");
+    check_found(path, "prog2", "/dir2/prog2");
+    check_not_found(path, "prog3");
+
+    create_prog("dir2", "prog3", 0755);
+    check_found(path, "prog3", "/dir2/prog3");
+    ATF_REQUIRE(unlink("dir1/prog1") != -1);
+    check_not_found(path, "prog1");
+}
+
+ATF_TC(find_path_change);
+ATF_TC_HEAD(find_path_change, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_prog_cache_find honors "
+                      "changes to the PATH");
+}
+ATF_TC_BODY(find_path_change, tc)
+{
+    char path[4096];
+
+    create_prog("dir1", "prog", 0755);
+    create_prog("dir2", "prog", 0755);
+    create_prog("dir3", "prog", 0755);
+
+    atf_prog_cache_clear();
+    make_path(path, sizeof(path), "dir1", "dir2");
+    check_found(path, "prog", "/dir1/prog");
+    make_path(path, sizeof(path), "dir3", "dir2");
+    check_found(path, "prog", "/dir3/prog");
+    check_not_found("", "prog");
+    check_not_found(NULL, "prog");
+}
+
+ATF_TC(find_all);
+ATF_TC_HEAD(find_all, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_prog_cache_find_all "
+                      "function");
+}
+ATF_TC_BODY(find_all, tc)
+{
+    const char *progs[] = { "prog1", "/bin/sh", "prog2", NULL };
+    const char *missing[] = { "prog1", "/non-existent/prog", "prog3",
+                              "prog2", NULL };
+    const char *none[] = { NULL };
+    const char *m;
+    char path[4096];
+
+    create_prog("dir1", "prog1", 0755);
+    create_prog("dir2", "prog2", 0755);
+    make_path(path, sizeof(path), "dir1", "dir2");
+
+    atf_prog_cache_clear();
+    RE(atf_prog_cache_find_all(path, progs, &m));
+    ATF_CHECK(m == NULL);
+    RE(atf_prog_cache_find_all(path, none, &m));
+    ATF_CHECK(m == NULL);
+    RE(atf_prog_cache_find_all(path, missing, &m));
+    ATF_CHECK_STREQ("/non-existent/prog", m);
+    RE(atf_prog_cache_find_all(path, missing + 2, &m));
+    ATF_CHECK_STREQ("prog3", m);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, find);
+    ATF_TP_ADD_TC(tp, find_created_later);
+    ATF_TP_ADD_TC(tp, find_indexed);
+    ATF_TP_ADD_TC(tp, find_path_change);
+    ATF_TP_ADD_TC(tp, find_all);
+
+    return atf_no_error();
+}
@@ -0,0 +1,193 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/sha256.h"
+
+#include <string.h>
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static const uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static
+void
+transform(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i * 4] << 24) |
+               ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) |
+               ((uint32_t)block[i * 4 + 3]);
+    for (i = 16; i < 64; i++) {
+        const uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^
+                            (w[i - 15] >> 3);
+        const uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^
+                            (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = state[0]; b = state[1]; c = state[2]; d = state[3];
+    e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+    for (i = 0; i < 64; i++) {
+        const uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        const uint32_t ch = (e & f) ^ (~e & g);
+        const uint32_t t1 = h + s1 + ch + round_constants[i] + w[i];
+        const uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        const uint32_t t2 = s0 + maj;
+
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+#undef ROTR
+
+/* ---------------------------------------------------------------------
+ * The "atf_sha256" type.
+ * --------------------------------------------------------------------- */
+
+void
+atf_sha256_init(atf_sha256_t *s)
+{
+    s->m_state[0] = 0x6a09e667;
+    s->m_state[1] = 0xbb67ae85;
+    s->m_state[2] = 0x3c6ef372;
+    s->m_state[3] = 0xa54ff53a;
+    s->m_state[4] = 0x510e527f;
+    s->m_state[5] = 0x9b05688c;
+    s->m_state[6] = 0x1f83d9ab;
+    s->m_state[7] = 0x5be0cd19;
+    s->m_length = 0;
+    s->m_buflen = 0;
+}
+
+void
+atf_sha256_update(atf_sha256_t *s, const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+
+    s->m_length += length;
+
+    if (s->m_buflen > 0) {
+        size_t n = sizeof(s->m_buffer) - s->m_buflen;
+        if (n > length)
+            n = length;
+        memcpy(s->m_buffer + s->m_buflen, bytes, n);
+        s->m_buflen += n;
+        bytes += n;
+        length -= n;
+        if (s->m_buflen < sizeof(s->m_buffer))
+            return;
+        transform(s->m_state, s->m_buffer);
+        s->m_buflen = 0;
+    }
+
+    while (length >= sizeof(s->m_buffer)) {
+        transform(s->m_state, bytes);
+        bytes += sizeof(s->m_buffer);
+        length -= sizeof(s->m_buffer);
+    }
+
+    memcpy(s->m_buffer, bytes, length);
+    s->m_buflen = length;
+}
+
+void
+atf_sha256_final(atf_sha256_t *s, uint8_t digest[ATF_SHA256_DIGEST_LENGTH])
+{
+    const uint64_t bits = s->m_length * 8;
+    int i;
+
+    s->m_buffer[s->m_buflen++] = 0x80;
+    if (s->m_buflen > sizeof(s->m_buffer) - 8) {
+        memset(s->m_buffer + s->m_buflen, 0,
+               sizeof(s->m_buffer) - s->m_buflen);
+        transform(s->m_state, s->m_buffer);
+        s->m_buflen = 0;
+    }
+    memset(s->m_buffer + s->m_buflen, 0,
+           sizeof(s->m_buffer) - 8 - s->m_buflen);
+    for (i = 0; i < 8; i++)
+        s->m_buffer[sizeof(s->m_buffer) - 1 - i] = (uint8_t)(bits >> (i * 8));
+    transform(s->m_state, s->m_buffer);
+
+    for (i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(s->m_state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(s->m_state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(s->m_state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)(s->m_state[i]);
+    }
+}
+
+void
+atf_sha256_final_hex(atf_sha256_t *s, char hex[ATF_SHA256_HEX_LENGTH])
+{
+    static const char digits[] = "0123456789abcdef";
+    uint8_t digest[ATF_SHA256_DIGEST_LENGTH];
+    int i;
+
+    atf_sha256_final(s, digest);
+    for (i = 0; i < ATF_SHA256_DIGEST_LENGTH; i++) {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[ATF_SHA256_DIGEST_LENGTH * 2] = '\0';
+}
+
+uint64_t
+atf_sha256_length(const atf_sha256_t *s)
+{
+    return s->m_length;
+}
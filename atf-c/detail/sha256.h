@@ -0,0 +1,54 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_SHA256_H)
+#define ATF_C_DETAIL_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ---------------------------------------------------------------------
+ * The "atf_sha256" type.
+ * --------------------------------------------------------------------- */
+
+#define ATF_SHA256_DIGEST_LENGTH 32
+#define ATF_SHA256_HEX_LENGTH (ATF_SHA256_DIGEST_LENGTH * 2 + 1)
+
+struct atf_sha256 {
+    uint32_t m_state[8];
+    uint64_t m_length;
+    uint8_t m_buffer[64];
+    size_t m_buflen;
+};
+typedef struct atf_sha256 atf_sha256_t;
+
+void atf_sha256_init(atf_sha256_t *);
+void atf_sha256_update(atf_sha256_t *, const void *, size_t);
+void atf_sha256_final(atf_sha256_t *, uint8_t [ATF_SHA256_DIGEST_LENGTH]);
+void atf_sha256_final_hex(atf_sha256_t *, char [ATF_SHA256_HEX_LENGTH]);
+
+uint64_t atf_sha256_length(const atf_sha256_t *);
+
+#endif /* !defined(ATF_C_DETAIL_SHA256_H) */
@@ -0,0 +1,145 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/sha256.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+check_digest(const char *data, const size_t chunk, const char *exp)
+{
+    atf_sha256_t s;
+    char hex[ATF_SHA256_HEX_LENGTH];
+    const size_t length = strlen(data);
+    size_t done;
+
+    atf_sha256_init(&s);
+    for (done = 0; done < length; done += chunk)
+        atf_sha256_update(&s, data + done,
+                          length - done < chunk ? length - done : chunk);
+    ATF_CHECK_EQ(length, atf_sha256_length(&s));
+    atf_sha256_final_hex(&s, hex);
+    ATF_CHECK_STREQ_MSG(exp, hex, "digest of '%s' in chunks of %zd bytes",
+                        data, chunk);
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the "atf_sha256" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(empty);
+ATF_TC_HEAD(empty, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks the digest of an empty input");
+}
+ATF_TC_BODY(empty, tc)
+{
+    atf_sha256_t s;
+    char hex[ATF_SHA256_HEX_LENGTH];
+
+    atf_sha256_init(&s);
+    atf_sha256_final_hex(&s, hex);
+    ATF_CHECK_STREQ("e3b0c44298fc1c149afbf4c8996fb924"
+                    "27ae41e4649b934ca495991b7852b855", hex);
+}
+
+ATF_TC(known_vectors);
+ATF_TC_HEAD(known_vectors, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks the digests of the FIPS 180-2 "
+                      "test vectors");
+}
+ATF_TC_BODY(known_vectors, tc)
+{
+    check_digest("abc", 3,
+                 "ba7816bf8f01cfea414140de5dae2223"
+                 "b00361a396177a9cb410ff61f20015ad");
+    check_digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                 56,
+                 "248d6a61d20638b8e5c026930c3e6039"
+                 "a33ce45964ff2167f6ecedd419db06c1");
+}
+
+ATF_TC(chunked_updates);
+ATF_TC_HEAD(chunked_updates, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that the digest does not depend "
+                      "on how the input is split across updates");
+}
+ATF_TC_BODY(chunked_updates, tc)
+{
+    const char *data =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    const char *exp =
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+    size_t chunk;
+
+    for (chunk = 1; chunk <= strlen(data); chunk++)
+        check_digest(data, chunk, exp);
+}
+
+ATF_TC(million_a);
+ATF_TC_HEAD(million_a, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks the digest of a large input");
+}
+ATF_TC_BODY(million_a, tc)
+{
+    atf_sha256_t s;
+    char block[1000];
+    char hex[ATF_SHA256_HEX_LENGTH];
+    int i;
+
+    memset(block, 'a', sizeof(block));
+    atf_sha256_init(&s);
+    for (i = 0; i < 1000; i++)
+        atf_sha256_update(&s, block, sizeof(block));
+    ATF_CHECK_EQ(1000000, atf_sha256_length(&s));
+    atf_sha256_final_hex(&s, hex);
+    ATF_CHECK_STREQ("cdc76e5c9914fb9281a1c7e284d73e67"
+                    "f1809a48a497200e046d39ccc7112cd0", hex);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, empty);
+    ATF_TP_ADD_TC(tp, known_vectors);
+    ATF_TP_ADD_TC(tp, chunked_updates);
+    ATF_TP_ADD_TC(tp, million_a);
+
+    return atf_no_error();
+}
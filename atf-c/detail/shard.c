@@ -0,0 +1,193 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/shard.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/*
+ * Test cases are split into shards so that several machines can each run
+ * a subset of a test program.  The selection only depends on the names
+ * of the test cases and on their duration hints, so every machine
+ * computes the same partition without talking to the others.
+ *
+ * If no test case has a hint, test cases are assigned by the FNV-1a hash
+ * of their name.  Otherwise, test cases are sorted by decreasing hint,
+ * breaking ties by name, and every one is assigned to the shard with the
+ * least accumulated time, breaking ties by the lowest index.  Test cases
+ * without a hint are assumed to take the average of the known hints.
+ *
+ * The atf-sh library implements the same algorithm.
+ */
+
+struct shard_tc {
+    const char *m_ident;
+    long m_weight;
+    size_t m_pos;
+};
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+uint32_t
+hash_ident(const char *ident)
+{
+    const unsigned char *p;
+    uint32_t hash;
+
+    hash = UINT32_C(2166136261);
+    for (p = (const unsigned char *)ident; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= UINT32_C(16777619);
+    }
+    return hash;
+}
+
+static
+int
+compare_tcs(const void *a, const void *b)
+{
+    const struct shard_tc *tca = a;
+    const struct shard_tc *tcb = b;
+
+    if (tca->m_weight != tcb->m_weight)
+        return tca->m_weight > tcb->m_weight ? -1 : 1;
+    return strcmp(tca->m_ident, tcb->m_ident);
+}
+
+static
+atf_error_t
+select_by_weight(const size_t index, const size_t count, const size_t n,
+                 const char *const *idents, const long *hints, bool *selected)
+{
+    struct shard_tc *tcs;
+    int64_t *loads;
+    long total, known, fallback;
+    size_t i, j;
+
+    tcs = malloc(n * sizeof(*tcs));
+    loads = calloc(count, sizeof(*loads));
+    if (tcs == NULL || loads == NULL) {
+        free(tcs);
+        free(loads);
+        return atf_no_memory_error();
+    }
+
+    total = known = 0;
+    for (i = 0; i < n; i++) {
+        if (hints[i] >= 0) {
+            total += hints[i];
+            known++;
+        }
+    }
+    INV(known > 0);
+    fallback = total / known;
+
+    for (i = 0; i < n; i++) {
+        tcs[i].m_ident = idents[i];
+        tcs[i].m_weight = hints[i] >= 0 ? hints[i] : fallback;
+        tcs[i].m_pos = i;
+    }
+    qsort(tcs, n, sizeof(*tcs), compare_tcs);
+
+    for (i = 0; i < n; i++) {
+        size_t lightest = 0;
+        for (j = 1; j < count; j++) {
+            if (loads[j] < loads[lightest])
+                lightest = j;
+        }
+        loads[lightest] += tcs[i].m_weight;
+        selected[tcs[i].m_pos] = (lightest == index - 1);
+    }
+
+    free(loads);
+    free(tcs);
+    return atf_no_error();
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Parses a shard specification of the form index/count, where index
+ * goes from 1 to count and count does not exceed ATF_SHARD_MAX_COUNT.
+ */
+bool
+atf_shard_parse(const char *arg, size_t *index, size_t *count)
+{
+    unsigned long i, c;
+    char *end;
+
+    if (arg[0] < '0' || arg[0] > '9')
+        return false;
+    errno = 0;
+    i = strtoul(arg, &end, 10);
+    if (errno != 0 || *end != '/' || end[1] < '0' || end[1] > '9')
+        return false;
+    c = strtoul(end + 1, &end, 10);
+    if (errno != 0 || *end != '\0')
+        return false;
+    if (i < 1 || i > c || c > ATF_SHARD_MAX_COUNT)
+        return false;
+
+    *index = i;
+    *count = c;
+    return true;
+}
+
+/*
+ * Determines which of the n given test cases belong to the shard index of
+ * count.  hints holds the expected duration of every test case in
+ * milliseconds, or a negative value if unknown.
+ */
+atf_error_t
+atf_shard_select(const size_t index, const size_t count, const size_t n,
+                 const char *const *idents, const long *hints, bool *selected)
+{
+    size_t i;
+    bool has_hints;
+
+    PRE(index >= 1 && index <= count);
+
+    has_hints = false;
+    for (i = 0; i < n; i++)
+        has_hints |= hints[i] >= 0;
+
+    if (has_hints)
+        return select_by_weight(index, count, n, idents, hints, selected);
+
+    for (i = 0; i < n; i++)
+        selected[i] = (hash_ident(idents[i]) % count == index - 1);
+    return atf_no_error();
+}
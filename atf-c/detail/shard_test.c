@@ -0,0 +1,187 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/shard.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+#define NTCS 40
+
+static
+void
+make_idents(char names[NTCS][16], const char *idents[NTCS])
+{
+    size_t i;
+
+    for (i = 0; i < NTCS; i++) {
+        snprintf(names[i], sizeof(names[i]), "tc_%zu", i);
+        idents[i] = names[i];
+    }
+}
+
+/*
+ * Checks that every test case belongs to exactly one of count shards and
+ * returns, in loads, the sum of the hints of every shard.
+ */
+static
+void
+check_partition(const size_t count, const char *const *idents,
+                const long *hints, long *loads)
+{
+    bool selected[NTCS];
+    size_t owners[NTCS];
+    size_t i, index;
+
+    memset(owners, 0, sizeof(owners));
+    for (index = 1; index <= count; index++) {
+        RE(atf_shard_select(index, count, NTCS, idents, hints, selected));
+        loads[index - 1] = 0;
+        for (i = 0; i < NTCS; i++) {
+            if (selected[i]) {
+                owners[i]++;
+                loads[index - 1] += hints[i] >= 0 ? hints[i] : 0;
+            }
+        }
+    }
+    for (i = 0; i < NTCS; i++) {
+        if (owners[i] != 1)
+            atf_tc_fail("Test case %s is in %zu shards", idents[i],
+                        owners[i]);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(parse);
+ATF_TC_BODY(parse, tc)
+{
+    size_t index, count;
+
+    ATF_REQUIRE(atf_shard_parse("1/1", &index, &count));
+    ATF_REQUIRE_EQ(1, index);
+    ATF_REQUIRE_EQ(1, count);
+    ATF_REQUIRE(atf_shard_parse("3/12", &index, &count));
+    ATF_REQUIRE_EQ(3, index);
+    ATF_REQUIRE_EQ(12, count);
+
+    ATF_REQUIRE(!atf_shard_parse("", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("1", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("1/", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("/1", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("0/1", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("2/1", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("-1/2", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("1/-2", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("1/2x", &index, &count));
+    ATF_REQUIRE(!atf_shard_parse("1/99999999999999999999999", &index,
+                                 &count));
+}
+
+ATF_TC_WITHOUT_HEAD(select_by_name);
+ATF_TC_BODY(select_by_name, tc)
+{
+    char names[NTCS][16];
+    const char *idents[NTCS];
+    long hints[NTCS], loads[7];
+    bool first[NTCS], second[NTCS];
+    size_t i, count;
+
+    make_idents(names, idents);
+    for (i = 0; i < NTCS; i++)
+        hints[i] = -1;
+
+    for (count = 1; count <= 7; count++)
+        check_partition(count, idents, hints, loads);
+
+    /* The selection of a test case does not depend on the others. */
+    RE(atf_shard_select(2, 3, NTCS, idents, hints, first));
+    RE(atf_shard_select(2, 3, NTCS - 10, idents + 10, hints, second));
+    for (i = 10; i < NTCS; i++)
+        ATF_CHECK_EQ(first[i], second[i - 10]);
+}
+
+ATF_TC_WITHOUT_HEAD(select_by_hint);
+ATF_TC_BODY(select_by_hint, tc)
+{
+    char names[NTCS][16];
+    const char *idents[NTCS];
+    long hints[NTCS], loads[4];
+    size_t i;
+
+    make_idents(names, idents);
+    for (i = 0; i < NTCS; i++)
+        hints[i] = (i % 5 == 0) ? 1000 : 100;
+
+    /* 8 * 1000 + 32 * 100 = 11200, which splits evenly in 4 shards. */
+    check_partition(4, idents, hints, loads);
+    for (i = 0; i < 4; i++)
+        ATF_CHECK_EQ(2800, loads[i]);
+}
+
+ATF_TC_WITHOUT_HEAD(select_by_hint_unknown);
+ATF_TC_BODY(select_by_hint_unknown, tc)
+{
+    const char *idents[] = { "a", "b", "c", "d" };
+    const long hints[] = { 300, -1, 100, -1 };
+    bool selected[4];
+
+    /* Unknown hints take the average, 200, so the order is a, b, d, c. */
+    RE(atf_shard_select(1, 2, 4, idents, hints, selected));
+    ATF_CHECK(selected[0]);
+    ATF_CHECK(!selected[1]);
+    ATF_CHECK(selected[2]);
+    ATF_CHECK(!selected[3]);
+    RE(atf_shard_select(2, 2, 4, idents, hints, selected));
+    ATF_CHECK(!selected[0]);
+    ATF_CHECK(selected[1]);
+    ATF_CHECK(!selected[2]);
+    ATF_CHECK(selected[3]);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, parse);
+    ATF_TP_ADD_TC(tp, select_by_name);
+    ATF_TP_ADD_TC(tp, select_by_hint);
+    ATF_TP_ADD_TC(tp, select_by_hint_unknown);
+
+    return atf_no_error();
+}
@@ -25,6 +25,7 @@
 
 #include "atf-c/detail/text.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <limits.h>
 #include <string.h>
@@ -158,6 +159,50 @@ atf_text_to_bool(const char *str, bool *b)
     return err;
 }
 
+/*
+ * Converts a size, optionally followed by one of the k, m, g or t units in
+ * either case, to a number of bytes.
+ */
+atf_error_t
+atf_text_to_bytes(const char *str, int64_t *bytes)
+{
+    int64_t multiplier;
+    long long value;
+    char *endptr;
+    size_t len;
+    char unit;
+
+    len = strlen(str);
+    if (len == 0)
+        return atf_libc_error(EINVAL, "Empty value");
+
+    unit = str[len - 1];
+    switch (unit) {
+    case 'k': case 'K': multiplier = INT64_C(1) << 10; break;
+    case 'm': case 'M': multiplier = INT64_C(1) << 20; break;
+    case 'g': case 'G': multiplier = INT64_C(1) << 30; break;
+    case 't': case 'T': multiplier = INT64_C(1) << 40; break;
+    default:
+        if (!isdigit((unsigned char)unit))
+            return atf_libc_error(EINVAL, "Unknown size unit '%c'", unit);
+        multiplier = 1;
+    }
+    if (multiplier != 1)
+        len--;
+
+    if (len == 0 || !isdigit((unsigned char)str[0]))
+        return atf_libc_error(EINVAL, "'%s' is not a number", str);
+    errno = 0;
+    value = strtoll(str, &endptr, 10);
+    if ((size_t)(endptr - str) != len)
+        return atf_libc_error(EINVAL, "'%s' is not a number", str);
+    if (errno == ERANGE || value > INT64_MAX / multiplier)
+        return atf_libc_error(ERANGE, "'%s' is out of range", str);
+
+    *bytes = value * multiplier;
+    return atf_no_error();
+}
+
 atf_error_t
 atf_text_to_long(const char *str, long *l)
 {
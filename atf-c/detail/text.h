@@ -28,6 +28,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <atf-c/detail/list.h>
 #include <atf-c/error_fwd.h>
@@ -39,6 +40,7 @@ atf_error_t atf_text_format(char **, const char *, ...);
 atf_error_t atf_text_format_ap(char **, const char *, va_list);
 atf_error_t atf_text_split(const char *, const char *, atf_list_t *);
 atf_error_t atf_text_to_bool(const char *, bool *);
+atf_error_t atf_text_to_bytes(const char *, int64_t *);
 atf_error_t atf_text_to_long(const char *, long *);
 
 #endif /* !defined(ATF_C_DETAIL_TEXT_H) */
@@ -380,6 +380,36 @@ ATF_TC_BODY(to_bool, tc)
     ATF_REQUIRE(b);
 }
 
+ATF_TC(to_bytes);
+ATF_TC_HEAD(to_bytes, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks the atf_text_to_bytes function");
+}
+ATF_TC_BODY(to_bytes, tc)
+{
+    int64_t b;
+
+    RE(atf_text_to_bytes("0", &b)); ATF_REQUIRE_EQ(b, 0);
+    RE(atf_text_to_bytes("12345", &b)); ATF_REQUIRE_EQ(b, 12345);
+    RE(atf_text_to_bytes("2k", &b)); ATF_REQUIRE_EQ(b, 2 * 1024);
+    RE(atf_text_to_bytes("4M", &b)); ATF_REQUIRE_EQ(b, 4 * 1024 * 1024);
+    RE(atf_text_to_bytes("8g", &b));
+    ATF_REQUIRE_EQ(b, INT64_C(8) * 1024 * 1024 * 1024);
+    RE(atf_text_to_bytes("16T", &b));
+    ATF_REQUIRE_EQ(b, INT64_C(16) * 1024 * 1024 * 1024 * 1024);
+
+    b = 1212;
+    REQUIRE_ERROR(atf_text_to_bytes("", &b));
+    REQUIRE_ERROR(atf_text_to_bytes("12d", &b));
+    REQUIRE_ERROR(atf_text_to_bytes(" ", &b));
+    REQUIRE_ERROR(atf_text_to_bytes(" k", &b));
+    REQUIRE_ERROR(atf_text_to_bytes("k", &b));
+    REQUIRE_ERROR(atf_text_to_bytes("-5k", &b));
+    REQUIRE_ERROR(atf_text_to_bytes("1x2k", &b));
+    REQUIRE_ERROR(atf_text_to_bytes("99999999999t", &b));
+    ATF_REQUIRE_EQ(b, 1212);
+}
+
 ATF_TC(to_long);
 ATF_TC_HEAD(to_long, tc)
 {
@@ -415,6 +445,7 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, split);
     ATF_TP_ADD_TC(tp, split_delims);
     ATF_TP_ADD_TC(tp, to_bool);
+    ATF_TP_ADD_TC(tp, to_bytes);
     ATF_TP_ADD_TC(tp, to_long);
 
     return atf_no_error();
@@ -27,8 +27,13 @@
 #include "config.h"
 #endif
 
+#include <sys/stat.h>
+
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,8 +42,12 @@
 #include "atf-c/detail/dynstr.h"
 #include "atf-c/detail/env.h"
 #include "atf-c/detail/fs.h"
+#include "atf-c/detail/history.h"
 #include "atf-c/detail/map.h"
+#include "atf-c/detail/process.h"
 #include "atf-c/detail/sanity.h"
+#include "atf-c/detail/shard.h"
+#include "atf-c/detail/tp_server.h"
 #include "atf-c/error.h"
 #include "atf-c/tc.h"
 #include "atf-c/tp.h"
@@ -135,11 +144,18 @@ print_warning(const char *message)
  * --------------------------------------------------------------------- */
 
 struct params {
+    const char *m_program;
     bool m_do_list;
     atf_fs_path_t m_srcdir;
     char *m_tcname;
     enum tc_part m_tcpart;
     atf_fs_path_t m_resfile;
+    bool m_has_resfile;
+    atf_fs_path_t m_resdir;
+    bool m_has_resdir;
+    size_t m_shard_index;
+    size_t m_shard_count;
+    bool m_serve;
     atf_map_t m_config;
 };
 
@@ -167,9 +183,15 @@ params_init(struct params *p, const char *argv0)
 {
     atf_error_t err;
 
+    p->m_program = argv0;
     p->m_do_list = false;
     p->m_tcname = NULL;
     p->m_tcpart = BODY;
+    p->m_has_resfile = false;
+    p->m_has_resdir = false;
+    p->m_shard_index = 0;
+    p->m_shard_count = 0;
+    p->m_serve = false;
 
     err = argv0_to_dir(argv0, &p->m_srcdir);
     if (atf_is_error(err))
@@ -181,8 +203,16 @@ params_init(struct params *p, const char *argv0)
         return err;
     }
 
+    err = atf_fs_path_init_fmt(&p->m_resdir, ".");
+    if (atf_is_error(err)) {
+        atf_fs_path_fini(&p->m_resfile);
+        atf_fs_path_fini(&p->m_srcdir);
+        return err;
+    }
+
     err = atf_map_init(&p->m_config);
     if (atf_is_error(err)) {
+        atf_fs_path_fini(&p->m_resdir);
         atf_fs_path_fini(&p->m_resfile);
         atf_fs_path_fini(&p->m_srcdir);
         return err;
@@ -196,6 +226,7 @@ void
 params_fini(struct params *p)
 {
     atf_map_fini(&p->m_config);
+    atf_fs_path_fini(&p->m_resdir);
     atf_fs_path_fini(&p->m_resfile);
     atf_fs_path_fini(&p->m_srcdir);
     if (p->m_tcname != NULL)
@@ -244,26 +275,134 @@ replace_path_param(atf_fs_path_t *param, const char *value)
  * Test case listing.
  * --------------------------------------------------------------------- */
 
+/*
+ * Loads the durations recorded for the test cases of this program, if
+ * any.  Errors are ignored because the hints are purely informational.
+ */
+static
+bool
+load_history(const char *program, atf_history_t *history)
+{
+    const char *file;
+    atf_error_t err;
+
+    file = atf_history_file();
+    if (file == NULL)
+        return false;
+
+    err = atf_history_init(history, file, program);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Returns the expected duration of a test case in milliseconds, or -1 if
+ * unknown.
+ */
+static
+long
+duration_hint(const atf_tc_t *tc, const atf_history_t *history)
+{
+    long msec;
+
+    if (atf_tc_has_md_var(tc, "X-duration-hint-ms")) {
+        char *end;
+
+        msec = strtol(atf_tc_get_md_var(tc, "X-duration-hint-ms"), &end, 10);
+        return *end == '\0' && msec >= 0 ? msec : -1;
+    }
+
+    if (history != NULL && atf_history_get(history, atf_tc_get_ident(tc),
+                                           &msec))
+        return msec;
+    return -1;
+}
+
+/*
+ * Determines which test cases belong to the shard requested with -S.
+ * Sets selected to NULL if all test cases do.
+ */
+static
+atf_error_t
+select_shard(const atf_tc_t *const *tcs, const struct params *p,
+             bool **selected)
+{
+    atf_error_t err;
+    atf_history_t history;
+    bool has_history;
+    const char **idents;
+    long *hints;
+    size_t i, n;
+
+    *selected = NULL;
+    if (p->m_shard_count == 0)
+        return atf_no_error();
+
+    for (n = 0; tcs[n] != NULL; n++)
+        continue;
+
+    idents = malloc((n + 1) * sizeof(*idents));
+    hints = malloc((n + 1) * sizeof(*hints));
+    *selected = malloc((n + 1) * sizeof(**selected));
+    if (idents == NULL || hints == NULL || *selected == NULL) {
+        err = atf_no_memory_error();
+        goto out;
+    }
+
+    has_history = load_history(p->m_program, &history);
+    for (i = 0; i < n; i++) {
+        idents[i] = atf_tc_get_ident(tcs[i]);
+        hints[i] = duration_hint(tcs[i], has_history ? &history : NULL);
+    }
+    if (has_history)
+        atf_history_fini(&history);
+
+    err = atf_shard_select(p->m_shard_index, p->m_shard_count, n, idents,
+                           hints, *selected);
+
+out:
+    if (atf_is_error(err)) {
+        free(*selected);
+        *selected = NULL;
+    }
+    free(hints);
+    free(idents);
+    return err;
+}
+
 static
 void
-list_tcs(const atf_tp_t *tp)
+list_tcs(const atf_tp_t *tp, const char *program, const bool *selected)
 {
     const atf_tc_t *const *tcs;
     const atf_tc_t *const *tcsptr;
+    atf_history_t history;
+    bool has_history, first;
+
+    has_history = load_history(program, &history);
 
     printf("Content-Type: application/X-atf-tp; version=\"1\"\n\n");
 
     tcs = atf_tp_get_tcs(tp);
     INV(tcs != NULL);  /* Should be checked. */
+    first = true;
     for (tcsptr = tcs; *tcsptr != NULL; tcsptr++) {
         const atf_tc_t *tc = *tcsptr;
-        char **vars = atf_tc_get_md_vars(tc);
+        char **vars;
         char **ptr;
 
+        if (selected != NULL && !selected[tcsptr - tcs])
+            continue;
+
+        vars = atf_tc_get_md_vars(tc);
         INV(vars != NULL);  /* Should be checked. */
 
-        if (tcsptr != tcs)  /* Not first. */
+        if (!first)
             printf("\n");
+        first = false;
 
         for (ptr = vars; *ptr != NULL; ptr += 2) {
             if (strcmp(*ptr, "ident") == 0) {
@@ -278,8 +417,18 @@ list_tcs(const atf_tp_t *tp)
             }
         }
 
+        if (has_history && !atf_tc_has_md_var(tc, "X-duration-hint-ms")) {
+            long msec;
+
+            if (atf_history_get(&history, atf_tc_get_ident(tc), &msec))
+                printf("X-duration-hint-ms: %ld\n", msec);
+        }
+
         atf_utils_free_charpp(vars);
     }
+
+    if (has_history)
+        atf_history_fini(&history);
 }
 
 /* ---------------------------------------------------------------------
@@ -334,7 +483,7 @@ process_params(int argc, char **argv, struct params *p)
     old_opterr = opterr;
     opterr = 0;
     while (!atf_is_error(err) &&
-           (ch = getopt(argc, argv, GETOPT_POSIX ":lr:s:v:")) != -1) {
+           (ch = getopt(argc, argv, GETOPT_POSIX ":lr:R:s:S:v:Z")) != -1) {
         switch (ch) {
         case 'l':
             p->m_do_list = true;
@@ -342,16 +491,35 @@ process_params(int argc, char **argv, struct params *p)
 
         case 'r':
             err = replace_path_param(&p->m_resfile, optarg);
+            p->m_has_resfile = true;
+            break;
+
+        case 'R':
+            err = replace_path_param(&p->m_resdir, optarg);
+            p->m_has_resdir = true;
             break;
 
         case 's':
             err = replace_path_param(&p->m_srcdir, optarg);
             break;
 
+        case 'S':
+            if (!atf_shard_parse(optarg, &p->m_shard_index,
+                                 &p->m_shard_count))
+                err = usage_error("Invalid shard `%s'; must be of the form "
+                                  "index/count with 1 <= index <= count <= "
+                                  "32767",
+                                  optarg);
+            break;
+
         case 'v':
             err = parse_vflag(optarg, &p->m_config);
             break;
 
+        case 'Z':
+            p->m_serve = true;
+            break;
+
         case ':':
             err = usage_error("Option -%c requires an argument.", optopt);
             break;
@@ -372,9 +540,22 @@ process_params(int argc, char **argv, struct params *p)
 #endif
 
     if (!atf_is_error(err)) {
-        if (p->m_do_list) {
+        if (p->m_serve) {
+            if (p->m_do_list || p->m_shard_count > 0 || p->m_has_resfile ||
+                p->m_has_resdir)
+                err = usage_error("-Z cannot be combined with -l, -r, -R or "
+                                  "-S");
+            else if (argc > 0)
+                err = usage_error("Cannot provide test case names with -Z");
+        } else if (p->m_do_list) {
             if (argc > 0)
                 err = usage_error("Cannot provide test case names with -l");
+        } else if (p->m_shard_count > 0) {
+            if (argc > 0)
+                err = usage_error("Cannot provide test case names with -S");
+            else if (p->m_has_resfile)
+                err = usage_error("-r cannot be combined with -S; use -R to "
+                                  "give a results directory");
         } else {
             if (argc == 0)
                 err = usage_error("Must provide a test case name");
@@ -478,6 +659,212 @@ out:
     return err;
 }
 
+static
+void
+warn_if_unsupervised(void)
+{
+    if (!atf_env_has("__RUNNING_INSIDE_ATF_RUN") || strcmp(atf_env_get(
+        "__RUNNING_INSIDE_ATF_RUN"), "internal-yes-value") != 0)
+    {
+        print_warning("Running test cases outside of kyua(1) is unsupported");
+        print_warning("No isolation nor timeout control is being applied; you "
+                      "may get unexpected failures; see atf-test-case(4)");
+    }
+}
+
+/*
+ * Initializes resdir to the absolute path of the results directory given
+ * with -R, which must exist, or to an empty path if none was given.
+ */
+static
+atf_error_t
+init_resdir(const struct params *p, atf_fs_path_t *resdir)
+{
+    atf_error_t err;
+    bool exists;
+
+    if (!p->m_has_resdir)
+        return atf_fs_path_init_fmt(resdir, "%s", "");
+
+    err = atf_fs_path_to_absolute(&p->m_resdir, resdir);
+    if (atf_is_error(err))
+        return err;
+    err = atf_fs_exists(resdir, &exists);
+    if (!atf_is_error(err) && !exists)
+        err = atf_libc_error(ENOENT, "Results directory `%s' does not "
+                             "exist", atf_fs_path_cstring(&p->m_resdir));
+    if (atf_is_error(err))
+        atf_fs_path_fini(resdir);
+    return err;
+}
+
+/*
+ * Runs the given function in a subprocess and waits for it.  Sets ok to
+ * false if it does not succeed.
+ */
+static
+atf_error_t
+run_part(void (*start)(void *), void *data, bool *ok)
+{
+    atf_error_t err;
+    atf_process_stream_t outsb, errsb;
+    atf_process_child_t proc;
+    atf_process_status_t status;
+
+    err = atf_process_stream_init_inherit(&outsb);
+    if (atf_is_error(err))
+        goto out;
+    err = atf_process_stream_init_inherit(&errsb);
+    if (atf_is_error(err))
+        goto out_outsb;
+
+    fflush(NULL);
+    err = atf_process_fork(&proc, start, &outsb, &errsb, data);
+    if (atf_is_error(err))
+        goto out_errsb;
+    err = atf_process_child_wait(&proc, &status);
+    if (atf_is_error(err))
+        goto out_errsb;
+
+    if (!atf_process_status_exited(&status) ||
+        atf_process_status_exitstatus(&status) != EXIT_SUCCESS)
+        *ok = false;
+    atf_process_status_fini(&status);
+
+out_errsb:
+    atf_process_stream_fini(&errsb);
+out_outsb:
+    atf_process_stream_fini(&outsb);
+out:
+    return err;
+}
+
+static
+bool
+has_table(const atf_tp_t *tp, const char *name)
+{
+    const atf_tc_t *const *tcs, *const *tcsptr;
+    bool found;
+
+    tcs = atf_tp_get_tcs(tp);
+    if (tcs == NULL)
+        return false;
+
+    found = false;
+    for (tcsptr = tcs; *tcsptr != NULL && !found; tcsptr++) {
+        const char *table = atf_tc_get_table(*tcsptr);
+        found = table != NULL && strcmp(table, name) == 0;
+    }
+    free((void *)(uintptr_t)tcs);
+    return found;
+}
+
+struct table_child {
+    const atf_tc_t *m_tc;
+    const char *m_resfile;
+};
+
+static void run_table_child(void *) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+run_table_child(void *v)
+{
+    const struct table_child *child = v;
+    atf_error_t err;
+
+    err = atf_tc_run(child->m_tc, child->m_resfile);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ * Runs every row of a parametrized test case, one after the other, in the
+ * current process, except for those with the X-isolated property set,
+ * which get a subprocess each.  If a results directory was given with -R,
+ * a results file named after each row is created in it; otherwise, the
+ * results go to the standard output prefixed by the name of their test
+ * case.  The program fails if any row fails.
+ */
+static
+atf_error_t
+run_table(const atf_tp_t *tp, const struct params *p, int *exitcode)
+{
+    atf_error_t err;
+    const atf_tc_t *const *tcs, *const *tcsptr;
+    atf_fs_path_t resdir;
+    size_t failures, rows;
+
+    tcs = atf_tp_get_tcs(tp);
+    if (tcs == NULL)
+        return atf_no_memory_error();
+
+    err = init_resdir(p, &resdir);
+    if (atf_is_error(err))
+        goto out;
+
+    warn_if_unsupervised();
+
+    err = atf_tp_run_fixture(tp);
+    if (atf_is_error(err))
+        goto out_resdir;
+
+    failures = rows = 0;
+    for (tcsptr = tcs; *tcsptr != NULL && !atf_is_error(err); tcsptr++) {
+        const char *table = atf_tc_get_table(*tcsptr);
+        const char *ident = atf_tc_get_ident(*tcsptr);
+        atf_fs_path_t resfile;
+        bool failed;
+
+        if (table == NULL || strcmp(table, p->m_tcname) != 0)
+            continue;
+
+        if (p->m_has_resdir)
+            err = atf_fs_path_init_fmt(&resfile, "%s/%s",
+                                       atf_fs_path_cstring(&resdir),
+                                       ident + strlen(table) + 1);
+        else
+            err = atf_fs_path_init_fmt(&resfile, "/dev/stdout");
+        if (atf_is_error(err))
+            break;
+
+        failed = false;
+        if (atf_tc_has_md_var(*tcsptr, "X-isolated") &&
+            strcmp(atf_tc_get_md_var(*tcsptr, "X-isolated"), "true") == 0) {
+            struct table_child child;
+            bool ok = true;
+
+            child.m_tc = *tcsptr;
+            child.m_resfile = atf_fs_path_cstring(&resfile);
+            err = run_part(run_table_child, &child, &ok);
+            failed = !ok;
+        } else
+            err = atf_tc_run_row(*tcsptr, atf_fs_path_cstring(&resfile),
+                                 NULL, &failed);
+        atf_fs_path_fini(&resfile);
+
+        rows++;
+        if (failed)
+            failures++;
+    }
+
+    if (!atf_is_error(err)) {
+        if (failures > 0)
+            fprintf(stderr, "%s: %zu of %zu rows of %s failed\n", progname,
+                    failures, rows, p->m_tcname);
+        *exitcode = failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+out_resdir:
+    atf_fs_path_fini(&resdir);
+out:
+    free((void *)(uintptr_t)tcs);
+    return err;
+}
+
 static
 atf_error_t
 run_tc(const atf_tp_t *tp, struct params *p, int *exitcode)
@@ -487,20 +874,32 @@ run_tc(const atf_tp_t *tp, struct params *p, int *exitcode)
     err = atf_no_error();
 
     if (!atf_tp_has_tc(tp, p->m_tcname)) {
-        err = usage_error("Unknown test case `%s'", p->m_tcname);
+        if (p->m_tcpart != BODY || !has_table(tp, p->m_tcname))
+            err = usage_error("Unknown test case `%s'", p->m_tcname);
+        else if (p->m_has_resfile)
+            err = usage_error("-r cannot be used with the parametrized test "
+                              "case `%s'; use -R to give a results "
+                              "directory", p->m_tcname);
+        else
+            err = run_table(tp, p, exitcode);
         goto out;
     }
 
-    if (!atf_env_has("__RUNNING_INSIDE_ATF_RUN") || strcmp(atf_env_get(
-        "__RUNNING_INSIDE_ATF_RUN"), "internal-yes-value") != 0)
-    {
-        print_warning("Running test cases outside of kyua(1) is unsupported");
-        print_warning("No isolation nor timeout control is being applied; you "
-                      "may get unexpected failures; see atf-test-case(4)");
+    if (p->m_has_resdir) {
+        err = usage_error("-R can only be used with -S or a parametrized "
+                          "test case");
+        goto out;
     }
 
+    warn_if_unsupervised();
+
     switch (p->m_tcpart) {
     case BODY:
+        err = atf_tp_run_fixture(tp);
+        if (atf_is_error(err))
+            goto out;
+
+        atf_history_track(p->m_program, p->m_tcname);
         err = atf_tp_run(tp, p->m_tcname, atf_fs_path_cstring(&p->m_resfile));
         if (atf_is_error(err)) {
             /* TODO: Handle error */
@@ -533,6 +932,393 @@ out:
     return err;
 }
 
+struct shard_child {
+    const atf_tp_t *m_tp;
+    const char *m_program;
+    const char *m_tcname;
+    const char *m_workdir;
+    enum tc_part m_tcpart;
+    const char *m_resfile;
+};
+
+static void run_shard_child(void *) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+/*
+ * Creates the directories that hold the work directories, under workroot,
+ * and, if resdir is not NULL, the results files of the rows of a
+ * parametrized test case.
+ */
+static
+atf_error_t
+make_table_dirs(const char *table, const atf_fs_path_t *workroot,
+                const atf_fs_path_t *resdir)
+{
+    atf_error_t err;
+    atf_fs_path_t dir;
+
+    err = atf_fs_path_init_fmt(&dir, "%s/%s", atf_fs_path_cstring(workroot),
+                               table);
+    if (atf_is_error(err))
+        return err;
+    if (mkdir(atf_fs_path_cstring(&dir), 0755) == -1 && errno != EEXIST)
+        err = atf_libc_error(errno, "Cannot create work directory `%s'",
+                             atf_fs_path_cstring(&dir));
+    atf_fs_path_fini(&dir);
+    if (atf_is_error(err) || resdir == NULL)
+        return err;
+
+    err = atf_fs_path_init_fmt(&dir, "%s/%s", atf_fs_path_cstring(resdir),
+                               table);
+    if (atf_is_error(err))
+        return err;
+    if (mkdir(atf_fs_path_cstring(&dir), 0755) == -1 && errno != EEXIST)
+        err = atf_libc_error(errno, "Cannot create results directory `%s'",
+                             atf_fs_path_cstring(&dir));
+    atf_fs_path_fini(&dir);
+    return err;
+}
+
+static
+atf_error_t
+remove_tree(const char *path)
+{
+    atf_error_t err;
+    struct dirent *de;
+    struct stat sb;
+    DIR *d;
+
+    if (lstat(path, &sb) == -1)
+        return atf_libc_error(errno, "Cannot stat `%s'", path);
+    if (!S_ISDIR(sb.st_mode)) {
+        if (unlink(path) == -1)
+            return atf_libc_error(errno, "Cannot remove `%s'", path);
+        return atf_no_error();
+    }
+
+    d = opendir(path);
+    if (d == NULL)
+        return atf_libc_error(errno, "Cannot open directory `%s'", path);
+    err = atf_no_error();
+    while (!atf_is_error(err) && (de = readdir(d)) != NULL) {
+        atf_fs_path_t entry;
+
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        err = atf_fs_path_init_fmt(&entry, "%s/%s", path, de->d_name);
+        if (!atf_is_error(err)) {
+            err = remove_tree(atf_fs_path_cstring(&entry));
+            atf_fs_path_fini(&entry);
+        }
+    }
+    closedir(d);
+
+    if (!atf_is_error(err) && rmdir(path) == -1)
+        err = atf_libc_error(errno, "Cannot remove directory `%s'", path);
+    return err;
+}
+
+/*
+ * Removes a work directory and everything in it.  Failures only deserve a
+ * warning because the results of the test cases are already known.
+ */
+static
+void
+remove_work_dir(const char *dir)
+{
+    atf_error_t err;
+
+    err = remove_tree(dir);
+    if (atf_is_error(err)) {
+        char buf[4096];
+
+        atf_error_format(err, buf, sizeof(buf));
+        print_warning(buf);
+        atf_error_free(err);
+    }
+}
+
+static
+void
+run_shard_child(void *v)
+{
+    const struct shard_child *child = v;
+    atf_error_t err;
+
+    if (child->m_tcpart == BODY)
+        atf_history_track(child->m_program, child->m_tcname);
+
+    if (chdir(child->m_workdir) == -1) {
+        fprintf(stderr, "%s: ERROR: Cannot enter work directory `%s': %s\n",
+                progname, child->m_workdir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (child->m_tcpart == BODY)
+        err = atf_tp_run(child->m_tp, child->m_tcname, child->m_resfile);
+    else
+        err = atf_tp_cleanup(child->m_tp, child->m_tcname);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ * Runs the body and the cleanup routine of every test case in the shard,
+ * one after the other, each in a subprocess within a work directory named
+ * after the test case.  The work directories live in a private directory
+ * created with mkdtemp(3) in the current directory, and each is removed
+ * once the cleanup routine of its test case has run.  If a results
+ * directory was given with -R, a results file named after each test case
+ * is created in it.  The rows of parametrized test cases
+ * get a directory named after their test case in both.  The fixture of
+ * the test program runs beforehand, so all the test cases inherit its
+ * results.
+ */
+static
+atf_error_t
+run_shard(const atf_tp_t *tp, const atf_tc_t *const *tcs,
+          const struct params *p, const bool *selected, int *exitcode)
+{
+    atf_error_t err;
+    const atf_tc_t *const *tcsptr;
+    atf_fs_path_t resdir, workroot;
+    bool ok;
+
+    err = init_resdir(p, &resdir);
+    if (atf_is_error(err))
+        goto out;
+
+    warn_if_unsupervised();
+
+    for (tcsptr = tcs; *tcsptr != NULL && !selected[tcsptr - tcs]; tcsptr++)
+        continue;
+    if (*tcsptr != NULL) {
+        err = atf_tp_run_fixture(tp);
+        if (atf_is_error(err))
+            goto out_resdir;
+    }
+
+    err = atf_fs_path_init_fmt(&workroot, "atf-shard.XXXXXX");
+    if (atf_is_error(err))
+        goto out_resdir;
+    err = atf_fs_mkdtemp(&workroot);
+    if (atf_is_error(err))
+        goto out_workroot;
+
+    ok = true;
+    for (tcsptr = tcs; *tcsptr != NULL && !atf_is_error(err); tcsptr++) {
+        const char *tcname = atf_tc_get_ident(*tcsptr);
+        const char *table = atf_tc_get_table(*tcsptr);
+        struct shard_child child;
+        atf_fs_path_t resfile, workdir;
+
+        if (!selected[tcsptr - tcs])
+            continue;
+
+        if (table != NULL) {
+            err = make_table_dirs(table, &workroot,
+                                  p->m_has_resdir ? &resdir : NULL);
+            if (atf_is_error(err))
+                break;
+        }
+
+        err = atf_fs_path_init_fmt(&workdir, "%s/%s",
+                                   atf_fs_path_cstring(&workroot), tcname);
+        if (atf_is_error(err))
+            break;
+        if (mkdir(atf_fs_path_cstring(&workdir), 0755) == -1) {
+            err = atf_libc_error(errno, "Cannot create work directory `%s'",
+                                 atf_fs_path_cstring(&workdir));
+            atf_fs_path_fini(&workdir);
+            break;
+        }
+
+        if (p->m_has_resdir)
+            err = atf_fs_path_init_fmt(&resfile, "%s/%s",
+                                       atf_fs_path_cstring(&resdir), tcname);
+        else
+            err = atf_fs_path_init_fmt(&resfile, "/dev/stdout");
+        if (atf_is_error(err)) {
+            atf_fs_path_fini(&workdir);
+            break;
+        }
+
+        child.m_tp = tp;
+        child.m_program = p->m_program;
+        child.m_tcname = tcname;
+        child.m_workdir = atf_fs_path_cstring(&workdir);
+        child.m_tcpart = BODY;
+        child.m_resfile = atf_fs_path_cstring(&resfile);
+        err = run_part(run_shard_child, &child, &ok);
+
+        if (!atf_is_error(err) && atf_tc_has_md_var(*tcsptr, "has.cleanup") &&
+            strcmp(atf_tc_get_md_var(*tcsptr, "has.cleanup"), "true") == 0) {
+            child.m_tcpart = CLEANUP;
+            err = run_part(run_shard_child, &child, &ok);
+        }
+
+        remove_work_dir(atf_fs_path_cstring(&workdir));
+        atf_fs_path_fini(&resfile);
+        atf_fs_path_fini(&workdir);
+    }
+
+    if (!atf_is_error(err))
+        *exitcode = ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    remove_work_dir(atf_fs_path_cstring(&workroot));
+out_workroot:
+    atf_fs_path_fini(&workroot);
+out_resdir:
+    atf_fs_path_fini(&resdir);
+out:
+    return err;
+}
+
+/*
+ * Adds copies of the variables in src to dst, replacing those that are
+ * already there.
+ */
+static
+atf_error_t
+copy_vars(atf_map_t *dst, const atf_map_t *src)
+{
+    atf_error_t err;
+    atf_map_citer_t iter;
+
+    err = atf_no_error();
+    atf_map_for_each_c(iter, src) {
+        char *value = strdup(atf_map_citer_data(iter));
+        if (value == NULL)
+            return atf_no_memory_error();
+
+        err = atf_map_insert(dst, atf_map_citer_key(iter), value, true);
+        if (atf_is_error(err))
+            break;
+    }
+    return err;
+}
+
+struct server_data {
+    const atf_tp_t *m_tp;
+    const struct params *m_params;
+    atf_error_t (*m_add_tcs_hook)(atf_tp_t *);
+};
+
+/*
+ * Registers the test cases again with the configuration variables of a
+ * request applied on top of those given to the server.  This runs the
+ * head routines of the test cases again, so it is only done when a
+ * request overrides the configuration.
+ */
+static
+atf_error_t
+reinit_tp(const struct server_data *data, const atf_map_t *overrides,
+          atf_tp_t *tp)
+{
+    atf_error_t err;
+    atf_map_t config;
+    char **raw_config;
+
+    err = atf_map_init(&config);
+    if (atf_is_error(err))
+        goto out;
+
+    err = copy_vars(&config, &data->m_params->m_config);
+    if (atf_is_error(err))
+        goto out_config;
+    err = copy_vars(&config, overrides);
+    if (atf_is_error(err))
+        goto out_config;
+
+    raw_config = atf_map_to_charpp(&config);
+    if (raw_config == NULL) {
+        err = atf_no_memory_error();
+        goto out_config;
+    }
+    err = atf_tp_init(tp, (const char *const *)raw_config);
+    atf_utils_free_charpp(raw_config);
+    if (atf_is_error(err))
+        goto out_config;
+
+    err = data->m_add_tcs_hook(tp);
+    if (atf_is_error(err))
+        atf_tp_fini(tp);
+
+out_config:
+    atf_map_fini(&config);
+out:
+    return err;
+}
+
+static
+int
+serve_request(const atf_tp_server_request_t *req, void *v)
+{
+    const struct server_data *data = v;
+    const atf_tp_t *tp = data->m_tp;
+    atf_tp_t reinit;
+    atf_error_t err;
+
+    if (atf_map_size(&req->m_config) > 0) {
+        err = reinit_tp(data, &req->m_config, &reinit);
+        if (atf_is_error(err))
+            goto out;
+        tp = &reinit;
+    }
+
+    if (!atf_tp_has_tc(tp, req->m_tcname)) {
+        err = usage_error("Unknown test case `%s'", req->m_tcname);
+        goto out;
+    }
+
+    warn_if_unsupervised();
+
+    if (!req->m_cleanup) {
+        atf_history_track(data->m_params->m_program, req->m_tcname);
+        err = atf_tp_run(tp, req->m_tcname, req->m_resfile != NULL ?
+                         req->m_resfile : "/dev/stdout");
+    } else
+        err = atf_tp_cleanup(tp, req->m_tcname);
+
+out:
+    if (atf_is_error(err)) {
+        print_error(err);
+        atf_error_free(err);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Runs as a server for the test cases of the program until the requests
+ * stop coming; see tp_server.c.  The fixture of the test program runs
+ * before serving, so the subprocesses of all requests inherit its results.
+ */
+static
+atf_error_t
+serve(const atf_tp_t *tp, const struct params *p,
+      atf_error_t (*add_tcs_hook)(atf_tp_t *), int *exitcode)
+{
+    atf_error_t err;
+    struct server_data data;
+
+    data.m_tp = tp;
+    data.m_params = p;
+    data.m_add_tcs_hook = add_tcs_hook;
+
+    err = atf_tp_run_fixture(tp);
+    if (atf_is_error(err))
+        return err;
+
+    err = atf_tp_server_serve(STDIN_FILENO, STDOUT_FILENO, serve_request,
+                              &data);
+    if (!atf_is_error(err))
+        *exitcode = EXIT_SUCCESS;
+    return err;
+}
+
 static
 atf_error_t
 controlled_main(int argc, char **argv,
@@ -543,6 +1329,8 @@ controlled_main(int argc, char **argv,
     struct params p;
     atf_tp_t tp;
     char **raw_config;
+    const atf_tc_t *const *tcs;
+    bool *selected;
 
     err = process_params(argc, argv, &p);
     if (atf_is_error(err))
@@ -566,13 +1354,27 @@ controlled_main(int argc, char **argv,
     if (atf_is_error(err))
         goto out_tp;
 
+    tcs = atf_tp_get_tcs(&tp);
+    if (tcs == NULL) {
+        err = atf_no_memory_error();
+        goto out_tp;
+    }
+    err = select_shard(tcs, &p, &selected);
+    if (atf_is_error(err))
+        goto out_tp;
+
     if (p.m_do_list) {
-        list_tcs(&tp);
+        list_tcs(&tp, p.m_program, selected);
         INV(!atf_is_error(err));
         *exitcode = EXIT_SUCCESS;
+    } else if (p.m_serve) {
+        err = serve(&tp, &p, add_tcs_hook, exitcode);
+    } else if (selected != NULL) {
+        err = run_shard(&tp, tcs, &p, selected, exitcode);
     } else {
         err = run_tc(&tp, &p, exitcode);
     }
+    free(selected);
 
 out_tp:
     atf_tp_fini(&tp);
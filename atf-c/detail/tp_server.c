@@ -0,0 +1,643 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/tp_server.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atf-c/defs.h"
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/*
+ * A test program in server mode initializes itself once and then forks a
+ * subprocess for every part of a test case it is asked to run, so that
+ * the cost of loading the program, of its static constructors and of
+ * the head routines of its test cases is only paid once.
+ *
+ * Requests are read from the input descriptor as lines of the form
+ * "field value", terminated by an empty line.  For every request, the
+ * server answers "started <pid>" once the subprocess exists, or
+ * "error <message>" if the request is invalid, in the order in which
+ * requests arrive.  Whenever a subprocess terminates, the server writes
+ * "done <pid> <status>", where status is the one returned by waitpid(2).
+ * The server writes "ready" before reading the first request and exits
+ * once the input is closed and all its subprocesses have terminated.
+ */
+
+static int sigchld_pipe[2] = { -1, -1 };
+
+struct server {
+    int m_in;
+    int m_out;
+    atf_tp_server_run_t m_run;
+    void *m_data;
+
+    atf_dynstr_t m_buffer;
+    bool m_eof;
+    size_t m_children;
+
+    atf_tp_server_request_t m_request;
+    size_t m_lines;
+    atf_error_t m_request_error;
+};
+
+/* ---------------------------------------------------------------------
+ * The "request" error type.
+ * --------------------------------------------------------------------- */
+
+struct request_error_data {
+    char m_what[1024];
+};
+
+static
+void
+request_format(const atf_error_t err, char *buf, size_t buflen)
+{
+    const struct request_error_data *data;
+
+    PRE(atf_error_is(err, "request"));
+
+    data = atf_error_data(err);
+    snprintf(buf, buflen, "%s", data->m_what);
+}
+
+static
+atf_error_t
+request_error(const char *fmt, ...)
+{
+    struct request_error_data data;
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(data.m_what, sizeof(data.m_what), fmt, ap);
+    va_end(ap);
+
+    return atf_error_new("request", &data, sizeof(data), request_format);
+}
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+notify_sigchld(const int signo ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    const int old_errno = errno;
+    if (write(sigchld_pipe[1], "", 1) == -1) {
+        /* The pipe is full, so the server will wake up anyway. */
+    }
+    errno = old_errno;
+}
+
+static
+atf_error_t
+request_init(atf_tp_server_request_t *req)
+{
+    atf_error_t err;
+
+    req->m_tcname = NULL;
+    req->m_cleanup = false;
+    req->m_resfile = NULL;
+    req->m_workdir = NULL;
+    req->m_stdout = NULL;
+    req->m_stderr = NULL;
+
+    err = atf_map_init(&req->m_config);
+    if (atf_is_error(err))
+        return err;
+
+    err = atf_map_init(&req->m_env);
+    if (atf_is_error(err))
+        atf_map_fini(&req->m_config);
+
+    return err;
+}
+
+static
+void
+request_fini(atf_tp_server_request_t *req)
+{
+    atf_map_fini(&req->m_env);
+    atf_map_fini(&req->m_config);
+    free(req->m_stderr);
+    free(req->m_stdout);
+    free(req->m_workdir);
+    free(req->m_resfile);
+    free(req->m_tcname);
+}
+
+static
+atf_error_t
+set_string(char **field, const char *value)
+{
+    char *copy;
+
+    copy = strdup(value);
+    if (copy == NULL)
+        return atf_no_memory_error();
+
+    free(*field);
+    *field = copy;
+    return atf_no_error();
+}
+
+static
+atf_error_t
+set_tcname(atf_tp_server_request_t *req, const char *value)
+{
+    atf_error_t err;
+    char *delim;
+
+    err = set_string(&req->m_tcname, value);
+    if (atf_is_error(err))
+        return err;
+
+    req->m_cleanup = false;
+    delim = strchr(req->m_tcname, ':');
+    if (delim != NULL) {
+        *delim = '\0';
+        delim++;
+        if (strcmp(delim, "cleanup") == 0)
+            req->m_cleanup = true;
+        else if (strcmp(delim, "body") != 0)
+            return request_error("Invalid test case part `%s'", delim);
+    }
+    return atf_no_error();
+}
+
+static
+atf_error_t
+insert_var(atf_map_t *map, const char *field, const char *value)
+{
+    atf_error_t err;
+    const char *split;
+    char *name, *data;
+
+    split = strchr(value, '=');
+    if (split == NULL || split == value)
+        return request_error("Invalid %s `%s'; must be of the form "
+                             "name=value", field, value);
+
+    name = strdup(value);
+    if (name == NULL)
+        return atf_no_memory_error();
+    name[split - value] = '\0';
+
+    data = strdup(split + 1);
+    if (data == NULL) {
+        free(name);
+        return atf_no_memory_error();
+    }
+
+    err = atf_map_insert(map, name, data, true);
+    free(name);
+    return err;
+}
+
+static
+atf_error_t
+apply_field(atf_tp_server_request_t *req, char *line)
+{
+    char *value;
+
+    value = strchr(line, ' ');
+    if (value == NULL)
+        return request_error("Invalid request line `%s'", line);
+    *value = '\0';
+    value++;
+
+    if (strcmp(line, "tc") == 0)
+        return set_tcname(req, value);
+    else if (strcmp(line, "resfile") == 0)
+        return set_string(&req->m_resfile, value);
+    else if (strcmp(line, "workdir") == 0)
+        return set_string(&req->m_workdir, value);
+    else if (strcmp(line, "stdout") == 0)
+        return set_string(&req->m_stdout, value);
+    else if (strcmp(line, "stderr") == 0)
+        return set_string(&req->m_stderr, value);
+    else if (strcmp(line, "var") == 0)
+        return insert_var(&req->m_config, line, value);
+    else if (strcmp(line, "env") == 0)
+        return insert_var(&req->m_env, line, value);
+    else
+        return request_error("Unknown request field `%s'", line);
+}
+
+static
+atf_error_t
+respond(const struct server *s, const char *fmt, ...)
+    ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(2, 3);
+
+static
+atf_error_t
+respond(const struct server *s, const char *fmt, ...)
+{
+    char buf[2048];
+    va_list ap;
+    size_t length, done;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    length = strlen(buf);
+    done = 0;
+    while (done < length) {
+        const ssize_t ret = write(s->m_out, buf + done, length - done);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return atf_libc_error(errno, "Cannot write response");
+        }
+        done += (size_t)ret;
+    }
+    return atf_no_error();
+}
+
+/* ---------------------------------------------------------------------
+ * Subprocesses.
+ * --------------------------------------------------------------------- */
+
+static
+void
+redirect(const int fd, const char *path, const int flags)
+{
+    const int newfd = open(path, flags, 0644);
+    if (newfd == -1) {
+        fprintf(stderr, "Cannot open `%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (newfd != fd) {
+        if (dup2(newfd, fd) == -1) {
+            fprintf(stderr, "Cannot redirect to `%s': %s\n", path,
+                    strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        close(newfd);
+    }
+}
+
+/*
+ * Makes a path of the request absolute so that it still refers to the
+ * same file once the subprocess has moved into the work directory.
+ */
+static
+void
+make_absolute(char **field)
+{
+    atf_error_t err;
+    char *abspath;
+
+    if (*field == NULL)
+        return;
+
+    err = atf_fs_make_absolute(*field, &abspath);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        fprintf(stderr, "Cannot resolve path of the request\n");
+        exit(EXIT_FAILURE);
+    }
+    free(*field);
+    *field = abspath;
+}
+
+static void run_child(struct server *) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+run_child(struct server *s)
+{
+    atf_tp_server_request_t *req = &s->m_request;
+    atf_map_citer_t iter;
+
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    close(sigchld_pipe[0]);
+    close(sigchld_pipe[1]);
+    if (s->m_in > STDERR_FILENO)
+        close(s->m_in);
+    if (s->m_out > STDERR_FILENO)
+        close(s->m_out);
+    (void)setpgid(0, 0);
+
+    /* Paths are relative to the directory of the server, so open or
+     * resolve them before moving into the work directory. */
+    redirect(STDIN_FILENO, "/dev/null", O_RDONLY);
+    if (req->m_stdout != NULL)
+        redirect(STDOUT_FILENO, req->m_stdout, O_WRONLY | O_CREAT | O_TRUNC);
+    else
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    if (req->m_stderr != NULL)
+        redirect(STDERR_FILENO, req->m_stderr, O_WRONLY | O_CREAT | O_TRUNC);
+    make_absolute(&req->m_resfile);
+
+    atf_map_for_each_c(iter, &req->m_env) {
+        atf_error_t err = atf_env_set(atf_map_citer_key(iter),
+                                      atf_map_citer_data(iter));
+        if (atf_is_error(err)) {
+            atf_error_free(err);
+            fprintf(stderr, "Cannot set variable `%s'\n",
+                    atf_map_citer_key(iter));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (req->m_workdir != NULL && chdir(req->m_workdir) == -1) {
+        fprintf(stderr, "Cannot enter work directory `%s': %s\n",
+                req->m_workdir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    exit(s->m_run(req, s->m_data));
+}
+
+static
+atf_error_t
+start_child(struct server *s)
+{
+    pid_t pid;
+
+    if (s->m_request.m_tcname == NULL)
+        return request_error("Missing test case name");
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid == -1)
+        return atf_libc_error(errno, "Cannot fork subprocess");
+    else if (pid == 0)
+        run_child(s);
+
+    /* Also done by the child; whoever runs first avoids a race with a
+     * client that kills the process group as soon as it knows it. */
+    (void)setpgid(pid, pid);
+    s->m_children++;
+    return respond(s, "started %ld\n", (long)pid);
+}
+
+static
+atf_error_t
+reap_children(struct server *s)
+{
+    atf_error_t err;
+    pid_t pid;
+    int status;
+
+    err = atf_no_error();
+    while (!atf_is_error(err) && s->m_children > 0 &&
+           (pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        INV(s->m_children > 0);
+        s->m_children--;
+        err = respond(s, "done %ld %d\n", (long)pid, status);
+    }
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * Requests.
+ * --------------------------------------------------------------------- */
+
+static
+atf_error_t
+end_request(struct server *s)
+{
+    atf_error_t err;
+
+    err = s->m_request_error;
+    s->m_request_error = atf_no_error();
+    if (!atf_is_error(err))
+        err = start_child(s);
+
+    if (atf_is_error(err) && atf_error_is(err, "request")) {
+        char buf[1024];
+
+        atf_error_format(err, buf, sizeof(buf));
+        atf_error_free(err);
+        err = respond(s, "error %s\n", buf);
+    }
+
+    request_fini(&s->m_request);
+    s->m_lines = 0;
+    if (!atf_is_error(err))
+        err = request_init(&s->m_request);
+    else {
+        atf_error_t err2 = request_init(&s->m_request);
+        if (atf_is_error(err2))
+            atf_error_free(err2);
+    }
+    return err;
+}
+
+static
+atf_error_t
+process_line(struct server *s, char *line)
+{
+    atf_error_t err;
+
+    if (*line == '\0')
+        return s->m_lines > 0 ? end_request(s) : atf_no_error();
+
+    s->m_lines++;
+    if (atf_is_error(s->m_request_error))
+        return atf_no_error();
+
+    err = apply_field(&s->m_request, line);
+    if (atf_is_error(err) && atf_error_is(err, "request")) {
+        /* Reported once the whole request has been read. */
+        s->m_request_error = err;
+        err = atf_no_error();
+    }
+    return err;
+}
+
+static
+atf_error_t
+read_requests(struct server *s)
+{
+    atf_error_t err;
+    char buf[4096];
+    ssize_t ret;
+    size_t pos;
+    char *lines, *line, *next;
+    atf_dynstr_t rest;
+
+    ret = read(s->m_in, buf, sizeof(buf));
+    if (ret == -1) {
+        if (errno == EINTR || errno == EAGAIN)
+            return atf_no_error();
+        return atf_libc_error(errno, "Cannot read requests");
+    } else if (ret == 0) {
+        s->m_eof = true;
+        return atf_no_error();
+    }
+
+    err = atf_dynstr_append_fmt(&s->m_buffer, "%.*s", (int)ret, buf);
+    if (atf_is_error(err))
+        return err;
+
+    pos = atf_dynstr_rfind_ch(&s->m_buffer, '\n');
+    if (pos == atf_dynstr_npos)
+        return atf_no_error();
+
+    lines = strdup(atf_dynstr_cstring(&s->m_buffer));
+    if (lines == NULL)
+        return atf_no_memory_error();
+    err = atf_dynstr_init_substr(&rest, &s->m_buffer, pos + 1,
+                                 atf_dynstr_npos);
+    if (atf_is_error(err)) {
+        free(lines);
+        return err;
+    }
+    atf_dynstr_fini(&s->m_buffer);
+    s->m_buffer = rest;
+
+    lines[pos] = '\0';
+    for (line = lines; line != NULL && !atf_is_error(err); line = next) {
+        next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        err = process_line(s, line);
+    }
+    free(lines);
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+atf_error_t
+atf_tp_server_serve(int in, int out, atf_tp_server_run_t run, void *data)
+{
+    atf_error_t err;
+    struct server s;
+    struct sigaction sa, oldchld, oldpipe;
+    const int original_out = out;
+    int i;
+
+    /* Keep anything the test program prints to its standard output away
+     * from the responses. */
+    if (out == STDOUT_FILENO) {
+        out = dup(STDOUT_FILENO);
+        if (out == -1)
+            return atf_libc_error(errno, "Cannot duplicate stdout");
+        if (dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+            err = atf_libc_error(errno, "Cannot redirect stdout");
+            close(out);
+            return err;
+        }
+        fcntl(out, F_SETFD, FD_CLOEXEC);
+    }
+
+    s.m_in = in;
+    s.m_out = out;
+    s.m_run = run;
+    s.m_data = data;
+    s.m_eof = false;
+    s.m_children = 0;
+    s.m_lines = 0;
+    s.m_request_error = atf_no_error();
+
+    err = atf_dynstr_init(&s.m_buffer);
+    if (atf_is_error(err))
+        goto out;
+    err = request_init(&s.m_request);
+    if (atf_is_error(err))
+        goto out_buffer;
+
+    if (pipe(sigchld_pipe) == -1) {
+        err = atf_libc_error(errno, "Cannot create pipe");
+        goto out_request;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(sigchld_pipe[i], F_SETFL,
+              fcntl(sigchld_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(sigchld_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = notify_sigchld;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, &oldchld);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, &oldpipe);
+
+    err = respond(&s, "ready\n");
+    while (!atf_is_error(err) && (!s.m_eof || s.m_children > 0)) {
+        struct pollfd pfds[2];
+        char drain[64];
+
+        pfds[0].fd = sigchld_pipe[0];
+        pfds[0].events = POLLIN;
+        pfds[1].fd = s.m_in;
+        pfds[1].events = POLLIN;
+        pfds[1].revents = 0;
+        if (poll(pfds, s.m_eof ? 1 : 2, -1) == -1) {
+            if (errno != EINTR)
+                err = atf_libc_error(errno, "poll failed");
+            continue;
+        }
+
+        while (read(sigchld_pipe[0], drain, sizeof(drain)) > 0)
+            continue;
+        err = reap_children(&s);
+        if (!atf_is_error(err) && pfds[1].revents != 0)
+            err = read_requests(&s);
+    }
+
+    sigaction(SIGPIPE, &oldpipe, NULL);
+    sigaction(SIGCHLD, &oldchld, NULL);
+    close(sigchld_pipe[0]);
+    close(sigchld_pipe[1]);
+    sigchld_pipe[0] = sigchld_pipe[1] = -1;
+out_request:
+    if (atf_is_error(s.m_request_error))
+        atf_error_free(s.m_request_error);
+    request_fini(&s.m_request);
+out_buffer:
+    atf_dynstr_fini(&s.m_buffer);
+out:
+    if (s.m_out != original_out)
+        close(s.m_out);
+    return err;
+}
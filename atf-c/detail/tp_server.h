@@ -0,0 +1,62 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_TP_SERVER_H)
+#define ATF_C_DETAIL_TP_SERVER_H
+
+#include <stdbool.h>
+
+#include <atf-c/detail/map.h>
+#include <atf-c/error_fwd.h>
+
+/* ---------------------------------------------------------------------
+ * The "atf_tp_server_request" type.
+ * --------------------------------------------------------------------- */
+
+/* A request to run a part of a test case.  Paths left as NULL were not
+ * given in the request. */
+struct atf_tp_server_request {
+    char *m_tcname;
+    bool m_cleanup;
+    char *m_resfile;
+    char *m_workdir;
+    char *m_stdout;
+    char *m_stderr;
+    atf_map_t m_config;
+    atf_map_t m_env;
+};
+typedef struct atf_tp_server_request atf_tp_server_request_t;
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/* Runs a request within the subprocess created for it and returns the
+ * exit code of the subprocess. */
+typedef int (*atf_tp_server_run_t)(const atf_tp_server_request_t *, void *);
+
+atf_error_t atf_tp_server_serve(int, int, atf_tp_server_run_t, void *);
+
+#endif /* !defined(ATF_C_DETAIL_TP_SERVER_H) */
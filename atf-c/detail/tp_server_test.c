@@ -0,0 +1,382 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/tp_server.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Runs a request on behalf of the server.  The name of the test case
+ * selects what to do, and the details of the request are printed so that
+ * the test cases can check them.
+ */
+static
+int
+run_request(const atf_tp_server_request_t *req,
+            void *data ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    atf_map_citer_t iter;
+
+    printf("tc: %s\n", req->m_tcname);
+    printf("cleanup: %s\n", req->m_cleanup ? "true" : "false");
+    if (req->m_resfile != NULL)
+        printf("resfile: %s\n", req->m_resfile);
+    atf_map_for_each_c(iter, &req->m_config)
+        printf("var: %s=%s\n", atf_map_citer_key(iter),
+               (const char *)atf_map_citer_data(iter));
+    if (atf_env_has("TP_SERVER_TEST"))
+        printf("env: %s\n", atf_env_get("TP_SERVER_TEST"));
+    fprintf(stderr, "to stderr\n");
+    atf_utils_create_file("created", "%s", "");
+
+    if (strcmp(req->m_tcname, "abort") == 0)
+        abort();
+    else if (strcmp(req->m_tcname, "wait") == 0) {
+        while (access("../go", F_OK) == -1)
+            usleep(10000);
+        return EXIT_SUCCESS;
+    } else if (strncmp(req->m_tcname, "exit", 4) == 0)
+        return atoi(req->m_tcname + 4);
+    else
+        return EXIT_FAILURE;
+}
+
+struct client {
+    pid_t m_pid;
+    int m_requests;
+    int m_responses;
+};
+
+static
+void
+start_server(struct client *c)
+{
+    int requests[2], responses[2];
+
+    ATF_REQUIRE(pipe(requests) != -1);
+    ATF_REQUIRE(pipe(responses) != -1);
+
+    c->m_pid = fork();
+    ATF_REQUIRE(c->m_pid != -1);
+    if (c->m_pid == 0) {
+        atf_error_t err;
+
+        close(requests[1]);
+        close(responses[0]);
+        err = atf_tp_server_serve(requests[0], responses[1], run_request,
+                                  NULL);
+        if (atf_is_error(err)) {
+            char buf[1024];
+            atf_error_format(err, buf, sizeof(buf));
+            fprintf(stderr, "Server failed: %s\n", buf);
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    close(requests[0]);
+    close(responses[1]);
+    c->m_requests = requests[1];
+    c->m_responses = responses[0];
+}
+
+static
+void
+send_request(const struct client *c, const char *text)
+{
+    const size_t length = strlen(text);
+
+    ATF_REQUIRE(write(c->m_requests, text, length) == (ssize_t)length);
+}
+
+static
+void
+read_response(const struct client *c, char *buf, const size_t buflen)
+{
+    size_t pos;
+
+    for (pos = 0; pos < buflen - 1; pos++) {
+        const ssize_t ret = read(c->m_responses, &buf[pos], 1);
+        if (ret == -1 && errno == EINTR) {
+            pos--;
+            continue;
+        }
+        ATF_REQUIRE_MSG(ret == 1, "Server closed its responses");
+        if (buf[pos] == '\n')
+            break;
+    }
+    buf[pos] = '\0';
+    printf("Response: %s\n", buf);
+}
+
+static
+void
+expect_response(const struct client *c, const char *expected)
+{
+    char buf[1024];
+
+    read_response(c, buf, sizeof(buf));
+    ATF_REQUIRE_STREQ(expected, buf);
+}
+
+static
+pid_t
+expect_started(const struct client *c)
+{
+    char buf[1024];
+    long pid;
+
+    read_response(c, buf, sizeof(buf));
+    ATF_REQUIRE_MSG(sscanf(buf, "started %ld", &pid) == 1,
+                    "Unexpected response `%s'", buf);
+    return (pid_t)pid;
+}
+
+static
+int
+expect_done(const struct client *c, const pid_t pid)
+{
+    char buf[1024];
+    long done;
+    int status;
+
+    read_response(c, buf, sizeof(buf));
+    ATF_REQUIRE_MSG(sscanf(buf, "done %ld %d", &done, &status) == 2,
+                    "Unexpected response `%s'", buf);
+    ATF_REQUIRE_EQ(pid, (pid_t)done);
+    return status;
+}
+
+static
+void
+stop_server(struct client *c)
+{
+    char ch;
+    int status;
+
+    close(c->m_requests);
+    ATF_REQUIRE_EQ(0, read(c->m_responses, &ch, 1));
+    close(c->m_responses);
+
+    ATF_REQUIRE(waitpid(c->m_pid, &status, 0) != -1);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, WEXITSTATUS(status));
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the atf_tp_server_serve function.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(run);
+ATF_TC_HEAD(run, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that a request runs in its "
+                      "own subprocess with the given settings");
+}
+ATF_TC_BODY(run, tc)
+{
+    struct client c;
+    pid_t pid;
+    int status;
+    char cwd[1024], expected[2048];
+
+    ATF_REQUIRE(getcwd(cwd, sizeof(cwd)) != NULL);
+    ATF_REQUIRE(mkdir("work", 0755) != -1);
+
+    start_server(&c);
+    expect_response(&c, "ready");
+    send_request(&c, "tc exit3:cleanup\n"
+                 "resfile the-resfile\n"
+                 "workdir work\n"
+                 "stdout run.out\n"
+                 "stderr run.err\n"
+                 "var a=b=c\n"
+                 "env TP_SERVER_TEST=some value\n"
+                 "\n");
+    pid = expect_started(&c);
+    status = expect_done(&c, pid);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(3, WEXITSTATUS(status));
+
+    send_request(&c, "\n\ntc exit0\nworkdir work\nstdout run2.out\n\n");
+    pid = expect_started(&c);
+    status = expect_done(&c, pid);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(0, WEXITSTATUS(status));
+    stop_server(&c);
+
+    /* The results file is relative to the server, not to the work
+     * directory. */
+    snprintf(expected, sizeof(expected), "tc: exit3\n"
+             "cleanup: true\n"
+             "resfile: %s/the-resfile\n"
+             "var: a=b=c\n"
+             "env: some value\n", cwd);
+    ATF_REQUIRE(atf_utils_compare_file("run.out", expected));
+    ATF_REQUIRE(atf_utils_compare_file("run.err", "to stderr\n"));
+    ATF_REQUIRE(atf_utils_compare_file("run2.out", "tc: exit0\n"
+                                       "cleanup: false\n"));
+    ATF_REQUIRE(atf_utils_file_exists("work/created"));
+    ATF_REQUIRE(!atf_utils_file_exists("created"));
+    ATF_REQUIRE(!atf_env_has("TP_SERVER_TEST"));
+}
+
+ATF_TC(concurrent);
+ATF_TC_HEAD(concurrent, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that the server accepts new "
+                      "requests while others are still running and "
+                      "reports them as they finish");
+}
+ATF_TC_BODY(concurrent, tc)
+{
+    struct client c;
+    pid_t waiting, aborting;
+    int status;
+
+    ATF_REQUIRE(mkdir("work", 0755) != -1);
+
+    start_server(&c);
+    expect_response(&c, "ready");
+    send_request(&c, "tc wait\nworkdir work\nstdout out1\n\n");
+    waiting = expect_started(&c);
+    send_request(&c, "tc abort\nworkdir work\nstdout out2\n\n");
+    aborting = expect_started(&c);
+    ATF_REQUIRE(waiting != aborting);
+
+    status = expect_done(&c, aborting);
+    ATF_REQUIRE(WIFSIGNALED(status));
+    ATF_REQUIRE_EQ(SIGABRT, WTERMSIG(status));
+
+    atf_utils_create_file("go", "%s", "");
+    status = expect_done(&c, waiting);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(0, WEXITSTATUS(status));
+    stop_server(&c);
+}
+
+ATF_TC(eof);
+ATF_TC_HEAD(eof, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that the server waits for its "
+                      "subprocesses once its input is closed");
+}
+ATF_TC_BODY(eof, tc)
+{
+    struct client c;
+    pid_t pid;
+    int status;
+
+    ATF_REQUIRE(mkdir("work", 0755) != -1);
+
+    start_server(&c);
+    expect_response(&c, "ready");
+    send_request(&c, "tc wait\nworkdir work\nstdout eof.out\n\ntc exit0\n");
+    pid = expect_started(&c);
+    close(c.m_requests);
+
+    atf_utils_create_file("go", "%s", "");
+    status = expect_done(&c, pid);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(0, WEXITSTATUS(status));
+
+    /* The incomplete request is discarded. */
+    c.m_requests = open("/dev/null", O_RDONLY);
+    stop_server(&c);
+}
+
+ATF_TC(invalid);
+ATF_TC_HEAD(invalid, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that invalid requests are "
+                      "reported without stopping the server");
+}
+ATF_TC_BODY(invalid, tc)
+{
+    struct client c;
+    pid_t pid;
+    int status;
+
+    start_server(&c);
+    expect_response(&c, "ready");
+
+    send_request(&c, "tc foo:bar\n\n");
+    expect_response(&c, "error Invalid test case part `bar'");
+    send_request(&c, "tc foo\nnospace\nunknown x\n\n");
+    expect_response(&c, "error Invalid request line `nospace'");
+    send_request(&c, "unknown x\n\n");
+    expect_response(&c, "error Unknown request field `unknown'");
+    send_request(&c, "tc foo\nvar =x\n\n");
+    expect_response(&c, "error Invalid var `=x'; must be of the form "
+                    "name=value");
+    send_request(&c, "tc foo\nenv x\n\n");
+    expect_response(&c, "error Invalid env `x'; must be of the form "
+                    "name=value");
+    send_request(&c, "workdir .\n\n");
+    expect_response(&c, "error Missing test case name");
+
+    send_request(&c, "tc exit0\nworkdir missing\nstderr err\n\n");
+    pid = expect_started(&c);
+    status = expect_done(&c, pid);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(EXIT_FAILURE, WEXITSTATUS(status));
+    ATF_REQUIRE(atf_utils_grep_file("Cannot enter work directory `missing'",
+                                    "err"));
+
+    stop_server(&c);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, run);
+    ATF_TP_ADD_TC(tp, concurrent);
+    ATF_TP_ADD_TC(tp, eof);
+    ATF_TP_ADD_TC(tp, invalid);
+
+    return atf_no_error();
+}
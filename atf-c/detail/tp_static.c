@@ -0,0 +1,504 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/tp_static.h"
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atf-c/detail/history.h"
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/*
+ * The ATF_TC, ATF_TP_ADD_TC and related macros, as well as their C++
+ * counterparts, emit records into the atf_tcs section of ELF binaries.
+ * Every record is a NUL-terminated string; the compiler may insert NUL
+ * padding between them.  The records are:
+ *
+ *     tp: <binding>\n            The program uses the atf-c or atf-c++
+ *                                macros that emit records.
+ *     tc: <ident>\n<md>          A test case whose metadata is known at
+ *                                build time, as "name: value" lines.
+ *     tc-dynamic: <ident>\n      A test case with a head routine.
+ *     add: <line> <ident>\n      A test case registered in the program;
+ *                                the line orders the registrations.
+ *
+ * A listing can only be built if every registered test case is static.
+ * This assumes that ATF_TP_ADD_TCS registers its test cases
+ * unconditionally, which is documented.
+ */
+
+#define SECTION_NAME "atf_tcs"
+
+struct static_var {
+    const char *m_name;
+    const char *m_value;
+};
+
+struct static_tc {
+    const char *m_ident;
+    bool m_dynamic;
+    struct static_var *m_vars;
+    size_t m_nvars;
+};
+
+struct static_add {
+    unsigned long m_line;
+    size_t m_seq;
+    const char *m_ident;
+};
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+uint64_t
+get_uint(const unsigned char *p, const size_t bytes, const bool msb)
+{
+    uint64_t value;
+    size_t i;
+
+    value = 0;
+    for (i = 0; i < bytes; i++)
+        value = (value << 8) | p[msb ? i : bytes - 1 - i];
+    return value;
+}
+
+static
+atf_error_t
+read_at(const int fd, const uint64_t offset, void *buf, const size_t len,
+        bool *complete)
+{
+    size_t done;
+
+    done = 0;
+    while (done < len) {
+        const ssize_t n = pread(fd, (char *)buf + done, len - done,
+                                (off_t)(offset + done));
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return atf_libc_error(errno, "Cannot read the test program");
+        } else if (n == 0)
+            break;
+        done += n;
+    }
+    *complete = done == len;
+    return atf_no_error();
+}
+
+/*
+ * Reads the contents of the atf_tcs section of an ELF file.  Sets found to
+ * false if the file is not ELF or does not have the section; malformed
+ * files are handled in the same way.  On success, the section is returned
+ * NUL-terminated in a buffer that the caller must free.
+ */
+static
+atf_error_t
+read_section(const int fd, char **section, size_t *length, bool *found)
+{
+    unsigned char ehdr[64], shdr[64];
+    uint64_t shoff, shentsize, shnum, shstrndx, stroff, strsize, i;
+    bool is64, msb, complete;
+    char *names;
+    atf_error_t err;
+
+    *found = false;
+
+    err = read_at(fd, 0, ehdr, sizeof(ehdr), &complete);
+    if (atf_is_error(err) || !complete)
+        return err;
+    if (memcmp(ehdr, "\177ELF", 4) != 0 || (ehdr[4] != 1 && ehdr[4] != 2) ||
+        (ehdr[5] != 1 && ehdr[5] != 2))
+        return atf_no_error();
+    is64 = ehdr[4] == 2;
+    msb = ehdr[5] == 2;
+
+    shoff = get_uint(ehdr + (is64 ? 40 : 32), is64 ? 8 : 4, msb);
+    shentsize = get_uint(ehdr + (is64 ? 58 : 46), 2, msb);
+    shnum = get_uint(ehdr + (is64 ? 60 : 48), 2, msb);
+    shstrndx = get_uint(ehdr + (is64 ? 62 : 50), 2, msb);
+    if (shoff == 0 || shentsize < (is64 ? 64U : 40U) ||
+        shentsize > sizeof(shdr))
+        return atf_no_error();
+
+    /* Files with many sections store the real counts in section 0. */
+    if (shnum == 0 || shstrndx == 0xffff) {
+        err = read_at(fd, shoff, shdr, shentsize, &complete);
+        if (atf_is_error(err) || !complete)
+            return err;
+        if (shnum == 0)
+            shnum = get_uint(shdr + (is64 ? 32 : 20), is64 ? 8 : 4, msb);
+        if (shstrndx == 0xffff)
+            shstrndx = get_uint(shdr + (is64 ? 40 : 24), 4, msb);
+    }
+    if (shstrndx >= shnum)
+        return atf_no_error();
+
+    err = read_at(fd, shoff + shstrndx * shentsize, shdr, shentsize,
+                  &complete);
+    if (atf_is_error(err) || !complete)
+        return err;
+    stroff = get_uint(shdr + (is64 ? 24 : 16), is64 ? 8 : 4, msb);
+    strsize = get_uint(shdr + (is64 ? 32 : 20), is64 ? 8 : 4, msb);
+    if (strsize == 0 || strsize > SIZE_MAX - 1)
+        return atf_no_error();
+
+    names = malloc(strsize + 1);
+    if (names == NULL)
+        return atf_no_memory_error();
+    err = read_at(fd, stroff, names, strsize, &complete);
+    if (atf_is_error(err) || !complete)
+        goto out_names;
+    names[strsize] = '\0';
+
+    for (i = 0; i < shnum; i++) {
+        uint64_t name, offset, size;
+
+        err = read_at(fd, shoff + i * shentsize, shdr, shentsize, &complete);
+        if (atf_is_error(err) || !complete)
+            goto out_names;
+
+        name = get_uint(shdr, 4, msb);
+        if (name >= strsize || strcmp(names + name, SECTION_NAME) != 0)
+            continue;
+        /* SHT_NOBITS sections have no contents in the file. */
+        if (get_uint(shdr + 4, 4, msb) == 8)
+            break;
+
+        offset = get_uint(shdr + (is64 ? 24 : 16), is64 ? 8 : 4, msb);
+        size = get_uint(shdr + (is64 ? 32 : 20), is64 ? 8 : 4, msb);
+        if (size > SIZE_MAX - 1)
+            break;
+
+        *section = malloc(size + 1);
+        if (*section == NULL) {
+            err = atf_no_memory_error();
+            goto out_names;
+        }
+        err = read_at(fd, offset, *section, size, &complete);
+        if (atf_is_error(err) || !complete) {
+            free(*section);
+            goto out_names;
+        }
+        (*section)[size] = '\0';
+        *length = size;
+        *found = true;
+        break;
+    }
+
+out_names:
+    free(names);
+    return err;
+}
+
+static
+bool
+has_prefix(const char *str, const char *prefix)
+{
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+/*
+ * Parses the metadata of a static test case in place.  Properties set
+ * more than once keep their first position, like in atf_tc_set_md_var.
+ */
+static
+atf_error_t
+parse_vars(char *md, struct static_tc *tc, bool *valid)
+{
+    char *line, *end, *sep;
+    size_t lines, i;
+
+    lines = 1;
+    for (line = md; *line != '\0'; line++)
+        lines += *line == '\n';
+    tc->m_vars = malloc(lines * sizeof(struct static_var));
+    if (tc->m_vars == NULL)
+        return atf_no_memory_error();
+    tc->m_nvars = 0;
+
+    *valid = true;
+    for (line = md; *line != '\0'; line = end) {
+        end = strchr(line, '\n');
+        if (end == NULL)
+            end = line + strlen(line);
+        else
+            *end++ = '\0';
+        if (*line == '\0')
+            continue;
+
+        sep = strstr(line, ": ");
+        if (sep == NULL || sep == line) {
+            *valid = false;
+            return atf_no_error();
+        }
+        *sep = '\0';
+        if (strcmp(line, "ident") == 0) {
+            *valid = false;
+            return atf_no_error();
+        }
+
+        for (i = 0; i < tc->m_nvars; i++) {
+            if (strcmp(tc->m_vars[i].m_name, line) == 0)
+                break;
+        }
+        tc->m_vars[i].m_name = line;
+        tc->m_vars[i].m_value = sep + 2;
+        if (i == tc->m_nvars)
+            tc->m_nvars++;
+    }
+    return atf_no_error();
+}
+
+static
+int
+compare_adds(const void *a, const void *b)
+{
+    const struct static_add *a1 = a, *b1 = b;
+
+    if (a1->m_line != b1->m_line)
+        return a1->m_line < b1->m_line ? -1 : 1;
+    return a1->m_seq < b1->m_seq ? -1 : a1->m_seq > b1->m_seq;
+}
+
+static
+int
+compare_vars(const void *a, const void *b)
+{
+    return strcmp(((const struct static_var *)a)->m_name,
+                  ((const struct static_var *)b)->m_name);
+}
+
+static
+const struct static_tc *
+find_tc(const struct static_tc *tcs, const size_t ntcs, const char *ident)
+{
+    const struct static_tc *found;
+    size_t i;
+
+    found = NULL;
+    for (i = 0; i < ntcs; i++) {
+        if (strcmp(tcs[i].m_ident, ident) != 0)
+            continue;
+        if (tcs[i].m_dynamic)
+            return &tcs[i];
+        if (found == NULL)
+            found = &tcs[i];
+    }
+    return found;
+}
+
+/*
+ * Formats the listing of a test program in the same way as its -l flag,
+ * including the duration hints of the history.
+ */
+static
+atf_error_t
+format_listing(const char *program, struct static_tc *tcs, const size_t ntcs,
+               const struct static_add *adds, const size_t nadds,
+               const bool sorted, atf_dynstr_t *listing, bool *found)
+{
+    atf_history_t history;
+    bool has_history;
+    const char *file;
+    atf_error_t err;
+    size_t i, j;
+
+    for (i = 0; i < nadds; i++) {
+        const struct static_tc *tc = find_tc(tcs, ntcs, adds[i].m_ident);
+        if (tc == NULL || tc->m_dynamic) {
+            *found = false;
+            return atf_no_error();
+        }
+    }
+
+    if (sorted) {
+        for (i = 0; i < ntcs; i++) {
+            if (!tcs[i].m_dynamic)
+                qsort(tcs[i].m_vars, tcs[i].m_nvars,
+                      sizeof(struct static_var), compare_vars);
+        }
+    }
+
+    has_history = false;
+    file = atf_history_file();
+    if (file != NULL) {
+        err = atf_history_init(&history, file, program);
+        if (atf_is_error(err))
+            atf_error_free(err);
+        else
+            has_history = true;
+    }
+
+    err = atf_dynstr_init_fmt(listing, "Content-Type: application/X-atf-tp; "
+                              "version=\"1\"\n");
+    for (i = 0; !atf_is_error(err) && i < nadds; i++) {
+        const struct static_tc *tc = find_tc(tcs, ntcs, adds[i].m_ident);
+        bool has_hint;
+        long msec;
+
+        err = atf_dynstr_append_fmt(listing, "\nident: %s\n", tc->m_ident);
+        has_hint = false;
+        for (j = 0; !atf_is_error(err) && j < tc->m_nvars; j++) {
+            err = atf_dynstr_append_fmt(listing, "%s: %s\n",
+                                        tc->m_vars[j].m_name,
+                                        tc->m_vars[j].m_value);
+            has_hint |= strcmp(tc->m_vars[j].m_name,
+                               "X-duration-hint-ms") == 0;
+        }
+        if (!atf_is_error(err) && has_history && !has_hint &&
+            atf_history_get(&history, tc->m_ident, &msec))
+            err = atf_dynstr_append_fmt(listing, "X-duration-hint-ms: %ld\n",
+                                        msec);
+    }
+
+    if (has_history)
+        atf_history_fini(&history);
+    if (atf_is_error(err))
+        atf_dynstr_fini(listing);
+    else
+        *found = true;
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Builds the list of test cases of a test program from the records in its
+ * binary, without executing it.  If found is set to true, the listing is
+ * exactly what the -l flag of the program prints, and the caller must
+ * release it.  Otherwise, the program must be executed to list its test
+ * cases.
+ */
+atf_error_t
+atf_tp_static_list(const char *program, atf_dynstr_t *listing, bool *found)
+{
+    struct static_tc *tcs;
+    struct static_add *adds;
+    size_t length, count, ntcs, nadds;
+    char *section, *p, *end;
+    bool has_tp, sorted, valid;
+    atf_error_t err;
+    int fd;
+
+    *found = false;
+    section = NULL;
+    length = 0;
+
+    fd = open(program, O_RDONLY);
+    if (fd == -1)
+        return atf_libc_error(errno, "Cannot open test program %s", program);
+    err = read_section(fd, &section, &length, found);
+    close(fd);
+    if (atf_is_error(err) || !*found)
+        return err;
+    *found = false;
+
+    count = 0;
+    for (p = section; p < section + length; p++)
+        count += *p == '\0' && (p == section || *(p - 1) != '\0');
+    count++;
+
+    tcs = calloc(count, sizeof(struct static_tc));
+    adds = malloc(count * sizeof(struct static_add));
+    if (tcs == NULL || adds == NULL) {
+        err = atf_no_memory_error();
+        goto out;
+    }
+    ntcs = nadds = 0;
+    has_tp = sorted = false;
+
+    for (p = section; p < section + length; p = end + 1) {
+        char *record = p;
+
+        end = record + strlen(record);
+        if (*record == '\0')
+            continue;
+
+        if (has_prefix(record, "tp: ")) {
+            has_tp = true;
+            sorted = strcmp(record, "tp: c++\n") == 0;
+        } else if (has_prefix(record, "tc: ") ||
+                   has_prefix(record, "tc-dynamic: ")) {
+            struct static_tc *tc = &tcs[ntcs++];
+            char *newline;
+
+            tc->m_dynamic = has_prefix(record, "tc-dynamic: ");
+            tc->m_ident = strchr(record, ' ') + 1;
+            newline = strchr(record, '\n');
+            if (newline == NULL)
+                goto out;
+            *newline = '\0';
+
+            if (!tc->m_dynamic) {
+                err = parse_vars(newline + 1, tc, &valid);
+                if (atf_is_error(err) || !valid)
+                    goto out;
+            }
+        } else if (has_prefix(record, "add: ")) {
+            struct static_add *add = &adds[nadds];
+            char *newline;
+
+            add->m_line = strtoul(record + 5, &newline, 10);
+            if (*newline != ' ')
+                goto out;
+            add->m_ident = newline + 1;
+            newline = strchr(add->m_ident, '\n');
+            if (newline == NULL)
+                goto out;
+            *newline = '\0';
+            add->m_seq = nadds++;
+        }
+    }
+
+    if (has_tp && nadds > 0) {
+        qsort(adds, nadds, sizeof(struct static_add), compare_adds);
+        err = format_listing(program, tcs, ntcs, adds, nadds, sorted, listing,
+                             found);
+    }
+
+out:
+    if (tcs != NULL) {
+        size_t i;
+
+        for (i = 0; i < count; i++)
+            free(tcs[i].m_vars);
+    }
+    free(tcs);
+    free(adds);
+    free(section);
+    return err;
+}
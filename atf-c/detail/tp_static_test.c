@@ -0,0 +1,183 @@
+/* Copyright (c) 2026 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/tp_static.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include "atf-c/check.h"
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/history.h"
+#include "atf-c/detail/test_helpers.h"
+
+/*
+ * All the test cases of this program are static, so that it can check
+ * its own listing.
+ */
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+program_path(const atf_tc_t *tc, const char *name, char *buf,
+             const size_t buflen)
+{
+    snprintf(buf, buflen, "%s/%s", atf_tc_get_config_var(tc, "srcdir"),
+             name);
+}
+
+/*
+ * Checks that the static listing of a program matches what its -l flag
+ * prints and returns the listing, which the caller must free.
+ */
+static
+char *
+check_listing(const char *program)
+{
+    const char *argv[3];
+    atf_check_result_t result;
+    atf_dynstr_t listing;
+    bool found;
+    char *str;
+
+    RE(atf_tp_static_list(program, &listing, &found));
+    ATF_REQUIRE_MSG(found, "No static listing in %s", program);
+    str = atf_dynstr_fini_disown(&listing);
+
+    argv[0] = program;
+    argv[1] = "-l";
+    argv[2] = NULL;
+    RE(atf_check_exec_array(argv, &result));
+    ATF_REQUIRE(atf_check_result_exited(&result));
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, atf_check_result_exitcode(&result));
+    if (!atf_utils_compare_file(atf_check_result_stdout(&result), str)) {
+        printf("Static listing:\n%s", str);
+        printf("Output of -l:\n");
+        atf_utils_cat_file(atf_check_result_stdout(&result), "");
+        atf_tc_fail("The static listing does not match the output of -l");
+    }
+    atf_check_result_fini(&result);
+    return str;
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the atf_tp_static_list function.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_STATIC(list_self,
+    "descr: Checks that the static listing of a program matches the "
+        "output of its -l flag\n"
+    "X-property: value: with colons\n"
+    "timeout: 30\n");
+ATF_TC_BODY(list_self, tc)
+{
+    char program[1024];
+    char *listing;
+
+    program_path(tc, "tp_static_test", program, sizeof(program));
+    listing = check_listing(program);
+    ATF_REQUIRE(atf_utils_grep_string("ident: list_self\n", listing));
+    ATF_REQUIRE(atf_utils_grep_string("X-property: value: with colons\n",
+                                      listing));
+    ATF_REQUIRE(atf_utils_grep_string("has.cleanup: true\n", listing));
+    ATF_REQUIRE(atf_utils_grep_string("ident: without_head\n", listing));
+    free(listing);
+}
+
+ATF_TC_STATIC_WITH_CLEANUP(with_cleanup,
+    "descr: Checks that the static listing includes the history of "
+        "the test cases\n");
+ATF_TC_BODY(with_cleanup, tc)
+{
+    char program[1024];
+    char *listing;
+
+    program_path(tc, "tp_static_test", program, sizeof(program));
+    RE(atf_env_set("ATF_HISTORY_FILE", "history"));
+    RE(atf_history_record("history", program, "with_cleanup", 1234));
+    listing = check_listing(program);
+    ATF_REQUIRE(atf_utils_grep_string("X-duration-hint-ms: 1234", listing));
+    free(listing);
+}
+ATF_TC_CLEANUP(with_cleanup, tc)
+{
+}
+
+ATF_TC_WITHOUT_HEAD(without_head);
+ATF_TC_BODY(without_head, tc)
+{
+    atf_dynstr_t listing;
+    bool found;
+    char program[1024];
+
+    /* Test programs with head routines can only be listed by running
+     * them. */
+    program_path(tc, "sha256_test", program, sizeof(program));
+    RE(atf_tp_static_list(program, &listing, &found));
+    ATF_REQUIRE(!found);
+
+    atf_utils_create_file("script", "#! /bin/sh\necho atf_tcs\n");
+    RE(atf_tp_static_list("script", &listing, &found));
+    ATF_REQUIRE(!found);
+
+    atf_utils_create_file("truncated", "\177ELF\002\001");
+    RE(atf_tp_static_list("truncated", &listing, &found));
+    ATF_REQUIRE(!found);
+}
+
+ATF_TC_STATIC(missing,
+    "descr: Checks that a missing test program is reported\n");
+ATF_TC_BODY(missing, tc)
+{
+    atf_dynstr_t listing;
+    atf_error_t err;
+    bool found;
+
+    err = atf_tp_static_list("non-existent", &listing, &found);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+    ATF_REQUIRE(!found);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, list_self);
+    ATF_TP_ADD_TC(tp, with_cleanup);
+    ATF_TP_ADD_TC(tp, without_head);
+    ATF_TP_ADD_TC(tp, missing);
+
+    return atf_no_error();
+}
@@ -34,6 +34,23 @@
 #include <atf-c/tp.h>
 #include <atf-c/utils.h>
 
+/*
+ * Records describing the test cases are emitted into the atf_tcs section
+ * of ELF binaries so that their list can be extracted without executing
+ * them; see atf-test-program(1).  Every record is a NUL-terminated string.
+ */
+#define ATFU_STRINGIFY(x) #x
+#define ATFU_STRINGIFY_VALUE(x) ATFU_STRINGIFY(x)
+
+#if defined(__ELF__) && defined(__GNUC__)
+#   define ATFU_RECORD(name, text) \
+    static const char name[] __attribute__((__section__("atf_tcs"), \
+                                            __used__)) = text
+#else
+#   define ATFU_RECORD(name, text) \
+    extern const char name[]
+#endif
+
 #define ATF_TC_NAME(tc) \
     (atfu_ ## tc ## _tc)
 
@@ -41,6 +58,7 @@
     (atfu_ ## tc ## _tc_pack)
 
 #define ATF_TC_WITHOUT_HEAD(tc) \
+    ATFU_RECORD(atfu_ ## tc ## _record, "tc: " #tc "\n"); \
     static void atfu_ ## tc ## _body(const atf_tc_t *); \
     static atf_tc_t atfu_ ## tc ## _tc; \
     static atf_tc_pack_t atfu_ ## tc ## _tc_pack = { \
@@ -51,6 +69,7 @@
     }
 
 #define ATF_TC(tc) \
+    ATFU_RECORD(atfu_ ## tc ## _record, "tc-dynamic: " #tc "\n"); \
     static void atfu_ ## tc ## _head(atf_tc_t *); \
     static void atfu_ ## tc ## _body(const atf_tc_t *); \
     static atf_tc_t atfu_ ## tc ## _tc; \
@@ -62,6 +81,7 @@
     }
 
 #define ATF_TC_WITH_CLEANUP(tc) \
+    ATFU_RECORD(atfu_ ## tc ## _record, "tc-dynamic: " #tc "\n"); \
     static void atfu_ ## tc ## _head(atf_tc_t *); \
     static void atfu_ ## tc ## _body(const atf_tc_t *); \
     static void atfu_ ## tc ## _cleanup(const atf_tc_t *); \
@@ -73,6 +93,74 @@
         .m_cleanup = atfu_ ## tc ## _cleanup, \
     }
 
+/*
+ * Test cases whose metadata is known at build time.  The metadata is a
+ * string literal with one "name: value" line per property, which is
+ * also recorded in the binary.
+ */
+#define ATF_TC_STATIC(tc, md) \
+    ATFU_RECORD(atfu_ ## tc ## _record, "tc: " #tc "\n" md); \
+    static void atfu_ ## tc ## _body(const atf_tc_t *); \
+    static void \
+    atfu_ ## tc ## _head(atf_tc_t *atfu_tc) \
+    { \
+        (void)atf_tc_set_md_text(atfu_tc, md); \
+    } \
+    static atf_tc_t atfu_ ## tc ## _tc; \
+    static atf_tc_pack_t atfu_ ## tc ## _tc_pack = { \
+        .m_ident = #tc, \
+        .m_head = atfu_ ## tc ## _head, \
+        .m_body = atfu_ ## tc ## _body, \
+        .m_cleanup = NULL, \
+    }
+
+#define ATF_TC_STATIC_WITH_CLEANUP(tc, md) \
+    ATFU_RECORD(atfu_ ## tc ## _record, \
+                "tc: " #tc "\nhas.cleanup: true\n" md); \
+    static void atfu_ ## tc ## _body(const atf_tc_t *); \
+    static void atfu_ ## tc ## _cleanup(const atf_tc_t *); \
+    static void \
+    atfu_ ## tc ## _head(atf_tc_t *atfu_tc) \
+    { \
+        (void)atf_tc_set_md_text(atfu_tc, md); \
+    } \
+    static atf_tc_t atfu_ ## tc ## _tc; \
+    static atf_tc_pack_t atfu_ ## tc ## _tc_pack = { \
+        .m_ident = #tc, \
+        .m_head = atfu_ ## tc ## _head, \
+        .m_body = atfu_ ## tc ## _body, \
+        .m_cleanup = atfu_ ## tc ## _cleanup, \
+    }
+
+/*
+ * Parametrized test cases, which become one test case per row of a table.
+ * The first member of the row type must be an atf_tc_row_t.
+ */
+#define ATFU_TC_PARAM(tc, row_type, rows, head) \
+    ATFU_RECORD(atfu_ ## tc ## _record, "tc-dynamic: " #tc "\n"); \
+    typedef row_type atfu_ ## tc ## _row_t; \
+    static void atfu_ ## tc ## _row_body(const atf_tc_t *, const row_type *); \
+    static void \
+    atfu_ ## tc ## _body(const atf_tc_t *atfu_tc) \
+    { \
+        atfu_ ## tc ## _row_body(atfu_tc, atf_tc_get_row(atfu_tc)); \
+    } \
+    static const row_type *const atfu_ ## tc ## _rows = (rows); \
+    static atf_tc_t atfu_ ## tc ## _tcs[sizeof(rows) / sizeof((rows)[0])]; \
+    static atf_tc_pack_t atfu_ ## tc ## _tc_pack = { \
+        .m_ident = #tc, \
+        .m_head = head, \
+        .m_body = atfu_ ## tc ## _body, \
+        .m_cleanup = NULL, \
+    }
+
+#define ATF_TC_PARAM_WITHOUT_HEAD(tc, row_type, rows) \
+    ATFU_TC_PARAM(tc, row_type, rows, NULL)
+
+#define ATF_TC_PARAM(tc, row_type, rows) \
+    static void atfu_ ## tc ## _head(atf_tc_t *); \
+    ATFU_TC_PARAM(tc, row_type, rows, atfu_ ## tc ## _head)
+
 #define ATF_TC_HEAD(tc, tcptr) \
     static \
     void \
@@ -97,7 +185,20 @@
 #define ATF_TC_CLEANUP_NAME(tc) \
     (atfu_ ## tc ## _cleanup)
 
+#define ATF_TC_PARAM_BODY(tc, tcptr, row) \
+    static \
+    void \
+    atfu_ ## tc ## _row_body(const atf_tc_t *tcptr ATF_DEFS_ATTRIBUTE_UNUSED, \
+                             const atfu_ ## tc ## _row_t *row)
+
+#define ATF_TP_FIXTURE(fixture, tpptr) \
+    static \
+    atf_error_t \
+    atfu_ ## fixture ## _fixture(const atf_tp_t *tpptr \
+                                 ATF_DEFS_ATTRIBUTE_UNUSED)
+
 #define ATF_TP_ADD_TCS(tps) \
+    ATFU_RECORD(atfu_tp_record, "tp: c\n"); \
     static atf_error_t atfu_tp_add_tcs(atf_tp_t *); \
     int atf_tp_main(int, char **, atf_error_t (*)(atf_tp_t *)); \
     \
@@ -112,6 +213,8 @@
 
 #define ATF_TP_ADD_TC(tp, tc) \
     do { \
+        ATFU_RECORD(atfu_add_record, "add: " \
+                    ATFU_STRINGIFY_VALUE(__LINE__) " " #tc "\n"); \
         atf_error_t atfu_err; \
         char **atfu_config = atf_tp_get_config(tp); \
         if (atfu_config == NULL) \
@@ -127,28 +230,61 @@
             return atfu_err; \
     } while (0)
 
+#define ATF_TP_ADD_TC_PARAM(tp, tc) \
+    do { \
+        ATFU_RECORD(atfu_add_record, "add: " \
+                    ATFU_STRINGIFY_VALUE(__LINE__) " " #tc "\n"); \
+        size_t atfu_i; \
+        for (atfu_i = 0; atfu_i < sizeof(atfu_ ## tc ## _tcs) / \
+                                  sizeof(atfu_ ## tc ## _tcs[0]); atfu_i++) { \
+            atf_error_t atfu_err; \
+            char **atfu_config = atf_tp_get_config(tp); \
+            if (atfu_config == NULL) \
+                return atf_no_memory_error(); \
+            atfu_err = atf_tc_init_row(&atfu_ ## tc ## _tcs[atfu_i], \
+                                       &atfu_ ## tc ## _tc_pack, \
+                                       (atf_tc_row_t *) \
+                                       &atfu_ ## tc ## _rows[atfu_i], \
+                                       (const char *const *)atfu_config); \
+            atf_utils_free_charpp(atfu_config); \
+            if (atf_is_error(atfu_err)) \
+                return atfu_err; \
+            atfu_err = atf_tp_add_tc(tp, &atfu_ ## tc ## _tcs[atfu_i]); \
+            if (atf_is_error(atfu_err)) \
+                return atfu_err; \
+        } \
+    } while (0)
+
+#define ATF_TP_ADD_FIXTURE(tp, fixture) \
+    atf_tp_set_fixture(tp, atfu_ ## fixture ## _fixture)
+
+/*
+ * The checks below only evaluate a predicted-not-taken condition; the
+ * messages are formatted by the out-of-line reporting functions, which
+ * are only called on failure.
+ */
 #define ATF_REQUIRE_MSG(expression, fmt, ...) \
     do { \
-        if (!(expression)) \
+        if (ATF_DEFS_UNLIKELY(!(expression))) \
             atf_tc_fail_requirement(__FILE__, __LINE__, fmt, ##__VA_ARGS__); \
     } while(0)
 
 #define ATF_CHECK_MSG(expression, fmt, ...) \
     do { \
-        if (!(expression)) \
+        if (ATF_DEFS_UNLIKELY(!(expression))) \
             atf_tc_fail_check(__FILE__, __LINE__, fmt, ##__VA_ARGS__); \
     } while(0)
 
 #define ATF_REQUIRE(expression) \
     do { \
-        if (!(expression)) \
+        if (ATF_DEFS_UNLIKELY(!(expression))) \
             atf_tc_fail_requirement(__FILE__, __LINE__, "%s", \
                                     #expression " not met"); \
     } while(0)
 
 #define ATF_CHECK(expression) \
     do { \
-        if (!(expression)) \
+        if (ATF_DEFS_UNLIKELY(!(expression))) \
             atf_tc_fail_check(__FILE__, __LINE__, "%s", \
                               #expression " not met"); \
     } while(0)
@@ -209,4 +345,26 @@
 #define ATF_REQUIRE_ERRNO(exp_errno, bool_expr) \
     atf_tc_require_errno(__FILE__, __LINE__, exp_errno, #bool_expr, bool_expr)
 
+/*
+ * Count the allocations made by the expression, which requires linking
+ * the test program with libatf-c-alloc or libatf-c++-alloc.
+ */
+#define ATF_CHECK_ALLOCS_LE(max, expression) \
+    do { \
+        atf_alloc_region_t atfu_region; \
+        atf_alloc_region_begin(&atfu_region); \
+        expression; \
+        atf_tc_check_allocs(__FILE__, __LINE__, max, #expression, \
+                            &atfu_region); \
+    } while (0)
+
+#define ATF_REQUIRE_ALLOCS_LE(max, expression) \
+    do { \
+        atf_alloc_region_t atfu_region; \
+        atf_alloc_region_begin(&atfu_region); \
+        expression; \
+        atf_tc_require_allocs(__FILE__, __LINE__, max, #expression, \
+                              &atfu_region); \
+    } while (0)
+
 #endif /* !defined(ATF_C_MACROS_H) */
@@ -230,6 +230,8 @@ H_REQUIRE_ERRNO(no_error, -1, errno_ok_stub() == -1);
 H_REQUIRE_ERRNO(errno_ok, 2, errno_fail_stub(2) == -1);
 H_REQUIRE_ERRNO(errno_fail, 3, errno_fail_stub(4) == -1);
 
+H_DEF(require_allocs_le, ATF_REQUIRE_ALLOCS_LE(1, (void)0));
+
 ATF_TC(check_errno);
 ATF_TC_HEAD(check_errno, tc)
 {
@@ -319,6 +321,25 @@ ATF_TC_BODY(require_errno, tc)
     }
 }
 
+ATF_TC(require_allocs_le);
+ATF_TC_HEAD(require_allocs_le, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that the ATF_REQUIRE_ALLOCS_LE "
+                      "macro fails if the allocations cannot be counted");
+}
+ATF_TC_BODY(require_allocs_le, tc)
+{
+    init_and_run_h_tc("h_require_allocs_le",
+                      ATF_TC_HEAD_NAME(h_require_allocs_le),
+                      ATF_TC_BODY_NAME(h_require_allocs_le));
+
+    ATF_REQUIRE(exists("before"));
+    ATF_REQUIRE(!exists("after"));
+    ATF_REQUIRE(atf_utils_grep_file("^failed: .*macros_test.c:[0-9]+: Cannot "
+        "count the allocations of \\(void\\)0; link the test program "
+        "with libatf-c-alloc or libatf-c\\+\\+-alloc$", "result"));
+}
+
 /* ---------------------------------------------------------------------
  * Test cases for the ATF_CHECK and ATF_CHECK_MSG macros.
  * --------------------------------------------------------------------- */
@@ -541,6 +562,59 @@ ATF_TC_BODY(check_match, tc)
     do_check_eq_tests(tests);
 }
 
+/* ---------------------------------------------------------------------
+ * Test cases for repeated failures of the ATF_CHECK macros.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_HEAD(h_check_repeated, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+}
+ATF_TC_BODY(h_check_repeated, tc)
+{
+    int i;
+
+    for (i = 0; i < 1000; i++)
+        ATF_CHECK_MSG(i < 0, "value %d", i % 5);
+    for (i = 0; i < 20; i++)
+        atf_tc_fail_nonfatal("Without a location");
+    ATF_CHECK_MSG(false, "Only once");
+}
+
+ATF_TC(check_repeated);
+ATF_TC_HEAD(check_repeated, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that repeated failures of the "
+                      "same check are only printed a few times and are "
+                      "summarized at the end");
+}
+ATF_TC_BODY(check_repeated, tc)
+{
+    init_and_run_h_tc("h_check_repeated", ATF_TC_HEAD_NAME(h_check_repeated),
+                      ATF_TC_BODY_NAME(h_check_repeated));
+
+    ATF_CHECK(atf_utils_grep_file("^failed: 1021 checks failed, 1000 not "
+        "shown; most frequent \\(1000 times\\): .*macros_test.c:[0-9]+: "
+        "value 0; see output for more details$", "result"));
+
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\* Check failed: .*: value 4$",
+                                  "error"));
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\* Check failed: Without a "
+                                  "location$", "error"));
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\* Check failed: .*: Only once$",
+                                  "error"));
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\* Not showing further "
+                                  "failures of this check$", "error"));
+
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\* Check at .*macros_test.c:"
+        "[0-9]+ failed 1000 times, 990 not shown; messages include:$",
+        "error"));
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\*     .*: value 2$", "error"));
+    ATF_CHECK(!atf_utils_grep_file("^\\*\\*\\*     .*: value 3$", "error"));
+    ATF_CHECK(atf_utils_grep_file("^\\*\\*\\* Check failed 20 times, 10 "
+        "not shown; messages include:$", "error"));
+}
+
 /* ---------------------------------------------------------------------
  * Test cases for the ATF_REQUIRE and ATF_REQUIRE_MSG macros.
  * --------------------------------------------------------------------- */
@@ -876,11 +950,13 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, check_streq);
     ATF_TP_ADD_TC(tp, check_errno);
     ATF_TP_ADD_TC(tp, check_match);
+    ATF_TP_ADD_TC(tp, check_repeated);
 
     ATF_TP_ADD_TC(tp, require);
     ATF_TP_ADD_TC(tp, require_eq);
     ATF_TP_ADD_TC(tp, require_streq);
     ATF_TP_ADD_TC(tp, require_errno);
+    ATF_TP_ADD_TC(tp, require_allocs_le);
     ATF_TP_ADD_TC(tp, require_match);
 
     ATF_TP_ADD_TC(tp, msg_embedded_fmt);
@@ -27,10 +27,12 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/uio.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -39,18 +41,40 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "atf-c/alloc.h"
 #include "atf-c/defs.h"
 #include "atf-c/detail/env.h"
 #include "atf-c/detail/fs.h"
 #include "atf-c/detail/map.h"
+#include "atf-c/detail/outbuf.h"
 #include "atf-c/detail/sanity.h"
 #include "atf-c/detail/text.h"
 #include "atf-c/error.h"
+#include "atf-c/utils.h"
 
 /* ---------------------------------------------------------------------
  * Auxiliary functions.
  * --------------------------------------------------------------------- */
 
+/* Number of failures of a single check that are printed as they happen,
+ * number of distinct messages kept for the summary of the ones that are
+ * not, and number of failures whose messages are looked at to find those.
+ * Checks without a location are told apart by their message, up to
+ * MAX_UNLOCATED_SITES distinct messages; the rest share a single site. */
+#define CHECK_REPORTS 10
+#define CHECK_SAMPLES 3
+#define CHECK_SAMPLED 1000
+#define MAX_UNLOCATED_SITES 64
+
+struct check_site {
+    const char *file;
+    size_t line;
+    char *message;
+    size_t count;
+    char *samples[CHECK_SAMPLES];
+    size_t nsamples;
+};
+
 enum expect_type {
     EXPECT_PASS,
     EXPECT_FAIL,
@@ -65,22 +89,45 @@ struct context {
     const char *resfile;
     size_t fail_count;
 
+    /* Non-fatal failures, aggregated by the check that raised them. */
+    struct check_site *sites;
+    size_t nsites;
+    size_t unlocated_sites;
+    size_t last_site;
+    size_t not_shown;
+
+    /* Set when running a row of a parametrized test case in the process of
+     * the caller, which regains control when the row finishes. */
+    bool in_process;
+    void (*stop)(void);
+    jmp_buf stop_jmp;
+    bool *failed;
+
     enum expect_type expect;
     atf_dynstr_t expect_reason;
     size_t expect_previous_fail_count;
     size_t expect_fail_count;
     int expect_exitcode;
     int expect_signo;
+
+    /* The allocations of the body, reported in the results file when the
+     * runtime engine asks for them through ATF_ALLOC_STATS. */
+    bool report_allocs;
+    atf_alloc_region_t allocs;
 };
 
 static void context_init(struct context *, const atf_tc_t *, const char *);
 static void check_fatal_error(atf_error_t);
 static void report_fatal_error(const char *, ...)
     ATF_DEFS_ATTRIBUTE_NORETURN;
-static atf_error_t write_resfile(const int, const char *, const int,
-                                 const atf_dynstr_t *);
-static void create_resfile(const char *, const char *, const int,
+static void check_running(const struct context *);
+static atf_error_t write_resfile(const int, const char *, const char *,
+                                 const int, const atf_dynstr_t *,
+                                 const atf_alloc_stats_t *);
+static void create_resfile(const struct context *, const char *, const int,
                            atf_dynstr_t *);
+static void finish(struct context *, const int)
+    ATF_DEFS_ATTRIBUTE_NORETURN;
 static void error_in_expect(struct context *, const char *, ...)
     ATF_DEFS_ATTRIBUTE_NORETURN;
 static void validate_expect(struct context *);
@@ -88,7 +135,8 @@ static void expected_failure(struct context *, atf_dynstr_t *)
     ATF_DEFS_ATTRIBUTE_NORETURN;
 static void fail_requirement(struct context *, atf_dynstr_t *)
     ATF_DEFS_ATTRIBUTE_NORETURN;
-static void fail_check(struct context *, atf_dynstr_t *);
+static void fail_check(struct context *, const char *, const size_t,
+                       atf_dynstr_t *);
 static void pass(struct context *)
     ATF_DEFS_ATTRIBUTE_NORETURN;
 static void skip(struct context *, atf_dynstr_t *)
@@ -98,10 +146,20 @@ static void format_reason_ap(atf_dynstr_t *, const char *, const size_t,
 static void format_reason_fmt(atf_dynstr_t *, const char *, const size_t,
                               const char *, ...);
 static void errno_test(struct context *, const char *, const size_t,
-                       const int, const char *, const bool,
-                       void (*)(struct context *, atf_dynstr_t *));
+                       const int, const char *, const bool, const bool);
+static void allocs_test(struct context *, const char *, const size_t,
+                        const size_t, const char *,
+                        const atf_alloc_region_t *, const bool);
 static atf_error_t check_prog_in_dir(const char *, void *);
+static atf_error_t find_prog_in_path(const char *, bool *);
 static atf_error_t check_prog(struct context *, const char *);
+static void check_requirements(struct context *);
+static struct check_site *find_site(struct context *, const char *,
+                                    const size_t, const char *);
+static void add_sample(struct check_site *, const char *);
+static bool count_quietly(struct context *, const char *, const size_t);
+static void count_failure(struct context *);
+static void report_sites(struct context *);
 
 static void
 context_init(struct context *ctx, const atf_tc_t *tc, const char *resfile)
@@ -109,12 +167,21 @@ context_init(struct context *ctx, const atf_tc_t *tc, const char *resfile)
     ctx->tc = tc;
     ctx->resfile = resfile;
     ctx->fail_count = 0;
+    ctx->sites = NULL;
+    ctx->nsites = 0;
+    ctx->unlocated_sites = 0;
+    ctx->last_site = 0;
+    ctx->not_shown = 0;
+    ctx->in_process = false;
+    ctx->stop = NULL;
+    ctx->failed = NULL;
     ctx->expect = EXPECT_PASS;
     check_fatal_error(atf_dynstr_init(&ctx->expect_reason));
     ctx->expect_previous_fail_count = 0;
     ctx->expect_fail_count = 0;
     ctx->expect_exitcode = 0;
     ctx->expect_signo = 0;
+    ctx->report_allocs = false;
 }
 
 static void
@@ -143,6 +210,159 @@ report_fatal_error(const char *msg, ...)
     abort();
 }
 
+/*
+ * Aborts if the body of a row run in the process of the caller carries on
+ * once its result has been written, which happens if it swallows the
+ * exception thrown by the stop hook.  Its context is gone by then.
+ */
+static void
+check_running(const struct context *ctx)
+{
+    if (ctx->in_process && ctx->tc == NULL)
+        report_fatal_error("A test case row continued after its result was "
+                           "written; its body must not swallow the exception "
+                           "that stops it");
+    PRE(ctx->tc != NULL);
+}
+
+/*
+ * Returns the site of the check at file:line or, for checks without a
+ * location, of the given message, creating it if needed.
+ */
+static struct check_site *
+find_site(struct context *ctx, const char *file, const size_t line,
+          const char *message)
+{
+    struct check_site *site;
+    size_t i;
+
+    if (ctx->nsites > 0) {
+        site = &ctx->sites[ctx->last_site];
+        if (file != NULL ? site->file != NULL && site->line == line &&
+                           (site->file == file ||
+                            strcmp(site->file, file) == 0)
+                         : site->file == NULL && site->message != NULL &&
+                           strcmp(site->message, message) == 0)
+            return site;
+    }
+
+    for (i = 0; i < ctx->nsites; i++) {
+        site = &ctx->sites[i];
+        if (file != NULL) {
+            if (site->file != NULL && site->line == line &&
+                strcmp(site->file, file) == 0)
+                break;
+        } else if (site->file == NULL) {
+            if (ctx->unlocated_sites >= MAX_UNLOCATED_SITES ?
+                site->message == NULL :
+                site->message != NULL && strcmp(site->message, message) == 0)
+                break;
+        }
+    }
+
+    if (i == ctx->nsites) {
+        site = realloc(ctx->sites, (ctx->nsites + 1) * sizeof(*site));
+        if (site == NULL)
+            check_fatal_error(atf_no_memory_error());
+        ctx->sites = site;
+        site = &ctx->sites[ctx->nsites++];
+        memset(site, 0, sizeof(*site));
+        site->file = file;
+        site->line = line;
+        if (file == NULL && ctx->unlocated_sites++ < MAX_UNLOCATED_SITES) {
+            site->message = strdup(message);
+            if (site->message == NULL)
+                check_fatal_error(atf_no_memory_error());
+        }
+    }
+    ctx->last_site = i;
+    return &ctx->sites[i];
+}
+
+static void
+add_sample(struct check_site *site, const char *message)
+{
+    size_t i;
+
+    for (i = 0; i < site->nsamples; i++)
+        if (strcmp(site->samples[i], message) == 0)
+            return;
+    if (site->nsamples < CHECK_SAMPLES) {
+        site->samples[site->nsamples] = strdup(message);
+        if (site->samples[site->nsamples] == NULL)
+            check_fatal_error(atf_no_memory_error());
+        site->nsamples++;
+    }
+}
+
+/*
+ * Counts a failure of the check at file:line without formatting its message
+ * if the check already reported as many failures as it prints and is done
+ * collecting messages.  Returns whether it did.
+ */
+static bool
+count_quietly(struct context *ctx, const char *file, const size_t line)
+{
+    struct check_site *site;
+
+    if (file == NULL ||
+        (ctx->expect != EXPECT_PASS && ctx->expect != EXPECT_FAIL))
+        return false;
+
+    site = find_site(ctx, file, line, NULL);
+    if (site->count < CHECK_REPORTS ||
+        (site->nsamples < CHECK_SAMPLES && site->count < CHECK_SAMPLED))
+        return false;
+
+    site->count++;
+    ctx->not_shown++;
+    count_failure(ctx);
+    return true;
+}
+
+static void
+count_failure(struct context *ctx)
+{
+    if (ctx->expect == EXPECT_FAIL)
+        ctx->expect_fail_count++;
+    else
+        ctx->fail_count++;
+}
+
+/*
+ * Prints a summary of the checks that failed more times than they reported
+ * and releases all sites.
+ */
+static void
+report_sites(struct context *ctx)
+{
+    size_t i, j;
+
+    for (i = 0; i < ctx->nsites; i++) {
+        struct check_site *site = &ctx->sites[i];
+
+        if (site->count > CHECK_REPORTS) {
+            if (site->file != NULL)
+                fprintf(stderr, "*** Check at %s:%zu failed %zu times, %zu "
+                        "not shown; messages include:\n", site->file,
+                        site->line, site->count, site->count - CHECK_REPORTS);
+            else
+                fprintf(stderr, "*** Check failed %zu times, %zu not shown; "
+                        "messages include:\n", site->count,
+                        site->count - CHECK_REPORTS);
+            for (j = 0; j < site->nsamples; j++)
+                fprintf(stderr, "***     %s\n", site->samples[j]);
+        }
+
+        for (j = 0; j < site->nsamples; j++)
+            free(site->samples[j]);
+        free(site->message);
+    }
+    free(ctx->sites);
+    ctx->sites = NULL;
+    ctx->nsites = 0;
+}
+
 /** Writes to a results file.
  *
  * The results file is supposed to be already open.
@@ -151,19 +371,28 @@ report_fatal_error(const char *msg, ...)
  * because the caller needs to clean up the reason object before terminating.
  */
 static atf_error_t
-write_resfile(const int fd, const char *result, const int arg,
-              const atf_dynstr_t *reason)
+write_resfile(const int fd, const char *prefix, const char *result,
+              const int arg, const atf_dynstr_t *reason,
+              const atf_alloc_stats_t *allocs)
 {
     static char NL[] = "\n", CS[] = ": ";
-    char buf[64];
+    char buf[64], allocsbuf[128];
     const char *r;
-    struct iovec iov[5];
+    struct iovec iov[8];
     ssize_t ret;
     int count = 0;
 
     INV(arg == -1 || reason != NULL);
 
 #define UNCONST(a) ((void *)(uintptr_t)(const void *)(a))
+    if (prefix != NULL) {
+        iov[count].iov_base = UNCONST(prefix);
+        iov[count++].iov_len = strlen(prefix);
+
+        iov[count].iov_base = CS;
+        iov[count++].iov_len = sizeof(CS) - 1;
+    }
+
     iov[count].iov_base = UNCONST(result);
     iov[count++].iov_len = strlen(result);
 
@@ -185,6 +414,13 @@ write_resfile(const int fd, const char *result, const int arg,
     iov[count].iov_base = NL;
     iov[count++].iov_len = sizeof(NL) - 1;
 
+    if (allocs != NULL) {
+        iov[count].iov_base = allocsbuf;
+        iov[count++].iov_len = snprintf(allocsbuf, sizeof(allocsbuf),
+            "allocations: %zu calls, %zu bytes, %zu bytes at peak\n",
+            allocs->m_count, allocs->m_bytes, allocs->m_peak);
+    }
+
     while ((ret = writev(fd, iov, count)) == -1 && errno == EINTR)
         continue; /* Retry. */
     if (ret != -1)
@@ -197,21 +433,38 @@ write_resfile(const int fd, const char *result, const int arg,
 
 /** Creates a results file.
  *
- * The input reason is released in all cases.
+ * The input reason is released in all cases.  The rows of a parametrized
+ * test case that run in the process of the caller share its standard
+ * output and error, so their results are prefixed by their name there.
+ * The allocations of the body, if requested, follow the result in a line
+ * of their own.
  *
  * An error in this function is considered to be fatal, hence why it does
  * not return any error code.
  */
 static void
-create_resfile(const char *resfile, const char *result, const int arg,
+create_resfile(const struct context *ctx, const char *result, const int arg,
                atf_dynstr_t *reason)
 {
+    const char *resfile = ctx->resfile;
+    const char *prefix = ctx->in_process ? atf_tc_get_ident(ctx->tc) : NULL;
+    atf_alloc_stats_t stats, *allocs = NULL;
     atf_error_t err;
 
+    if (ctx->in_process)
+        fflush(NULL);
+
+    if (ctx->report_allocs && atf_alloc_available()) {
+        atf_alloc_region_end(&ctx->allocs, &stats);
+        allocs = &stats;
+    }
+
     if (strcmp("/dev/stdout", resfile) == 0) {
-        err = write_resfile(STDOUT_FILENO, result, arg, reason);
+        err = write_resfile(STDOUT_FILENO, prefix, result, arg, reason,
+                            allocs);
     } else if (strcmp("/dev/stderr", resfile) == 0) {
-        err = write_resfile(STDERR_FILENO, result, arg, reason);
+        err = write_resfile(STDERR_FILENO, prefix, result, arg, reason,
+                            allocs);
     } else {
         const int fd = open(resfile, O_WRONLY | O_CREAT | O_TRUNC,
             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
@@ -219,7 +472,7 @@ create_resfile(const char *resfile, const char *result, const int arg,
             err = atf_libc_error(errno, "Cannot create results file '%s'",
                                  resfile);
         } else {
-            err = write_resfile(fd, result, arg, reason);
+            err = write_resfile(fd, NULL, result, arg, reason, allocs);
             close(fd);
         }
     }
@@ -230,6 +483,32 @@ create_resfile(const char *resfile, const char *result, const int arg,
     check_fatal_error(err);
 }
 
+/** Terminates the test case once its result has been written.
+ *
+ * Test cases normally own their process, so this exits it with the given
+ * status.  Rows run in the process of the caller record whether they
+ * failed and return control to it instead, either through the stop hook
+ * given by the caller or by jumping back into atf_tc_run_row.
+ */
+static void
+finish(struct context *ctx, const int status)
+{
+    check_running(ctx);
+    report_sites(ctx);
+
+    if (!ctx->in_process)
+        exit(status);
+
+    *ctx->failed = status != EXIT_SUCCESS;
+    atf_dynstr_fini(&ctx->expect_reason);
+    ctx->tc = NULL;
+    if (ctx->stop != NULL) {
+        ctx->stop();
+        report_fatal_error("Stop hook of a test case row returned");
+    }
+    longjmp(ctx->stop_jmp, 1);
+}
+
 /** Fails a test case if validate_expect fails. */
 static void
 error_in_expect(struct context *ctx, const char *fmt, ...)
@@ -281,8 +560,8 @@ expected_failure(struct context *ctx, atf_dynstr_t *reason)
 {
     check_fatal_error(atf_dynstr_prepend_fmt(reason, "%s: ",
         atf_dynstr_cstring(&ctx->expect_reason)));
-    create_resfile(ctx->resfile, "expected_failure", -1, reason);
-    exit(EXIT_SUCCESS);
+    create_resfile(ctx, "expected_failure", -1, reason);
+    finish(ctx, EXIT_SUCCESS);
 }
 
 static void
@@ -291,8 +570,8 @@ fail_requirement(struct context *ctx, atf_dynstr_t *reason)
     if (ctx->expect == EXPECT_FAIL) {
         expected_failure(ctx, reason);
     } else if (ctx->expect == EXPECT_PASS) {
-        create_resfile(ctx->resfile, "failed", -1, reason);
-        exit(EXIT_FAILURE);
+        create_resfile(ctx, "failed", -1, reason);
+        finish(ctx, EXIT_FAILURE);
     } else {
         error_in_expect(ctx, "Test case raised a failure but was not "
             "expecting one; reason was %s", atf_dynstr_cstring(reason));
@@ -300,21 +579,41 @@ fail_requirement(struct context *ctx, atf_dynstr_t *reason)
     UNREACHABLE;
 }
 
+/*
+ * Records a non-fatal failure.  Only the first CHECK_REPORTS failures of
+ * every check are printed; the others are counted and summarized once the
+ * test case finishes.
+ */
 static void
-fail_check(struct context *ctx, atf_dynstr_t *reason)
+fail_check(struct context *ctx, const char *file, const size_t line,
+           atf_dynstr_t *reason)
 {
-    if (ctx->expect == EXPECT_FAIL) {
+    struct check_site *site;
+
+    if (ctx->expect != EXPECT_FAIL && ctx->expect != EXPECT_PASS)
+        error_in_expect(ctx, "Test case raised a failure but was not "
+            "expecting one; reason was %s", atf_dynstr_cstring(reason));
+
+    site = find_site(ctx, file, line, atf_dynstr_cstring(reason));
+    site->count++;
+    add_sample(site, atf_dynstr_cstring(reason));
+
+    if (site->count > CHECK_REPORTS) {
+        ctx->not_shown++;
+    } else if (ctx->expect == EXPECT_FAIL) {
         fprintf(stderr, "*** Expected check failure: %s: %s\n",
             atf_dynstr_cstring(&ctx->expect_reason),
             atf_dynstr_cstring(reason));
-        ctx->expect_fail_count++;
-    } else if (ctx->expect == EXPECT_PASS) {
-        fprintf(stderr, "*** Check failed: %s\n", atf_dynstr_cstring(reason));
-        ctx->fail_count++;
+    } else if (ctx->in_process) {
+        fprintf(stderr, "*** Check failed in %s: %s\n",
+                atf_tc_get_ident(ctx->tc), atf_dynstr_cstring(reason));
     } else {
-        error_in_expect(ctx, "Test case raised a failure but was not "
-            "expecting one; reason was %s", atf_dynstr_cstring(reason));
+        fprintf(stderr, "*** Check failed: %s\n",
+                atf_dynstr_cstring(reason));
     }
+    if (site->count == CHECK_REPORTS)
+        fprintf(stderr, "*** Not showing further failures of this check\n");
+    count_failure(ctx);
 
     atf_dynstr_fini(reason);
 }
@@ -326,8 +625,8 @@ pass(struct context *ctx)
         error_in_expect(ctx, "Test case was expecting a failure but got "
             "a pass instead");
     } else if (ctx->expect == EXPECT_PASS) {
-        create_resfile(ctx->resfile, "passed", -1, NULL);
-        exit(EXIT_SUCCESS);
+        create_resfile(ctx, "passed", -1, NULL);
+        finish(ctx, EXIT_SUCCESS);
     } else {
         error_in_expect(ctx, "Test case asked to explicitly pass but was "
             "not expecting such condition");
@@ -339,8 +638,8 @@ static void
 skip(struct context *ctx, atf_dynstr_t *reason)
 {
     if (ctx->expect == EXPECT_PASS) {
-        create_resfile(ctx->resfile, "skipped", -1, reason);
-        exit(EXIT_SUCCESS);
+        create_resfile(ctx, "skipped", -1, reason);
+        finish(ctx, EXIT_SUCCESS);
     } else {
         error_in_expect(ctx, "Can only skip a test case when running in "
             "expect pass mode");
@@ -400,26 +699,56 @@ format_reason_fmt(atf_dynstr_t *out_reason,
 static void
 errno_test(struct context *ctx, const char *file, const size_t line,
            const int exp_errno, const char *expr_str,
-           const bool expr_result,
-           void (*fail_func)(struct context *, atf_dynstr_t *))
+           const bool expr_result, const bool fatal)
 {
     const int actual_errno = errno;
+    atf_dynstr_t reason;
 
-    if (expr_result) {
-        if (exp_errno != actual_errno) {
-            atf_dynstr_t reason;
-
-            format_reason_fmt(&reason, file, line, "Expected errno %d, got %d, "
-                "in %s", exp_errno, actual_errno, expr_str);
-            fail_func(ctx, &reason);
-        }
-    } else {
-        atf_dynstr_t reason;
+    if (expr_result && exp_errno == actual_errno)
+        return;
+    if (!fatal && count_quietly(ctx, file, line))
+        return;
 
+    if (expr_result)
+        format_reason_fmt(&reason, file, line, "Expected errno %d, got %d, "
+            "in %s", exp_errno, actual_errno, expr_str);
+    else
         format_reason_fmt(&reason, file, line, "Expected true value in %s",
             expr_str);
-        fail_func(ctx, &reason);
-    }
+
+    if (fatal)
+        fail_requirement(ctx, &reason);
+    else
+        fail_check(ctx, file, line, &reason);
+}
+
+static void
+allocs_test(struct context *ctx, const char *file, const size_t line,
+            const size_t max, const char *expr_str,
+            const atf_alloc_region_t *region, const bool fatal)
+{
+    atf_alloc_stats_t stats;
+    atf_dynstr_t reason;
+
+    atf_alloc_region_end(region, &stats);
+    if (atf_alloc_available() && stats.m_count <= max)
+        return;
+    if (!fatal && count_quietly(ctx, file, line))
+        return;
+
+    if (!atf_alloc_available())
+        format_reason_fmt(&reason, file, line, "Cannot count the "
+            "allocations of %s; link the test program with libatf-c-alloc "
+            "or libatf-c++-alloc", expr_str);
+    else
+        format_reason_fmt(&reason, file, line, "Expected at most %zu "
+            "allocations in %s, got %zu (%zu bytes, %zu bytes at peak)",
+            max, expr_str, stats.m_count, stats.m_bytes, stats.m_peak);
+
+    if (fatal)
+        fail_requirement(ctx, &reason);
+    else
+        fail_check(ctx, file, line, &reason);
 }
 
 struct prog_found_pair {
@@ -458,6 +787,25 @@ out_p:
     return err;
 }
 
+/*
+ * Looks for prog in the PATH by probing its directories one by one.  A
+ * test program only does a few of these lookups, so it does not pay off
+ * to index the PATH as atf_prog_cache_find does for long-lived callers.
+ */
+static atf_error_t
+find_prog_in_path(const char *prog, bool *found)
+{
+    struct prog_found_pair pf;
+    atf_error_t err;
+
+    pf.prog = prog;
+    pf.found = false;
+    err = atf_text_for_each_word(atf_env_get_with_default("PATH", ""), ":",
+                                 check_prog_in_dir, &pf);
+    *found = pf.found;
+    return err;
+}
+
 static atf_error_t
 check_prog(struct context *ctx, const char *prog)
 {
@@ -480,9 +828,8 @@ check_prog(struct context *ctx, const char *prog)
             skip(ctx, &reason);
         }
     } else {
-        const char *path = atf_env_get("PATH");
-        struct prog_found_pair pf;
         atf_fs_path_t bp;
+        bool found;
 
         err = atf_fs_path_branch_path(&p, &bp);
         if (atf_is_error(err))
@@ -497,13 +844,11 @@ check_prog(struct context *ctx, const char *prog)
             UNREACHABLE;
         }
 
-        pf.prog = prog;
-        pf.found = false;
-        err = atf_text_for_each_word(path, ":", check_prog_in_dir, &pf);
+        err = find_prog_in_path(prog, &found);
         if (atf_is_error(err))
             goto out_bp;
 
-        if (!pf.found) {
+        if (!found) {
             atf_dynstr_t reason;
 
             atf_fs_path_fini(&bp);
@@ -523,6 +868,191 @@ out:
     return err;
 }
 
+static char **
+get_list_md_var(const struct context *ctx, const char *name)
+{
+    atf_list_t words;
+    char **array;
+
+    check_fatal_error(atf_text_split(atf_tc_get_md_var(ctx->tc, name), " ",
+                                     &words));
+    array = atf_list_to_charpp(&words);
+    atf_list_fini(&words);
+    if (array == NULL)
+        check_fatal_error(atf_no_memory_error());
+    return array;
+}
+
+static int64_t
+get_size_md_var(const struct context *ctx, const char *name)
+{
+    atf_error_t err;
+    int64_t bytes;
+
+    err = atf_text_to_bytes(atf_tc_get_md_var(ctx->tc, name), &bytes);
+    if (atf_is_error(err)) {
+        char buf[1024];
+
+        atf_error_format(err, buf, sizeof(buf));
+        atf_error_free(err);
+        report_fatal_error("Invalid value for %s: %s", name, buf);
+    }
+    return bytes;
+}
+
+static bool
+get_physical_memory(int64_t *bytes)
+{
+#if defined(_SC_PHYS_PAGES)
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pagesize = sysconf(_SC_PAGESIZE);
+
+    if (pages == -1 || pagesize == -1)
+        return false;
+    *bytes = (int64_t)pages * pagesize;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool
+get_available_disk_space(int64_t *bytes)
+{
+    struct statvfs sv;
+
+    if (statvfs(".", &sv) == -1)
+        return false;
+    *bytes = (int64_t)sv.f_bavail * sv.f_frsize;
+    return true;
+}
+
+static void
+check_required_files(struct context *ctx)
+{
+    char **files, **file;
+
+    files = get_list_md_var(ctx, "require.files");
+    for (file = files; *file != NULL; file++) {
+        atf_dynstr_t reason;
+
+        if ((*file)[0] != '/')
+            format_reason_fmt(&reason, NULL, 0, "Relative path '%s' not "
+                "allowed in require.files", *file);
+        else if (access(*file, F_OK) == -1)
+            format_reason_fmt(&reason, NULL, 0, "Required file '%s' not "
+                "found", *file);
+        else
+            continue;
+
+        atf_utils_free_charpp(files);
+        skip(ctx, &reason);
+    }
+    atf_utils_free_charpp(files);
+}
+
+static void
+check_required_progs(struct context *ctx)
+{
+    atf_dynstr_t reason;
+    char **progs, **prog;
+
+    progs = get_list_md_var(ctx, "require.progs");
+    for (prog = progs; *prog != NULL; prog++) {
+        if ((*prog)[0] != '/' && strchr(*prog, '/') != NULL) {
+            format_reason_fmt(&reason, NULL, 0, "Relative path '%s' not "
+                "allowed in require.progs", *prog);
+            atf_utils_free_charpp(progs);
+            skip(ctx, &reason);
+        }
+    }
+
+    for (prog = progs; *prog != NULL; prog++) {
+        bool found;
+
+        if ((*prog)[0] == '/') {
+            atf_fs_path_t p;
+            atf_error_t err;
+
+            check_fatal_error(atf_fs_path_init_fmt(&p, "%s", *prog));
+            err = atf_fs_eaccess(&p, atf_fs_access_x);
+            atf_fs_path_fini(&p);
+            found = !atf_is_error(err);
+            if (!found)
+                atf_error_free(err);
+        } else
+            check_fatal_error(find_prog_in_path(*prog, &found));
+
+        if (!found) {
+            if ((*prog)[0] == '/')
+                format_reason_fmt(&reason, NULL, 0, "Required program '%s' "
+                    "not found", *prog);
+            else
+                format_reason_fmt(&reason, NULL, 0, "Required program '%s' "
+                    "not found in the PATH", *prog);
+            atf_utils_free_charpp(progs);
+            skip(ctx, &reason);
+        }
+    }
+    atf_utils_free_charpp(progs);
+}
+
+static void
+check_required_memory(struct context *ctx)
+{
+    const int64_t needed = get_size_md_var(ctx, "require.memory");
+    int64_t available;
+
+    if (get_physical_memory(&available) && available < needed) {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, NULL, 0, "Requires %lld bytes of physical "
+            "memory but only %lld are available", (long long)needed,
+            (long long)available);
+        skip(ctx, &reason);
+    }
+}
+
+static void
+check_required_disk_space(struct context *ctx)
+{
+    const int64_t needed = get_size_md_var(ctx, "require.diskspace");
+    int64_t available;
+
+    if (get_available_disk_space(&available) && available < needed) {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, NULL, 0, "Requires %lld bytes of free disk "
+            "space but only %lld are available", (long long)needed,
+            (long long)available);
+        skip(ctx, &reason);
+    }
+}
+
+/*
+ * Skips the test case if the machine does not provide what its require.*
+ * properties ask for, so that a test case that cannot succeed does not
+ * start when its test program is run on its own or by a runner that does
+ * not check them.  atf-run already checks require.files and require.progs
+ * before it starts a test case, so these are not checked again under it.
+ */
+static void
+check_requirements(struct context *ctx)
+{
+    const bool inside_atf_run = atf_env_has("__RUNNING_INSIDE_ATF_RUN") &&
+        strcmp(atf_env_get("__RUNNING_INSIDE_ATF_RUN"),
+               "internal-yes-value") == 0;
+
+    if (!inside_atf_run && atf_tc_has_md_var(ctx->tc, "require.files"))
+        check_required_files(ctx);
+    if (!inside_atf_run && atf_tc_has_md_var(ctx->tc, "require.progs"))
+        check_required_progs(ctx);
+    if (atf_tc_has_md_var(ctx->tc, "require.memory"))
+        check_required_memory(ctx);
+    if (atf_tc_has_md_var(ctx->tc, "require.diskspace"))
+        check_required_disk_space(ctx);
+}
+
 /* ---------------------------------------------------------------------
  * The "atf_tc" type.
  * --------------------------------------------------------------------- */
@@ -530,6 +1060,12 @@ out:
 struct atf_tc_impl {
     const char *m_ident;
 
+    /* Only set for the rows of parametrized test cases, which own their
+     * identifier. */
+    const char *m_table;
+    const void *m_row;
+    char *m_row_ident;
+
     atf_map_t m_vars;
     atf_map_t m_config;
 
@@ -556,6 +1092,9 @@ atf_tc_init(atf_tc_t *tc, const char *ident, atf_tc_head_t head,
     }
 
     tc->pimpl->m_ident = ident;
+    tc->pimpl->m_table = NULL;
+    tc->pimpl->m_row = NULL;
+    tc->pimpl->m_row_ident = NULL;
     tc->pimpl->m_head = head;
     tc->pimpl->m_body = body;
     tc->pimpl->m_cleanup = cleanup;
@@ -607,10 +1146,54 @@ atf_tc_init_pack(atf_tc_t *tc, const atf_tc_pack_t *pack,
                        pack->m_cleanup, config);
 }
 
+/*
+ * Initializes the test case for one row of a parametrized test case.  The
+ * test case is named after the pack and the row, separated by a slash, and
+ * the metadata of the row is applied after the head of the pack.
+ */
+atf_error_t
+atf_tc_init_row(atf_tc_t *tc, const atf_tc_pack_t *pack,
+                const atf_tc_row_t *row, const char *const *config)
+{
+    atf_error_t err;
+    char *ident;
+
+    PRE(pack->m_cleanup == NULL);
+
+    if (row->m_id == NULL || row->m_id[0] == '\0' ||
+        strpbrk(row->m_id, "/:") != NULL)
+        return atf_libc_error(EINVAL, "Invalid row `%s' in test case %s; "
+                              "must be non-empty and not contain / nor :",
+                              row->m_id == NULL ? "" : row->m_id,
+                              pack->m_ident);
+
+    err = atf_text_format(&ident, "%s/%s", pack->m_ident, row->m_id);
+    if (atf_is_error(err))
+        return err;
+
+    err = atf_tc_init(tc, ident, pack->m_head, pack->m_body, NULL, config);
+    if (atf_is_error(err)) {
+        free(ident);
+        return err;
+    }
+    tc->pimpl->m_table = pack->m_ident;
+    tc->pimpl->m_row = row;
+    tc->pimpl->m_row_ident = ident;
+
+    if (row->m_md != NULL) {
+        err = atf_tc_set_md_text(tc, row->m_md);
+        if (atf_is_error(err))
+            atf_tc_fini(tc);
+    }
+
+    return err;
+}
+
 void
 atf_tc_fini(atf_tc_t *tc)
 {
     atf_map_fini(&tc->pimpl->m_vars);
+    free(tc->pimpl->m_row_ident);
     free(tc->pimpl);
 }
 
@@ -736,6 +1319,23 @@ atf_tc_get_md_vars(const atf_tc_t *tc)
     return atf_map_to_charpp(&tc->pimpl->m_vars);
 }
 
+const void *
+atf_tc_get_row(const atf_tc_t *tc)
+{
+    PRE(tc->pimpl->m_table != NULL);
+    return tc->pimpl->m_row;
+}
+
+/*
+ * Returns the name of the parametrized test case to which the test case
+ * belongs as a row, or NULL if it is not a row.
+ */
+const char *
+atf_tc_get_table(const atf_tc_t *tc)
+{
+    return tc->pimpl->m_table;
+}
+
 bool
 atf_tc_has_config_var(const atf_tc_t *tc, const char *name)
 {
@@ -779,6 +1379,47 @@ atf_tc_set_md_var(atf_tc_t *tc, const char *name, const char *fmt, ...)
     return err;
 }
 
+/*
+ * Sets the properties given as "name: value" lines, which is the format
+ * of the metadata of the ATF_TC_STATIC macros.  Empty lines are ignored.
+ */
+atf_error_t
+atf_tc_set_md_text(atf_tc_t *tc, const char *text)
+{
+    atf_error_t err;
+    const char *line;
+
+    err = atf_no_error();
+    line = text;
+    while (!atf_is_error(err) && *line != '\0') {
+        const char *end = strchr(line, '\n');
+        const size_t len = end == NULL ? strlen(line) : (size_t)(end - line);
+        char *copy, *sep;
+
+        if (len > 0) {
+            copy = malloc(len + 1);
+            if (copy == NULL)
+                return atf_no_memory_error();
+            memcpy(copy, line, len);
+            copy[len] = '\0';
+
+            sep = strstr(copy, ": ");
+            if (sep == NULL || sep == copy)
+                err = atf_libc_error(EINVAL, "Invalid metadata line `%s'",
+                                     copy);
+            else {
+                *sep = '\0';
+                err = atf_tc_set_md_var(tc, copy, "%s", sep + 2);
+            }
+            free(copy);
+        }
+
+        line = end == NULL ? line + len : end + 1;
+    }
+
+    return err;
+}
+
 /* ---------------------------------------------------------------------
  * Free functions, as they should be publicly but they can't.
  * --------------------------------------------------------------------- */
@@ -798,6 +1439,10 @@ static void _atf_tc_check_errno(struct context *, const char *, const size_t,
     const int, const char *, const bool);
 static void _atf_tc_require_errno(struct context *, const char *, const size_t,
     const int, const char *, const bool);
+static void _atf_tc_check_allocs(struct context *, const char *, const size_t,
+    const size_t, const char *, const atf_alloc_region_t *);
+static void _atf_tc_require_allocs(struct context *, const char *,
+    const size_t, const size_t, const char *, const atf_alloc_region_t *);
 static void _atf_tc_expect_pass(struct context *);
 static void _atf_tc_expect_fail(struct context *, const char *, va_list);
 static void _atf_tc_expect_exit(struct context *, const int, const char *,
@@ -831,7 +1476,7 @@ _atf_tc_fail_nonfatal(struct context *ctx, const char *fmt, va_list ap)
     format_reason_ap(&reason, NULL, 0, fmt, ap2);
     va_end(ap2);
 
-    fail_check(ctx, &reason);
+    fail_check(ctx, NULL, 0, &reason);
 }
 
 static void
@@ -841,11 +1486,14 @@ _atf_tc_fail_check(struct context *ctx, const char *file, const size_t line,
     va_list ap2;
     atf_dynstr_t reason;
 
+    if (count_quietly(ctx, file, line))
+        return;
+
     va_copy(ap2, ap);
     format_reason_ap(&reason, file, line, fmt, ap2);
     va_end(ap2);
 
-    fail_check(ctx, &reason);
+    fail_check(ctx, file, line, &reason);
 }
 
 static void
@@ -894,7 +1542,7 @@ _atf_tc_check_errno(struct context *ctx, const char *file, const size_t line,
                     const int exp_errno, const char *expr_str,
                     const bool expr_result)
 {
-    errno_test(ctx, file, line, exp_errno, expr_str, expr_result, fail_check);
+    errno_test(ctx, file, line, exp_errno, expr_str, expr_result, false);
 }
 
 static void
@@ -902,8 +1550,23 @@ _atf_tc_require_errno(struct context *ctx, const char *file, const size_t line,
                       const int exp_errno, const char *expr_str,
                       const bool expr_result)
 {
-    errno_test(ctx, file, line, exp_errno, expr_str, expr_result,
-        fail_requirement);
+    errno_test(ctx, file, line, exp_errno, expr_str, expr_result, true);
+}
+
+static void
+_atf_tc_check_allocs(struct context *ctx, const char *file, const size_t line,
+                     const size_t max, const char *expr_str,
+                     const atf_alloc_region_t *region)
+{
+    allocs_test(ctx, file, line, max, expr_str, region, false);
+}
+
+static void
+_atf_tc_require_allocs(struct context *ctx, const char *file,
+                       const size_t line, const size_t max,
+                       const char *expr_str, const atf_alloc_region_t *region)
+{
+    allocs_test(ctx, file, line, max, expr_str, region, true);
 }
 
 static void
@@ -943,7 +1606,7 @@ _atf_tc_expect_exit(struct context *ctx, const int exitcode, const char *reason,
     check_fatal_error(atf_dynstr_init_ap(&formatted, reason, ap2));
     va_end(ap2);
 
-    create_resfile(ctx->resfile, "expected_exit", exitcode, &formatted);
+    create_resfile(ctx, "expected_exit", exitcode, &formatted);
 }
 
 static void
@@ -960,7 +1623,7 @@ _atf_tc_expect_signal(struct context *ctx, const int signo, const char *reason,
     check_fatal_error(atf_dynstr_init_ap(&formatted, reason, ap2));
     va_end(ap2);
 
-    create_resfile(ctx->resfile, "expected_signal", signo, &formatted);
+    create_resfile(ctx, "expected_signal", signo, &formatted);
 }
 
 static void
@@ -976,7 +1639,7 @@ _atf_tc_expect_death(struct context *ctx, const char *reason, va_list ap)
     check_fatal_error(atf_dynstr_init_ap(&formatted, reason, ap2));
     va_end(ap2);
 
-    create_resfile(ctx->resfile, "expected_death", -1, &formatted);
+    create_resfile(ctx, "expected_death", -1, &formatted);
 }
 
 static void
@@ -992,7 +1655,7 @@ _atf_tc_expect_timeout(struct context *ctx, const char *reason, va_list ap)
     check_fatal_error(atf_dynstr_init_ap(&formatted, reason, ap2));
     va_end(ap2);
 
-    create_resfile(ctx->resfile, "expected_timeout", -1, &formatted);
+    create_resfile(ctx, "expected_timeout", -1, &formatted);
 }
 
 /* ---------------------------------------------------------------------
@@ -1001,31 +1664,99 @@ _atf_tc_expect_timeout(struct context *ctx, const char *reason, va_list ap)
 
 static struct context Current;
 
-atf_error_t
-atf_tc_run(const atf_tc_t *tc, const char *resfile)
+/*
+ * Formats the reason of a test case whose checks failed, adding the number
+ * of failures that were not printed and the check that failed most often
+ * if any was cut short.
+ */
+static void
+format_checks_reason(atf_dynstr_t *reason, const struct context *ctx,
+                     const size_t count, const char *what)
 {
-    context_init(&Current, tc, resfile);
+    const struct check_site *top;
+    size_t i;
+
+    if (ctx->not_shown == 0) {
+        format_reason_fmt(reason, NULL, 0, "%zu checks %s; see output for "
+            "more details", count, what);
+        return;
+    }
 
-    tc->pimpl->m_body(tc);
+    top = &ctx->sites[0];
+    for (i = 1; i < ctx->nsites; i++)
+        if (ctx->sites[i].count > top->count)
+            top = &ctx->sites[i];
+    format_reason_fmt(reason, NULL, 0, "%zu checks %s, %zu not shown; most "
+        "frequent (%zu times): %s; see output for more details", count, what,
+        ctx->not_shown, top->count, top->samples[0]);
+}
 
-    validate_expect(&Current);
+static void run_body(struct context *) ATF_DEFS_ATTRIBUTE_NORETURN;
 
-    if (Current.fail_count > 0) {
+static void
+run_body(struct context *ctx)
+{
+    check_requirements(ctx);
+
+    if (!ctx->in_process && atf_env_has("ATF_ALLOC_STATS"))
+        ctx->report_allocs = atf_env_get("ATF_ALLOC_STATS")[0] != '\0';
+    atf_alloc_region_begin(&ctx->allocs);
+
+    ctx->tc->pimpl->m_body(ctx->tc);
+
+    validate_expect(ctx);
+
+    if (ctx->fail_count > 0) {
         atf_dynstr_t reason;
 
-        format_reason_fmt(&reason, NULL, 0, "%d checks failed; see output for "
-            "more details", Current.fail_count);
-        fail_requirement(&Current, &reason);
-    } else if (Current.expect_fail_count > 0) {
+        format_checks_reason(&reason, ctx, ctx->fail_count, "failed");
+        fail_requirement(ctx, &reason);
+    } else if (ctx->expect_fail_count > 0) {
         atf_dynstr_t reason;
 
-        format_reason_fmt(&reason, NULL, 0, "%d checks failed as expected; "
-            "see output for more details", Current.expect_fail_count);
-        expected_failure(&Current, &reason);
+        format_checks_reason(&reason, ctx, ctx->expect_fail_count,
+                             "failed as expected");
+        expected_failure(ctx, &reason);
     } else {
-        pass(&Current);
+        pass(ctx);
     }
     UNREACHABLE;
+}
+
+atf_error_t
+atf_tc_run(const atf_tc_t *tc, const char *resfile)
+{
+    atf_outbuf_capture(atf_tc_get_ident(tc), resfile);
+    context_init(&Current, tc, resfile);
+
+    run_body(&Current);
+    UNREACHABLE;
+    return atf_no_error();
+}
+
+/*
+ * Runs the body of a row of a parametrized test case without giving it the
+ * process, so that the caller can run the next rows once it finishes.
+ * Sets failed to whether the row failed.
+ *
+ * Once the result of the row is written, the stop hook is called if given;
+ * it must not return, which leaves throwing an exception as its only use.
+ * Otherwise, this function returns.  Either way, rows that exit, crash or
+ * expect to do so take the caller down with them.
+ */
+atf_error_t
+atf_tc_run_row(const atf_tc_t *tc, const char *resfile, void (*stop)(void),
+               bool *failed)
+{
+    PRE(tc->pimpl->m_table != NULL);
+
+    context_init(&Current, tc, resfile);
+    Current.in_process = true;
+    Current.stop = stop;
+    Current.failed = failed;
+
+    if (setjmp(Current.stop_jmp) == 0)
+        run_body(&Current);
     return atf_no_error();
 }
 
@@ -1057,7 +1788,7 @@ atf_tc_fail(const char *fmt, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, fmt);
     _atf_tc_fail(&Current, fmt, ap);
@@ -1069,7 +1800,7 @@ atf_tc_fail_nonfatal(const char *fmt, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, fmt);
     _atf_tc_fail_nonfatal(&Current, fmt, ap);
@@ -1081,7 +1812,7 @@ atf_tc_fail_check(const char *file, const size_t line, const char *fmt, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, fmt);
     _atf_tc_fail_check(&Current, file, line, fmt, ap);
@@ -1094,7 +1825,7 @@ atf_tc_fail_requirement(const char *file, const size_t line,
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, fmt);
     _atf_tc_fail_requirement(&Current, file, line, fmt, ap);
@@ -1104,7 +1835,7 @@ atf_tc_fail_requirement(const char *file, const size_t line,
 void
 atf_tc_pass(void)
 {
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     _atf_tc_pass(&Current);
 }
@@ -1112,7 +1843,7 @@ atf_tc_pass(void)
 void
 atf_tc_require_prog(const char *prog)
 {
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     _atf_tc_require_prog(&Current, prog);
 }
@@ -1122,7 +1853,7 @@ atf_tc_skip(const char *fmt, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, fmt);
     _atf_tc_skip(&Current, fmt, ap);
@@ -1133,7 +1864,7 @@ void
 atf_tc_check_errno(const char *file, const size_t line, const int exp_errno,
                    const char *expr_str, const bool expr_result)
 {
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     _atf_tc_check_errno(&Current, file, line, exp_errno, expr_str,
                         expr_result);
@@ -1143,16 +1874,34 @@ void
 atf_tc_require_errno(const char *file, const size_t line, const int exp_errno,
                      const char *expr_str, const bool expr_result)
 {
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     _atf_tc_require_errno(&Current, file, line, exp_errno, expr_str,
                           expr_result);
 }
 
+void
+atf_tc_check_allocs(const char *file, const size_t line, const size_t max,
+                    const char *expr_str, const atf_alloc_region_t *region)
+{
+    check_running(&Current);
+
+    _atf_tc_check_allocs(&Current, file, line, max, expr_str, region);
+}
+
+void
+atf_tc_require_allocs(const char *file, const size_t line, const size_t max,
+                      const char *expr_str, const atf_alloc_region_t *region)
+{
+    check_running(&Current);
+
+    _atf_tc_require_allocs(&Current, file, line, max, expr_str, region);
+}
+
 void
 atf_tc_expect_pass(void)
 {
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     _atf_tc_expect_pass(&Current);
 }
@@ -1162,7 +1911,7 @@ atf_tc_expect_fail(const char *reason, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, reason);
     _atf_tc_expect_fail(&Current, reason, ap);
@@ -1174,7 +1923,7 @@ atf_tc_expect_exit(const int exitcode, const char *reason, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, reason);
     _atf_tc_expect_exit(&Current, exitcode, reason, ap);
@@ -1186,7 +1935,7 @@ atf_tc_expect_signal(const int signo, const char *reason, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, reason);
     _atf_tc_expect_signal(&Current, signo, reason, ap);
@@ -1198,7 +1947,7 @@ atf_tc_expect_death(const char *reason, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, reason);
     _atf_tc_expect_death(&Current, reason, ap);
@@ -1210,7 +1959,7 @@ atf_tc_expect_timeout(const char *reason, ...)
 {
     va_list ap;
 
-    PRE(Current.tc != NULL);
+    check_running(&Current);
 
     va_start(ap, reason);
     _atf_tc_expect_timeout(&Current, reason, ap);
@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include <atf-c/alloc.h>
 #include <atf-c/defs.h>
 #include <atf-c/error_fwd.h>
 
@@ -54,6 +55,18 @@ struct atf_tc_pack {
 };
 typedef const struct atf_tc_pack atf_tc_pack_t;
 
+/* ---------------------------------------------------------------------
+ * The "atf_tc_row" type.
+ * --------------------------------------------------------------------- */
+
+/* For static initialization only; the first member of the rows of a
+ * parametrized test case. */
+struct atf_tc_row {
+    const char *m_id;
+    const char *m_md;
+};
+typedef const struct atf_tc_row atf_tc_row_t;
+
 /* ---------------------------------------------------------------------
  * The "atf_tc" type.
  * --------------------------------------------------------------------- */
@@ -70,6 +83,8 @@ atf_error_t atf_tc_init(atf_tc_t *, const char *, atf_tc_head_t,
                         const char *const *);
 atf_error_t atf_tc_init_pack(atf_tc_t *, atf_tc_pack_t *,
                              const char *const *);
+atf_error_t atf_tc_init_row(atf_tc_t *, atf_tc_pack_t *, atf_tc_row_t *,
+                            const char *const *);
 void atf_tc_fini(atf_tc_t *);
 
 /* Getters. */
@@ -85,11 +100,14 @@ long atf_tc_get_config_var_as_long_wd(const atf_tc_t *, const char *,
                                       const long);
 const char *atf_tc_get_md_var(const atf_tc_t *, const char *);
 char **atf_tc_get_md_vars(const atf_tc_t *);
+const void *atf_tc_get_row(const atf_tc_t *);
+const char *atf_tc_get_table(const atf_tc_t *);
 bool atf_tc_has_config_var(const atf_tc_t *, const char *);
 bool atf_tc_has_md_var(const atf_tc_t *, const char *);
 
 /* Modifiers. */
 atf_error_t atf_tc_set_md_var(atf_tc_t *, const char *, const char *, ...);
+atf_error_t atf_tc_set_md_text(atf_tc_t *, const char *);
 
 /* ---------------------------------------------------------------------
  * Free functions.
@@ -97,6 +115,8 @@ atf_error_t atf_tc_set_md_var(atf_tc_t *, const char *, const char *, ...);
 
 atf_error_t atf_tc_run(const atf_tc_t *, const char *);
 atf_error_t atf_tc_cleanup(const atf_tc_t *);
+atf_error_t atf_tc_run_row(const atf_tc_t *, const char *, void (*)(void),
+                           bool *);
 
 /* To be run from test case bodies only. */
 void atf_tc_fail(const char *, ...)
@@ -124,13 +144,19 @@ void atf_tc_expect_timeout(const char *, ...)
 
 /* To be run from test case bodies only; internal to macros.h. */
 void atf_tc_fail_check(const char *, const size_t, const char *, ...)
+    ATF_DEFS_ATTRIBUTE_COLD
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(3, 4);
 void atf_tc_fail_requirement(const char *, const size_t, const char *, ...)
+    ATF_DEFS_ATTRIBUTE_COLD
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(3, 4)
     ATF_DEFS_ATTRIBUTE_NORETURN;
 void atf_tc_check_errno(const char *, const size_t, const int,
                         const char *, const bool);
 void atf_tc_require_errno(const char *, const size_t, const int,
                           const char *, const bool);
+void atf_tc_check_allocs(const char *, const size_t, const size_t,
+                         const char *, const atf_alloc_region_t *);
+void atf_tc_require_allocs(const char *, const size_t, const size_t,
+                           const char *, const atf_alloc_region_t *);
 
 #endif /* !defined(ATF_C_TC_H) */
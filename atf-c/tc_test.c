@@ -25,12 +25,14 @@
 
 #include "atf-c/tc.h"
 
+#include <errno.h>
 #include <stdbool.h>
 #include <string.h>
 
 #include <atf-c.h>
 
 #include "atf-c/detail/test_helpers.h"
+#include "atf-c/error.h"
 
 /* ---------------------------------------------------------------------
  * Auxiliary test cases.
@@ -107,6 +109,54 @@ ATF_TC_BODY(init_pack, tcin)
     atf_tc_fini(&tc);
 }
 
+ATF_TC(init_row);
+ATF_TC_HEAD(init_row, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_tc_init_row function");
+}
+ATF_TC_BODY(init_row, tcin)
+{
+    atf_tc_t tc;
+    atf_tc_pack_t tcp = {
+        .m_ident = "table",
+        .m_head = ATF_TC_HEAD_NAME(test_var),
+        .m_body = ATF_TC_BODY_NAME(empty),
+        .m_cleanup = NULL,
+    };
+    atf_tc_row_t plain = { "plain", NULL };
+    atf_tc_row_t custom = { "custom", "descr: Row description\n"
+                                      "test-var: row-value\n" };
+    atf_tc_row_t invalid[] = { { "", NULL }, { "a/b", NULL },
+                               { "a:b", NULL } };
+    size_t i;
+
+    RE(atf_tc_init(&tc, "test1", ATF_TC_HEAD_NAME(empty),
+                   ATF_TC_BODY_NAME(empty), NULL, NULL));
+    ATF_REQUIRE(atf_tc_get_table(&tc) == NULL);
+    atf_tc_fini(&tc);
+
+    RE(atf_tc_init_row(&tc, &tcp, &plain, NULL));
+    ATF_REQUIRE_STREQ("table/plain", atf_tc_get_ident(&tc));
+    ATF_REQUIRE_STREQ("table", atf_tc_get_table(&tc));
+    ATF_REQUIRE(atf_tc_get_row(&tc) == &plain);
+    ATF_REQUIRE_STREQ("Test text", atf_tc_get_md_var(&tc, "test-var"));
+    atf_tc_fini(&tc);
+
+    RE(atf_tc_init_row(&tc, &tcp, &custom, NULL));
+    ATF_REQUIRE_STREQ("table/custom", atf_tc_get_ident(&tc));
+    ATF_REQUIRE_STREQ("Row description", atf_tc_get_md_var(&tc, "descr"));
+    ATF_REQUIRE_STREQ("row-value", atf_tc_get_md_var(&tc, "test-var"));
+    atf_tc_fini(&tc);
+
+    for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        atf_error_t err = atf_tc_init_row(&tc, &tcp, &invalid[i], NULL);
+        ATF_REQUIRE(atf_is_error(err));
+        ATF_REQUIRE(atf_error_is(err, "libc"));
+        ATF_REQUIRE_EQ(EINVAL, atf_libc_error_code(err));
+        atf_error_free(err);
+    }
+}
+
 ATF_TC(vars);
 ATF_TC_HEAD(vars, tc)
 {
@@ -126,6 +176,32 @@ ATF_TC_BODY(vars, tcin)
     atf_tc_fini(&tc);
 }
 
+ATF_TC(md_text);
+ATF_TC_HEAD(md_text, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_tc_set_md_text function");
+}
+ATF_TC_BODY(md_text, tcin)
+{
+    atf_tc_t tc;
+    atf_error_t err;
+
+    RE(atf_tc_init(&tc, "test1", ATF_TC_HEAD_NAME(empty),
+                   ATF_TC_BODY_NAME(empty), NULL, NULL));
+    RE(atf_tc_set_md_text(&tc, "descr: A: B %s\n\nX-empty: \n"
+                          "timeout: 10"));
+    ATF_REQUIRE_STREQ("A: B %s", atf_tc_get_md_var(&tc, "descr"));
+    ATF_REQUIRE_STREQ("", atf_tc_get_md_var(&tc, "X-empty"));
+    ATF_REQUIRE_STREQ("10", atf_tc_get_md_var(&tc, "timeout"));
+
+    err = atf_tc_set_md_text(&tc, "timeout: 20\nbogus\n");
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+    ATF_REQUIRE_STREQ("20", atf_tc_get_md_var(&tc, "timeout"));
+    atf_tc_fini(&tc);
+}
+
 ATF_TC(config);
 ATF_TC_HEAD(config, tc)
 {
@@ -173,7 +249,9 @@ ATF_TP_ADD_TCS(tp)
     /* Add the test cases for the "atf_tcr_t" type. */
     ATF_TP_ADD_TC(tp, init);
     ATF_TP_ADD_TC(tp, init_pack);
+    ATF_TP_ADD_TC(tp, init_row);
     ATF_TP_ADD_TC(tp, vars);
+    ATF_TP_ADD_TC(tp, md_text);
     ATF_TP_ADD_TC(tp, config);
 
     /* Add the test cases for the free functions. */
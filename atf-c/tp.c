@@ -39,6 +39,7 @@
 struct atf_tp_impl {
     atf_list_t m_tcs;
     atf_map_t m_config;
+    atf_tp_fixture_t m_fixture;
 };
 
 /* ---------------------------------------------------------------------
@@ -93,6 +94,8 @@ atf_tp_init(atf_tp_t *tp, const char *const *config)
         goto out;
     }
 
+    tp->pimpl->m_fixture = NULL;
+
     INV(!atf_is_error(err));
 out:
     return err;
@@ -124,6 +127,28 @@ atf_tp_get_config(const atf_tp_t *tp)
     return atf_map_to_charpp(&tp->pimpl->m_config);
 }
 
+const char *
+atf_tp_get_config_var(const atf_tp_t *tp, const char *name)
+{
+    const char *val;
+
+    PRE(atf_tp_has_config_var(tp, name));
+    val = atf_map_citer_data(atf_map_find_c(&tp->pimpl->m_config, name));
+    INV(val != NULL);
+
+    return val;
+}
+
+bool
+atf_tp_has_config_var(const atf_tp_t *tp, const char *name)
+{
+    atf_map_citer_t end, iter;
+
+    iter = atf_map_find_c(&tp->pimpl->m_config, name);
+    end = atf_map_end_c(&tp->pimpl->m_config);
+    return !atf_equal_map_citer_map_citer(iter, end);
+}
+
 bool
 atf_tp_has_tc(const atf_tp_t *tp, const char *id)
 {
@@ -186,6 +211,14 @@ atf_tp_add_tc(atf_tp_t *tp, atf_tc_t *tc)
     return err;
 }
 
+void
+atf_tp_set_fixture(atf_tp_t *tp, atf_tp_fixture_t fixture)
+{
+    PRE(tp->pimpl->m_fixture == NULL);
+
+    tp->pimpl->m_fixture = fixture;
+}
+
 /* ---------------------------------------------------------------------
  * Free functions.
  * --------------------------------------------------------------------- */
@@ -211,3 +244,16 @@ atf_tp_cleanup(const atf_tp_t *tp, const char *tcname)
 
     return atf_tc_cleanup(tc);
 }
+
+/*
+ * Runs the fixture of the test program, if any.  The caller is responsible
+ * for doing so only once per process, before the body of the first test
+ * case, so that the bodies forked afterwards share its results.
+ */
+atf_error_t
+atf_tp_run_fixture(const atf_tp_t *tp)
+{
+    if (tp->pimpl->m_fixture == NULL)
+        return atf_no_error();
+    return tp->pimpl->m_fixture(tp);
+}
@@ -31,6 +31,9 @@
 #include <atf-c/error_fwd.h>
 
 struct atf_tc;
+struct atf_tp;
+
+typedef atf_error_t (*atf_tp_fixture_t)(const struct atf_tp *);
 
 /* ---------------------------------------------------------------------
  * The "atf_tp" type.
@@ -48,12 +51,15 @@ void atf_tp_fini(atf_tp_t *);
 
 /* Getters. */
 char **atf_tp_get_config(const atf_tp_t *);
+const char *atf_tp_get_config_var(const atf_tp_t *, const char *);
+bool atf_tp_has_config_var(const atf_tp_t *, const char *);
 bool atf_tp_has_tc(const atf_tp_t *, const char *);
 const struct atf_tc *atf_tp_get_tc(const atf_tp_t *, const char *);
 const struct atf_tc *const *atf_tp_get_tcs(const atf_tp_t *);
 
 /* Modifiers. */
 atf_error_t atf_tp_add_tc(atf_tp_t *, struct atf_tc *);
+void atf_tp_set_fixture(atf_tp_t *, atf_tp_fixture_t);
 
 /* ---------------------------------------------------------------------
  * Free functions.
@@ -61,5 +67,6 @@ atf_error_t atf_tp_add_tc(atf_tp_t *, struct atf_tc *);
 
 atf_error_t atf_tp_run(const atf_tp_t *, const char *, const char *);
 atf_error_t atf_tp_cleanup(const atf_tp_t *, const char *);
+atf_error_t atf_tp_run_fixture(const atf_tp_t *);
 
 #endif /* !defined(ATF_C_TP_H) */
@@ -40,6 +40,7 @@
 #include <atf-c.h>
 
 #include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/fs.h"
 
 /** Allocate a filename to be used by atf_utils_{fork,wait}.
  *
@@ -178,12 +179,14 @@ atf_utils_copy_file(const char *source, const char *destination)
     ATF_REQUIRE_MSG(output != -1, "Failed to open destination file during "
                     "copy (%s)", destination);
 
-    char buffer[1024];
-    ssize_t length;
-    while ((length = read(input, buffer, sizeof(buffer))) > 0)
-        ATF_REQUIRE_MSG(write(output, buffer, length) == length,
-                        "Failed to write to %s during copy", destination);
-    ATF_REQUIRE_MSG(length != -1, "Failed to read from %s during copy", source);
+    atf_error_t error = atf_fs_copy_fd(input, output);
+    if (atf_is_error(error)) {
+        char buffer[1024];
+        atf_error_format(error, buffer, sizeof(buffer));
+        atf_error_free(error);
+        atf_tc_fail("Failed to copy %s to %s: %s", source, destination,
+                    buffer);
+    }
 
     struct stat sb;
     ATF_REQUIRE_MSG(fstat(input, &sb) != -1,
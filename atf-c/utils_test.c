@@ -205,6 +205,30 @@ ATF_TC_BODY(copy_file__some_contents, tc)
     ATF_REQUIRE(atf_utils_compare_file("dest.txt", "This is a\ntest file\n"));
 }
 
+ATF_TC_WITHOUT_HEAD(copy_file__large);
+ATF_TC_BODY(copy_file__large, tc)
+{
+    const size_t size = 8 * 1024 * 1024 + 1;
+    char *contents = malloc(size + 1);
+    ATF_REQUIRE(contents != NULL);
+    size_t i;
+    for (i = 0; i < size; i++)
+        contents[i] = 'a' + i % 26;
+    contents[size] = '\0';
+
+    atf_utils_create_file("src.txt", "%s", contents);
+    ATF_REQUIRE(chmod("src.txt", 0640) != -1);
+    atf_utils_create_file("dest.txt", "previous contents");
+
+    atf_utils_copy_file("src.txt", "dest.txt");
+    ATF_REQUIRE(atf_utils_compare_file("dest.txt", contents));
+    struct stat sb;
+    ATF_REQUIRE(stat("dest.txt", &sb) != -1);
+    ATF_REQUIRE_EQ(0640, sb.st_mode & 0xfff);
+
+    free(contents);
+}
+
 ATF_TC_WITHOUT_HEAD(create_file);
 ATF_TC_BODY(create_file, tc)
 {
@@ -538,6 +562,7 @@ ATF_TP_ADD_TCS(tp)
 
     ATF_TP_ADD_TC(tp, copy_file__empty);
     ATF_TP_ADD_TC(tp, copy_file__some_contents);
+    ATF_TP_ADD_TC(tp, copy_file__large);
 
     ATF_TP_ADD_TC(tp, create_file);
 
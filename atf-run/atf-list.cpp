@@ -0,0 +1,147 @@
+// Copyright (c) 2026 The NetBSD Foundation, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+// CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+// IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+extern "C" {
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+extern "C" {
+#include "atf-c/defs.h"
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/tp_static.h"
+#include "atf-c/error.h"
+}
+
+#include "atf-c++/detail/application.hpp"
+#include "atf-c++/detail/exceptions.hpp"
+#include "atf-c++/detail/sanity.hpp"
+
+// ------------------------------------------------------------------------
+// The "atf_list" class.
+// ------------------------------------------------------------------------
+
+class atf_list : public atf::application::app {
+    static const char* m_description;
+
+    bool m_static_only;
+
+    std::string specific_args(void) const;
+    options_set specific_options(void) const;
+    void process_option(int, const char*);
+
+public:
+    atf_list(void);
+
+    int main(void);
+};
+
+const char* atf_list::m_description =
+    "atf-list prints the list of test cases of a test program.  The list "
+    "is read from the records in the binary when all of its test cases "
+    "have static metadata; otherwise, the program is executed with its "
+    "-l flag.";
+
+atf_list::atf_list(void) :
+    app(m_description, "atf-list(1)"),
+    m_static_only(false)
+{
+}
+
+std::string
+atf_list::specific_args(void)
+    const
+{
+    return "test_program";
+}
+
+atf_list::options_set
+atf_list::specific_options(void)
+    const
+{
+    using atf::application::option;
+    options_set opts;
+
+    opts.insert(option('s', "", "Fails instead of executing the test "
+                       "program if it has no static listing"));
+
+    return opts;
+}
+
+void
+atf_list::process_option(int ch, const char* arg ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    switch (ch) {
+    case 's':
+        m_static_only = true;
+        break;
+
+    default:
+        UNREACHABLE;
+    }
+}
+
+int
+atf_list::main(void)
+{
+    if (m_argc != 1)
+        throw atf::application::usage_error("Must specify exactly one test "
+                                            "program");
+    const char* program = m_argv[0];
+
+    atf_dynstr_t listing;
+    bool found;
+    atf_error_t err = atf_tp_static_list(program, &listing, &found);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+
+    if (found) {
+        std::cout << atf_dynstr_cstring(&listing);
+        atf_dynstr_fini(&listing);
+        return std::cout.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (m_static_only)
+        throw std::runtime_error(std::string("Test program ") + program +
+                                 " has no static listing");
+
+    char* const argv[] = { const_cast< char* >(program),
+                           const_cast< char* >("-l"), NULL };
+    ::execv(program, argv);
+    throw std::runtime_error(std::string("Cannot execute ") + program +
+                             ": " + std::strerror(errno));
+}
+
+int
+main(int argc, char* const* argv)
+{
+    return atf_list().run(argc, argv);
+}
@@ -0,0 +1,90 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+: ${ATF_LIST:="__ATF_LIST__"}
+: ${ATF_SH:="__ATF_SH__"}
+
+atf_test_case static
+static_head()
+{
+    atf_set "descr" "Verifies that the static listing of C and C++ test" \
+        "programs matches the output of their -l flag"
+}
+static_body()
+{
+    for tp in atf-c/detail/tp_static_test atf-c++/macros_static_test; do
+        program="$(atf_get_srcdir)/../${tp}"
+        atf_check -o save:expout "${program}" -l
+        atf_check -o file:expout "${ATF_LIST}" -s "${program}"
+        atf_check -o file:expout "${ATF_LIST}" "${program}"
+    done
+}
+
+atf_test_case fallback
+fallback_head()
+{
+    atf_set "descr" "Verifies that test programs without a static listing" \
+        "are executed to list their test cases"
+}
+fallback_body()
+{
+    cat >tp <<EOF
+#! ${ATF_SH}
+atf_test_case a
+a_body() { :; }
+atf_init_test_cases() { atf_add_test_case a; }
+EOF
+    chmod +x tp
+    dynamic="$(atf_get_srcdir)/../atf-c/detail/sha256_test"
+
+    for program in ./tp "${dynamic}"; do
+        atf_check -o save:expout "${program}" -l
+        atf_check -o file:expout "${ATF_LIST}" "${program}"
+        atf_check -s exit:1 -e match:'has no static listing' \
+            "${ATF_LIST}" -s "${program}"
+    done
+}
+
+atf_test_case usage_errors
+usage_errors_head()
+{
+    atf_set "descr" "Verifies that invalid invocations are reported"
+}
+usage_errors_body()
+{
+    atf_check -s exit:1 -e match:'exactly one test program' "${ATF_LIST}"
+    atf_check -s exit:1 -e match:'exactly one test program' \
+        "${ATF_LIST}" a b
+    atf_check -s exit:1 -e match:'non-existent' "${ATF_LIST}" non-existent
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case static
+    atf_add_test_case fallback
+    atf_add_test_case usage_errors
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
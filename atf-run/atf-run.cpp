@@ -0,0 +1,2819 @@
+// Copyright (c) 2026 The NetBSD Foundation, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+// CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+// IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+extern "C" {
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "atf-c/defs.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/process.h"
+#include "atf-c/detail/sha256.h"
+#include "atf-c/detail/tp_static.h"
+#include "atf-c/error.h"
+}
+
+#include "atf-c++/detail/application.hpp"
+#include "atf-c++/detail/env.hpp"
+#include "atf-c++/detail/exceptions.hpp"
+#include "atf-c++/detail/fs.hpp"
+#include "atf-c++/detail/sanity.hpp"
+#include "atf-c++/detail/text.hpp"
+
+// ------------------------------------------------------------------------
+// Auxiliary functions.
+// ------------------------------------------------------------------------
+
+namespace {
+
+//!
+//! \brief Maximum time, in seconds, that a test program can take to list
+//! its test cases.
+//!
+static const int list_timeout = 60;
+
+//!
+//! \brief Default timeout, in seconds, of test cases that do not set one.
+//!
+static const int default_timeout = 300;
+
+static
+int64_t
+now_usec(void)
+{
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return static_cast< int64_t >(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static
+std::string
+format_usec(const int64_t usec)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3fs", usec / 1000000.0);
+    return buf;
+}
+
+static
+std::string
+dirname_of(const std::string& path)
+{
+    const std::string::size_type pos = path.rfind('/');
+    if (pos == std::string::npos)
+        return ".";
+    else if (pos == 0)
+        return "/";
+    else
+        return path.substr(0, pos);
+}
+
+//!
+//! \brief Joins two path components, simplifying a leading "./".
+//!
+static
+std::string
+join_path(const std::string& dir, const std::string& name)
+{
+    if (!name.empty() && name[0] == '/')
+        return name;
+    else if (dir == ".")
+        return name;
+    else
+        return dir + "/" + name;
+}
+
+static
+std::string
+current_directory(void)
+{
+    char buf[4096];
+    if (::getcwd(buf, sizeof(buf)) == NULL)
+        throw std::runtime_error(std::string("Cannot get the current "
+                                             "directory: ") +
+                                 std::strerror(errno));
+    return buf;
+}
+
+static
+std::string
+read_file(const std::string& path)
+{
+    std::ifstream is(path.c_str());
+    std::ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+}
+
+//!
+//! \brief Removes a directory tree, even if the test cases left parts of
+//! it without write or search permissions.
+//!
+static
+void
+remove_tree(const std::string& path)
+{
+    try {
+        atf::fs::remove_tree(atf::fs::path(path));
+    } catch (const std::exception&) {
+        // The leftovers of the test cases are not worth failing the run.
+    }
+}
+
+static
+void
+make_directory(const std::string& path)
+{
+    if (::mkdir(path.c_str(), 0755) == -1)
+        throw std::runtime_error("Cannot create directory " + path + ": " +
+                                 std::strerror(errno));
+}
+
+//!
+//! \brief Moves a file, copying it if it lives in another file system.
+//!
+static
+void
+move_file(const std::string& from, const std::string& to)
+{
+    if (::rename(from.c_str(), to.c_str()) == 0 || errno != EXDEV)
+        return;
+
+    std::ifstream is(from.c_str(), std::ios::binary);
+    std::ofstream os(to.c_str(), std::ios::binary);
+    os << is.rdbuf();
+    if (!os)
+        throw std::runtime_error("Cannot copy " + from + " to " + to);
+}
+
+// ------------------------------------------------------------------------
+// Kyuafile discovery.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief A test program to be run.
+//!
+struct test_program {
+    //! \brief Absolute path to the binary.
+    std::string path;
+
+    //! \brief Name used in the reports; relative to the root Kyuafile.
+    std::string name;
+};
+
+//!
+//! \brief Reads a quoted string starting at pos, which is updated to
+//! point past the closing quote.
+//!
+static
+std::string
+read_string(const std::string& text, std::string::size_type& pos)
+{
+    const char quote = text[pos];
+    INV(quote == '"' || quote == '\'');
+
+    std::string str;
+    for (pos++; pos < text.length() && text[pos] != quote; pos++) {
+        if (text[pos] == '\\' && pos + 1 < text.length())
+            pos++;
+        str += text[pos];
+    }
+    if (pos >= text.length())
+        throw std::runtime_error("Unterminated string");
+    pos++;
+    return str;
+}
+
+//!
+//! \brief Strips the comments of a Kyuafile.
+//!
+static
+std::string
+strip_comments(const std::string& text)
+{
+    std::string stripped;
+    std::string::size_type pos = 0;
+    while (pos < text.length()) {
+        if (text[pos] == '"' || text[pos] == '\'') {
+            const std::string::size_type start = pos;
+            (void)read_string(text, pos);
+            stripped += text.substr(start, pos - start);
+        } else if (text.compare(pos, 2, "--") == 0) {
+            while (pos < text.length() && text[pos] != '\n')
+                pos++;
+        } else
+            stripped += text[pos++];
+    }
+    return stripped;
+}
+
+//!
+//! \brief A call in a Kyuafile, such as include("foo/Kyuafile") or
+//! atf_test_program{name="foo_test"}.
+//!
+struct kyuafile_call {
+    std::string function;
+    std::vector< std::string > positional;
+    std::map< std::string, std::string > named;
+};
+
+static
+std::vector< kyuafile_call >
+parse_kyuafile_calls(const std::string& text)
+{
+    std::vector< kyuafile_call > calls;
+
+    std::string::size_type pos = 0;
+    while (pos < text.length()) {
+        if (!std::isalpha(static_cast< unsigned char >(text[pos])) &&
+            text[pos] != '_') {
+            pos++;
+            continue;
+        }
+
+        kyuafile_call call;
+        while (pos < text.length() &&
+               (std::isalnum(static_cast< unsigned char >(text[pos])) ||
+                text[pos] == '_'))
+            call.function += text[pos++];
+        while (pos < text.length() &&
+               std::isspace(static_cast< unsigned char >(text[pos])))
+            pos++;
+        if (pos >= text.length() || (text[pos] != '(' && text[pos] != '{'))
+            throw std::runtime_error("Expected a call to " + call.function);
+        const char close = text[pos] == '(' ? ')' : '}';
+        pos++;
+
+        std::string key;
+        while (pos < text.length() && text[pos] != close) {
+            if (text[pos] == '"' || text[pos] == '\'') {
+                const std::string value = read_string(text, pos);
+                if (key.empty())
+                    call.positional.push_back(value);
+                else
+                    call.named[key] = value;
+                key.clear();
+            } else if (std::isalpha(static_cast< unsigned char >(text[pos])) ||
+                       text[pos] == '_') {
+                std::string word;
+                while (pos < text.length() &&
+                       (std::isalnum(static_cast< unsigned char >(
+                           text[pos])) || text[pos] == '_'))
+                    word += text[pos++];
+                key = word;
+            } else if (text[pos] == ',') {
+                key.clear();
+                pos++;
+            } else
+                pos++;
+        }
+        if (pos >= text.length())
+            throw std::runtime_error("Unterminated call to " + call.function);
+        pos++;
+
+        calls.push_back(call);
+    }
+
+    return calls;
+}
+
+//!
+//! \brief Collects the ATF test programs defined by a Kyuafile and all the
+//! Kyuafiles it includes.
+//!
+//! \param kyuafile Path to the Kyuafile to process.
+//! \param prefix Directory of the Kyuafile relative to the root one, used
+//!     to name the test programs in the reports.
+//!
+static
+void
+load_kyuafile(const std::string& kyuafile, const std::string& prefix,
+              std::vector< test_program >& programs)
+{
+    std::ifstream is(kyuafile.c_str());
+    if (!is)
+        throw std::runtime_error("Cannot open " + kyuafile);
+    std::ostringstream os;
+    os << is.rdbuf();
+
+    std::vector< kyuafile_call > calls;
+    try {
+        calls = parse_kyuafile_calls(strip_comments(os.str()));
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(kyuafile + ": " + e.what());
+    }
+
+    const std::string dir = dirname_of(kyuafile);
+    for (std::vector< kyuafile_call >::const_iterator iter = calls.begin();
+         iter != calls.end(); iter++) {
+        const kyuafile_call& call = *iter;
+
+        if (call.function == "include") {
+            if (call.positional.size() != 1)
+                throw std::runtime_error(kyuafile + ": include requires a "
+                                         "file name");
+            const std::string& name = call.positional[0];
+            load_kyuafile(join_path(dir, name), join_path(prefix,
+                                                          dirname_of(name)),
+                          programs);
+        } else if (call.function == "atf_test_program") {
+            std::map< std::string, std::string >::const_iterator name =
+                call.named.find("name");
+            if (name == call.named.end())
+                throw std::runtime_error(kyuafile + ": atf_test_program "
+                                         "requires a name");
+            test_program program;
+            program.path = join_path(dir, (*name).second);
+            program.name = join_path(prefix, (*name).second);
+            programs.push_back(program);
+        } else if (call.function == "plain_test_program" ||
+                   call.function == "tap_test_program") {
+            std::cerr << "atf-run: WARNING: " << kyuafile << ": skipping "
+                      << call.function << "; only ATF test programs are "
+                      "supported\n";
+        }
+    }
+}
+
+// ------------------------------------------------------------------------
+// Test cases and results.
+// ------------------------------------------------------------------------
+
+enum result_type {
+    result_passed,
+    result_failed,
+    result_skipped,
+    result_xfail,
+    result_broken,
+};
+
+struct result {
+    result_type type;
+    std::string reason;
+
+    // The allocations of the body, if the test program counted them.
+    std::string allocs;
+
+    result(void) :
+        type(result_broken)
+    {
+    }
+
+    result(const result_type p_type, const std::string& p_reason = "") :
+        type(p_type),
+        reason(p_reason)
+    {
+    }
+};
+
+static
+std::string
+format_result(const result& r)
+{
+    static const char* names[] = {
+        "passed", "failed", "skipped", "expected_failure", "broken"
+    };
+    std::string str = names[r.type];
+    if (!r.reason.empty())
+        str += ": " + r.reason;
+    return str;
+}
+
+struct test_case {
+    const test_program* program;
+    std::string ident;
+    int timeout;
+    bool has_cleanup;
+    bool exclusive;
+    long hint_ms;
+    std::string skip_reason;
+    std::vector< std::string > inputs;
+    std::string cache_key;
+
+    test_case(const test_program* p_program) :
+        program(p_program),
+        timeout(default_timeout),
+        has_cleanup(false),
+        exclusive(false),
+        hint_ms(-1)
+    {
+    }
+};
+
+//!
+//! \brief Checks the requirements of a test case that can be evaluated
+//! before running it.
+//!
+//! Returns the reason to skip the test case, or an empty string if it can
+//! run.
+//!
+static
+std::string
+check_requirements(const std::map< std::string, std::string >& md,
+                   const std::map< std::string, std::string >& config)
+{
+    std::map< std::string, std::string >::const_iterator iter;
+
+    iter = md.find("require.config");
+    if (iter != md.end()) {
+        const std::vector< std::string > vars =
+            atf::text::split((*iter).second, " ");
+        for (std::vector< std::string >::const_iterator var = vars.begin();
+             var != vars.end(); var++) {
+            if (config.find(*var) == config.end())
+                return "Required configuration property '" + *var + "' not "
+                    "defined";
+        }
+    }
+
+    iter = md.find("require.files");
+    if (iter != md.end()) {
+        const std::vector< std::string > files =
+            atf::text::split((*iter).second, " ");
+        for (std::vector< std::string >::const_iterator file = files.begin();
+             file != files.end(); file++) {
+            if ((*file)[0] != '/')
+                return "Relative path '" + *file + "' not allowed in "
+                    "require.files";
+            if (::access((*file).c_str(), F_OK) == -1)
+                return "Required file '" + *file + "' not found";
+        }
+    }
+
+    iter = md.find("require.progs");
+    if (iter != md.end()) {
+        const std::vector< std::string > progs =
+            atf::text::split((*iter).second, " ");
+        for (std::vector< std::string >::const_iterator prog = progs.begin();
+             prog != progs.end(); prog++) {
+            if ((*prog)[0] != '/' && (*prog).find('/') != std::string::npos)
+                return "Relative path '" + *prog + "' not allowed in "
+                    "require.progs";
+        }
+
+        const std::string missing = atf::fs::find_missing_prog(progs);
+        if (!missing.empty() && missing[0] == '/')
+            return "Required program '" + missing + "' not found";
+        else if (!missing.empty())
+            return "Required program '" + missing + "' not found in the "
+                "PATH";
+    }
+
+    iter = md.find("require.user");
+    if (iter != md.end()) {
+        if ((*iter).second == "root" && ::getuid() != 0)
+            return "Requires root privileges";
+        else if ((*iter).second == "unprivileged" && ::getuid() == 0)
+            return "Requires an unprivileged user";
+    }
+
+    return "";
+}
+
+//!
+//! \brief Collects the files whose contents affect the result of a test
+//! case: those in require.files and those in X-inputs, which are relative
+//! to the directory of the test program unless absolute.
+//!
+static
+std::vector< std::string >
+collect_inputs(const test_program* program,
+               const std::map< std::string, std::string >& md)
+{
+    std::vector< std::string > inputs;
+    std::map< std::string, std::string >::const_iterator iter;
+
+    iter = md.find("require.files");
+    if (iter != md.end()) {
+        const std::vector< std::string > files =
+            atf::text::split((*iter).second, " ");
+        inputs.insert(inputs.end(), files.begin(), files.end());
+    }
+
+    iter = md.find("X-inputs");
+    if (iter != md.end()) {
+        const std::vector< std::string > files =
+            atf::text::split((*iter).second, " ");
+        for (std::vector< std::string >::const_iterator file = files.begin();
+             file != files.end(); file++)
+            inputs.push_back(join_path(dirname_of(program->path), *file));
+    }
+
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+    return inputs;
+}
+
+//!
+//! \brief Parses the output of a test program's -l flag.
+//!
+static
+std::vector< test_case* >
+parse_test_cases(const test_program* program, std::istream& is,
+                 const std::map< std::string, std::string >& config)
+{
+    std::string line;
+    if (!std::getline(is, line) ||
+        line.compare(0, 35, "Content-Type: application/X-atf-tp;") != 0)
+        throw std::runtime_error("Invalid header in the list of test cases");
+    if (!std::getline(is, line) || !line.empty())
+        throw std::runtime_error("Invalid header in the list of test cases");
+
+    std::vector< test_case* > tcs;
+    std::map< std::string, std::string > md;
+    bool eof = false;
+    while (!eof) {
+        eof = !std::getline(is, line);
+        if (!eof && !line.empty()) {
+            const std::string::size_type pos = line.find(": ");
+            if (pos == std::string::npos)
+                throw std::runtime_error("Invalid property '" + line + "'");
+            md[line.substr(0, pos)] = line.substr(pos + 2);
+            continue;
+        }
+        if (md.empty())
+            continue;
+
+        if (md.find("ident") == md.end())
+            throw std::runtime_error("Test case without an ident");
+
+        test_case* tc = new test_case(program);
+        tcs.push_back(tc);
+        tc->ident = md["ident"];
+        if (md.find("timeout") != md.end())
+            tc->timeout = atf::text::to_type< int >(md["timeout"]);
+        if (md.find("has.cleanup") != md.end())
+            tc->has_cleanup = atf::text::to_bool(md["has.cleanup"]);
+        if (md.find("is.exclusive") != md.end())
+            tc->exclusive = atf::text::to_bool(md["is.exclusive"]);
+        if (md.find("X-duration-hint-ms") != md.end()) {
+            // Hints only affect the order, so ignore any bogus ones.
+            try {
+                tc->hint_ms = std::max(0L, atf::text::to_type< long >(
+                    md["X-duration-hint-ms"]));
+            } catch (const std::runtime_error&) {
+            }
+        }
+        tc->skip_reason = check_requirements(md, config);
+        tc->inputs = collect_inputs(program, md);
+        md.clear();
+    }
+
+    if (tcs.empty())
+        throw std::runtime_error("No test cases defined");
+    return tcs;
+}
+
+//!
+//! \brief Parses a result formatted by format_result.
+//!
+static
+bool
+parse_result(const std::string& line, result& r)
+{
+    static const char* names[] = {
+        "passed", "failed", "skipped", "expected_failure", "broken", NULL
+    };
+    for (const char** name = names; *name != NULL; name++) {
+        const std::string prefix = *name;
+        if (line == prefix) {
+            r = result(static_cast< result_type >(name - names));
+            return true;
+        } else if (line.compare(0, prefix.length() + 2, prefix + ": ") == 0) {
+            r = result(static_cast< result_type >(name - names),
+                       line.substr(prefix.length() + 2));
+            return true;
+        }
+    }
+    return false;
+}
+
+//!
+//! \brief Parses the "expected_exit(N)" and similar result names.
+//!
+static
+bool
+parse_expected_arg(const std::string& name, const std::string& prefix,
+                   int& arg)
+{
+    if (name == prefix) {
+        arg = -1;
+        return true;
+    }
+    if (name.compare(0, prefix.length() + 1, prefix + "(") != 0 ||
+        name[name.length() - 1] != ')')
+        return false;
+    arg = atf::text::to_type< int >(
+        name.substr(prefix.length() + 1,
+                    name.length() - prefix.length() - 2));
+    return true;
+}
+
+//!
+//! \brief Computes the result of a test case from its result file and
+//! the way its body terminated.
+//!
+static
+result
+compute_result(const std::string& resfile, const atf_process_status_t* s,
+               const bool timed_out)
+{
+    std::ifstream is(resfile.c_str());
+    std::string line;
+    if (!std::getline(is, line)) {
+        if (timed_out)
+            return result(result_broken, "Test case body timed out");
+        else if (atf_process_status_signaled(s))
+            return result(result_broken, "Premature exit; test case "
+                          "received signal " + atf::text::to_string(
+                              atf_process_status_termsig(s)));
+        else
+            return result(result_broken, "Premature exit; test case "
+                          "exited with code " + atf::text::to_string(
+                              atf_process_status_exitstatus(s)));
+    }
+
+    std::string name = line, reason;
+    const std::string::size_type pos = line.find(": ");
+    if (pos != std::string::npos) {
+        name = line.substr(0, pos);
+        reason = line.substr(pos + 2);
+    }
+
+    const bool exited = !timed_out && atf_process_status_exited(s);
+    const int exitstatus = exited ? atf_process_status_exitstatus(s) : -1;
+    int arg;
+
+    if (name == "expected_timeout") {
+        if (timed_out)
+            return result(result_xfail, reason);
+        return result(result_failed, "Test case was expected to hang but "
+                      "it continued execution");
+    } else if (timed_out)
+        return result(result_broken, "Test case body timed out");
+
+    try {
+        if (name == "passed") {
+            if (exitstatus == EXIT_SUCCESS)
+                return result(result_passed);
+        } else if (name == "failed") {
+            if (exitstatus == EXIT_FAILURE)
+                return result(result_failed, reason);
+        } else if (name == "skipped") {
+            if (exitstatus == EXIT_SUCCESS)
+                return result(result_skipped, reason);
+        } else if (name == "expected_failure") {
+            if (exitstatus == EXIT_SUCCESS)
+                return result(result_xfail, reason);
+        } else if (name == "expected_death") {
+            return result(result_xfail, reason);
+        } else if (parse_expected_arg(name, "expected_exit", arg)) {
+            if (exited && (arg == -1 || exitstatus == arg))
+                return result(result_xfail, reason);
+            return result(result_failed, "Test case expected to exit " +
+                          std::string(arg == -1 ? "" : "with code " +
+                                      atf::text::to_string(arg) + " ") +
+                          "but it did not");
+        } else if (parse_expected_arg(name, "expected_signal", arg)) {
+            if (atf_process_status_signaled(s) &&
+                (arg == -1 || atf_process_status_termsig(s) == arg))
+                return result(result_xfail, reason);
+            return result(result_failed, "Test case expected to receive " +
+                          std::string(arg == -1 ? "a signal" : "signal " +
+                                      atf::text::to_string(arg)) +
+                          " but it did not");
+        } else
+            return result(result_broken, "Unknown test result '" + line +
+                          "'");
+    } catch (const std::runtime_error&) {
+        return result(result_broken, "Invalid test result '" + line + "'");
+    }
+
+    return result(result_broken, "Test case reported '" + line + "' but " +
+                  (exited ? "exited with code " +
+                   atf::text::to_string(exitstatus) :
+                   "received signal " + atf::text::to_string(
+                       atf_process_status_termsig(s))));
+}
+
+//!
+//! \brief Reads the allocations of the body of a test case that follow its
+//! result, if any.
+//!
+//! Test programs only report them if ATF_ALLOC_STATS is set and they were
+//! linked with an allocation tracker; see atf-test-program(1).
+//!
+static
+std::string
+read_allocs(const std::string& resfile)
+{
+    static const std::string prefix = "allocations: ";
+
+    std::ifstream is(resfile.c_str());
+    std::string line;
+    if (!std::getline(is, line) || !std::getline(is, line) ||
+        line.compare(0, prefix.length(), prefix) != 0)
+        return "";
+    return line.substr(prefix.length());
+}
+
+// ------------------------------------------------------------------------
+// The "result_cache" class.
+// ------------------------------------------------------------------------
+
+static
+void
+hash_string(atf_sha256_t* ctx, const std::string& str)
+{
+    atf_sha256_update(ctx, str.c_str(), str.length() + 1);
+}
+
+//!
+//! \brief Feeds the contents of a file or a directory tree to a hash.
+//!
+//! Missing files are hashed as such, so that creating them changes the
+//! hash.  The entries of directories are visited in order.
+//!
+static
+void
+hash_path(atf_sha256_t* ctx, const std::string& path)
+{
+    struct stat sb;
+    if (::lstat(path.c_str(), &sb) == -1) {
+        hash_string(ctx, "missing " + path);
+        return;
+    }
+
+    if (S_ISLNK(sb.st_mode)) {
+        char target[4096];
+        const ssize_t length = ::readlink(path.c_str(), target,
+                                          sizeof(target));
+        hash_string(ctx, "link " + path + " " +
+                    std::string(target, length > 0 ? length : 0));
+    } else if (S_ISDIR(sb.st_mode)) {
+        hash_string(ctx, "dir " + path);
+        std::vector< std::string > names;
+        DIR* dir = ::opendir(path.c_str());
+        if (dir != NULL) {
+            struct dirent* de;
+            while ((de = ::readdir(dir)) != NULL) {
+                if (std::strcmp(de->d_name, ".") != 0 &&
+                    std::strcmp(de->d_name, "..") != 0)
+                    names.push_back(de->d_name);
+            }
+            ::closedir(dir);
+        }
+        std::sort(names.begin(), names.end());
+        for (std::vector< std::string >::const_iterator iter = names.begin();
+             iter != names.end(); iter++)
+            hash_path(ctx, path + "/" + *iter);
+    } else {
+        hash_string(ctx, "file " + path + " " +
+                    atf::text::to_string(sb.st_size));
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            hash_string(ctx, std::string("unreadable ") +
+                        std::strerror(errno));
+            return;
+        }
+        char buf[65536];
+        ssize_t length;
+        while ((length = ::read(fd, buf, sizeof(buf))) > 0)
+            atf_sha256_update(ctx, buf, length);
+        ::close(fd);
+    }
+}
+
+//!
+//! \brief Returns the interpreter named by the #! line of a script, or an
+//! empty string for other files.
+//!
+static
+std::string
+interpreter_of(const std::string& path)
+{
+    std::ifstream is(path.c_str());
+    std::string line;
+    if (!std::getline(is, line) || line.compare(0, 2, "#!") != 0)
+        return "";
+
+    std::string::size_type start = 2;
+    while (start < line.length() && (line[start] == ' ' ||
+                                     line[start] == '\t'))
+        start++;
+    std::string::size_type end = start;
+    while (end < line.length() && line[end] != ' ' && line[end] != '\t')
+        end++;
+    return line.substr(start, end - start);
+}
+
+static
+void
+set_trace_loaded_objects(void)
+{
+    atf::env::set("LD_TRACE_LOADED_OBJECTS", "1");
+}
+
+static
+unsigned long long
+elf_word(const unsigned char* p, const size_t length, const bool big_endian)
+{
+    unsigned long long value = 0;
+    for (size_t i = 0; i < length; i++)
+        value |= static_cast< unsigned long long >(
+            p[big_endian ? i : length - 1 - i]) << (8 * (length - 1 - i));
+    return value;
+}
+
+//!
+//! \brief Checks if a file is an ELF executable that names a dynamic
+//! linker (a PT_INTERP program header).
+//!
+//! Only these start in the dynamic linker, which stops before running any
+//! code of the program when asked to list its libraries.  Static binaries
+//! and scripts would run as usual instead.
+//!
+static
+bool
+is_dynamic_elf(const std::string& path)
+{
+    std::ifstream is(path.c_str(), std::ios::binary);
+    unsigned char ehdr[64];
+    if (!is.read(reinterpret_cast< char* >(ehdr), 52) ||
+        std::memcmp(ehdr, "\177ELF", 4) != 0)
+        return false;
+
+    const bool is64 = ehdr[4] == 2;
+    const bool big_endian = ehdr[5] == 2;
+    if (is64 && !is.read(reinterpret_cast< char* >(ehdr) + 52, 12))
+        return false;
+
+    const unsigned long long phoff = is64 ?
+        elf_word(ehdr + 32, 8, big_endian) : elf_word(ehdr + 28, 4, big_endian);
+    const size_t phentsize = elf_word(ehdr + (is64 ? 54 : 42), 2, big_endian);
+    const size_t phnum = elf_word(ehdr + (is64 ? 56 : 44), 2, big_endian);
+    if (phentsize < 4)
+        return false;
+
+    std::vector< unsigned char > phdr(phentsize);
+    for (size_t i = 0; i < phnum; i++) {
+        is.seekg(phoff + i * phentsize);
+        if (!is.read(reinterpret_cast< char* >(&phdr[0]), phentsize))
+            return false;
+        if (elf_word(&phdr[0], 4, big_endian) == 3) // PT_INTERP
+            return true;
+    }
+    return false;
+}
+
+//!
+//! \brief Returns the shared libraries that a program loads.
+//!
+//! This asks the dynamic linker for the list, which is only supported by
+//! ld.so(8) in systems that honor LD_TRACE_LOADED_OBJECTS; anywhere else
+//! the list is empty.  The program is only started if it is a dynamically
+//! linked ELF binary, as anything else would just run.
+//!
+static
+std::vector< std::string >
+loaded_libraries(const std::string& program, const std::string& scratch)
+{
+    std::vector< std::string > libraries;
+    if (!is_dynamic_elf(program))
+        return libraries;
+
+    atf_fs_path_t path, outpath, nullpath;
+    atf_error_t err = atf_fs_path_init_fmt(&path, "%s", program.c_str());
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    err = atf_fs_path_init_fmt(&outpath, "%s", scratch.c_str());
+    if (atf_is_error(err)) {
+        atf_fs_path_fini(&path);
+        atf::throw_atf_error(err);
+    }
+    err = atf_fs_path_init_fmt(&nullpath, "/dev/null");
+    if (atf_is_error(err)) {
+        atf_fs_path_fini(&outpath);
+        atf_fs_path_fini(&path);
+        atf::throw_atf_error(err);
+    }
+
+    atf_process_stream_t outsb, errsb;
+    err = atf_process_stream_init_redirect_path(&outsb, &outpath);
+    if (!atf_is_error(err)) {
+        err = atf_process_stream_init_redirect_path(&errsb, &nullpath);
+        if (!atf_is_error(err)) {
+            const char* argv[] = { program.c_str(), NULL };
+            atf_process_status_t status;
+            std::cout.flush();
+            std::cerr.flush();
+            err = atf_process_exec_array(&status, &path, argv, &outsb,
+                                         &errsb, set_trace_loaded_objects);
+            if (!atf_is_error(err))
+                atf_process_status_fini(&status);
+            atf_process_stream_fini(&errsb);
+        }
+        atf_process_stream_fini(&outsb);
+    }
+    atf_fs_path_fini(&nullpath);
+    atf_fs_path_fini(&outpath);
+    atf_fs_path_fini(&path);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+
+    // Lines look like "\tlibfoo.so.1 => /lib/libfoo.so.1 (0x...)" or
+    // "\t/lib/ld.so (0x...)".
+    std::ifstream is(scratch.c_str());
+    std::string line;
+    while (std::getline(is, line)) {
+        const std::string::size_type paren = line.rfind(" (0x");
+        if (paren == std::string::npos)
+            continue;
+        std::string::size_type start = line.find(" => ");
+        start = start == std::string::npos ? line.find('/') : start + 4;
+        if (start != std::string::npos && start < paren &&
+            line[start] == '/')
+            libraries.push_back(line.substr(start, paren - start));
+    }
+    ::unlink(scratch.c_str());
+    return libraries;
+}
+
+//!
+//! \brief Stores the results of test cases under a key that identifies
+//! everything they depend on.
+//!
+//! Every entry is a directory named after the key that holds the result
+//! and the output of the test case.  Entries are created under a
+//! temporary name and renamed into place, so that concurrent runs sharing
+//! the cache never see partial entries.
+//!
+class result_cache {
+    const std::string m_dir;
+    size_t m_hits;
+    size_t m_misses;
+    size_t m_stored;
+
+    std::string entry_dir(const std::string&) const;
+
+public:
+    result_cache(const std::string&);
+
+    void invalidate(void);
+
+    std::string fingerprint(const std::string&, const std::string&) const;
+    std::string key(const std::string&, const test_case*,
+                    const std::map< std::string, std::string >&) const;
+
+    bool lookup(const std::string&, result&, std::string&);
+    void store(const std::string&, const result&, const std::string&);
+
+    void print_stats(std::ostream&) const;
+};
+
+result_cache::result_cache(const std::string& dir) :
+    m_dir(dir),
+    m_hits(0),
+    m_misses(0),
+    m_stored(0)
+{
+    if (::mkdir(m_dir.c_str(), 0755) == -1 && errno != EEXIST)
+        throw std::runtime_error("Cannot create cache directory " + m_dir +
+                                 ": " + std::strerror(errno));
+}
+
+std::string
+result_cache::entry_dir(const std::string& key)
+    const
+{
+    return m_dir + "/" + key.substr(0, 2) + "/" + key;
+}
+
+//!
+//! \brief Discards all the stored results.
+//!
+void
+result_cache::invalidate(void)
+{
+    remove_tree(m_dir);
+    make_directory(m_dir);
+}
+
+//!
+//! \brief Computes the hash of a test program and the files it loads.
+//!
+//! These are the binary itself, the interpreter of scripts, the atf-sh
+//! library for atf-sh scripts, and the shared libraries of the binary or
+//! of the interpreter.
+//!
+std::string
+result_cache::fingerprint(const std::string& program,
+                          const std::string& scratch)
+    const
+{
+    atf_sha256_t ctx;
+    atf_sha256_init(&ctx);
+    hash_path(&ctx, program);
+
+    const std::string interpreter = interpreter_of(program);
+    const std::string binary = interpreter.empty() ? program : interpreter;
+    if (!interpreter.empty()) {
+        hash_path(&ctx, interpreter);
+        if (interpreter.length() >= 6 &&
+            interpreter.compare(interpreter.length() - 6, 6, "atf-sh") == 0)
+            hash_path(&ctx, atf::env::get("ATF_PKGDATADIR", ATF_PKGDATADIR) +
+                      "/libatf-sh.subr");
+    }
+
+    const std::vector< std::string > libraries =
+        loaded_libraries(binary, scratch);
+    for (std::vector< std::string >::const_iterator iter = libraries.begin();
+         iter != libraries.end(); iter++)
+        hash_path(&ctx, *iter);
+
+    char hex[ATF_SHA256_HEX_LENGTH];
+    atf_sha256_final_hex(&ctx, hex);
+    return hex;
+}
+
+//!
+//! \brief Computes the key of a test case from the fingerprint of its
+//! program, its name, the configuration variables and its inputs.
+//!
+std::string
+result_cache::key(const std::string& fingerprint, const test_case* tc,
+                  const std::map< std::string, std::string >& config)
+    const
+{
+    atf_sha256_t ctx;
+    atf_sha256_init(&ctx);
+    hash_string(&ctx, "atf-run result 1");
+    hash_string(&ctx, fingerprint);
+    hash_string(&ctx, tc->ident);
+    for (std::map< std::string, std::string >::const_iterator iter =
+         config.begin(); iter != config.end(); iter++)
+        hash_string(&ctx, (*iter).first + "=" + (*iter).second);
+    for (std::vector< std::string >::const_iterator iter =
+         tc->inputs.begin(); iter != tc->inputs.end(); iter++)
+        hash_path(&ctx, *iter);
+
+    char hex[ATF_SHA256_HEX_LENGTH];
+    atf_sha256_final_hex(&ctx, hex);
+    return hex;
+}
+
+//!
+//! \brief Looks up the result stored under a key.
+//!
+//! On a hit, dir is set to the directory holding the output of the test
+//! case.
+//!
+bool
+result_cache::lookup(const std::string& key, result& r, std::string& dir)
+{
+    dir = entry_dir(key);
+    std::ifstream is((dir + "/result").c_str());
+    std::string line;
+    if (!std::getline(is, line) || !parse_result(line, r)) {
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    return true;
+}
+
+//!
+//! \brief Stores the result of a test case and the output found in its
+//! job directory.
+//!
+void
+result_cache::store(const std::string& key, const result& r,
+                    const std::string& jobdir)
+{
+    const std::string dir = entry_dir(key);
+    const std::string parent = dirname_of(dir);
+    if (::mkdir(parent.c_str(), 0755) == -1 && errno != EEXIST)
+        throw std::runtime_error("Cannot create directory " + parent +
+                                 ": " + std::strerror(errno));
+
+    const std::string tmpdir = parent + "/tmp.XXXXXX";
+    std::vector< char > buf(tmpdir.begin(), tmpdir.end());
+    buf.push_back('\0');
+    if (::mkdtemp(&buf[0]) == NULL)
+        throw std::runtime_error("Cannot create a temporary directory in " +
+                                 parent + ": " + std::strerror(errno));
+    const std::string tmp = &buf[0];
+
+    static const char* files[] = {
+        "stdout", "stderr", "cleanup.stdout", "cleanup.stderr", NULL
+    };
+    for (const char** file = files; *file != NULL; file++) {
+        if (::access((jobdir + "/" + *file).c_str(), F_OK) == 0)
+            move_file(jobdir + "/" + *file, tmp + "/" + *file);
+    }
+    {
+        std::ofstream os((tmp + "/result").c_str());
+        os << format_result(r) << "\n";
+    }
+
+    // Losing the race against another run storing the same entry is fine.
+    if (::rename(tmp.c_str(), dir.c_str()) == -1)
+        remove_tree(tmp);
+    else
+        m_stored++;
+}
+
+void
+result_cache::print_stats(std::ostream& os)
+    const
+{
+    os << "Result cache: " << m_hits << " hits, " << m_misses
+       << " misses, " << m_stored << " stored\n";
+}
+
+// ------------------------------------------------------------------------
+// The "scheduler" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief The order in which test cases are distributed among workers.
+//!
+enum order_type {
+    order_locality,
+    order_lpt
+};
+
+//!
+//! \brief Distributes the test programs to list and the test cases to run
+//! among the workers.
+//!
+//! Every worker owns a queue.  The test cases of a test program are queued
+//! in the worker that listed it and are consumed from the front, so a
+//! worker keeps running the test cases of the same program while it can.
+//! An idle worker with an empty queue steals the back half of the longest
+//! queue.  Listing test programs takes precedence over running test cases
+//! so that all workers get work as soon as possible.
+//!
+//! Exclusive test cases are kept apart, to be run one at a time once
+//! everything else is done.
+//!
+//! In the longest-first order, test cases are held back until all test
+//! programs have been listed.  They are then sorted by their duration
+//! hints, longest first, and every one is assigned to the worker with the
+//! least predicted work so far.  Test cases without a hint are assumed to
+//! take the average time of the others.  Stealing still compensates for
+//! wrong predictions.
+//!
+class scheduler {
+    const order_type m_order;
+    std::deque< const test_program* > m_listings;
+    std::vector< std::deque< test_case* > > m_queues;
+    std::vector< int64_t > m_predicted;
+    std::deque< test_case* > m_exclusive;
+    std::vector< test_case* > m_held;
+
+    bool steal(const size_t);
+
+public:
+    scheduler(const size_t, const order_type);
+
+    void add_listing(const test_program*);
+    void add_test_cases(const size_t, const std::vector< test_case* >&);
+    void seal(void);
+
+    const test_program* next_listing(void);
+    test_case* next_test_case(const size_t);
+    test_case* next_exclusive(void);
+
+    void print_plan(std::ostream&) const;
+};
+
+scheduler::scheduler(const size_t workers, const order_type order) :
+    m_order(order),
+    m_queues(workers),
+    m_predicted(workers, 0)
+{
+}
+
+static
+bool
+longer_hint(const test_case* a, const test_case* b)
+{
+    return a->hint_ms > b->hint_ms;
+}
+
+static
+long
+estimated_ms(const test_case* tc, const long fallback)
+{
+    return tc->hint_ms >= 0 ? tc->hint_ms : fallback;
+}
+
+//!
+//! \brief Returns the duration assumed for test cases without a hint.
+//!
+static
+long
+fallback_hint(const std::vector< test_case* >& tcs)
+{
+    long total = 0, count = 0;
+    for (std::vector< test_case* >::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++) {
+        if ((*iter)->hint_ms >= 0) {
+            total += (*iter)->hint_ms;
+            count++;
+        }
+    }
+    return count > 0 ? std::max(total / count, 1L) : 1;
+}
+
+void
+scheduler::add_listing(const test_program* program)
+{
+    m_listings.push_back(program);
+}
+
+void
+scheduler::add_test_cases(const size_t worker,
+                          const std::vector< test_case* >& tcs)
+{
+    PRE(worker < m_queues.size());
+    for (std::vector< test_case* >::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++) {
+        if ((*iter)->exclusive)
+            m_exclusive.push_back(*iter);
+        else if (m_order == order_lpt)
+            m_held.push_back(*iter);
+        else
+            m_queues[worker].push_back(*iter);
+    }
+}
+
+//!
+//! \brief Notifies the scheduler that all test programs have been listed.
+//!
+void
+scheduler::seal(void)
+{
+    if (m_order != order_lpt)
+        return;
+
+    const long fallback = fallback_hint(m_held);
+    for (std::vector< test_case* >::iterator iter = m_held.begin();
+         iter != m_held.end(); iter++) {
+        if ((*iter)->hint_ms < 0)
+            (*iter)->hint_ms = fallback;
+    }
+    std::stable_sort(m_held.begin(), m_held.end(), longer_hint);
+
+    for (std::vector< test_case* >::const_iterator iter = m_held.begin();
+         iter != m_held.end(); iter++) {
+        const size_t worker = std::min_element(m_predicted.begin(),
+            m_predicted.end()) - m_predicted.begin();
+        m_queues[worker].push_back(*iter);
+        m_predicted[worker] += (*iter)->hint_ms;
+    }
+    m_held.clear();
+}
+
+const test_program*
+scheduler::next_listing(void)
+{
+    if (m_listings.empty())
+        return NULL;
+    const test_program* program = m_listings.front();
+    m_listings.pop_front();
+    return program;
+}
+
+bool
+scheduler::steal(const size_t worker)
+{
+    size_t victim = worker;
+    for (size_t i = 0; i < m_queues.size(); i++) {
+        if (m_queues[i].size() > m_queues[victim].size())
+            victim = i;
+    }
+    if (victim == worker)
+        return false;
+
+    std::deque< test_case* >& from = m_queues[victim];
+    const size_t count = (from.size() + 1) / 2;
+    m_queues[worker].insert(m_queues[worker].end(), from.end() - count,
+                            from.end());
+    from.erase(from.end() - count, from.end());
+    return true;
+}
+
+test_case*
+scheduler::next_test_case(const size_t worker)
+{
+    PRE(worker < m_queues.size());
+    std::deque< test_case* >& queue = m_queues[worker];
+    if (queue.empty() && !steal(worker))
+        return NULL;
+
+    test_case* tc = queue.front();
+    queue.pop_front();
+    return tc;
+}
+
+test_case*
+scheduler::next_exclusive(void)
+{
+    if (m_exclusive.empty())
+        return NULL;
+    test_case* tc = m_exclusive.front();
+    m_exclusive.pop_front();
+    return tc;
+}
+
+//!
+//! \brief Prints the test cases assigned to every worker.
+//!
+//! The predicted wall time assumes that the hints are accurate and that
+//! exclusive test cases run after all the others.
+//!
+void
+scheduler::print_plan(std::ostream& os)
+    const
+{
+    int64_t wall_ms = 0;
+    for (size_t worker = 0; worker < m_queues.size(); worker++) {
+        const std::deque< test_case* >& queue = m_queues[worker];
+        int64_t total_ms = 0;
+        for (std::deque< test_case* >::const_iterator iter = queue.begin();
+             iter != queue.end(); iter++)
+            total_ms += estimated_ms(*iter, 0);
+        wall_ms = std::max(wall_ms, total_ms);
+
+        os << "Worker " << worker + 1 << ": " << queue.size()
+           << " test cases  [" << format_usec(total_ms * 1000) << "]\n";
+        for (std::deque< test_case* >::const_iterator iter = queue.begin();
+             iter != queue.end(); iter++)
+            os << "    " << (*iter)->program->name << ":" << (*iter)->ident
+               << "  [" << format_usec(estimated_ms(*iter, 0) * 1000)
+               << "]\n";
+    }
+
+    if (!m_exclusive.empty()) {
+        const std::vector< test_case* > all(m_exclusive.begin(),
+                                            m_exclusive.end());
+        const long fallback = fallback_hint(all);
+        int64_t total_ms = 0;
+        for (std::deque< test_case* >::const_iterator iter =
+             m_exclusive.begin(); iter != m_exclusive.end(); iter++)
+            total_ms += estimated_ms(*iter, fallback);
+        wall_ms += total_ms;
+
+        os << "Exclusive: " << m_exclusive.size() << " test cases  ["
+           << format_usec(total_ms * 1000) << "]\n";
+        for (std::deque< test_case* >::const_iterator iter =
+             m_exclusive.begin(); iter != m_exclusive.end(); iter++)
+            os << "    " << (*iter)->program->name << ":" << (*iter)->ident
+               << "  [" << format_usec(estimated_ms(*iter, fallback) * 1000)
+               << "]\n";
+    }
+
+    os << "\nPredicted wall time: " << format_usec(wall_ms * 1000) << "\n";
+}
+
+// ------------------------------------------------------------------------
+// The "runner" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief Signal notifications for the event loop.
+//!
+//! The handlers only write to a pipe that the event loop polls, so that
+//! signals delivered at any time wake it up.
+//!
+static int signal_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t interrupted_by = 0;
+
+static
+void
+notify_signal(const int signo)
+{
+    const int old_errno = errno;
+    if (signo != SIGCHLD)
+        interrupted_by = signo;
+    if (::write(signal_pipe[1], "", 1) == -1) {
+        // The pipe is full, so the event loop will wake up anyway.
+    }
+    errno = old_errno;
+}
+
+enum job_type {
+    job_list,
+    job_body,
+    job_cleanup,
+};
+
+//!
+//! \brief A process being executed on behalf of a worker.
+//!
+struct job {
+    job_type type;
+    const test_program* program;
+    test_case* tc;
+    std::string dir;
+
+    class server* srv;
+    atf_process_child_t child;
+    pid_t pid;
+    int64_t start;
+    int64_t deadline;
+    bool timed_out;
+
+    result body_result;
+    int64_t body_usec;
+};
+
+//!
+//! \brief The arguments to the child process of a job.
+//!
+struct exec_args {
+    std::string workdir;
+    std::vector< std::string > argv;
+};
+
+static void exec_job(void*) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+exec_job(void* v)
+{
+    const exec_args* args = static_cast< const exec_args* >(v);
+
+    ::setpgid(0, 0);
+    for (int signo = 1; signo < NSIG; signo++)
+        ::signal(signo, SIG_DFL);
+
+    const int fd = ::open("/dev/null", O_RDONLY);
+    if (fd == -1 || ::dup2(fd, STDIN_FILENO) == -1) {
+        std::cerr << "Cannot redirect stdin to /dev/null\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if (fd != STDIN_FILENO)
+        ::close(fd);
+
+    if (::chdir(args->workdir.c_str()) == -1) {
+        std::cerr << "Cannot enter " << args->workdir << ": "
+                  << std::strerror(errno) << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+    atf::env::set("HOME", args->workdir);
+    atf::env::set("TMPDIR", args->workdir);
+    atf::env::set("__RUNNING_INSIDE_ATF_RUN", "internal-yes-value");
+    atf::env::set("ATF_ALLOC_STATS", "yes");
+    ::umask(0022);
+
+    std::vector< char* > argv;
+    for (std::vector< std::string >::const_iterator iter =
+         args->argv.begin(); iter != args->argv.end(); iter++)
+        argv.push_back(const_cast< char* >((*iter).c_str()));
+    argv.push_back(NULL);
+
+    ::execv(argv[0], &argv[0]);
+    std::cerr << "Failed to execute " << argv[0] << ": "
+              << std::strerror(errno) << "\n";
+    std::exit(EXIT_FAILURE);
+}
+
+//!
+//! \brief A test program running in server mode.
+//!
+//! The server forks a process for every part of a test case that it is
+//! asked to run, instead of the test program being executed every time;
+//! see atf-test-program(1) for the protocol.
+//!
+class server {
+    pid_t m_pid;
+    int m_requests;
+    int m_responses;
+    std::string m_buffer;
+    std::map< pid_t, int > m_statuses;
+
+    bool read_more(void);
+    bool next_line(std::string&);
+
+public:
+    server(const pid_t, const int, const int);
+    ~server(void);
+
+    bool alive(void) const;
+    int fd(void) const;
+
+    bool wait_ready(const int);
+    std::string request(const std::string&);
+    void receive(void);
+    bool has_status(const pid_t) const;
+    bool take_status(const pid_t, int&);
+};
+
+server::server(const pid_t pid, const int requests, const int responses) :
+    m_pid(pid),
+    m_requests(requests),
+    m_responses(responses)
+{
+}
+
+server::~server(void)
+{
+    ::close(m_requests);
+    if (m_responses != -1)
+        ::close(m_responses);
+    ::kill(m_pid, SIGKILL);
+    int status;
+    while (::waitpid(m_pid, &status, 0) == -1 && errno == EINTR)
+        continue;
+}
+
+bool
+server::alive(void)
+    const
+{
+    return m_responses != -1;
+}
+
+int
+server::fd(void)
+    const
+{
+    return m_responses;
+}
+
+//!
+//! \brief Reads whatever the server has sent, blocking if it sent nothing.
+//!
+//! Returns false once the server has gone away.
+//!
+bool
+server::read_more(void)
+{
+    char buf[4096];
+    ssize_t ret;
+    while ((ret = ::read(m_responses, buf, sizeof(buf))) == -1 &&
+           errno == EINTR)
+        continue;
+    if (ret <= 0) {
+        ::close(m_responses);
+        m_responses = -1;
+        return false;
+    }
+    m_buffer.append(buf, static_cast< size_t >(ret));
+    return true;
+}
+
+//!
+//! \brief Gets the next complete response other than a termination notice.
+//!
+//! Termination notices can arrive at any time and are recorded for
+//! take_status.
+//!
+bool
+server::next_line(std::string& line)
+{
+    std::string::size_type pos;
+    while ((pos = m_buffer.find('\n')) != std::string::npos) {
+        line = m_buffer.substr(0, pos);
+        m_buffer.erase(0, pos + 1);
+
+        long pid;
+        int status;
+        if (std::sscanf(line.c_str(), "done %ld %d", &pid, &status) == 2)
+            m_statuses[static_cast< pid_t >(pid)] = status;
+        else
+            return true;
+    }
+    return false;
+}
+
+//!
+//! \brief Waits for the server to finish its initialization.
+//!
+bool
+server::wait_ready(const int timeout)
+{
+    const int64_t deadline = now_usec() + static_cast< int64_t >(timeout) *
+        1000000;
+    std::string line;
+    while (!next_line(line)) {
+        struct pollfd pfd;
+        pfd.fd = m_responses;
+        pfd.events = POLLIN;
+        const int64_t remaining = (deadline - now_usec()) / 1000;
+        if (remaining <= 0 ||
+            ::poll(&pfd, 1, static_cast< int >(remaining)) == 0 ||
+            !read_more())
+            return false;
+    }
+    return line == "ready";
+}
+
+//!
+//! \brief Sends a request and returns the response, which is empty if the
+//! server went away.
+//!
+std::string
+server::request(const std::string& text)
+{
+    std::string::size_type done = 0;
+    while (done < text.length()) {
+        const ssize_t ret = ::write(m_requests, text.c_str() + done,
+                                    text.length() - done);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return "";
+        }
+        done += static_cast< std::string::size_type >(ret);
+    }
+
+    std::string line;
+    while (!next_line(line)) {
+        if (!read_more())
+            return "";
+    }
+
+    // Record the termination notices that came along with the response.
+    std::string extra;
+    while (next_line(extra))
+        continue;
+    return line;
+}
+
+//!
+//! \brief Processes the responses of a server that became readable.
+//!
+void
+server::receive(void)
+{
+    if (read_more()) {
+        std::string line;
+        while (next_line(line))
+            continue;
+    }
+}
+
+//!
+//! \brief Checks if the server reported the termination of a process.
+//!
+bool
+server::has_status(const pid_t pid)
+    const
+{
+    return m_statuses.find(pid) != m_statuses.end();
+}
+
+//!
+//! \brief Gets the wait status of a process of the server if it finished.
+//!
+bool
+server::take_status(const pid_t pid, int& status)
+{
+    std::map< pid_t, int >::iterator iter = m_statuses.find(pid);
+    if (iter == m_statuses.end())
+        return false;
+    status = (*iter).second;
+    m_statuses.erase(iter);
+    return true;
+}
+
+//!
+//! \brief Runs test programs and test cases in parallel.
+//!
+//! All the processes are driven from a single event loop: every worker
+//! is a slot that executes one process at a time.  A test case occupies
+//! its worker until its cleanup routine, if any, has finished.
+//!
+class runner {
+    const std::map< std::string, std::string > m_config;
+    std::string m_root;
+    scheduler m_scheduler;
+    std::vector< job* > m_workers;
+    std::vector< test_program >& m_programs;
+    std::list< test_case* > m_test_cases;
+    size_t m_next_id;
+    size_t m_pending_listings;
+    bool m_exclusive_running;
+    const bool m_plan_only;
+    const bool m_use_servers;
+    std::map< const test_program*, server* > m_servers;
+    result_cache* m_cache;
+
+    size_t m_counts[result_broken + 1];
+    size_t m_total;
+
+    server* start_server(const test_program*);
+    server* server_for(const test_program*);
+    bool request_job(server*, job*);
+    void stop_servers(void);
+
+    void start_job(const size_t, std::auto_ptr< job >,
+                   const std::vector< std::string >&, const int);
+    void spawn_job(job*, const std::vector< std::string >&);
+    void start_listing(const size_t, const test_program*);
+    void start_body(const size_t, test_case*);
+    void start_cleanup(const size_t, std::auto_ptr< job >);
+
+    void finish_listing(const size_t, std::auto_ptr< job >,
+                        const atf_process_status_t*);
+    void finish_body(const size_t, std::auto_ptr< job >,
+                     const atf_process_status_t*);
+    void finish_cleanup(const size_t, std::auto_ptr< job >,
+                        const atf_process_status_t*);
+    void finish_job(const size_t, const pid_t, const atf_process_status_t*);
+
+    bool list_statically(const size_t, const test_program*);
+    void add_test_cases(const size_t, const test_program*,
+                        const std::vector< test_case* >&);
+    void listing_done(void);
+
+    void report(const std::string&, const result&, const int64_t,
+                const std::string&, const bool);
+    bool replay(test_case*);
+    void store(const job*, const result&);
+
+    void dispatch(void);
+    bool running(void) const;
+    void reap(void);
+    int poll_timeout(void) const;
+    void enforce_deadlines(void);
+    void kill_all(void);
+
+public:
+    runner(std::vector< test_program >&, const size_t, const order_type,
+           const bool, const bool,
+           const std::map< std::string, std::string >&, result_cache*);
+    ~runner(void);
+
+    bool run(void);
+};
+
+runner::runner(std::vector< test_program >& programs, const size_t workers,
+               const order_type order, const bool plan_only,
+               const bool use_servers,
+               const std::map< std::string, std::string >& config,
+               result_cache* cache) :
+    m_config(config),
+    m_scheduler(workers, order),
+    m_workers(workers, static_cast< job* >(NULL)),
+    m_programs(programs),
+    m_next_id(0),
+    m_pending_listings(0),
+    m_exclusive_running(false),
+    m_plan_only(plan_only),
+    m_use_servers(use_servers),
+    m_cache(cache),
+    m_total(0)
+{
+    std::fill(m_counts, m_counts + result_broken + 1, 0);
+}
+
+runner::~runner(void)
+{
+    kill_all();
+    stop_servers();
+    for (std::list< test_case* >::iterator iter = m_test_cases.begin();
+         iter != m_test_cases.end(); iter++)
+        delete *iter;
+    if (!m_root.empty())
+        remove_tree(m_root);
+}
+
+//!
+//! \brief Starts a test program in server mode.
+//!
+//! Returns NULL if the test program cannot act as a server, in which case
+//! it is executed for every test case as usual.
+//!
+server*
+runner::start_server(const test_program* program)
+{
+    // Scripts would run their interpreter again for every test case.
+    if (!interpreter_of(program->path).empty())
+        return NULL;
+
+    int requests[2], responses[2];
+    if (::pipe(requests) == -1)
+        throw std::runtime_error(std::string("Cannot create pipe: ") +
+                                 std::strerror(errno));
+    if (::pipe(responses) == -1) {
+        ::close(requests[0]);
+        ::close(requests[1]);
+        throw std::runtime_error(std::string("Cannot create pipe: ") +
+                                 std::strerror(errno));
+    }
+    for (int i = 0; i < 2; i++) {
+        ::fcntl(requests[i], F_SETFD, FD_CLOEXEC);
+        ::fcntl(responses[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    std::vector< std::string > args;
+    args.push_back(program->path);
+    args.push_back("-Z");
+    args.push_back("-s" + dirname_of(program->path));
+    for (std::map< std::string, std::string >::const_iterator iter =
+         m_config.begin(); iter != m_config.end(); iter++)
+        args.push_back("-v" + (*iter).first + "=" + (*iter).second);
+    std::vector< char* > argv;
+    for (std::vector< std::string >::const_iterator iter = args.begin();
+         iter != args.end(); iter++)
+        argv.push_back(const_cast< char* >((*iter).c_str()));
+    argv.push_back(NULL);
+
+    std::cout.flush();
+    std::cerr.flush();
+    const pid_t pid = ::fork();
+    if (pid == -1) {
+        for (int i = 0; i < 2; i++) {
+            ::close(requests[i]);
+            ::close(responses[i]);
+        }
+        throw std::runtime_error(std::string("Cannot fork: ") +
+                                 std::strerror(errno));
+    } else if (pid == 0) {
+        ::setpgid(0, 0);
+        for (int signo = 1; signo < NSIG; signo++)
+            ::signal(signo, SIG_DFL);
+
+        // Test programs that do not support -Z complain on stderr.
+        const int null = ::open("/dev/null", O_WRONLY);
+        if (::dup2(requests[0], STDIN_FILENO) == -1 ||
+            ::dup2(responses[1], STDOUT_FILENO) == -1 ||
+            null == -1 || ::dup2(null, STDERR_FILENO) == -1 ||
+            ::chdir(m_root.c_str()) == -1)
+            std::exit(EXIT_FAILURE);
+        ::close(null);
+        ::umask(0022);
+
+        ::execv(argv[0], &argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+    ::close(requests[0]);
+    ::close(responses[1]);
+
+    std::auto_ptr< server > srv(new server(pid, requests[1], responses[0]));
+    if (!srv->wait_ready(list_timeout))
+        return NULL;
+    return srv.release();
+}
+
+//!
+//! \brief Gets the server of a test program, starting it if necessary.
+//!
+//! Returns NULL if test cases are not run through servers or if the test
+//! program cannot act as one.
+//!
+server*
+runner::server_for(const test_program* program)
+{
+    if (!m_use_servers)
+        return NULL;
+
+    std::map< const test_program*, server* >::iterator iter =
+        m_servers.find(program);
+    if (iter == m_servers.end())
+        iter = m_servers.insert(std::make_pair(
+            program, start_server(program))).first;
+    server* srv = (*iter).second;
+    return srv != NULL && srv->alive() ? srv : NULL;
+}
+
+//!
+//! \brief Asks a server to run a part of a test case.
+//!
+//! Returns false if the server did not start it.
+//!
+bool
+runner::request_job(server* srv, job* j)
+{
+    const std::string workdir = j->dir + "/work";
+    const char* suffix = j->type == job_cleanup ? "cleanup." : "";
+
+    std::ostringstream text;
+    text << "tc " << j->tc->ident
+         << (j->type == job_cleanup ? ":cleanup" : "") << "\n";
+    if (j->type == job_body)
+        text << "resfile " << j->dir << "/result\n";
+    text << "workdir " << workdir << "\n"
+         << "stdout " << j->dir << "/" << suffix << "stdout\n"
+         << "stderr " << j->dir << "/" << suffix << "stderr\n"
+         << "env HOME=" << workdir << "\n"
+         << "env TMPDIR=" << workdir << "\n"
+         << "env __RUNNING_INSIDE_ATF_RUN=internal-yes-value\n"
+         << "env ATF_ALLOC_STATS=yes\n"
+         << "\n";
+
+    const std::string response = srv->request(text.str());
+    long pid;
+    if (std::sscanf(response.c_str(), "started %ld", &pid) != 1)
+        return false;
+
+    j->srv = srv;
+    j->pid = static_cast< pid_t >(pid);
+    return true;
+}
+
+void
+runner::stop_servers(void)
+{
+    for (std::map< const test_program*, server* >::iterator iter =
+         m_servers.begin(); iter != m_servers.end(); iter++)
+        delete (*iter).second;
+    m_servers.clear();
+}
+
+void
+runner::start_job(const size_t worker, std::auto_ptr< job > j,
+                  const std::vector< std::string >& args, const int timeout)
+{
+    PRE(m_workers[worker] == NULL);
+
+    j->srv = NULL;
+    server* srv = j->type == job_list ? NULL : server_for(j->program);
+    if (srv == NULL || !request_job(srv, j.get()))
+        spawn_job(j.get(), args);
+
+    j->start = now_usec();
+    j->deadline = timeout > 0 ?
+        j->start + static_cast< int64_t >(timeout) * 1000000 : 0;
+    j->timed_out = false;
+    m_workers[worker] = j.release();
+}
+
+//!
+//! \brief Executes the test program of a job.
+//!
+void
+runner::spawn_job(job* j, const std::vector< std::string >& args)
+{
+    exec_args eargs;
+    eargs.workdir = j->dir + "/work";
+    eargs.argv = args;
+
+    const char* suffix = j->type == job_cleanup ? "cleanup." : "";
+    atf_fs_path_t outpath, errpath;
+    atf_error_t err = atf_fs_path_init_fmt(&outpath, "%s/%sstdout",
+                                           j->dir.c_str(), suffix);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    err = atf_fs_path_init_fmt(&errpath, "%s/%sstderr", j->dir.c_str(),
+                               suffix);
+    if (atf_is_error(err)) {
+        atf_fs_path_fini(&outpath);
+        atf::throw_atf_error(err);
+    }
+
+    atf_process_stream_t outsb, errsb;
+    err = atf_process_stream_init_redirect_path(&outsb, &outpath);
+    if (!atf_is_error(err)) {
+        err = atf_process_stream_init_redirect_path(&errsb, &errpath);
+        if (!atf_is_error(err)) {
+            std::cout.flush();
+            std::cerr.flush();
+            err = atf_process_fork(&j->child, exec_job, &outsb, &errsb,
+                                   &eargs);
+            atf_process_stream_fini(&errsb);
+        }
+        atf_process_stream_fini(&outsb);
+    }
+    atf_fs_path_fini(&errpath);
+    atf_fs_path_fini(&outpath);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+
+    // Also done by the child; whoever runs first avoids a race with kill.
+    j->pid = atf_process_child_pid(&j->child);
+    ::setpgid(j->pid, j->pid);
+}
+
+void
+runner::start_listing(const size_t worker, const test_program* program)
+{
+    std::auto_ptr< job > j(new job);
+    j->type = job_list;
+    j->program = program;
+    j->tc = NULL;
+    j->dir = m_root + "/" + atf::text::to_string(m_next_id++);
+    make_directory(j->dir);
+    make_directory(j->dir + "/work");
+
+    std::vector< std::string > args;
+    args.push_back(program->path);
+    args.push_back("-l");
+    start_job(worker, j, args, list_timeout);
+}
+
+void
+runner::start_body(const size_t worker, test_case* tc)
+{
+    std::auto_ptr< job > j(new job);
+    j->type = job_body;
+    j->program = tc->program;
+    j->tc = tc;
+    j->dir = m_root + "/" + atf::text::to_string(m_next_id++);
+    make_directory(j->dir);
+    make_directory(j->dir + "/work");
+
+    std::vector< std::string > args;
+    args.push_back(tc->program->path);
+    args.push_back("-r" + j->dir + "/result");
+    args.push_back("-s" + dirname_of(tc->program->path));
+    for (std::map< std::string, std::string >::const_iterator iter =
+         m_config.begin(); iter != m_config.end(); iter++)
+        args.push_back("-v" + (*iter).first + "=" + (*iter).second);
+    args.push_back(tc->ident);
+    start_job(worker, j, args, tc->timeout);
+}
+
+void
+runner::start_cleanup(const size_t worker, std::auto_ptr< job > j)
+{
+    j->type = job_cleanup;
+
+    std::vector< std::string > args;
+    args.push_back(j->tc->program->path);
+    args.push_back("-s" + dirname_of(j->tc->program->path));
+    for (std::map< std::string, std::string >::const_iterator iter =
+         m_config.begin(); iter != m_config.end(); iter++)
+        args.push_back("-v" + (*iter).first + "=" + (*iter).second);
+    args.push_back(j->tc->ident + ":cleanup");
+    start_job(worker, j, args, j->tc->timeout);
+}
+
+void
+runner::report(const std::string& name, const result& r, const int64_t usec,
+               const std::string& dir, const bool cached)
+{
+    m_counts[r.type]++;
+    m_total++;
+
+    std::cout << name << "  ->  " << format_result(r);
+    if (cached)
+        std::cout << "  [cached]";
+    else if (usec >= 0)
+        std::cout << "  [" << format_usec(usec) << "]";
+    if (!r.allocs.empty())
+        std::cout << "  [allocations: " << r.allocs << "]";
+    std::cout << "\n";
+
+    if ((r.type == result_failed || r.type == result_broken) &&
+        !dir.empty()) {
+        static const char* files[] = {
+            "stdout", "stderr", "cleanup.stdout", "cleanup.stderr", NULL
+        };
+        for (const char** file = files; *file != NULL; file++) {
+            const std::string contents = read_file(dir + "/" + *file);
+            if (contents.empty())
+                continue;
+            std::cout << "    --- " << *file << " ---\n";
+            const std::vector< std::string > lines =
+                atf::text::split(contents, "\n");
+            for (std::vector< std::string >::const_iterator iter =
+                 lines.begin(); iter != lines.end(); iter++)
+                std::cout << "    " << *iter << "\n";
+        }
+    }
+    std::cout.flush();
+}
+
+//!
+//! \brief Reports the stored result of a test case, if any.
+//!
+bool
+runner::replay(test_case* tc)
+{
+    if (m_cache == NULL || tc->cache_key.empty())
+        return false;
+
+    result r;
+    std::string dir;
+    if (!m_cache->lookup(tc->cache_key, r, dir))
+        return false;
+    report(tc->program->name + ":" + tc->ident, r, -1, dir, true);
+    return true;
+}
+
+//!
+//! \brief Stores the result of a test case in the cache.
+//!
+//! Only passed and expected results are stored.  Failures, skips and
+//! broken results often depend on things the key does not cover, such as
+//! the PATH, the user running the tests or timeouts, so they are always
+//! run again.
+//!
+void
+runner::store(const job* j, const result& r)
+{
+    if (m_cache == NULL || j->tc->cache_key.empty() ||
+        (r.type != result_passed && r.type != result_xfail))
+        return;
+
+    try {
+        m_cache->store(j->tc->cache_key, r, j->dir);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "atf-run: WARNING: Cannot store the result of "
+                  << j->program->name << ":" << j->tc->ident << ": "
+                  << e.what() << "\n";
+    }
+}
+
+void
+runner::finish_listing(const size_t worker, std::auto_ptr< job > j,
+                       const atf_process_status_t* s)
+{
+    std::vector< test_case* > tcs;
+    std::string error;
+    if (j->timed_out)
+        error = "Test program timed out while listing its test cases";
+    else if (!atf_process_status_exited(s) ||
+             atf_process_status_exitstatus(s) != EXIT_SUCCESS)
+        error = "Test program failed to list its test cases";
+    else {
+        try {
+            std::ifstream is((j->dir + "/stdout").c_str());
+            tcs = parse_test_cases(j->program, is, m_config);
+        } catch (const std::runtime_error& e) {
+            error = std::string("Invalid list of test cases: ") + e.what();
+        }
+    }
+
+    if (!error.empty()) {
+        report(j->program->name + ":__test_cases_list__",
+               result(result_broken, error), -1, j->dir, false);
+        remove_tree(j->dir);
+        return;
+    }
+    remove_tree(j->dir);
+
+    add_test_cases(worker, j->program, tcs);
+}
+
+//!
+//! \brief Lists the test cases of a test program from the records in its
+//! binary, if it has them.
+//!
+//! Returns false if the test program has to be executed instead, which
+//! is also the way to report any problem.
+//!
+bool
+runner::list_statically(const size_t worker, const test_program* program)
+{
+    atf_dynstr_t listing;
+    bool found;
+    atf_error_t err = atf_tp_static_list(program->path.c_str(), &listing,
+                                         &found);
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        return false;
+    } else if (!found)
+        return false;
+
+    std::istringstream is(atf_dynstr_cstring(&listing));
+    atf_dynstr_fini(&listing);
+    std::vector< test_case* > tcs;
+    try {
+        tcs = parse_test_cases(program, is, m_config);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+
+    add_test_cases(worker, program, tcs);
+    listing_done();
+    return true;
+}
+
+//!
+//! \brief Queues the test cases of a test program once it has been listed.
+//!
+void
+runner::add_test_cases(const size_t worker, const test_program* program,
+                       const std::vector< test_case* >& tcs)
+{
+    if (m_cache != NULL && !m_plan_only) {
+        const std::string fingerprint = m_cache->fingerprint(
+            program->path, m_root + "/libraries");
+        for (std::vector< test_case* >::const_iterator iter = tcs.begin();
+             iter != tcs.end(); iter++)
+            (*iter)->cache_key = m_cache->key(fingerprint, *iter, m_config);
+    }
+
+    std::vector< test_case* > runnable;
+    for (std::vector< test_case* >::const_iterator iter = tcs.begin();
+         iter != tcs.end(); iter++) {
+        m_test_cases.push_back(*iter);
+        if ((*iter)->skip_reason.empty())
+            runnable.push_back(*iter);
+        else if (!m_plan_only)
+            report(program->name + ":" + (*iter)->ident,
+                   result(result_skipped, (*iter)->skip_reason), -1, "",
+                   false);
+    }
+    m_scheduler.add_test_cases(worker, runnable);
+}
+
+void
+runner::finish_body(const size_t worker, std::auto_ptr< job > j,
+                    const atf_process_status_t* s)
+{
+    j->body_result = compute_result(j->dir + "/result", s, j->timed_out);
+    j->body_result.allocs = read_allocs(j->dir + "/result");
+    j->body_usec = now_usec() - j->start;
+
+    if (j->tc->has_cleanup)
+        start_cleanup(worker, j);
+    else {
+        report(j->program->name + ":" + j->tc->ident, j->body_result,
+               j->body_usec, j->dir, false);
+        store(j.get(), j->body_result);
+        remove_tree(j->dir);
+    }
+}
+
+void
+runner::finish_cleanup(const size_t worker ATF_DEFS_ATTRIBUTE_UNUSED,
+                       std::auto_ptr< job > j, const atf_process_status_t* s)
+{
+    result r = j->body_result;
+    if (j->timed_out)
+        r = result(result_broken, "Test case cleanup timed out");
+    else if (!atf_process_status_exited(s) ||
+             atf_process_status_exitstatus(s) != EXIT_SUCCESS)
+        r = result(result_broken, "Test case cleanup did not terminate "
+                   "successfully");
+
+    report(j->program->name + ":" + j->tc->ident, r, j->body_usec, j->dir,
+           false);
+    store(j.get(), r);
+    remove_tree(j->dir);
+}
+
+void
+runner::finish_job(const size_t worker, const pid_t pid,
+                   const atf_process_status_t* s)
+{
+    std::auto_ptr< job > j(m_workers[worker]);
+    m_workers[worker] = NULL;
+
+    // Get rid of any process that the job left behind.
+    ::kill(-pid, SIGKILL);
+
+    if (j->type != job_list && j->tc->exclusive &&
+        (j->type == job_cleanup || !j->tc->has_cleanup))
+        m_exclusive_running = false;
+
+    const job_type type = j->type;
+    switch (type) {
+    case job_list: finish_listing(worker, j, s); break;
+    case job_body: finish_body(worker, j, s); break;
+    case job_cleanup: finish_cleanup(worker, j, s); break;
+    default: UNREACHABLE;
+    }
+
+    if (type == job_list)
+        listing_done();
+}
+
+//!
+//! \brief Notifies the scheduler once all test programs have been listed.
+//!
+void
+runner::listing_done(void)
+{
+    INV(m_pending_listings > 0);
+    if (--m_pending_listings == 0)
+        m_scheduler.seal();
+}
+
+void
+runner::dispatch(void)
+{
+    if (m_exclusive_running)
+        return;
+
+    for (size_t worker = 0; worker < m_workers.size(); worker++) {
+        if (m_workers[worker] != NULL)
+            continue;
+
+        const test_program* program;
+        while ((program = m_scheduler.next_listing()) != NULL &&
+               list_statically(worker, program))
+            continue;
+        if (program != NULL) {
+            start_listing(worker, program);
+            continue;
+        }
+        if (m_plan_only)
+            continue;
+
+        test_case* tc;
+        while ((tc = m_scheduler.next_test_case(worker)) != NULL &&
+               replay(tc))
+            continue;
+        if (tc != NULL)
+            start_body(worker, tc);
+    }
+
+    if (!running() && !m_plan_only) {
+        test_case* tc;
+        while ((tc = m_scheduler.next_exclusive()) != NULL && replay(tc))
+            continue;
+        if (tc != NULL) {
+            m_exclusive_running = true;
+            start_body(0, tc);
+        }
+    }
+}
+
+bool
+runner::running(void)
+    const
+{
+    for (size_t worker = 0; worker < m_workers.size(); worker++) {
+        if (m_workers[worker] != NULL)
+            return true;
+    }
+    return false;
+}
+
+void
+runner::reap(void)
+{
+    for (size_t worker = 0; worker < m_workers.size(); worker++) {
+        job* j = m_workers[worker];
+        if (j == NULL)
+            continue;
+
+        if (j->srv != NULL) {
+            int raw;
+            if (!j->srv->take_status(j->pid, raw)) {
+                if (j->srv->alive())
+                    continue;
+                // The server went away with the process, so report it as
+                // killed using the status encoding common to all Unixes.
+                ::kill(-j->pid, SIGKILL);
+                raw = SIGKILL;
+            }
+            atf_process_status_t status;
+            atf_error_t err = atf_process_status_init_raw(&status, raw);
+            if (atf_is_error(err))
+                atf::throw_atf_error(err);
+            finish_job(worker, j->pid, &status);
+            atf_process_status_fini(&status);
+            continue;
+        }
+
+        // The child is not valid any more once reaped.
+        const pid_t pid = j->pid;
+        atf_process_status_t status;
+        bool done;
+        atf_error_t err = atf_process_child_try_wait(&j->child, &status,
+                                                     &done);
+        if (atf_is_error(err))
+            atf::throw_atf_error(err);
+        if (!done)
+            continue;
+
+        finish_job(worker, pid, &status);
+        atf_process_status_fini(&status);
+    }
+}
+
+int
+runner::poll_timeout(void)
+    const
+{
+    int64_t nearest = -1;
+    for (size_t worker = 0; worker < m_workers.size(); worker++) {
+        const job* j = m_workers[worker];
+        // Servers may have reported a termination while answering a
+        // request, so there would be nothing left to wake us up.
+        if (j != NULL && j->srv != NULL &&
+            (!j->srv->alive() || j->srv->has_status(j->pid)))
+            return 0;
+        if (j != NULL && j->deadline > 0 && !j->timed_out &&
+            (nearest == -1 || j->deadline < nearest))
+            nearest = j->deadline;
+    }
+    if (nearest == -1)
+        return -1;
+
+    const int64_t remaining = (nearest - now_usec() + 999) / 1000;
+    return remaining < 0 ? 0 : static_cast< int >(remaining);
+}
+
+void
+runner::enforce_deadlines(void)
+{
+    const int64_t now = now_usec();
+    for (size_t worker = 0; worker < m_workers.size(); worker++) {
+        job* j = m_workers[worker];
+        if (j != NULL && j->deadline > 0 && !j->timed_out &&
+            now >= j->deadline) {
+            j->timed_out = true;
+            ::kill(-j->pid, SIGKILL);
+        }
+    }
+}
+
+void
+runner::kill_all(void)
+{
+    for (size_t worker = 0; worker < m_workers.size(); worker++) {
+        job* j = m_workers[worker];
+        if (j == NULL)
+            continue;
+
+        const pid_t pid = j->pid;
+        ::kill(-pid, SIGKILL);
+        if (j->srv == NULL) {
+            atf_process_status_t status;
+            atf_error_t err = atf_process_child_wait(&j->child, &status);
+            if (atf_is_error(err))
+                atf_error_free(err);
+            else
+                atf_process_status_fini(&status);
+            ::kill(-pid, SIGKILL);
+        }
+        delete j;
+        m_workers[worker] = NULL;
+    }
+}
+
+bool
+runner::run(void)
+{
+    const int64_t start = now_usec();
+
+    const std::string tmpdir = atf::env::get("TMPDIR", "/tmp") +
+        "/atf-run.XXXXXX";
+    std::vector< char > buf(tmpdir.begin(), tmpdir.end());
+    buf.push_back('\0');
+    if (::mkdtemp(&buf[0]) == NULL)
+        throw std::runtime_error("Cannot create a temporary directory in " +
+                                 atf::env::get("TMPDIR", "/tmp") + ": " +
+                                 std::strerror(errno));
+    m_root = &buf[0];
+    if (m_root[0] != '/')
+        m_root = join_path(current_directory(), m_root);
+
+    for (std::vector< test_program >::iterator iter = m_programs.begin();
+         iter != m_programs.end(); iter++)
+        m_scheduler.add_listing(&(*iter));
+    m_pending_listings = m_programs.size();
+
+    dispatch();
+    while (running() && interrupted_by == 0) {
+        std::vector< struct pollfd > pfds(1);
+        pfds[0].fd = signal_pipe[0];
+        pfds[0].events = POLLIN;
+        std::vector< server* > servers;
+        for (std::map< const test_program*, server* >::const_iterator iter =
+             m_servers.begin(); iter != m_servers.end(); iter++) {
+            if ((*iter).second != NULL && (*iter).second->alive()) {
+                struct pollfd pfd;
+                pfd.fd = (*iter).second->fd();
+                pfd.events = POLLIN;
+                pfds.push_back(pfd);
+                servers.push_back((*iter).second);
+            }
+        }
+        if (::poll(&pfds[0], pfds.size(), poll_timeout()) == -1 &&
+            errno != EINTR)
+            throw std::runtime_error(std::string("poll failed: ") +
+                                     std::strerror(errno));
+
+        char drain[64];
+        while (::read(signal_pipe[0], drain, sizeof(drain)) > 0)
+            continue;
+        if (interrupted_by != 0)
+            break;
+
+        for (size_t i = 0; i < servers.size(); i++) {
+            if (pfds[i + 1].revents != 0)
+                servers[i]->receive();
+        }
+
+        reap();
+        enforce_deadlines();
+        dispatch();
+    }
+
+    stop_servers();
+    if (interrupted_by != 0) {
+        kill_all();
+        std::cerr << "atf-run: Interrupted by signal " << interrupted_by
+                  << "; killed all running test cases\n";
+        return false;
+    }
+
+    if (m_plan_only) {
+        if (m_total > 0)
+            std::cout << "\n";
+        m_scheduler.print_plan(std::cout);
+        return m_counts[result_broken] == 0;
+    }
+
+    std::cout << "\n" << m_total << " test cases: "
+              << m_counts[result_passed] << " passed, "
+              << m_counts[result_failed] << " failed, "
+              << m_counts[result_skipped] << " skipped, "
+              << m_counts[result_xfail] << " expected failures, "
+              << m_counts[result_broken] << " broken "
+              << "(" << format_usec(now_usec() - start) << " with "
+              << m_workers.size() << " workers)\n";
+    if (m_cache != NULL)
+        m_cache->print_stats(std::cout);
+    return m_counts[result_failed] == 0 && m_counts[result_broken] == 0;
+}
+
+//!
+//! \brief Sets up the signal handlers that feed the event loop.
+//!
+static
+void
+install_signal_handlers(void)
+{
+    if (::pipe(signal_pipe) == -1)
+        throw std::runtime_error(std::string("Cannot create pipe: ") +
+                                 std::strerror(errno));
+    for (int i = 0; i < 2; i++) {
+        ::fcntl(signal_pipe[i], F_SETFL,
+                ::fcntl(signal_pipe[i], F_GETFL) | O_NONBLOCK);
+        ::fcntl(signal_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    // A server that dies must not take the runner with it.
+    ::signal(SIGPIPE, SIG_IGN);
+
+    static const int signals[] = { SIGCHLD, SIGHUP, SIGINT, SIGTERM, 0 };
+    for (const int* signo = signals; *signo != 0; signo++) {
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = notify_signal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        if (::sigaction(*signo, &sa, NULL) == -1)
+            throw std::runtime_error(std::string("Cannot program signal "
+                                                 "handler: ") +
+                                     std::strerror(errno));
+    }
+}
+
+static
+size_t
+default_workers(void)
+{
+    const long ncpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return ncpus > 0 ? static_cast< size_t >(ncpus) : 1;
+}
+
+} // anonymous namespace
+
+// ------------------------------------------------------------------------
+// The "atf_run" class.
+// ------------------------------------------------------------------------
+
+class atf_run : public atf::application::app {
+    static const char* m_description;
+
+    size_t m_workers;
+    order_type m_order;
+    bool m_plan_only;
+    bool m_use_servers;
+    std::string m_history;
+    std::string m_cache;
+    bool m_invalidate;
+    std::map< std::string, std::string > m_config;
+
+    std::string specific_args(void) const;
+    options_set specific_options(void) const;
+    void process_option(int, const char*);
+
+public:
+    atf_run(void);
+
+    int main(void);
+};
+
+const char* atf_run::m_description =
+    "atf-run runs the test cases of the test programs defined by a tree "
+    "of Kyuafiles in parallel and reports their results as they finish.";
+
+atf_run::atf_run(void) :
+    app(m_description, "atf-run(1)"),
+    m_workers(default_workers()),
+    m_order(order_locality),
+    m_plan_only(false),
+    m_use_servers(false),
+    m_invalidate(false)
+{
+}
+
+std::string
+atf_run::specific_args(void)
+    const
+{
+    return "[kyuafile ...]";
+}
+
+atf_run::options_set
+atf_run::specific_options(void)
+    const
+{
+    using atf::application::option;
+    options_set opts;
+
+    opts.insert(option('C', "dir", "Reuses the results of unchanged test "
+                       "cases stored in the given directory"));
+    opts.insert(option('H', "file", "Records the durations of the test "
+                       "cases in the given history file"));
+    opts.insert(option('I', "", "Discards all the results stored in the "
+                       "cache before running"));
+    opts.insert(option('j', "workers", "Number of test cases to run in "
+                       "parallel; default: the number of CPUs"));
+    opts.insert(option('o', "order", "Order in which to distribute the test "
+                       "cases: locality or lpt; default: locality"));
+    opts.insert(option('P', "", "Prints the planned distribution of the "
+                       "test cases without running them"));
+    opts.insert(option('v', "var=value", "Sets the configuration variable "
+                       "`var' to `value'"));
+    opts.insert(option('Z', "", "Runs the test cases of every C and C++ "
+                       "test program through a single server process"));
+
+    return opts;
+}
+
+void
+atf_run::process_option(int ch, const char* arg)
+{
+    switch (ch) {
+    case 'C':
+        m_cache = arg;
+        break;
+
+    case 'H':
+        m_history = arg;
+        break;
+
+    case 'I':
+        m_invalidate = true;
+        break;
+
+    case 'j':
+        try {
+            const int workers = atf::text::to_type< int >(arg);
+            if (workers < 1)
+                throw std::runtime_error("");
+            m_workers = static_cast< size_t >(workers);
+        } catch (const std::runtime_error&) {
+            throw atf::application::usage_error("Invalid number of workers "
+                                                "'%s'", arg);
+        }
+        break;
+
+    case 'o':
+        if (std::strcmp(arg, "locality") == 0)
+            m_order = order_locality;
+        else if (std::strcmp(arg, "lpt") == 0)
+            m_order = order_lpt;
+        else
+            throw atf::application::usage_error("Invalid order '%s'", arg);
+        break;
+
+    case 'P':
+        m_plan_only = true;
+        break;
+
+    case 'Z':
+        m_use_servers = true;
+        break;
+
+    case 'v': {
+        const std::string var(arg);
+        const std::string::size_type pos = var.find('=');
+        if (pos == std::string::npos || pos == 0)
+            throw atf::application::usage_error("Invalid variable "
+                                                "definition '%s'", arg);
+        m_config[var.substr(0, pos)] = var.substr(pos + 1);
+        break;
+    }
+
+    default:
+        UNREACHABLE;
+    }
+}
+
+int
+atf_run::main(void)
+{
+    std::vector< std::string > kyuafiles;
+    for (int i = 0; i < m_argc; i++)
+        kyuafiles.push_back(m_argv[i]);
+    if (kyuafiles.empty())
+        kyuafiles.push_back("Kyuafile");
+
+    if (m_invalidate && m_cache.empty())
+        throw atf::application::usage_error("-I requires a cache directory "
+                                            "given with -C");
+
+    const std::string cwd = current_directory();
+
+    // Test cases run in their own directories, so they need an absolute
+    // path to the history.
+    if (!m_history.empty())
+        atf::env::set("ATF_HISTORY_FILE", join_path(cwd, m_history));
+    else if (atf::env::has("ATF_HISTORY_FILE") &&
+             !atf::env::get("ATF_HISTORY_FILE").empty())
+        atf::env::set("ATF_HISTORY_FILE", join_path(
+            cwd, atf::env::get("ATF_HISTORY_FILE")));
+
+    std::vector< test_program > programs;
+    for (std::vector< std::string >::const_iterator iter = kyuafiles.begin();
+         iter != kyuafiles.end(); iter++) {
+        std::string kyuafile = *iter;
+        struct stat sb;
+        if (::stat(kyuafile.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode))
+            kyuafile = join_path(kyuafile, "Kyuafile");
+        load_kyuafile(join_path(cwd, kyuafile), dirname_of(kyuafile),
+                      programs);
+    }
+    if (programs.empty())
+        throw std::runtime_error("No test programs found");
+
+    std::auto_ptr< result_cache > cache;
+    if (!m_cache.empty()) {
+        cache.reset(new result_cache(join_path(cwd, m_cache)));
+        if (m_invalidate)
+            cache->invalidate();
+    }
+
+    install_signal_handlers();
+    runner r(programs, m_workers, m_order, m_plan_only, m_use_servers,
+             m_config, cache.get());
+    const bool ok = r.run();
+    if (interrupted_by != 0) {
+        ::signal(interrupted_by, SIG_DFL);
+        ::kill(::getpid(), interrupted_by);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int
+main(int argc, char* const* argv)
+{
+    return atf_run().run(argc, argv);
+}
@@ -0,0 +1,516 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+: ${ATF_SH:="__ATF_SH__"}
+: ${ATF_RUN:="__ATF_RUN__"}
+
+create_test_program() {
+    local output="${1}"; shift
+    echo "#! ${ATF_SH}" >"${output}"
+    cat >>"${output}"
+    chmod +x "${output}"
+}
+
+atf_test_case discovery
+discovery_head()
+{
+    atf_set "descr" "Verifies that test programs are discovered from a" \
+        "tree of Kyuafiles"
+}
+discovery_body()
+{
+    mkdir -p root/sub
+    cat >root/Kyuafile <<EOF
+syntax("kyuafile", 1)
+
+test_suite("discovery")
+
+-- atf_test_program{name="commented_test"}
+atf_test_program{name="first_test"}
+include("sub/Kyuafile")
+plain_test_program{name="plain_test"}
+EOF
+    cat >root/sub/Kyuafile <<EOF
+syntax("kyuafile", 1)
+test_suite("discovery")
+atf_test_program{name='second_test', timeout=10}
+EOF
+    for tp in root/first_test root/sub/second_test; do
+        create_test_program "${tp}" <<EOF
+atf_test_case a
+a_body() { :; }
+atf_test_case b
+b_body() { :; }
+atf_init_test_cases() {
+    atf_add_test_case a
+    atf_add_test_case b
+}
+EOF
+    done
+
+    atf_check -o match:'^first_test:a  ->  passed  \[' \
+        -o match:'^first_test:b  ->  passed  \[' \
+        -o match:'^sub/second_test:a  ->  passed  \[' \
+        -o match:'^sub/second_test:b  ->  passed  \[' \
+        -o match:'^4 test cases: 4 passed, 0 failed' \
+        -e match:'skipping plain_test_program' \
+        -x "cd root && ${ATF_RUN}"
+
+    atf_check -o match:'^root/sub/second_test:a  ->  passed' \
+        -o match:'^4 test cases' -e ignore "${ATF_RUN}" root
+}
+
+atf_test_case results
+results_head()
+{
+    atf_set "descr" "Verifies that all the test results are reported and" \
+        "that the exit status reflects them"
+}
+results_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case pass
+pass_body() { :; }
+atf_test_case fail
+fail_body() { echo "some diagnostics" 1>&2; atf_fail "Failed on purpose"; }
+atf_test_case skip
+skip_body() { atf_skip "Skipped on purpose"; }
+atf_test_case xfail
+xfail_body() { atf_expect_fail "Known bug"; atf_fail "The bug"; }
+atf_test_case crash
+crash_body() { kill -9 \$\$; }
+atf_test_case skip_progs
+skip_progs_head() { atf_set "require.progs" "non-existent-program"; }
+skip_progs_body() { atf_fail "Should not run"; }
+atf_test_case config
+config_head() { atf_set "require.config" "the-var"; }
+config_body() { atf_check_equal "\$(atf_config_get the-var)" "the-value"; }
+atf_init_test_cases() {
+    for tc in pass fail skip xfail crash skip_progs config; do
+        atf_add_test_case \${tc}
+    done
+}
+EOF
+
+    atf_check -s exit:1 -o match:'^tp:pass  ->  passed' \
+        -o match:'^tp:fail  ->  failed: Failed on purpose' \
+        -o match:'^    some diagnostics$' \
+        -o match:'^tp:skip  ->  skipped: Skipped on purpose' \
+        -o match:'^tp:xfail  ->  expected_failure: Known bug: The bug' \
+        -o match:'^tp:crash  ->  broken: Premature exit' \
+        -o match:"^tp:skip_progs  ->  skipped: Required program 'non-exist" \
+        -o match:"^tp:config  ->  skipped: Required configuration" \
+        -o match:'^7 test cases: 1 passed, 1 failed, 3 skipped, 1 expected failures, 1 broken' \
+        "${ATF_RUN}"
+
+    atf_check -s exit:1 -o match:'^tp:config  ->  passed' \
+        "${ATF_RUN}" -v the-var=the-value
+}
+
+atf_test_case broken_program
+broken_program_head()
+{
+    atf_set "descr" "Verifies that test programs that cannot be listed" \
+        "are reported as broken"
+}
+broken_program_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    cat >tp <<EOF
+#! /bin/sh
+echo "Cannot list" 1>&2
+exit 1
+EOF
+    chmod +x tp
+
+    atf_check -s exit:1 -o match:'^tp:__test_cases_list__  ->  broken' \
+        -o match:'^    Cannot list$' "${ATF_RUN}"
+}
+
+atf_test_case isolation
+isolation_head()
+{
+    atf_set "descr" "Verifies that every test case runs in its own work" \
+        "directory with a clean environment"
+}
+isolation_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case a
+a_body() {
+    [ ! -f cookie ] || atf_fail "Work directory reused"
+    touch cookie
+    atf_check_equal "\$(pwd)" "\${HOME}"
+    atf_check_equal "\$(pwd)" "\${TMPDIR}"
+    [ /dev/stdin -ef /dev/null ] || atf_fail "stdin is not /dev/null"
+    pwd >>"$(pwd)/workdirs"
+}
+atf_test_case b
+b_body() { a_body; }
+atf_init_test_cases() {
+    atf_add_test_case a
+    atf_add_test_case b
+}
+EOF
+
+    atf_check -o match:'^2 test cases: 2 passed' "${ATF_RUN}" -j 1
+    atf_check -o inline:'2\n' -x 'sort -u workdirs | wc -l | tr -d " "'
+    for dir in $(cat workdirs); do
+        atf_check -s exit:1 test -d "${dir}"
+    done
+}
+
+atf_test_case cleanup
+cleanup_head()
+{
+    atf_set "descr" "Verifies that the cleanup routine runs in the work" \
+        "directory of the body and that its failures are reported"
+}
+cleanup_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case good cleanup
+good_body() { touch cookie; }
+good_cleanup() { test -f cookie && touch "$(pwd)/cleaned"; }
+atf_test_case bad cleanup
+bad_body() { :; }
+bad_cleanup() { exit 1; }
+atf_init_test_cases() {
+    atf_add_test_case good
+    atf_add_test_case bad
+}
+EOF
+
+    atf_check -s exit:1 -o match:'^tp:good  ->  passed' \
+        -o match:'^tp:bad  ->  broken: Test case cleanup did not terminate' \
+        "${ATF_RUN}"
+    atf_check test -f cleaned
+}
+
+atf_test_case timeout
+timeout_head()
+{
+    atf_set "descr" "Verifies that test cases are killed when they exceed" \
+        "their timeout, together with their subprocesses"
+}
+timeout_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case hang
+hang_head() { atf_set "timeout" "1"; }
+hang_body() { sleep 60 & echo \$! >"$(pwd)/pid"; wait; }
+atf_test_case expected
+expected_head() { atf_set "timeout" "1"; }
+expected_body() { atf_expect_timeout "Hangs on purpose"; sleep 60; }
+atf_init_test_cases() {
+    atf_add_test_case hang
+    atf_add_test_case expected
+}
+EOF
+
+    atf_check -s exit:1 \
+        -o match:'^tp:hang  ->  broken: Test case body timed out' \
+        -o match:'^tp:expected  ->  expected_failure: Hangs on purpose' \
+        "${ATF_RUN}"
+
+    # The killed process may linger as a zombie until init reaps it.
+    state=$(ps -o stat= -p "$(cat pid)" || true)
+    case "${state}" in
+        ''|Z*) ;;
+        *) atf_fail "Subprocess of the test case is still alive" ;;
+    esac
+}
+
+atf_test_case parallel
+parallel_head()
+{
+    atf_set "descr" "Verifies that the test cases of a single test program" \
+        "run in parallel across the workers"
+}
+parallel_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    {
+        for i in 1 2 3 4 5 6 7 8; do
+            echo "atf_test_case tc${i}"
+            echo "tc${i}_body() { sleep 1; }"
+        done
+        echo "atf_init_test_cases() {"
+        for i in 1 2 3 4 5 6 7 8; do
+            echo "    atf_add_test_case tc${i}"
+        done
+        echo "}"
+    } | create_test_program tp
+
+    start=$(date +%s)
+    atf_check -o match:'^8 test cases: 8 passed.* with 8 workers' \
+        "${ATF_RUN}" -j 8
+    end=$(date +%s)
+    echo "Took $((${end} - ${start})) seconds"
+    [ $((${end} - ${start})) -lt 5 ] || \
+        atf_fail "Test cases did not run in parallel"
+}
+
+atf_test_case exclusive
+exclusive_head()
+{
+    atf_set "descr" "Verifies that exclusive test cases do not run" \
+        "concurrently with any other test case"
+}
+exclusive_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case alone
+alone_head() { atf_set "is.exclusive" "true"; }
+alone_body() {
+    ! ls "$(pwd)" | grep running || atf_fail "Not running alone"
+    touch "$(pwd)/ran-alone"
+}
+atf_test_case other1
+other1_body() {
+    touch "$(pwd)/running.\${1}"
+    sleep 1
+    rm "$(pwd)/running.\${1}"
+}
+atf_test_case other2
+other2_body() { other1_body 2; }
+atf_test_case other3
+other3_body() { other1_body 3; }
+atf_init_test_cases() {
+    atf_add_test_case alone
+    atf_add_test_case other1
+    atf_add_test_case other2
+    atf_add_test_case other3
+}
+EOF
+    atf_check -o match:'^4 test cases: 4 passed' "${ATF_RUN}" -j 4
+    atf_check test -f ran-alone
+}
+
+atf_test_case plan_lpt
+plan_lpt_head()
+{
+    atf_set "descr" "Verifies that the longest-first order packs the test" \
+        "cases onto the workers according to their duration hints"
+}
+plan_lpt_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case short1
+short1_head() { atf_set "X-duration-hint-ms" "1000"; }
+short1_body() { :; }
+atf_test_case short2
+short2_head() { atf_set "X-duration-hint-ms" "1000"; }
+short2_body() { :; }
+atf_test_case unknown
+unknown_body() { :; }
+atf_test_case long
+long_head() { atf_set "X-duration-hint-ms" "4000"; }
+long_body() { :; }
+atf_init_test_cases() {
+    atf_add_test_case short1
+    atf_add_test_case short2
+    atf_add_test_case unknown
+    atf_add_test_case long
+}
+EOF
+
+    cat >expout <<EOF
+Worker 1: 1 test cases  [4.000s]
+    tp:long  [4.000s]
+Worker 2: 3 test cases  [4.000s]
+    tp:unknown  [2.000s]
+    tp:short1  [1.000s]
+    tp:short2  [1.000s]
+
+Predicted wall time: 4.000s
+EOF
+    atf_check -o file:expout "${ATF_RUN}" -j 2 -o lpt -P
+
+    atf_check -o match:'^4 test cases: 4 passed.* with 2 workers' \
+        "${ATF_RUN}" -j 2 -o lpt
+}
+
+atf_test_case history
+history_head()
+{
+    atf_set "descr" "Verifies that the durations recorded in a history" \
+        "file are used to plan later runs"
+}
+history_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case fast
+fast_body() { :; }
+atf_test_case slow
+slow_body() { sleep 1; }
+atf_init_test_cases() {
+    atf_add_test_case fast
+    atf_add_test_case slow
+}
+EOF
+
+    atf_check -o match:'^2 test cases: 2 passed' "${ATF_RUN}" -H history
+    atf_check test -f history
+    atf_check -o match:'^Worker 1: 1 test cases  \[1\.' \
+        -o match:'^    tp:slow  \[1\.' -o match:'^Predicted wall time: 1\.' \
+        "${ATF_RUN}" -H history -j 2 -o lpt -P
+}
+
+atf_test_case cache
+cache_head()
+{
+    atf_set "descr" "Verifies that the results of test cases whose inputs" \
+        "did not change are taken from the cache"
+}
+cache_body()
+{
+    echo 'atf_test_program{name="tp"}' >Kyuafile
+    create_test_program tp <<EOF
+atf_test_case input
+input_head() { atf_set "X-inputs" "data"; }
+input_body() {
+    echo input >>\$(atf_get_srcdir)/runs
+    atf_check_equal "\$(cat \$(atf_get_srcdir)/data)" 1
+}
+atf_test_case plain
+plain_body() { echo plain >>\$(atf_get_srcdir)/runs; }
+atf_test_case missing
+missing_head() { atf_set "require.files" "/non-existent-file"; }
+missing_body() { atf_fail "Should not run"; }
+atf_init_test_cases() {
+    atf_add_test_case input
+    atf_add_test_case plain
+    atf_add_test_case missing
+}
+EOF
+    echo 1 >data
+
+    atf_check -o match:'^tp:input  ->  passed  \[[0-9]' \
+        -o match:"^tp:missing  ->  skipped: Required file '/non-existent" \
+        -o match:'^Result cache: 0 hits, 2 misses, 2 stored' \
+        "${ATF_RUN}" -C cache
+    atf_check -o inline:'input\nplain\n' sort runs
+
+    atf_check -o match:'^tp:input  ->  passed  \[cached\]' \
+        -o match:'^tp:plain  ->  passed  \[cached\]' \
+        -o match:'^3 test cases: 2 passed, 0 failed, 1 skipped' \
+        -o match:'^Result cache: 2 hits, 0 misses, 0 stored' \
+        "${ATF_RUN}" -C cache
+    atf_check -o inline:'input\nplain\n' sort runs
+
+    echo 2 >data
+    atf_check -s exit:1 -o match:'^tp:input  ->  failed' \
+        -o match:'^tp:plain  ->  passed  \[cached\]' \
+        -o match:'^Result cache: 1 hits, 1 misses, 0 stored' \
+        "${ATF_RUN}" -C cache
+    atf_check -s exit:1 -o match:'^tp:input  ->  failed: .*  \[[0-9]' \
+        -o match:'^Result cache: 1 hits, 1 misses, 0 stored' \
+        "${ATF_RUN}" -C cache
+
+    atf_check -s exit:1 -o match:'^Result cache: 0 hits, 2 misses, 1 stored' \
+        "${ATF_RUN}" -C cache -v foo=bar
+
+    atf_check -s exit:1 -o match:'^Result cache: 0 hits, 2 misses' \
+        "${ATF_RUN}" -C cache -I
+    atf_check -o inline:'5\n' grep -c input runs
+    atf_check -o inline:'3\n' grep -c plain runs
+}
+
+atf_test_case servers
+servers_head()
+{
+    atf_set "descr" "Verifies that running test cases through servers" \
+        "gives the same results as executing the test programs"
+}
+servers_body()
+{
+    srcdir="$(atf_get_srcdir)/.."
+    cp "${srcdir}/atf-c/detail/sha256_test" \
+        "${srcdir}/atf-c++/macros_static_test" .
+    cat >Kyuafile <<EOF
+syntax("kyuafile", 1)
+test_suite("servers")
+atf_test_program{name="sha256_test"}
+atf_test_program{name="macros_static_test"}
+atf_test_program{name="script"}
+EOF
+    create_test_program script <<EOF
+atf_test_case config
+config_body() { atf_check_equal "\$(atf_config_get the-var)" "the-value"; }
+atf_init_test_cases() { atf_add_test_case config; }
+EOF
+
+    for flags in "" "-Z"; do
+        atf_check -o save:stdout "${ATF_RUN}" -j 4 ${flags} \
+            -v the-var=the-value
+        sed -n 's/  \[.*//p' stdout | sort >results${flags}
+    done
+    atf_check -o match:'^script:config  ->  passed$' cat results
+    atf_check -o file:results cat results-Z
+}
+
+atf_test_case usage_errors
+usage_errors_head()
+{
+    atf_set "descr" "Verifies the handling of invalid arguments"
+}
+usage_errors_body()
+{
+    atf_check -s exit:1 -e match:'Invalid number of workers' \
+        "${ATF_RUN}" -j 0
+    atf_check -s exit:1 -e match:'Invalid variable definition' \
+        "${ATF_RUN}" -v foo
+    atf_check -s exit:1 -e match:"Invalid order 'foo'" "${ATF_RUN}" -o foo
+    atf_check -s exit:1 -e match:'-I requires a cache directory' \
+        "${ATF_RUN}" -I
+    atf_check -s exit:1 -e match:'Cannot open .*/Kyuafile' "${ATF_RUN}"
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case discovery
+    atf_add_test_case results
+    atf_add_test_case broken_program
+    atf_add_test_case isolation
+    atf_add_test_case cleanup
+    atf_add_test_case timeout
+    atf_add_test_case parallel
+    atf_add_test_case exclusive
+    atf_add_test_case plan_lpt
+    atf_add_test_case history
+    atf_add_test_case cache
+    atf_add_test_case servers
+    atf_add_test_case usage_errors
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
@@ -25,24 +25,37 @@
 
 extern "C" {
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <unistd.h>
 }
 
+#include <algorithm>
 #include <cerrno>
+#include <deque>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <ios>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <memory>
+#include <sstream>
 #include <utility>
 
+extern "C" {
+#include "atf-c/defs.h"
+#include "atf-c/detail/sha256.h"
+}
+
 #include "atf-c++/check.hpp"
 #include "atf-c++/detail/application.hpp"
 #include "atf-c++/detail/auto_array.hpp"
@@ -85,7 +98,9 @@ enum output_check_t {
     oc_file,
     oc_empty,
     oc_match,
-    oc_save
+    oc_save,
+    oc_sha256,
+    oc_size
 };
 
 struct output_check {
@@ -102,6 +117,51 @@ struct output_check {
     }
 };
 
+enum resource_check_t {
+    rc_cpu,
+    rc_maxrss,
+    rc_wall,
+};
+
+struct resource_check {
+    resource_check_t type;
+    bool at_most;
+    int64_t value;
+    std::string spec;
+
+    resource_check(const resource_check_t& p_type, const bool p_at_most,
+                   const int64_t p_value, const std::string& p_spec) :
+        type(p_type),
+        at_most(p_at_most),
+        value(p_value),
+        spec(p_spec)
+    {
+    }
+};
+
+struct baseline_check {
+    std::string path;
+    double tolerance;
+
+    baseline_check(const std::string& p_path, const double p_tolerance) :
+        path(p_path),
+        tolerance(p_tolerance)
+    {
+    }
+};
+
+struct manifest_entry {
+    std::string::size_type line;
+    std::vector< std::string > args;
+
+    manifest_entry(const std::string::size_type p_line,
+                   const std::vector< std::string >& p_args) :
+        line(p_line),
+        args(p_args)
+    {
+    }
+};
+
 class temp_file : public std::ostream {
     std::auto_ptr< atf::fs::path > m_path;
     int m_fd;
@@ -300,10 +360,211 @@ parse_output_check_arg(const std::string& arg)
         if (negated)
             throw atf::application::usage_error("Cannot negate save checker");
         type = oc_save;
-    } else
+    } else if (action == "sha256")
+        type = oc_sha256;
+    else if (action == "size")
+        type = oc_size;
+    else
         throw atf::application::usage_error("Invalid output checker");
 
-    return output_check(type, negated, arg.substr(delimiter + 1));
+    std::string value = arg.substr(delimiter + 1);
+    if (type == oc_sha256) {
+        value = atf::text::to_lower(value);
+        if (delimiter == std::string::npos ||
+            value.length() != ATF_SHA256_HEX_LENGTH - 1 ||
+            value.find_first_not_of("0123456789abcdef") != std::string::npos)
+            throw atf::application::usage_error("Invalid SHA-256 digest "
+                "'%s'", value.c_str());
+    } else if (type == oc_size) {
+        if (delimiter == std::string::npos)
+            throw atf::application::usage_error("Missing size in output "
+                "checker");
+        try {
+            std::ostringstream str;
+            str << atf::text::to_bytes(value);
+            value = str.str();
+        } catch (const std::runtime_error&) {
+            throw atf::application::usage_error("Invalid size '%s' in output "
+                "checker", value.c_str());
+        }
+    }
+
+    return output_check(type, negated, value);
+}
+
+static
+int64_t
+parse_time(const std::string& str)
+{
+    std::string number = str;
+    double factor = 1000000.0;
+    if (number.length() > 2 && number.substr(number.length() - 2) == "ms") {
+        number.erase(number.length() - 2);
+        factor = 1000.0;
+    } else if (number.length() > 1 && number[number.length() - 1] == 's') {
+        number.erase(number.length() - 1);
+    }
+
+    try {
+        const double value = atf::text::to_type< double >(number);
+        // Written so that NaN is rejected too.  The limit converts exactly
+        // to 2^63, so any smaller product fits in an int64_t.
+        const double limit = static_cast< double >(
+            std::numeric_limits< int64_t >::max());
+        if (!(value >= 0 && value * factor < limit))
+            throw std::runtime_error("Unused reason");
+        return static_cast< int64_t >(value * factor);
+    } catch (const std::runtime_error&) {
+        throw atf::application::usage_error("Invalid time '%s' in -r option; "
+            "must be a non-negative number of seconds with an optional s or "
+            "ms suffix", str.c_str());
+    }
+}
+
+static
+resource_check
+parse_resource_check_arg(const std::string& arg)
+{
+    std::string::size_type delimiter = arg.find("<=");
+    bool at_most = true;
+    if (delimiter == std::string::npos) {
+        delimiter = arg.find(">=");
+        at_most = false;
+    }
+    if (delimiter == std::string::npos)
+        throw atf::application::usage_error("Invalid resource checker; "
+            "must be of the form name<=value or name>=value");
+
+    const std::string name = arg.substr(0, delimiter);
+    const std::string value_str = arg.substr(delimiter + 2);
+
+    resource_check_t type;
+    int64_t value;
+    if (name == "cpu") {
+        type = rc_cpu;
+        value = parse_time(value_str);
+    } else if (name == "maxrss") {
+        type = rc_maxrss;
+        try {
+            value = atf::text::to_bytes(value_str);
+        } catch (const std::runtime_error&) {
+            throw atf::application::usage_error("Invalid size '%s' in -r "
+                "option", value_str.c_str());
+        }
+    } else if (name == "wall") {
+        type = rc_wall;
+        value = parse_time(value_str);
+    } else
+        throw atf::application::usage_error("Invalid resource checker");
+
+    return resource_check(type, at_most, value, arg);
+}
+
+static
+int
+parse_count(const std::string& str, const char option, const int min)
+{
+    try {
+        const int value = atf::text::to_type< int >(str);
+        if (value < min)
+            throw std::runtime_error("Unused reason");
+        return value;
+    } catch (const std::runtime_error&) {
+        throw atf::application::usage_error("Invalid count for -%c option; "
+            "must be an integer greater than or equal to %d", option, min);
+    }
+}
+
+static
+baseline_check
+parse_baseline_arg(const std::string& arg)
+{
+    const std::string::size_type delimiter = arg.rfind(':');
+    if (delimiter != std::string::npos && delimiter + 1 < arg.length() &&
+        arg[arg.length() - 1] == '%') {
+        const std::string tolerance_str = arg.substr(delimiter + 1,
+            arg.length() - delimiter - 2);
+        try {
+            const double tolerance =
+                atf::text::to_type< double >(tolerance_str);
+            if (tolerance < 0)
+                throw std::runtime_error("Unused reason");
+            return baseline_check(arg.substr(0, delimiter), tolerance);
+        } catch (const std::runtime_error&) {
+            throw atf::application::usage_error("Invalid tolerance '%s' in -b "
+                "option", tolerance_str.c_str());
+        }
+    } else
+        return baseline_check(arg, 10.0);
+}
+
+static
+std::vector< std::string >
+split_manifest_line(const std::string& line,
+                    const std::string::size_type lineno)
+{
+    std::vector< std::string > words;
+    std::string word;
+    bool in_word = false;
+    char quote = '\0';
+
+    for (std::string::size_type i = 0; i < line.length(); i++) {
+        const char c = line[i];
+
+        if (quote != '\0') {
+            if (c == quote)
+                quote = '\0';
+            else if (c == '\\' && quote == '"' && i + 1 < line.length() &&
+                     (line[i + 1] == '"' || line[i + 1] == '\\'))
+                word += line[++i];
+            else
+                word += c;
+        } else if (c == ' ' || c == '\t') {
+            if (in_word) {
+                words.push_back(word);
+                word.clear();
+                in_word = false;
+            }
+        } else if (c == '#' && !in_word) {
+            break;
+        } else {
+            in_word = true;
+            if (c == '\'' || c == '"')
+                quote = c;
+            else if (c == '\\' && i + 1 < line.length())
+                word += line[++i];
+            else
+                word += c;
+        }
+    }
+
+    if (quote != '\0')
+        throw std::runtime_error("Unterminated quote in manifest line " +
+                                 atf::text::to_string(lineno));
+    if (in_word)
+        words.push_back(word);
+
+    return words;
+}
+
+static
+std::vector< manifest_entry >
+read_manifest(std::istream& is)
+{
+    std::vector< manifest_entry > entries;
+
+    std::string line;
+    std::string::size_type lineno = 0;
+    while (std::getline(is, line).good() || !line.empty()) {
+        lineno++;
+        const std::vector< std::string > args =
+            split_manifest_line(line, lineno);
+        if (!args.empty())
+            entries.push_back(manifest_entry(lineno, args));
+        line.clear();
+    }
+
+    return entries;
 }
 
 static
@@ -327,37 +588,78 @@ flatten_argv(char* const* argv)
 
 static
 std::auto_ptr< atf::check::check_result >
-execute(const char* const* argv)
-{
-    // TODO: This should go to stderr... but fixing it now may be hard as test
-    // cases out there might be relying on stderr being silent.
-    std::cout << "Executing command [ ";
-    for (int i = 0; argv[i] != NULL; ++i)
-        std::cout << argv[i] << " ";
-    std::cout << "]\n";
-    std::cout.flush();
+execute(const char* const* argv, const bool digest_stdout,
+        const bool digest_stderr, const bool announce = true)
+{
+    if (announce) {
+        // TODO: This should go to stderr... but fixing it now may be hard as
+        // test cases out there might be relying on stderr being silent.
+        std::cout << "Executing command [ ";
+        for (int i = 0; argv[i] != NULL; ++i)
+            std::cout << argv[i] << " ";
+        std::cout << "]\n";
+        std::cout.flush();
+    }
 
     atf::process::argv_array argva(argv);
-    return atf::check::exec(argva);
+    return atf::check::exec(argva, digest_stdout, digest_stderr);
 }
 
 static
 std::auto_ptr< atf::check::check_result >
-execute_with_shell(char* const* argv)
+execute_with_shell(char* const* argv, const bool digest_stdout,
+                   const bool digest_stderr, const bool announce = true)
 {
     const std::string cmd = flatten_argv(argv);
+    const std::string shell = atf::env::get("ATF_SHELL", ATF_SHELL);
 
     const char* sh_argv[4];
-    sh_argv[0] = atf::env::get("ATF_SHELL", ATF_SHELL).c_str();
+    sh_argv[0] = shell.c_str();
     sh_argv[1] = "-c";
     sh_argv[2] = cmd.c_str();
     sh_argv[3] = NULL;
-    return execute(sh_argv);
+    return execute(sh_argv, digest_stdout, digest_stderr, announce);
+}
+
+//!
+//! \brief Prepares the standard input to be shared by repeated runs.
+//!
+//! If the standard input is a regular file, returns the current offset in
+//! it so that every run can be given the same data by rewinding to it.
+//! Otherwise, the standard input cannot be replayed and is replaced by
+//! /dev/null so that no run consumes the input of another; returns -1 in
+//! this case.
+//!
+static
+off_t
+prepare_repeated_stdin(void)
+{
+    struct stat sb;
+    if (::fstat(STDIN_FILENO, &sb) != -1 && S_ISREG(sb.st_mode)) {
+        const off_t offset = ::lseek(STDIN_FILENO, 0, SEEK_CUR);
+        if (offset != -1)
+            return offset;
+    }
+
+    const int fd = ::open("/dev/null", O_RDONLY);
+    if (fd == -1)
+        throw atf::system_error("atf_check", "Failed to open /dev/null",
+                                errno);
+    if (fd != STDIN_FILENO) {
+        if (::dup2(fd, STDIN_FILENO) == -1) {
+            const int original_errno = errno;
+            ::close(fd);
+            throw atf::system_error("atf_check", "Failed to redirect the "
+                                    "standard input", original_errno);
+        }
+        ::close(fd);
+    }
+    return -1;
 }
 
 static
 void
-cat_file(const atf::fs::path& path)
+cat_file(const atf::fs::path& path, std::ostream& os = std::cerr)
 {
     std::ifstream stream(path.c_str());
     if (!stream)
@@ -365,7 +667,7 @@ cat_file(const atf::fs::path& path)
 
     stream >> std::noskipws;
     std::istream_iterator< char > begin(stream), end;
-    std::ostream_iterator< char > out(std::cerr);
+    std::ostream_iterator< char > out(os);
     std::copy(begin, end, out);
 
     stream.close();
@@ -401,6 +703,129 @@ file_empty(const atf::fs::path& p)
     return (f.get_size() == 0);
 }
 
+//!
+//! \brief Returns whether the given checks can be run on a digest of the
+//! output alone.
+//!
+//! When this is true, the output of the command does not need to be saved
+//! to disk and is hashed while the command runs instead.
+//!
+static
+bool
+digest_only(const std::vector< output_check >& checks)
+{
+    bool needs_digest = false;
+    for (std::vector< output_check >::const_iterator iter = checks.begin();
+         iter != checks.end(); iter++) {
+        if ((*iter).type == oc_sha256 || (*iter).type == oc_size)
+            needs_digest = true;
+        else if ((*iter).type != oc_ignore)
+            return false;
+    }
+    return needs_digest;
+}
+
+namespace {
+
+//!
+//! \brief The output of a command, either saved to a file or digested.
+//!
+//! The digest and size of a saved output are only computed if a check
+//! requests them.
+//!
+class captured_output {
+    atf::fs::path m_path;
+    bool m_digested;
+    mutable bool m_have_digest;
+    mutable std::string m_digest;
+    mutable int64_t m_size;
+
+    void
+    digest_file(void)
+        const
+    {
+        std::ifstream stream(m_path.c_str(), std::fstream::binary);
+        if (!stream)
+            throw std::runtime_error("Failed to open " + m_path.str());
+
+        atf_sha256_t ctx;
+        atf_sha256_init(&ctx);
+        char buf[65536];
+        while (stream.read(buf, sizeof(buf)) || stream.gcount() > 0)
+            atf_sha256_update(&ctx, buf, stream.gcount());
+        m_size = atf_sha256_length(&ctx);
+
+        char hex[ATF_SHA256_HEX_LENGTH];
+        atf_sha256_final_hex(&ctx, hex);
+        m_digest = hex;
+        m_have_digest = true;
+    }
+
+public:
+    captured_output(const atf::fs::path& p_path) :
+        m_path(p_path),
+        m_digested(false),
+        m_have_digest(false),
+        m_size(0)
+    {
+    }
+
+    captured_output(const std::string& p_digest, const int64_t p_size) :
+        m_path("/dev/null"),
+        m_digested(true),
+        m_have_digest(true),
+        m_digest(p_digest),
+        m_size(p_size)
+    {
+    }
+
+    bool
+    digested(void)
+        const
+    {
+        return m_digested;
+    }
+
+    const atf::fs::path&
+    path(void)
+        const
+    {
+        PRE(!m_digested);
+        return m_path;
+    }
+
+    const std::string&
+    digest(void)
+        const
+    {
+        if (!m_have_digest)
+            digest_file();
+        return m_digest;
+    }
+
+    int64_t
+    size(void)
+        const
+    {
+        if (!m_have_digest)
+            digest_file();
+        return m_size;
+    }
+};
+
+} // anonymous namespace
+
+static
+void
+print_output(const captured_output& out)
+{
+    if (out.digested())
+        std::cerr << "(not saved; " << out.size() << " bytes, sha256 "
+                  << out.digest() << ")\n";
+    else
+        cat_file(out.path());
+}
+
 static bool
 compare_files(const atf::fs::path& p1, const atf::fs::path& p2)
 {
@@ -561,11 +986,19 @@ run_status_check(const status_check& sc, const atf::check::check_result& cr)
 
     if (result == false) {
         std::cerr << "stdout:\n";
-        cat_file(atf::fs::path(cr.stdout_path()));
+        if (cr.stdout_digested())
+            print_output(captured_output(cr.stdout_digest(),
+                                         cr.stdout_size()));
+        else
+            cat_file(atf::fs::path(cr.stdout_path()));
         std::cerr << "\n";
 
         std::cerr << "stderr:\n";
-        cat_file(atf::fs::path(cr.stderr_path()));
+        if (cr.stderr_digested())
+            print_output(captured_output(cr.stderr_digest(),
+                                         cr.stderr_size()));
+        else
+            cat_file(atf::fs::path(cr.stderr_path()));
         std::cerr << "\n";
     }
 
@@ -587,14 +1020,207 @@ run_status_checks(const std::vector< status_check >& checks,
     return ok;
 }
 
+static
+std::string
+format_usec(const int64_t usec)
+{
+    std::ostringstream str;
+    str << (usec / 1000000) << '.' << std::setw(6) << std::setfill('0')
+        << (usec % 1000000) << 's';
+    return str.str();
+}
+
+static
+bool
+run_resource_check(const resource_check& rc,
+                   const atf::check::check_result& cr)
+{
+    std::string name;
+    int64_t measured;
+    std::string measured_str, limit_str;
+
+    switch (rc.type) {
+    case rc_cpu:
+        name = "cpu time";
+        measured = cr.cpu_time();
+        measured_str = format_usec(measured);
+        limit_str = format_usec(rc.value);
+        break;
+
+    case rc_maxrss:
+        name = "maximum resident set size";
+        measured = cr.maxrss();
+        measured_str = atf::text::to_string(measured) + " bytes";
+        limit_str = atf::text::to_string(rc.value) + " bytes";
+        break;
+
+    case rc_wall:
+        name = "wall time";
+        measured = cr.wall_time();
+        measured_str = format_usec(measured);
+        limit_str = format_usec(rc.value);
+        break;
+
+    default:
+        UNREACHABLE;
+        return false;
+    }
+
+    if (rc.at_most && measured > rc.value) {
+        std::cerr << "Fail: " << name << " " << measured_str << " exceeds "
+                  << "the limit of " << limit_str << " (" << rc.spec << ")\n";
+        return false;
+    } else if (!rc.at_most && measured < rc.value) {
+        std::cerr << "Fail: " << name << " " << measured_str << " is below "
+                  << "the minimum of " << limit_str << " (" << rc.spec
+                  << ")\n";
+        return false;
+    } else
+        return true;
+}
+
+static
+bool
+run_resource_checks(const std::vector< resource_check >& checks,
+                    const atf::check::check_result& result)
+{
+    bool ok = true;
+
+    for (std::vector< resource_check >::const_iterator iter = checks.begin();
+         iter != checks.end(); iter++) {
+         ok &= run_resource_check(*iter, result);
+    }
+
+    return ok;
+}
+
+static
+int64_t
+percentile(const std::vector< int64_t >& sorted, const int pct)
+{
+    PRE(!sorted.empty());
+    const std::vector< int64_t >::size_type rank =
+        (sorted.size() * pct + 99) / 100;
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+static
+int64_t
+median(const std::vector< int64_t >& sorted)
+{
+    PRE(!sorted.empty());
+    const std::vector< int64_t >::size_type half = sorted.size() / 2;
+    if (sorted.size() % 2 == 0)
+        return (sorted[half - 1] + sorted[half]) / 2;
+    else
+        return sorted[half];
+}
+
+static
+void
+print_timings(const std::string& name, std::vector< int64_t > times)
+{
+    std::sort(times.begin(), times.end());
+    std::cout << name << ": min " << format_usec(times.front())
+              << ", median " << format_usec(median(times))
+              << ", p90 " << format_usec(percentile(times, 90))
+              << ", max " << format_usec(times.back()) << "\n";
+}
+
+//!
+//! \brief Checks if missing baselines should be recorded instead of failing.
+//!
+static
+bool
+record_baselines(void)
+{
+    return atf::env::get("ATF_CHECK_RECORD_BASELINE", "") == "yes";
+}
+
+static
+bool
+run_baseline_check(const baseline_check& bc,
+                   std::vector< int64_t > wall_times)
+{
+    std::sort(wall_times.begin(), wall_times.end());
+    const int64_t measured = median(wall_times);
+
+    std::ifstream is(bc.path.c_str());
+    if (!is) {
+        if (!record_baselines()) {
+            std::cerr << "Fail: cannot open the baseline " << bc.path
+                      << "; set ATF_CHECK_RECORD_BASELINE=yes to record "
+                      "the median wall time " << format_usec(measured)
+                      << " in it\n";
+            return false;
+        }
+
+        std::ofstream os(bc.path.c_str(), std::fstream::trunc);
+        if (!os)
+            throw std::runtime_error("Failed to create " + bc.path);
+        os << format_usec(measured) << "\n";
+        std::cout << "Recorded baseline " << format_usec(measured) << " in "
+                  << bc.path << "\n";
+        return true;
+    }
+
+    std::string line;
+    std::getline(is, line);
+    int64_t baseline;
+    try {
+        baseline = parse_time(atf::text::trim(line));
+    } catch (const atf::application::usage_error&) {
+        throw std::runtime_error("Invalid baseline '" + line + "' in " +
+                                 bc.path);
+    }
+
+    const double limit = baseline * (1.0 + bc.tolerance / 100.0);
+    if (measured > limit) {
+        std::cerr << "Fail: median wall time " << format_usec(measured)
+                  << " exceeds the baseline of " << format_usec(baseline)
+                  << " by more than " << bc.tolerance << "%\n";
+        return false;
+    } else
+        return true;
+}
+
 static
 bool
-run_output_check(const output_check oc, const atf::fs::path& path,
+run_output_check(const output_check oc, const captured_output& out,
                  const std::string& stdxxx)
 {
     bool result;
 
-    if (oc.type == oc_empty) {
+    if (oc.type == oc_sha256) {
+        const bool equals = out.digest() == oc.value;
+        if (!oc.negated && !equals) {
+            std::cerr << "Fail: " << stdxxx << " has SHA-256 digest "
+                      << out.digest() << " (" << out.size() << " bytes), "
+                      << "expected " << oc.value << "\n";
+            result = false;
+        } else if (oc.negated && equals) {
+            std::cerr << "Fail: " << stdxxx << " has SHA-256 digest "
+                      << oc.value << "\n";
+            result = false;
+        } else
+            result = true;
+    } else if (oc.type == oc_size) {
+        std::ostringstream size;
+        size << out.size();
+        const bool equals = size.str() == oc.value;
+        if (!oc.negated && !equals) {
+            std::cerr << "Fail: " << stdxxx << " is " << out.size()
+                      << " bytes long (SHA-256 digest " << out.digest()
+                      << "), expected " << oc.value << " bytes\n";
+            result = false;
+        } else if (oc.negated && equals) {
+            std::cerr << "Fail: " << stdxxx << " is " << oc.value
+                      << " bytes long\n";
+            result = false;
+        } else
+            result = true;
+    } else if (oc.type == oc_empty) {
+        const atf::fs::path& path = out.path();
         const bool is_empty = file_empty(path);
         if (!oc.negated && !is_empty) {
             std::cerr << "Fail: " << stdxxx << " not empty\n";
@@ -606,6 +1232,7 @@ run_output_check(const output_check oc, const atf::fs::path& path,
         } else
             result = true;
     } else if (oc.type == oc_file) {
+        const atf::fs::path& path = out.path();
         const bool equals = compare_files(path, atf::fs::path(oc.value));
         if (!oc.negated && !equals) {
             std::cerr << "Fail: " << stdxxx << " does not match golden "
@@ -621,6 +1248,7 @@ run_output_check(const output_check oc, const atf::fs::path& path,
     } else if (oc.type == oc_ignore) {
         result = true;
     } else if (oc.type == oc_inline) {
+        const atf::fs::path& path = out.path();
         temp_file temp("atf-check.XXXXXX");
         temp.write(decode(oc.value));
         temp.close();
@@ -638,6 +1266,7 @@ run_output_check(const output_check oc, const atf::fs::path& path,
         } else
             result = true;
     } else if (oc.type == oc_match) {
+        const atf::fs::path& path = out.path();
         const bool matches = grep_file(path, oc.value);
         if (!oc.negated && !matches) {
             std::cerr << "Fail: regexp " + oc.value + " not in " << stdxxx
@@ -653,15 +1282,7 @@ run_output_check(const output_check oc, const atf::fs::path& path,
             result = true;
     } else if (oc.type == oc_save) {
         INV(!oc.negated);
-        std::ifstream ifs(path.c_str(), std::fstream::binary);
-        ifs >> std::noskipws;
-        std::istream_iterator< char > begin(ifs), end;
-
-        std::ofstream ofs(oc.value.c_str(), std::fstream::binary
-                                     | std::fstream::trunc);
-        std::ostream_iterator <char> obegin(ofs);
-
-        std::copy(begin, end, obegin);
+        atf::fs::copy_file(out.path(), atf::fs::path(oc.value));
         result = true;
     } else {
         UNREACHABLE;
@@ -674,18 +1295,26 @@ run_output_check(const output_check oc, const atf::fs::path& path,
 static
 bool
 run_output_checks(const std::vector< output_check >& checks,
-                  const atf::fs::path& path, const std::string& stdxxx)
+                  const captured_output& out, const std::string& stdxxx)
 {
     bool ok = true;
 
     for (std::vector< output_check >::const_iterator iter = checks.begin();
          iter != checks.end(); iter++) {
-         ok &= run_output_check(*iter, path, stdxxx);
+         ok &= run_output_check(*iter, out, stdxxx);
     }
 
     return ok;
 }
 
+static
+int
+default_jobs(void)
+{
+    const long ncpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return ncpus > 0 ? static_cast< int >(ncpus) : 1;
+}
+
 // ------------------------------------------------------------------------
 // The "atf_check" application.
 // ------------------------------------------------------------------------
@@ -694,15 +1323,25 @@ namespace {
 
 class atf_check : public atf::application::app {
     bool m_xflag;
+    int m_runs;
+    int m_warmups;
+    int m_jobs;
+    std::string m_manifest;
+    std::string m_server;
 
     std::vector< status_check > m_status_checks;
     std::vector< output_check > m_stdout_checks;
     std::vector< output_check > m_stderr_checks;
+    std::vector< resource_check > m_resource_checks;
+    std::vector< baseline_check > m_baseline_checks;
 
     static const char* m_description;
 
     bool run_output_checks(const atf::check::check_result&,
                            const std::string&) const;
+    bool run_checks(const atf::check::check_result&) const;
+    int run_manifest(void) const;
+    int run_server(void) const;
 
     std::string specific_args(void) const;
     options_set specific_options(void) const;
@@ -721,7 +1360,10 @@ const char* atf_check::m_description =
 
 atf_check::atf_check(void) :
     app(m_description, "atf-check(1)"),
-    m_xflag(false)
+    m_xflag(false),
+    m_runs(1),
+    m_warmups(0),
+    m_jobs(default_jobs())
 {
 }
 
@@ -731,17 +1373,29 @@ atf_check::run_output_checks(const atf::check::check_result& r,
     const
 {
     if (stdxxx == "stdout") {
-        return ::run_output_checks(m_stdout_checks,
-            atf::fs::path(r.stdout_path()), "stdout");
+        return ::run_output_checks(m_stdout_checks, r.stdout_digested() ?
+            captured_output(r.stdout_digest(), r.stdout_size()) :
+            captured_output(atf::fs::path(r.stdout_path())), "stdout");
     } else if (stdxxx == "stderr") {
-        return ::run_output_checks(m_stderr_checks,
-            atf::fs::path(r.stderr_path()), "stderr");
+        return ::run_output_checks(m_stderr_checks, r.stderr_digested() ?
+            captured_output(r.stderr_digest(), r.stderr_size()) :
+            captured_output(atf::fs::path(r.stderr_path())), "stderr");
     } else {
         UNREACHABLE;
         return false;
     }
 }
 
+bool
+atf_check::run_checks(const atf::check::check_result& r)
+    const
+{
+    return run_status_checks(m_status_checks, r) &&
+        run_output_checks(r, "stderr") &&
+        run_output_checks(r, "stdout") &&
+        run_resource_checks(m_resource_checks, r);
+}
+
 std::string
 atf_check::specific_args(void)
     const
@@ -764,7 +1418,21 @@ atf_check::specific_options(void)
     opts.insert(option('e', "action:arg", "Handle stderr. Action must be "
                 "one of: empty ignore file:<path> inline:<val> match:regexp "
                 "save:<path>"));
+    opts.insert(option('r', "name<=value", "Handle resource usage. Name "
+                "must be one of: cpu maxrss wall; >= is also accepted"));
+    opts.insert(option('n', "runs", "Execute the command this many times "
+                "and report timing statistics"));
+    opts.insert(option('w', "warmups", "Execute the command this many extra "
+                "times before taking measurements"));
+    opts.insert(option('b', "path[:tolerance%]", "Compare the median wall "
+                "time against the baseline stored in path"));
+    opts.insert(option('f', "manifest", "Execute all the commands and "
+                "checks listed in the given file; - reads stdin"));
+    opts.insert(option('j', "jobs", "Number of manifest entries to execute "
+                "concurrently"));
     opts.insert(option('x', "", "Execute command as a shell command"));
+    opts.insert(option('C', "dir", "Serve the check requests received "
+                "through the dir/in and dir/out FIFOs"));
 
     return opts;
 }
@@ -785,10 +1453,38 @@ atf_check::process_option(int ch, const char* arg)
         m_stderr_checks.push_back(parse_output_check_arg(arg));
         break;
 
+    case 'r':
+        m_resource_checks.push_back(parse_resource_check_arg(arg));
+        break;
+
+    case 'n':
+        m_runs = parse_count(arg, 'n', 1);
+        break;
+
+    case 'w':
+        m_warmups = parse_count(arg, 'w', 0);
+        break;
+
+    case 'b':
+        m_baseline_checks.push_back(parse_baseline_arg(arg));
+        break;
+
+    case 'f':
+        m_manifest = arg;
+        break;
+
+    case 'j':
+        m_jobs = parse_count(arg, 'j', 1);
+        break;
+
     case 'x':
         m_xflag = true;
         break;
 
+    case 'C':
+        m_server = arg;
+        break;
+
     default:
         UNREACHABLE;
     }
@@ -797,13 +1493,22 @@ atf_check::process_option(int ch, const char* arg)
 int
 atf_check::main(void)
 {
-    if (m_argc < 1)
-        throw atf::application::usage_error("No command specified");
+    if (!m_server.empty()) {
+        if (m_argc > 0 || !m_manifest.empty())
+            throw atf::application::usage_error("Cannot specify a command "
+                "or a manifest together with -C");
+        return run_server();
+    }
 
-    int status = EXIT_FAILURE;
+    if (!m_manifest.empty()) {
+        if (m_argc > 0)
+            throw atf::application::usage_error("Cannot specify a command "
+                "together with -f");
+        return run_manifest();
+    }
 
-    std::auto_ptr< atf::check::check_result > r =
-        m_xflag ? execute_with_shell(m_argv) : execute(m_argv);
+    if (m_argc < 1)
+        throw atf::application::usage_error("No command specified");
 
     if (m_status_checks.empty())
         m_status_checks.push_back(status_check(sc_exit, false, EXIT_SUCCESS));
@@ -817,14 +1522,533 @@ atf_check::main(void)
     if (m_stderr_checks.empty())
         m_stderr_checks.push_back(output_check(oc_empty, false, ""));
 
-    if ((run_status_checks(m_status_checks, *r) == false) ||
-        (run_output_checks(*r, "stderr") == false) ||
-        (run_output_checks(*r, "stdout") == false))
-        status = EXIT_FAILURE;
-    else
-        status = EXIT_SUCCESS;
+    const bool digest_stdout = digest_only(m_stdout_checks);
+    const bool digest_stderr = digest_only(m_stderr_checks);
+
+    std::vector< int64_t > wall_times, cpu_times;
+    const int total = m_warmups + m_runs;
+    const off_t stdin_offset = total > 1 ? prepare_repeated_stdin() : -1;
+    for (int i = 0; i < total; i++) {
+        if (stdin_offset != -1 &&
+            ::lseek(STDIN_FILENO, stdin_offset, SEEK_SET) == -1)
+            throw atf::system_error("atf_check", "Failed to rewind the "
+                                    "standard input", errno);
+
+        std::auto_ptr< atf::check::check_result > r =
+            m_xflag ? execute_with_shell(m_argv, digest_stdout, digest_stderr,
+                                         i == 0)
+                    : execute(m_argv, digest_stdout, digest_stderr, i == 0);
+
+        if (!run_checks(*r)) {
+            if (total > 1)
+                std::cerr << "Fail: run " << (i + 1) << " of " << total
+                          << " did not pass the checks\n";
+            return EXIT_FAILURE;
+        }
+
+        if (i >= m_warmups) {
+            wall_times.push_back(r->wall_time());
+            cpu_times.push_back(r->cpu_time());
+        }
+    }
+
+    if (m_runs > 1) {
+        std::cout << "Timings over " << m_runs << " runs";
+        if (m_warmups > 0)
+            std::cout << " (after " << m_warmups << " warmups)";
+        std::cout << ":\n";
+        print_timings("wall", wall_times);
+        print_timings("cpu", cpu_times);
+    }
+
+    bool ok = true;
+    for (std::vector< baseline_check >::const_iterator iter =
+         m_baseline_checks.begin(); iter != m_baseline_checks.end(); iter++)
+        ok &= run_baseline_check(*iter, wall_times);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+
+//!
+//! \brief A manifest entry being executed in a subprocess.
+//!
+//! The output of the subprocess is spooled to temporary files so that the
+//! results of concurrent entries can be printed in manifest order.
+//!
+struct manifest_job {
+    const manifest_entry* entry;
+    temp_file out;
+    temp_file err;
+    std::auto_ptr< atf::process::child > child;
+    bool done;
+    bool passed;
+
+    manifest_job(const manifest_entry& p_entry) :
+        entry(&p_entry),
+        out("atf-check.XXXXXX"),
+        err("atf-check.XXXXXX"),
+        done(false),
+        passed(false)
+    {
+    }
+};
+
+class manifest_jobs : public std::deque< manifest_job* > {
+public:
+    ~manifest_jobs(void)
+    {
+        for (const_iterator iter = begin(); iter != end(); iter++)
+            delete *iter;
+    }
+};
+
+} // anonymous namespace
+
+static void run_atf_check(const std::vector< std::string >&)
+    ATF_DEFS_ATTRIBUTE_NORETURN;
+static void run_manifest_entry(void*) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+//!
+//! \brief Runs a nested instance of atf-check and exits the process.
+//!
+//! This is meant to be called from a subprocess of atf-check: it avoids
+//! the cost of exec'ing a new copy of the program.
+//!
+static
+void
+run_atf_check(const std::vector< std::string >& args)
+{
+    std::vector< char* > argv;
+    argv.push_back(const_cast< char* >("atf-check"));
+    for (std::vector< std::string >::const_iterator iter = args.begin();
+         iter != args.end(); iter++)
+        argv.push_back(const_cast< char* >((*iter).c_str()));
+    argv.push_back(NULL);
+
+    const int exitcode = atf_check().run(argv.size() - 1, &argv[0]);
+    std::cout.flush();
+    std::cerr.flush();
+    std::exit(exitcode);
+}
+
+static
+void
+run_manifest_entry(void* v)
+{
+    const manifest_entry* entry = static_cast< const manifest_entry* >(v);
+
+    const int fd = ::open("/dev/null", O_RDONLY);
+    if (fd != -1 && fd != STDIN_FILENO) {
+        ::dup2(fd, STDIN_FILENO);
+        ::close(fd);
+    }
+
+    run_atf_check(entry->args);
+}
+
+//!
+//! \brief Waits for whichever running manifest entry finishes first.
+//!
+//! The subprocess is only reaped once it is known to belong to one of the
+//! given jobs, so that its status can still be collected through it.
+//! Returns false if the subprocess that finished was not one of them.
+//!
+static
+bool
+reap_manifest_job(manifest_jobs& jobs)
+{
+    siginfo_t info;
+    while (::waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) == -1) {
+        if (errno != EINTR)
+            throw atf::system_error("atf_check", "waitid(2) failed", errno);
+    }
+
+    for (manifest_jobs::iterator iter = jobs.begin(); iter != jobs.end();
+         iter++) {
+        manifest_job* job = *iter;
+        if (job != NULL && !job->done && job->child->pid() == info.si_pid) {
+            const atf::process::status s = job->child->wait();
+            job->passed = s.exited() && s.exitstatus() == EXIT_SUCCESS;
+            job->done = true;
+            return true;
+        }
+    }
+
+    int status;
+    (void)::waitpid(info.si_pid, &status, 0);
+    return false;
+}
+
+static
+void
+print_manifest_job(const manifest_job& job, const std::size_t number)
+{
+    std::cout << "Entry " << number << " (line " << job.entry->line
+              << "): " << atf::text::join(job.entry->args, " ") << "\n";
+    cat_file(job.out.get_path(), std::cout);
+    std::cout.flush();
+    cat_file(job.err.get_path(), std::cerr);
+    std::cerr.flush();
+    std::cout << "Entry " << number << ": "
+              << (job.passed ? "passed" : "failed") << "\n";
+}
+
+int
+atf_check::run_manifest(void)
+    const
+{
+    std::vector< manifest_entry > entries;
+    if (m_manifest == "-")
+        entries = read_manifest(std::cin);
+    else {
+        std::ifstream is(m_manifest.c_str());
+        if (!is)
+            throw std::runtime_error("Failed to open " + m_manifest);
+        entries = read_manifest(is);
+    }
+
+    // Every slot starts the next entry as soon as its previous one
+    // finishes, whatever its position; the results are still printed in
+    // manifest order, as soon as all the entries before them are done.
+    std::size_t failed = 0;
+    std::size_t printed = 0;
+    std::size_t running = 0;
+    manifest_jobs jobs;
+    while (printed < entries.size()) {
+        while (jobs.size() < entries.size() &&
+               running < static_cast< std::size_t >(m_jobs)) {
+            const manifest_entry& entry = entries[jobs.size()];
+            std::auto_ptr< manifest_job > job(new manifest_job(entry));
+            job->out.close();
+            job->err.close();
+            job->child.reset(new atf::process::child(atf::process::fork(
+                run_manifest_entry,
+                atf::process::stream_redirect_path(job->out.get_path()),
+                atf::process::stream_redirect_path(job->err.get_path()),
+                const_cast< manifest_entry* >(&entry))));
+            jobs.push_back(job.release());
+            running++;
+        }
+
+        while (!reap_manifest_job(jobs))
+            continue;
+        running--;
+
+        while (printed < jobs.size() && jobs[printed]->done) {
+            print_manifest_job(*jobs[printed], printed + 1);
+            if (!jobs[printed]->passed)
+                failed++;
+            delete jobs[printed];
+            jobs[printed] = NULL;
+            printed++;
+        }
+    }
+
+    std::cout << "Ran " << entries.size() << " entries: "
+              << (entries.size() - failed) << " passed, " << failed
+              << " failed\n";
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ------------------------------------------------------------------------
+// The check server.
+// ------------------------------------------------------------------------
+
+namespace {
+
+//!
+//! \brief A check request received by the server.
+//!
+//! Requests are sent by libatf-sh as a sequence of NUL-terminated fields:
+//! a header, the working directory, the umask, the output of the shell's
+//! 'export -p' builtin, the number of arguments and the arguments.  The
+//! exported variables are not parsed, as their format differs between
+//! shells; they are only compared to those of the first request.
+//!
+struct server_request {
+    std::string cwd;
+    mode_t mask;
+    std::string exported;
+    std::vector< std::string > args;
+};
+
+//!
+//! \brief Reads NUL-terminated fields from a file descriptor.
+//!
+//! Reading gives up when the client goes away, even if some of its
+//! children still hold the other end of the FIFO.
+//!
+class request_reader {
+    const int m_fd;
+    const pid_t m_client;
+    std::string m_buffer;
+    std::string::size_type m_pos;
+
+    bool
+    fill(void)
+    {
+        for (;;) {
+            struct pollfd pfd;
+            pfd.fd = m_fd;
+            pfd.events = POLLIN;
+            const int ret = ::poll(&pfd, 1, 1000);
+            if (ret == -1) {
+                if (errno == EINTR)
+                    continue;
+                throw atf::system_error("atf_check::request_reader",
+                                        "poll(2) failed", errno);
+            } else if (ret == 0) {
+                if (::kill(m_client, 0) == -1 && errno == ESRCH)
+                    return false;
+                continue;
+            }
+
+            char buf[4096];
+            const ssize_t n = ::read(m_fd, buf, sizeof(buf));
+            if (n == -1) {
+                if (errno == EINTR)
+                    continue;
+                throw atf::system_error("atf_check::request_reader",
+                                        "read(2) failed", errno);
+            } else if (n == 0)
+                return false;
+            m_buffer.append(buf, n);
+            return true;
+        }
+    }
+
+public:
+    request_reader(const int fd, const pid_t client) :
+        m_fd(fd),
+        m_client(client),
+        m_pos(0)
+    {
+    }
+
+    bool
+    read_field(std::string& field)
+    {
+        for (;;) {
+            const std::string::size_type end = m_buffer.find('\0', m_pos);
+            if (end != std::string::npos) {
+                field = m_buffer.substr(m_pos, end - m_pos);
+                m_pos = end + 1;
+                return true;
+            }
+
+            m_buffer.erase(0, m_pos);
+            m_pos = 0;
+            if (!fill())
+                return false;
+        }
+    }
+};
+
+} // anonymous namespace
+
+static
+std::string
+read_request_field(request_reader& reader)
+{
+    std::string field;
+    if (!reader.read_field(field))
+        throw std::runtime_error("Truncated check request");
+    return field;
+}
+
+static
+bool
+read_server_request(request_reader& reader, server_request& request)
+{
+    std::string header;
+    if (!reader.read_field(header))
+        return false;
+    if (header != "atf-check-request")
+        throw std::runtime_error("Invalid check request header '" + header +
+                                 "'");
+
+    request.cwd = read_request_field(reader);
+
+    const std::string mask = read_request_field(reader);
+    char* end;
+    request.mask = static_cast< mode_t >(std::strtol(mask.c_str(), &end, 8));
+    if (mask.empty() || (*end != '\0' && *end != '\n'))
+        throw std::runtime_error("Invalid umask '" + mask + "' in check "
+                                 "request");
+
+    request.exported = read_request_field(reader);
+
+    const std::size_t argc =
+        atf::text::to_type< std::size_t >(read_request_field(reader));
+    request.args.clear();
+    for (std::size_t i = 0; i < argc; i++)
+        request.args.push_back(read_request_field(reader));
+
+    return true;
+}
+
+static void run_server_request(void*) ATF_DEFS_ATTRIBUTE_NORETURN;
+
+static
+void
+run_server_request(void* v)
+{
+    const server_request* request = static_cast< const server_request* >(v);
+
+    if (::chdir(request->cwd.c_str()) == -1) {
+        std::cerr << "atf-check: Cannot enter directory " << request->cwd
+                  << ": " << std::strerror(errno) << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+    ::umask(request->mask);
+
+    run_atf_check(request->args);
+}
+
+//!
+//! \brief Appends the contents of a file to a reply, one line at a time.
+//!
+//! Lines are prefixed by the given tag; the tag is lowercased for a last
+//! line that does not end with a newline character.
+//!
+static
+void
+append_reply_output(const atf::fs::path& path, const char tag,
+                    std::string& reply)
+{
+    std::ifstream is(path.c_str(), std::fstream::binary);
+    std::string line;
+    while (std::getline(is, line)) {
+        if (is.eof())
+            reply += static_cast< char >(tag - 'A' + 'a');
+        else
+            reply += tag;
+        reply += line;
+        reply += '\n';
+    }
+}
+
+static
+void
+write_reply(const int fd, const std::string& reply)
+{
+    std::string::size_type done = 0;
+    while (done < reply.length()) {
+        const ssize_t n = ::write(fd, reply.data() + done,
+                                  reply.length() - done);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            throw atf::system_error("atf_check::write_reply",
+                                    "write(2) failed", errno);
+        }
+        done += n;
+    }
+}
+
+static
+int
+open_server_fifo(const std::string& path, const int flags)
+{
+    const int fd = ::open(path.c_str(), flags);
+    if (fd == -1)
+        throw atf::system_error("atf_check::open_server_fifo",
+                                "open(" + path + ") failed", errno);
+    ::unlink(path.c_str());
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+//!
+//! \brief Executes check requests until the client goes away.
+//!
+//! Each request is served by a subprocess of the server, which saves the
+//! client from having to load a new copy of atf-check for every check.
+//! The checks' output is spooled to temporary files and sent back to the
+//! client together with the exit code of the check.  If a request cannot
+//! be understood, the client is told to execute the check on its own.
+//!
+//! The checks inherit the environment of the server, which is the one the
+//! client had when it sent its first request.  If the variables exported
+//! by a later request differ, the client is told to start a new server.
+//!
+//! The client, which is the parent of this process, holds the other ends
+//! of the FIFOs before executing it and waits for it to return.  The
+//! requests are therefore served by a subprocess, and this one returns as
+//! soon as the FIFOs are open, so that the client never waits on them.
+//!
+int
+atf_check::run_server(void)
+    const
+{
+    const pid_t client = ::getppid();
+
+    // Opening the FIFOs blocks until the other ends are open, so do not
+    // wait forever if the client did not open them beforehand.
+    ::alarm(60);
+    const int in = open_server_fifo(m_server + "/in", O_RDONLY);
+    const int out = open_server_fifo(m_server + "/out", O_WRONLY);
+    ::alarm(0);
+    ::rmdir(m_server.c_str());
+
+    const pid_t pid = ::fork();
+    if (pid == -1)
+        throw atf::system_error("atf_check::run_server", "fork(2) failed",
+                                errno);
+    else if (pid > 0) {
+        ::close(out);
+        ::close(in);
+        return EXIT_SUCCESS;
+    }
+
+    request_reader reader(in, client);
+    std::string exported;
+    bool first = true;
+    for (;;) {
+        server_request request;
+        std::string reply;
+        try {
+            if (!read_server_request(reader, request))
+                break;
+        } catch (const std::runtime_error& e) {
+            std::cerr << "atf-check: " << e.what() << "; executing the check "
+                "in the client\n";
+            write_reply(out, "!\n");
+            continue;
+        }
+
+        if (first) {
+            exported = request.exported;
+            first = false;
+        } else if (request.exported != exported) {
+            write_reply(out, "~\n");
+            continue;
+        }
+
+        temp_file stdout_file("atf-check.XXXXXX");
+        temp_file stderr_file("atf-check.XXXXXX");
+        stdout_file.close();
+        stderr_file.close();
+        atf::process::child child = atf::process::fork(
+            run_server_request,
+            atf::process::stream_redirect_path(stdout_file.get_path()),
+            atf::process::stream_redirect_path(stderr_file.get_path()),
+            &request);
+        const atf::process::status s = child.wait();
+
+        append_reply_output(stdout_file.get_path(), 'O', reply);
+        append_reply_output(stderr_file.get_path(), 'E', reply);
+        reply += "=" + atf::text::to_string(s.exited() ? s.exitstatus() :
+                                            EXIT_FAILURE) + "\n";
+        write_reply(out, reply);
+    }
 
-    return status;
+    ::close(out);
+    ::close(in);
+    return EXIT_SUCCESS;
 }
 
 int
@@ -240,6 +240,62 @@ oflag_save_body()
     cmp -s out exp || atf_fail "Saved output does not match expected results"
 }
 
+atf_test_case oflag_save_large
+oflag_save_large_head()
+{
+    atf_set "descr" "Benchmarks the -o option using the 'save:' argument" \
+        "on a large output"
+}
+oflag_save_large_body()
+{
+    dd if=/dev/zero of=big bs=65536 count=1024 2>/dev/null
+    echo trailer >>big
+
+    # The outer atf-check reports the timings of the copy performed by the
+    # inner one and fails if they regress to the cost of a byte-wise copy.
+    atf_check -o ignore -r 'cpu<=5s' -n 3 \
+        ${Atf_Check} -o save:copy cat big
+    cmp -s big copy || atf_fail "Saved output does not match expected results"
+}
+
+atf_test_case oflag_digest
+oflag_digest_head()
+{
+    atf_set "descr" "Tests for the -o option using the 'sha256:' and" \
+        "'size:' arguments"
+}
+oflag_digest_body()
+{
+    foo=b5bb9d8014a0f9b1d61e21e796d78dccdf1352f23cd32812f4850b878ae4944c
+    h_pass "echo foo" -o sha256:${foo}
+    h_pass "echo foo" -o sha256:$(echo ${foo} | tr a-f A-F)
+    h_fail "echo bar" -o sha256:${foo}
+    h_pass "echo bar" -o not-sha256:${foo}
+    h_fail "echo foo" -o not-sha256:${foo}
+    h_pass "echo foo" -o size:4
+    h_fail "echo foo" -o size:3
+    h_pass "echo foo" -o not-size:3
+    big=c0e271987af6652bfecd7ad80c73a314fb15a85fe15408cf05f6893675e8a505
+    h_pass "yes | head -n 524288" -o size:1m -o sha256:${big}
+
+    h_pass "echo foo" -o sha256:${foo} -o match:foo
+    h_fail "echo foo" -o size:4 -o match:bar
+
+    ${Atf_Check} -o size:5 -x "echo foo" 2>stderr && \
+        atf_fail "Wrong size not detected"
+    grep 'stdout is 4 bytes long.*expected 5 bytes' stderr >/dev/null || \
+        atf_fail "Actual size not reported"
+    grep "${foo}" stderr >/dev/null || atf_fail "Actual digest not reported"
+
+    ${Atf_Check} -o sha256:0123 true 2>stderr && \
+        atf_fail "Invalid digest accepted"
+    grep 'Invalid SHA-256 digest' stderr >/dev/null || \
+        atf_fail "Invalid digest not reported"
+    ${Atf_Check} -o size:foo true 2>stderr && \
+        atf_fail "Invalid size accepted"
+    grep 'Invalid size' stderr >/dev/null || atf_fail "Invalid size not reported"
+}
+
 atf_test_case oflag_multiple
 oflag_multiple_head()
 {
@@ -351,6 +407,26 @@ eflag_match_body()
     h_fail "echo foo bar 1>&2" -e "match:^bar"
 }
 
+atf_test_case eflag_digest
+eflag_digest_head()
+{
+    atf_set "descr" "Tests for the -e option using the 'sha256:' and" \
+        "'size:' arguments"
+}
+eflag_digest_body()
+{
+    foo=b5bb9d8014a0f9b1d61e21e796d78dccdf1352f23cd32812f4850b878ae4944c
+    h_pass "echo foo 1>&2" -e sha256:${foo}
+    h_fail "echo bar 1>&2" -e sha256:${foo}
+    h_pass "echo foo 1>&2" -e size:4 -e not-size:0
+    h_fail "echo foo 1>&2" -e size:0
+
+    ${Atf_Check} -s exit:1 -e size:4 -x "echo foo 1>&2" 2>stderr && \
+        atf_fail "Wrong exit code not detected"
+    grep "not saved; 4 bytes, sha256 ${foo}" stderr >/dev/null || \
+        atf_fail "Digest of the output not reported on failure"
+}
+
 atf_test_case eflag_multiple
 eflag_multiple_head()
 {
@@ -378,6 +454,182 @@ eflag_negated_body()
     h_fail "echo foo bar 1>&2" -e not-match:foo
 }
 
+atf_test_case rflag
+rflag_head()
+{
+    atf_set "descr" "Tests for the -r option"
+}
+rflag_body()
+{
+    h_pass 'true' -r 'wall<=60s' -r 'cpu<=60s' -r 'maxrss<=1g'
+    h_pass 'sleep 1' -r 'wall>=500ms'
+    h_pass 'true' -r 'cpu>=0'
+
+    h_fail 'true' -r 'maxrss<=1'
+    h_fail 'true' -r 'wall>=60'
+
+    ${Atf_Check} -r 'maxrss<=1' true 2>stderr && \
+        atf_fail "maxrss limit not enforced"
+    grep 'Fail: maximum resident set size [0-9]* bytes exceeds' stderr \
+        >/dev/null || atf_fail "Measured maxrss not reported"
+    ${Atf_Check} -r 'wall>=60s' true 2>stderr && \
+        atf_fail "wall minimum not enforced"
+    grep 'Fail: wall time [0-9]*\.[0-9]*s is below the minimum of 60\.000000s' \
+        stderr >/dev/null || atf_fail "Measured wall time not reported"
+
+    ${Atf_Check} -r 'foo<=1' true 2>stderr && \
+        atf_fail "Invalid resource accepted"
+    grep 'Invalid resource checker' stderr >/dev/null || \
+        atf_fail "Invalid resource not reported"
+    ${Atf_Check} -r 'cpu<=abc' true 2>stderr && \
+        atf_fail "Invalid time accepted"
+    grep 'Invalid time' stderr >/dev/null || \
+        atf_fail "Invalid time not reported"
+    for time in 1e300 9300000000000 nan; do
+        ${Atf_Check} -r "wall<=${time}" true 2>stderr && \
+            atf_fail "Out of range time ${time} accepted"
+        grep 'Invalid time' stderr >/dev/null || \
+            atf_fail "Out of range time ${time} not reported"
+    done
+    h_pass 'true' -r 'wall<=9000000000000'
+}
+
+atf_test_case nflag
+nflag_head()
+{
+    atf_set "descr" "Tests for the -n and -w options"
+}
+nflag_body()
+{
+    h_pass 'true' -n 3
+    h_fail 'false' -n 3
+
+    ${Atf_Check} -n 3 -w 2 -x 'echo run >>runs' >stdout || \
+        atf_fail "atf-check failed"
+    test $(wc -l <runs) -eq 5 || atf_fail "Command not executed 5 times"
+    test $(grep -c 'Executing command' stdout) -eq 1 || \
+        atf_fail "Command announced more than once"
+    grep 'Timings over 3 runs (after 2 warmups):' stdout >/dev/null || \
+        atf_fail "Timing summary not printed"
+    grep '^wall: min [0-9.]*s, median [0-9.]*s, p90 [0-9.]*s, max [0-9.]*s$' \
+        stdout >/dev/null || atf_fail "Wall time statistics not printed"
+    grep '^cpu: min [0-9.]*s, median [0-9.]*s, p90 [0-9.]*s, max [0-9.]*s$' \
+        stdout >/dev/null || atf_fail "CPU time statistics not printed"
+
+    # Every run reads the same input from a regular file.
+    printf 'line\n' >input
+    ${Atf_Check} -n 3 -w 1 -o inline:'line\n' cat <input >stdout || \
+        atf_fail "Runs did not get the same input from a file"
+    # Other inputs cannot be replayed and are replaced by /dev/null.
+    printf 'line\n' | ${Atf_Check} -n 2 -o empty cat >stdout || \
+        atf_fail "Runs shared a piped standard input"
+    printf 'line\n' | ${Atf_Check} -o inline:'line\n' cat >stdout || \
+        atf_fail "A single run did not get the standard input"
+
+    ${Atf_Check} -n 0 true 2>stderr && atf_fail "-n 0 accepted"
+    grep 'Invalid count for -n' stderr >/dev/null || \
+        atf_fail "Invalid count not reported"
+}
+
+atf_test_case bflag
+bflag_head()
+{
+    atf_set "descr" "Tests for the -b option"
+}
+bflag_body()
+{
+    ${Atf_Check} -n 3 -b baseline true 2>stderr && \
+        atf_fail "Missing baseline accepted"
+    grep 'Fail: cannot open the baseline baseline' stderr >/dev/null || \
+        atf_fail "Missing baseline not reported"
+    test ! -f baseline || atf_fail "Baseline recorded without being requested"
+
+    ATF_CHECK_RECORD_BASELINE=yes ${Atf_Check} -n 3 -b baseline true \
+        >stdout || atf_fail "atf-check failed"
+    grep 'Recorded baseline' stdout >/dev/null || \
+        atf_fail "Baseline not recorded"
+    grep '^[0-9]*\.[0-9]*s$' baseline >/dev/null || \
+        atf_fail "Invalid baseline file contents"
+
+    echo "100s" >baseline
+    h_pass 'true' -n 3 -b baseline:5%
+
+    echo "0.000001s" >baseline
+    h_fail 'sleep 1' -b baseline:50%
+    ${Atf_Check} -b baseline sleep 1 2>stderr && \
+        atf_fail "Regression not detected"
+    grep 'Fail: median wall time .* exceeds the baseline of 0.000001s' \
+        stderr >/dev/null || atf_fail "Regression not reported"
+
+    ${Atf_Check} -b baseline:abc% true 2>stderr && \
+        atf_fail "Invalid tolerance accepted"
+    grep 'Invalid tolerance' stderr >/dev/null || \
+        atf_fail "Invalid tolerance not reported"
+}
+
+atf_test_case fflag
+fflag_head()
+{
+    atf_set "descr" "Tests for the -f and -j options"
+}
+fflag_body()
+{
+    cat >manifest <<EOF
+# Comments and blank lines are ignored.
+
+-o inline:"first entry\\n" echo "first entry"
+-s exit:1 false
+-o match:third -x 'echo third; echo x >>ran'
+EOF
+    for jobs in 1 2 8; do
+        ${Atf_Check} -j ${jobs} -f manifest >stdout 2>stderr || \
+            atf_fail "Valid manifest failed with -j ${jobs}"
+        grep 'Ran 3 entries: 3 passed, 0 failed' stdout >/dev/null || \
+            atf_fail "Summary not printed"
+        sed -n 's/^\(Entry [0-9]*\): .*/\1/p' stdout | uniq >entries
+        printf 'Entry 1\nEntry 2\nEntry 3\n' >expout
+        cmp -s expout entries || atf_fail "Entries not reported in order"
+    done
+    test $(wc -l <ran) -eq 3 || atf_fail "Entry not executed once per run"
+
+    echo 'true' >>manifest
+    echo '-o empty echo unexpected' >>manifest
+    ${Atf_Check} -f manifest >stdout 2>stderr && \
+        atf_fail "Failing manifest entry not detected"
+    grep 'Entry 5: failed' stdout >/dev/null || \
+        atf_fail "Failing entry not reported"
+    grep 'Ran 5 entries: 4 passed, 1 failed' stdout >/dev/null || \
+        atf_fail "Summary does not account for the failure"
+
+    printf 'true\n-s exit:1 false\n' | ${Atf_Check} -f - >stdout || \
+        atf_fail "Manifest from stdin failed"
+    grep 'Ran 2 entries: 2 passed, 0 failed' stdout >/dev/null || \
+        atf_fail "Manifest from stdin not executed"
+
+    echo "echo 'unterminated" >bad
+    ${Atf_Check} -f bad 2>stderr && atf_fail "Invalid manifest accepted"
+    grep 'Unterminated quote in manifest line 1' stderr >/dev/null || \
+        atf_fail "Invalid manifest not reported"
+    ${Atf_Check} -f manifest true 2>stderr && \
+        atf_fail "Command accepted together with -f"
+    grep 'Cannot specify a command together with -f' stderr >/dev/null || \
+        atf_fail "Invalid usage not reported"
+
+    # The first entry only finishes once the third one has run, which
+    # requires the slot of the second one to be reused while the first one
+    # is still running.
+    cat >manifest <<EOF
+-x 'i=0; while [ ! -f go ] && [ \$i -lt 100 ]; do sleep 0.1; i=\$((i + 1)); done; test -f go'
+true
+-x 'touch go'
+EOF
+    ${Atf_Check} -j 2 -f manifest >stdout 2>stderr || \
+        atf_fail "Slot of a finished entry not reused while another runs"
+    sed -n 's/^\(Entry [0-9]*\): .*/\1/p' stdout | uniq >entries
+    printf 'Entry 1\nEntry 2\nEntry 3\n' >expout
+    cmp -s expout entries || atf_fail "Entries not reported in order"
+}
+
 atf_test_case stdin
 stdin_head()
 {
@@ -421,6 +673,8 @@ atf_init_test_cases()
     atf_add_test_case oflag_inline
     atf_add_test_case oflag_match
     atf_add_test_case oflag_save
+    atf_add_test_case oflag_save_large
+    atf_add_test_case oflag_digest
     atf_add_test_case oflag_multiple
     atf_add_test_case oflag_negated
 
@@ -430,9 +684,15 @@ atf_init_test_cases()
     atf_add_test_case eflag_inline
     atf_add_test_case eflag_match
     atf_add_test_case eflag_save
+    atf_add_test_case eflag_digest
     atf_add_test_case eflag_multiple
     atf_add_test_case eflag_negated
 
+    atf_add_test_case rflag
+    atf_add_test_case nflag
+    atf_add_test_case bflag
+    atf_add_test_case fflag
+
     atf_add_test_case stdin
 
     atf_add_test_case invalid_umask
@@ -23,19 +23,43 @@
 // OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
 extern "C" {
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <unistd.h>
 }
 
+#include <algorithm>
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <vector>
+
+extern "C" {
+#include "atf-c/detail/history.h"
+#include "atf-c/detail/sha256.h"
+#include "atf-c/error.h"
+}
 
 #include "atf-c++/detail/application.hpp"
 #include "atf-c++/detail/env.hpp"
 #include "atf-c++/detail/fs.hpp"
 #include "atf-c++/detail/sanity.hpp"
+#include "atf-c++/detail/text.hpp"
 
 // ------------------------------------------------------------------------
 // Auxiliary functions.
@@ -43,6 +67,62 @@ extern "C" {
 
 namespace {
 
+//!
+//! \brief The shells probed by default when selecting one automatically.
+//!
+//! In case of a tie in their startup times, the first one wins.
+//!
+static const char* default_shell_candidates = "dash mksh ksh bash sh";
+
+//!
+//! \brief A test program to verify that a shell can run the atf-sh library.
+//!
+//! This includes checking that its arithmetic is at least 32 bits wide, as
+//! the library needs that to assign test cases to shards.
+//!
+static const char* selftest_program =
+    "atf_test_case selftest\n"
+    "selftest_head() {\n"
+    "    atf_set \"descr\" \"Self-test of the atf-sh library\"\n"
+    "    atf_set \"X-dotted.name\" \"the value\"\n"
+    "}\n"
+    "selftest_body() {\n"
+    "    atf_get_var value X-dotted.name\n"
+    "    atf_check_equal 'the value' \"${value}\"\n"
+    "    atf_config_get_var value the-var default\n"
+    "    atf_check_equal expected \"${value}\"\n"
+    "    atf_check_equal 3 \"$((1 + 2))\"\n"
+    "    atf_check_equal 2147385345 \"$((65535 * 32767))\"\n"
+    "    _atf_hash_shard value a 1000\n"
+    "    atf_check_equal 220 \"${value}\"\n"
+    "    path=/foo/bar/baz\n"
+    "    atf_check_equal baz \"${path##*/}\"\n"
+    "    atf_check_equal /foo/bar \"${path%/*}\"\n"
+    "    set -- a b c; shift 2\n"
+    "    atf_check_equal c \"${1}\"\n"
+    "    atf_check -o inline:'hello\\n' echo hello\n"
+    "}\n"
+    "atf_init_test_cases() {\n"
+    "    atf_add_test_case selftest\n"
+    "}\n";
+
+//!
+//! \brief The result of probing a candidate shell.
+//!
+struct shell_probe {
+    std::string name;
+    std::string path;
+    bool passed;
+    int64_t usec;
+
+    shell_probe(const std::string& p_name) :
+        name(p_name),
+        passed(false),
+        usec(0)
+    {
+    }
+};
+
 static
 std::string
 fix_plain_name(const char *filename)
@@ -54,21 +134,125 @@ fix_plain_name(const char *filename)
         return std::string(filename);
 }
 
+static
+std::string
+library_path(void)
+{
+    return atf::env::get("ATF_PKGDATADIR", ATF_PKGDATADIR) +
+        "/libatf-sh.subr";
+}
+
+static
+std::string
+hash_string(const std::string& text)
+{
+    atf_sha256_t ctx;
+    atf_sha256_init(&ctx);
+    atf_sha256_update(&ctx, text.data(), text.length());
+
+    char hex[ATF_SHA256_HEX_LENGTH];
+    atf_sha256_final_hex(&ctx, hex);
+    return std::string(hex).substr(0, 16);
+}
+
+//!
+//! \brief Returns a stamp that identifies the current library file.
+//!
+//! The stamp is made of the file metadata only, so that it can be checked
+//! on every startup without reading the library.  Modifying or replacing
+//! the file updates its change time or its inode, so the stamp changes too;
+//! the change time is only accurate to the second where the system does not
+//! record nanoseconds.  Returns an empty string if the library cannot be
+//! found.
+//!
+static
+std::string
+library_stamp(void)
+{
+    struct stat sb;
+    if (::stat(library_path().c_str(), &sb) == -1)
+        return "";
+
+    using atf::text::to_string;
+    std::string stamp = to_string(sb.st_dev) + ":" + to_string(sb.st_ino) +
+        ":" + to_string(sb.st_size) + ":" + to_string(sb.st_mtime) + ":" +
+        to_string(sb.st_ctime);
+#if defined(HAVE_STRUCT_STAT_ST_CTIM_TV_NSEC)
+    stamp += "." + to_string(sb.st_ctim.tv_nsec);
+#endif
+    return stamp;
+}
+
+//!
+//! \brief Returns the directory in which atf-sh caches its data.
+//!
+//! The directory is specified by ATF_CACHE_DIR.  If that is not set, it
+//! defaults to a private directory under TMPDIR.  It is
+//! created on demand and is only used if it is a real directory owned by
+//! the current user that nobody else can write to.  Returns an empty
+//! string if caching is disabled, which happens if there is no directory
+//! to use, if ATF_CACHE_DIR is set to the empty string, or if the
+//! directory cannot be used safely.
+//!
+static
+std::string
+cache_dir(void)
+{
+    const std::string dir = atf::env::get("ATF_CACHE_DIR",
+        atf::env::get("TMPDIR", "/tmp") + "/atf-cache-" +
+        atf::text::to_string(::getuid()));
+    if (dir.empty())
+        return "";
+
+    if (::mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST)
+        return "";
+
+    struct stat sb;
+    if (::lstat(dir.c_str(), &sb) == -1 || !S_ISDIR(sb.st_mode) ||
+        sb.st_uid != ::getuid() || (sb.st_mode & 022) != 0)
+        return "";
+
+    return dir;
+}
+
+//!
+//! \brief Creates or replaces a file without exposing partial contents.
+//!
+static
+bool
+write_file_atomically(const std::string& path, const std::string& contents)
+{
+    const std::string tmp = path + ".tmp." + atf::text::to_string(::getpid());
+    {
+        std::ofstream os(tmp.c_str());
+        if (!os)
+            return false;
+        os << contents;
+        os.close();
+        if (!os) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+    }
+    if (::rename(tmp.c_str(), path.c_str()) == -1) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
 static
 std::string*
-construct_script(const char* filename)
+construct_script(const char* filename, const std::string& shell)
 {
     const std::string libexecdir = atf::env::get(
         "ATF_LIBEXECDIR", ATF_LIBEXECDIR);
-    const std::string pkgdatadir = atf::env::get(
-        "ATF_PKGDATADIR", ATF_PKGDATADIR);
-    const std::string shell = atf::env::get("ATF_SHELL", ATF_SHELL);
 
     std::string* command = new std::string();
     command->reserve(512);
     (*command) += ("Atf_Check='" + libexecdir + "/atf-check' ; " +
                    "Atf_Shell='" + shell + "' ; " +
-                   ". " + pkgdatadir + "/libatf-sh.subr ; " +
+                   ". " + library_path() + " ; " +
                    ". " + fix_plain_name(filename) + " ; " +
                    "main \"${@}\"");
     return command;
@@ -76,13 +260,14 @@ construct_script(const char* filename)
 
 static
 const char**
-construct_argv(const std::string& shell, const int interpreter_argc,
-               const char* const* interpreter_argv)
+construct_argv(const std::string& shell,
+               const int interpreter_argc, const char* const* interpreter_argv)
 {
     PRE(interpreter_argc >= 1);
     PRE(interpreter_argv[0] != NULL);
 
-    const std::string* script = construct_script(interpreter_argv[0]);
+    const std::string* script = construct_script(
+        interpreter_argv[0], atf::env::get("ATF_SHELL", ATF_SHELL));
 
     const int count = 4 + (interpreter_argc - 1) + 1;
     const char** argv = new const char*[count];
@@ -99,6 +284,390 @@ construct_argv(const std::string& shell, const int interpreter_argc,
     return argv;
 }
 
+//!
+//! \brief Looks for a program in the PATH.
+//!
+//! Returns an empty string if the program cannot be found.  Names that
+//! contain a slash are returned as is if they are executable.
+//!
+static
+std::string
+find_in_path(const std::string& name)
+{
+    if (name.find('/') != std::string::npos)
+        return ::access(name.c_str(), X_OK) == 0 ? name : "";
+
+    const std::vector< std::string > dirs =
+        atf::text::split(atf::env::get("PATH", ""), ":");
+    for (std::vector< std::string >::const_iterator iter = dirs.begin();
+         iter != dirs.end(); iter++) {
+        const std::string candidate = *iter + "/" + name;
+        if (::access(candidate.c_str(), X_OK) == 0)
+            return candidate;
+    }
+    return "";
+}
+
+static
+int64_t
+now_usec(void)
+{
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return static_cast< int64_t >(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+//!
+//! \brief Executes a command with all its standard streams on /dev/null.
+//!
+//! Returns true if the command exited successfully.
+//!
+static
+bool
+run_silently(const std::vector< std::string >& args)
+{
+    std::vector< char* > argv;
+    for (std::vector< std::string >::const_iterator iter = args.begin();
+         iter != args.end(); iter++)
+        argv.push_back(const_cast< char* >((*iter).c_str()));
+    argv.push_back(NULL);
+
+    const pid_t pid = ::fork();
+    if (pid == -1)
+        return false;
+    else if (pid == 0) {
+        const int fd = ::open("/dev/null", O_RDWR);
+        if (fd != -1) {
+            ::dup2(fd, STDIN_FILENO);
+            ::dup2(fd, STDOUT_FILENO);
+            ::dup2(fd, STDERR_FILENO);
+            if (fd > STDERR_FILENO)
+                ::close(fd);
+        }
+        ::execv(argv[0], &argv[0]);
+        ::_exit(127);
+    }
+
+    int status;
+    while (::waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR)
+            return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+//!
+//! \brief Checks if a shell passes the self-test and measures its startup.
+//!
+//! The startup time is the median wall time of listing the test cases of
+//! the self-test program, which covers starting the interpreter and
+//! loading the library but not running any test.
+//!
+static
+void
+probe_shell(shell_probe& probe, const std::string& workdir)
+{
+    probe.path = find_in_path(probe.name);
+    if (probe.path.empty())
+        return;
+
+    const std::string program = workdir + "/selftest";
+    const std::string resfile = workdir + "/result";
+    ::unlink(resfile.c_str());
+
+    std::auto_ptr< std::string > script(
+        construct_script(program.c_str(), probe.path));
+
+    std::vector< std::string > args;
+    args.push_back(probe.path);
+    args.push_back("-c");
+    args.push_back(*script);
+    args.push_back(program);
+
+    std::vector< std::string > run_args = args;
+    run_args.push_back("-r");
+    run_args.push_back(resfile);
+    run_args.push_back("-v");
+    run_args.push_back("the-var=expected");
+    run_args.push_back("selftest");
+    if (!run_silently(run_args))
+        return;
+
+    std::ifstream is(resfile.c_str());
+    std::string result;
+    if (!std::getline(is, result) || result != "passed")
+        return;
+    probe.passed = true;
+
+    std::vector< std::string > list_args = args;
+    list_args.push_back("-l");
+    std::vector< int64_t > times;
+    for (int i = 0; i < 5; i++) {
+        const int64_t start = now_usec();
+        if (!run_silently(list_args)) {
+            probe.passed = false;
+            return;
+        }
+        times.push_back(now_usec() - start);
+    }
+    std::sort(times.begin(), times.end());
+    probe.usec = times[times.size() / 2];
+}
+
+//!
+//! \brief Probes all the given candidate shells.
+//!
+static
+std::vector< shell_probe >
+probe_shells(const std::string& candidates)
+{
+    const std::string tmpdir = atf::env::get("TMPDIR", "/tmp");
+    std::string pattern = tmpdir + "/atf-sh.XXXXXX";
+    std::vector< char > buf(pattern.begin(), pattern.end());
+    buf.push_back('\0');
+    if (::mkdtemp(&buf[0]) == NULL)
+        throw std::runtime_error("Cannot create temporary directory in " +
+                                 tmpdir + ": " + std::strerror(errno));
+    const std::string workdir(&buf[0]);
+
+    std::vector< shell_probe > probes;
+    {
+        std::ofstream os((workdir + "/selftest").c_str());
+        os << selftest_program;
+    }
+    const std::vector< std::string > names =
+        atf::text::split(candidates, " ");
+    for (std::vector< std::string >::const_iterator iter = names.begin();
+         iter != names.end(); iter++) {
+        probes.push_back(shell_probe(*iter));
+        probe_shell(probes.back(), workdir);
+    }
+
+    ::unlink((workdir + "/selftest").c_str());
+    ::unlink((workdir + "/result").c_str());
+    ::rmdir(workdir.c_str());
+
+    return probes;
+}
+
+static
+std::string
+fastest_shell(const std::vector< shell_probe >& probes)
+{
+    const shell_probe* best = NULL;
+    for (std::vector< shell_probe >::const_iterator iter = probes.begin();
+         iter != probes.end(); iter++) {
+        if ((*iter).passed && (best == NULL || (*iter).usec < best->usec))
+            best = &(*iter);
+    }
+    return best == NULL ? "" : best->path;
+}
+
+static
+std::string
+shell_candidates(void)
+{
+    return atf::env::get("ATF_SHELL_CANDIDATES", default_shell_candidates);
+}
+
+//!
+//! \brief Returns the path to the file that caches the selected shell.
+//!
+//! The file depends on the list of candidates and on the stamp of the
+//! library, so that changing any of them triggers a new selection, which
+//! runs the self-test against the new library.  Returns an empty string if
+//! caching is disabled.
+//!
+static
+std::string
+selected_shell_file(void)
+{
+    const std::string dir = cache_dir();
+    if (dir.empty())
+        return "";
+    return dir + "/shell." + hash_string(shell_candidates() + "\n" +
+                                         library_stamp());
+}
+
+static
+void
+store_selected_shell(const std::string& shell)
+{
+    const std::string file = selected_shell_file();
+    if (!file.empty())
+        (void)write_file_atomically(file, shell + "\n");
+}
+
+//!
+//! \brief Returns the fastest candidate shell that can run the library.
+//!
+//! The candidates are only probed if there is no cached selection.
+//!
+static
+std::string
+select_shell(void)
+{
+    const std::string file = selected_shell_file();
+    if (!file.empty()) {
+        std::ifstream is(file.c_str());
+        std::string shell;
+        if (std::getline(is, shell) && !shell.empty() &&
+            ::access(shell.c_str(), X_OK) == 0)
+            return shell;
+    }
+
+    const std::string shell = fastest_shell(probe_shells(shell_candidates()));
+    if (shell.empty())
+        throw std::runtime_error("None of the candidate shells (" +
+                                 shell_candidates() + ") can run the atf-sh "
+                                 "library");
+    store_selected_shell(shell);
+    return shell;
+}
+
+//!
+//! \brief The action requested from a test program by its arguments.
+//!
+//! Only the arguments that affect the recording of durations are
+//! recognized; the library takes care of validating all of them.
+//!
+struct tp_request {
+    bool list;
+    bool shard;
+    std::vector< std::string > tcargs;
+
+    tp_request(const int argc, const char* const* argv) :
+        list(false),
+        shard(false)
+    {
+        int i = 0;
+        for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+            if (std::strcmp(argv[i], "--") == 0) {
+                i++;
+                break;
+            }
+            for (const char* ch = &argv[i][1]; *ch != '\0'; ch++) {
+                if (*ch == 'l')
+                    list = true;
+                else if (std::strchr("rsSv", *ch) != NULL) {
+                    shard |= *ch == 'S';
+                    if (*(ch + 1) == '\0')
+                        i++;
+                    break;
+                }
+            }
+        }
+        for (; i < argc; i++)
+            tcargs.push_back(argv[i]);
+    }
+
+    //!
+    //! \brief Returns the test case whose body is run, if any.
+    //!
+    //! Cleanup routines and batches of test cases are not timed.
+    //!
+    std::string
+    timed_tc(void)
+        const
+    {
+        if (list || shard || tcargs.size() != 1)
+            return "";
+        const std::string::size_type pos = tcargs[0].find(':');
+        if (pos == std::string::npos)
+            return tcargs[0];
+        else if (tcargs[0].substr(pos + 1) == "body")
+            return tcargs[0].substr(0, pos);
+        else
+            return "";
+    }
+};
+
+static
+std::string
+canonical_path(const std::string& path)
+{
+    char resolved[PATH_MAX];
+    if (::realpath(path.c_str(), resolved) == NULL)
+        return path;
+    return resolved;
+}
+
+//!
+//! \brief Passes the recorded durations of a test program to the library.
+//!
+//! The library adds them to the listing of the test cases as hints.  They
+//! are exported as a space-separated list of ident=msec words.
+//!
+static
+void
+export_duration_hints(const std::string& program)
+{
+    const char* file = atf_history_file();
+    if (file == NULL)
+        return;
+
+    atf_history_t history;
+    atf_error_t err = atf_history_init(&history, file, program.c_str());
+    if (atf_is_error(err)) {
+        atf_error_free(err);
+        return;
+    }
+    std::ostringstream hints;
+    hints << " ";
+    for (size_t i = 0; i < atf_history_count(&history); i++)
+        hints << atf_history_ident(&history, i) << "="
+              << atf_history_msec(&history, i) << " ";
+    atf_history_fini(&history);
+
+    atf::env::set("__ATF_SH_DURATION_HINTS", hints.str());
+}
+
+//!
+//! \brief Runs the shell in a subprocess and records its duration.
+//!
+//! Terminates the current process with the same status as the shell.
+//!
+static
+void
+exec_timed(const std::string& shell, const char** argv,
+           const std::string& program, const std::string& tcname)
+{
+    const int64_t start = now_usec();
+
+    const pid_t pid = ::fork();
+    if (pid == -1)
+        return;
+    else if (pid == 0) {
+        ::execv(shell.c_str(), const_cast< char** >(argv));
+        std::cerr << "Failed to execute " << shell << ": "
+                  << std::strerror(errno) << "\n";
+        ::_exit(EXIT_FAILURE);
+    }
+
+    // The shell receives any terminal signals on its own.
+    ::signal(SIGINT, SIG_IGN);
+    ::signal(SIGQUIT, SIG_IGN);
+
+    int status;
+    while (::waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR)
+            std::exit(EXIT_FAILURE);
+    }
+
+    if (WIFEXITED(status)) {
+        atf_error_t err = atf_history_record(
+            atf_history_file(), program.c_str(), tcname.c_str(),
+            (now_usec() - start) / 1000);
+        if (atf_is_error(err))
+            atf_error_free(err);
+        std::exit(WEXITSTATUS(status));
+    }
+
+    ::signal(WTERMSIG(status), SIG_DFL);
+    ::kill(::getpid(), WTERMSIG(status));
+    std::abort();
+}
+
 } // anonymous namespace
 
 // ------------------------------------------------------------------------
@@ -109,10 +678,13 @@ class atf_sh : public atf::application::app {
     static const char* m_description;
 
     atf::fs::path m_shell;
+    bool m_probe;
 
     options_set specific_options(void) const;
     void process_option(int, const char*);
 
+    int probe(void) const;
+
 public:
     atf_sh(void);
 
@@ -125,7 +697,8 @@ const char* atf_sh::m_description =
 
 atf_sh::atf_sh(void) :
     app(m_description, "atf-sh(1)"),
-    m_shell(atf::fs::path(atf::env::get("ATF_SHELL", ATF_SHELL)))
+    m_shell(atf::fs::path(atf::env::get("ATF_SHELL", ATF_SHELL))),
+    m_probe(false)
 {
 }
 
@@ -137,8 +710,11 @@ atf_sh::specific_options(void)
     options_set opts;
 
     INV(m_shell == atf::fs::path(atf::env::get("ATF_SHELL", ATF_SHELL)));
-    opts.insert(option('s', "shell", "Path to the shell interpreter to use; "
+    opts.insert(option('s', "shell", "Path to the shell interpreter to use, "
+                       "or auto to select the fastest one; "
                        "default: " + m_shell.str()));
+    opts.insert(option('p', "", "Probe the candidate shells, report their "
+                       "startup times and cache the fastest one"));
 
     return opts;
 }
@@ -151,14 +727,61 @@ atf_sh::process_option(int ch, const char* arg)
         m_shell = atf::fs::path(arg);
         break;
 
+    case 'p':
+        m_probe = true;
+        break;
+
     default:
         UNREACHABLE;
     }
 }
 
+int
+atf_sh::probe(void)
+    const
+{
+    const std::vector< shell_probe > probes = probe_shells(shell_candidates());
+    for (std::vector< shell_probe >::const_iterator iter = probes.begin();
+         iter != probes.end(); iter++) {
+        std::cout << (*iter).name << ": ";
+        if ((*iter).path.empty()) {
+            std::cout << "not found\n";
+            continue;
+        }
+
+        if ((*iter).path != (*iter).name)
+            std::cout << (*iter).path << ": ";
+        if (!(*iter).passed)
+            std::cout << "failed the self-test";
+        else {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.1f",
+                          (*iter).usec / 1000.0);
+            std::cout << buf << " ms";
+        }
+        std::cout << "\n";
+    }
+
+    const std::string shell = fastest_shell(probes);
+    if (shell.empty()) {
+        std::cerr << "No candidate shell can run the atf-sh library\n";
+        return EXIT_FAILURE;
+    }
+    store_selected_shell(shell);
+    std::cout << "Selected: " << shell << "\n";
+    return EXIT_SUCCESS;
+}
+
 int
 atf_sh::main(void)
 {
+    if (m_probe) {
+        if (m_argc > 0)
+            throw atf::application::usage_error("Cannot provide a test "
+                                                "program with -p");
+        return probe();
+    }
+
     if (m_argc < 1)
         throw atf::application::usage_error("No test program provided");
 
@@ -167,13 +790,29 @@ atf_sh::main(void)
         throw std::runtime_error("The test program '" + script.str() + "' "
                                  "does not exist");
 
-    const char** argv = construct_argv(m_shell.str(), m_argc, m_argv);
+    std::string shell = m_shell.str();
+    if (shell == "auto") {
+        shell = select_shell();
+        // Let the library and atf-check -x use the same interpreter.
+        atf::env::set("ATF_SHELL", shell);
+    }
+
+    const char** argv = construct_argv(shell, m_argc, m_argv);
     // Don't bother keeping track of the memory allocated by construct_argv:
     // we are going to exec or die immediately.
 
-    const int ret = execv(m_shell.c_str(), const_cast< char** >(argv));
+    if (atf_history_file() != NULL) {
+        const tp_request request(m_argc - 1, m_argv + 1);
+        const std::string program = canonical_path(script.str());
+        if (request.list || request.shard)
+            export_duration_hints(program);
+        else if (!request.timed_tc().empty())
+            exec_timed(shell, argv, program, request.timed_tc());
+    }
+
+    const int ret = execv(shell.c_str(), const_cast< char** >(argv));
     INV(ret == -1);
-    std::cerr << "Failed to execute " << m_shell.str() << ": "
+    std::cerr << "Failed to execute " << shell << ": "
               << std::strerror(errno) << "\n";
     return EXIT_FAILURE;
 }
@@ -70,10 +70,40 @@ get_body()
               "TEST_VARIABLE=foo ${h} -v foo=baz config_get"
 }
 
+atf_test_case get_var
+get_var_head()
+{
+    atf_set "descr" "Verifies that atf_config_get_var works"
+}
+get_var_body()
+{
+    h="$(atf_get_srcdir)/misc_helpers -s $(atf_get_srcdir)"
+
+    echo "Querying an undefined variable"
+    ( atf_config_get_var v "undefined" ) >out 2>err && \
+        atf_fail "Getting an undefined variable succeeded"
+    grep 'not find' err || \
+        atf_fail "Getting an undefined variable did not report an error"
+
+    echo "Querying an undefined variable using a default value"
+    atf_config_get_var v "undefined" "the  default value"
+    [ "${v}" = "the  default value" ] || \
+        atf_fail "Default value does not work"
+
+    atf_check -s eq:0 -o match:'^foo = bar$' \
+              -o match:'^foo with default = bar$' -e ignore -x \
+              "TEST_VARIABLE=foo ${h} -v foo=bar config_get_var"
+
+    atf_check -s eq:0 -o not-match:'^foo = ' \
+              -o match:'^foo with default = the default value$' -e ignore -x \
+              "TEST_VARIABLE=foo ${h} config_get_var"
+}
+
 atf_init_test_cases()
 {
     atf_add_test_case has
     atf_add_test_case get
+    atf_add_test_case get_var
 }
 
 # vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
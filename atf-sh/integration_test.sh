@@ -24,6 +24,7 @@
 # IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 : ${ATF_SH:="__ATF_SH__"}
+: ${ATF_PKGDATADIR:="__ATF_PKGDATADIR__"}
 
 create_test_program() {
     local output="${1}"; shift
@@ -32,6 +33,60 @@ create_test_program() {
     chmod +x "${output}"
 }
 
+# Creates the test program ${1} with ${2} test cases, each of which defines
+# a few metadata properties and queries them from its body.
+create_many_tcs_program() {
+    i=0
+    while [ ${i} -lt ${2} ]; do
+        cat <<EOF
+atf_test_case tc${i}
+tc${i}_head() {
+    atf_set "descr" "Test case number ${i}"
+    atf_set "timeout" "30"
+    atf_set "X-custom.property" "value ${i}"
+}
+tc${i}_body() {
+    atf_get_var descr descr
+    atf_config_get_var value foo-bar "default"
+    atf_get_srcdir_var srcdir
+}
+EOF
+        i=$((${i} + 1))
+    done | create_test_program "${1}"
+
+    echo "atf_init_test_cases() {" >>"${1}"
+    i=0
+    while [ ${i} -lt ${2} ]; do
+        echo "    atf_add_test_case tc${i}" >>"${1}"
+        i=$((${i} + 1))
+    done
+    echo "}" >>"${1}"
+}
+
+# Runs the given command and stores in Forks the number of processes that
+# were created while it ran, including the command itself.  The command
+# runs in a private PID namespace, in which only its own processes are
+# allocated PIDs, sequentially from 2 on, so other processes running on
+# the system do not affect the count.  The last PID is read with cat(1),
+# which is then left out of the count, because the read builtin of some
+# shells only gets the first byte of sysctl files.  The test case is
+# skipped if unshare(1) cannot create such a namespace, with or without a
+# user namespace to gain the privileges to do so.
+count_forks() {
+    for flags in '' '--user --map-root-user'; do
+        unshare ${flags} --pid --fork --mount-proc true >/dev/null 2>&1 || \
+            continue
+
+        Forks=$(unshare ${flags} --pid --fork --mount-proc /bin/sh -c '
+            "${@}" >/dev/null 2>&1 || exit 1
+            echo $(($(cat /proc/sys/kernel/ns_last_pid) - 2))' \
+            count_forks "${@}") || \
+            atf_fail "${*} failed"
+        return
+    done
+    atf_skip "Cannot run the command in a private PID namespace"
+}
+
 atf_test_case no_args
 no_args_body()
 {
@@ -147,6 +202,468 @@ EOF
         "${ATF_SH}" -s ./custom-shell tp helper
 }
 
+atf_test_case list_forks
+list_forks_head()
+{
+    atf_set "descr" "Benchmarks the number of processes spawned while" \
+        "listing the test cases of a large test program"
+}
+list_forks_body()
+{
+    create_many_tcs_program tp 300
+
+    atf_check -o match:'^ident: tc299$' -o match:'^descr: Test case number 0$' \
+        -o match:'^X-custom.property: value 299$' ./tp -l
+
+    count_forks ./tp -l
+    echo "Forks while listing 300 test cases: ${Forks}"
+    # The listing itself must not fork at all: only the test program runs.
+    [ ${Forks} -eq 1 ] || atf_fail "Listing spawned ${Forks} processes"
+}
+
+atf_test_case run_forks
+run_forks_head()
+{
+    atf_set "descr" "Benchmarks the number of processes spawned while" \
+        "running a test case that queries its metadata"
+}
+run_forks_body()
+{
+    create_many_tcs_program tp 300
+
+    count_forks ./tp -r result tc299
+    echo "Forks while running a test case: ${Forks}"
+    atf_check -o inline:'passed\n' cat result
+    [ ${Forks} -lt 3 ] || atf_fail "Running spawned ${Forks} processes"
+}
+
+# Creates a test program whose test cases exercise the state that the
+# atf-check coprocess has to replicate for every check.
+create_check_program() {
+    create_test_program "${1}" <<'EOF'
+atf_test_case checks
+checks_body() {
+    export ATF_TEST_VAR="a 'quoted' \"value\" with \$dollars, \\ and
+a newline"
+    export ATF_EMPTY_VAR=
+    mkdir subdir
+    cd subdir
+    umask 027
+
+    atf_check -o inline:"${ATF_TEST_VAR}\n" \
+        -x 'printf "%s\n" "${ATF_TEST_VAR}"'
+    atf_check -o inline:'set\n' -x 'echo ${ATF_EMPTY_VAR+set}'
+    atf_check -o match:'/subdir$' pwd
+    atf_check -o inline:'0027\n' -x umask
+    atf_check -s exit:3 -o inline:'out\nmore' -e inline:'err\n' \
+        -x 'echo out; printf more; echo err >&2; exit 3'
+    atf_check -o inline:'from stdin\n' -x 'echo from stdin | cat'
+    echo 'through a pipe' | atf_check -o inline:'through a pipe\n' cat
+    echo "server: ${Check_Server}"
+
+    export ATF_LATE_VAR=late
+    atf_check -o inline:'late\n' -x 'echo ${ATF_LATE_VAR}'
+    unset ATF_TEST_VAR
+    atf_check -o inline:'unset\n' -x 'echo ${ATF_TEST_VAR-unset}'
+    echo "server: ${Check_Server}"
+}
+
+atf_test_case busy_fds
+busy_fds_body() {
+    exec 8>/dev/null
+    atf_check -o inline:'yes\n' echo yes
+    echo "server: ${Check_Server}"
+    echo 'still mine' >&8 || atf_fail "Lost file descriptor 8"
+}
+
+atf_test_case failure
+failure_body() {
+    atf_check -o inline:'foo\n' echo bar
+}
+
+atf_init_test_cases() {
+    atf_add_test_case checks
+    atf_add_test_case failure
+    atf_add_test_case busy_fds
+}
+EOF
+}
+
+atf_test_case shell_probe
+shell_probe_head()
+{
+    atf_set "descr" "Verifies that atf-sh -p only selects shells that pass" \
+        "the self-test of the library"
+}
+shell_probe_body()
+{
+    cat >broken-shell <<EOF
+#! /bin/sh
+exit 1
+EOF
+    chmod +x broken-shell
+
+    export ATF_CACHE_DIR="$(pwd)/cache"
+    export ATF_SHELL_CANDIDATES="missing-shell $(pwd)/broken-shell /bin/sh"
+    atf_check -o match:'^missing-shell: not found$' \
+        -o match:'broken-shell: failed the self-test$' \
+        -o match:'^/bin/sh: [0-9.]+ ms$' \
+        -o match:'^Selected: /bin/sh$' "${ATF_SH}" -p
+    atf_check -o match:'^shell\.' ls cache
+
+    export ATF_SHELL_CANDIDATES="missing-shell $(pwd)/broken-shell"
+    atf_check -s exit:1 -o match:'broken-shell: failed the self-test$' \
+        -e match:'No candidate shell' "${ATF_SH}" -p
+}
+
+atf_test_case shell_auto
+shell_auto_head()
+{
+    atf_set "descr" "Verifies that atf-sh -s auto runs the test program" \
+        "with the selected shell and caches the selection"
+}
+shell_auto_body()
+{
+    cat >fake-shell <<EOF
+#! /bin/sh
+echo "fake shell executed" >>"$(pwd)/fake-shell.log"
+exec /bin/sh "\${@}"
+EOF
+    chmod +x fake-shell
+
+    create_test_program tp -sauto <<'EOF'
+atf_test_case tc
+tc_body() {
+    echo "Atf_Shell is ${Atf_Shell}"
+    atf_check -o inline:"${Atf_Shell}\n" -x 'echo ${ATF_SHELL}'
+}
+atf_init_test_cases() {
+    atf_add_test_case tc
+}
+EOF
+
+    export ATF_CACHE_DIR="$(pwd)/cache"
+    export ATF_SHELL_CANDIDATES="$(pwd)/fake-shell"
+    atf_check -o match:"Atf_Shell is $(pwd)/fake-shell" -e ignore \
+        ./tp -r result tc
+    atf_check -o inline:'passed\n' cat result
+    # The self-test runs the shell 6 times.  The test program runs it
+    # twice: once for itself and once for atf_check -x.
+    atf_check -o inline:'8\n' grep -c executed fake-shell.log
+
+    # The selection is cached, so the self-test does not run again.
+    atf_check -o match:"Atf_Shell is $(pwd)/fake-shell" -e ignore \
+        ./tp -r result tc
+    atf_check -o inline:'10\n' grep -c executed fake-shell.log
+
+    ATF_SHELL_CANDIDATES=missing-shell atf_check -s exit:1 \
+        -e match:'None of the candidate shells' ./tp -r result tc
+}
+
+atf_test_case selection_cache
+selection_cache_head()
+{
+    atf_set "descr" "Verifies that the selected shell is cached until the" \
+        "library changes and that the cache can be disabled"
+}
+selection_cache_body()
+{
+    cat >fake-shell <<EOF
+#! /bin/sh
+echo "fake shell executed" >>"$(pwd)/fake-shell.log"
+exec /bin/sh "\${@}"
+EOF
+    chmod +x fake-shell
+
+    create_test_program tp <<'EOF'
+atf_test_case tc
+tc_body() {
+    echo "Atf_Shell is ${Atf_Shell}"
+}
+atf_init_test_cases() {
+    atf_add_test_case tc
+}
+EOF
+
+    mkdir pkgdata
+    cp "${ATF_PKGDATADIR}/libatf-sh.subr" pkgdata
+    export ATF_PKGDATADIR="$(pwd)/pkgdata"
+    export ATF_CACHE_DIR="$(pwd)/cache"
+    export ATF_SHELL_CANDIDATES="$(pwd)/fake-shell"
+
+    # The self-test runs the shell 6 times and the test program once.
+    atf_check -o match:'Atf_Shell is .*/fake-shell$' -e ignore \
+        "${ATF_SH}" -s auto tp tc
+    atf_check -o inline:'7\n' grep -c executed fake-shell.log
+    atf_check -o match:'^shell\.' ls cache
+    atf_check -o match:'Atf_Shell is .*/fake-shell$' -e ignore \
+        "${ATF_SH}" -s auto tp tc
+    atf_check -o inline:'8\n' grep -c executed fake-shell.log
+
+    # A change to the library that keeps its size and modification time
+    # still triggers a new self-test.
+    sed 's/^# vim:/#_vim:/' pkgdata/libatf-sh.subr >lib.new
+    touch -r pkgdata/libatf-sh.subr lib.new
+    cat lib.new >pkgdata/libatf-sh.subr
+    touch -r lib.new pkgdata/libatf-sh.subr
+    atf_check -o match:'Atf_Shell is .*/fake-shell$' -e ignore \
+        "${ATF_SH}" -s auto tp tc
+    atf_check -o inline:'15\n' grep -c executed fake-shell.log
+    unset ATF_PKGDATADIR
+
+    # Shells given explicitly never touch the cache.
+    rm -rf cache
+    atf_check -o match:'Atf_Shell is ' -e ignore "${ATF_SH}" -s /bin/sh tp tc
+    atf_check -s exit:1 test -d cache
+
+    rm -f fake-shell.log
+    ATF_CACHE_DIR= atf_check -o match:'Atf_Shell is .*/fake-shell$' \
+        -e ignore "${ATF_SH}" -s auto tp tc
+    atf_check -s exit:1 test -d cache
+    atf_check -o inline:'7\n' grep -c executed fake-shell.log
+
+    # Without ATF_CACHE_DIR, the cache lives in a private directory under
+    # TMPDIR, which is not used if others can write to it.
+    unset ATF_CACHE_DIR
+    mkdir tmp
+    export TMPDIR="$(pwd)/tmp"
+    atf_check -o match:'Atf_Shell is .*/fake-shell$' -e ignore \
+        "${ATF_SH}" -s auto tp tc
+    atf_check -o match:'^shell\.' ls tmp/atf-cache-$(id -u)
+    rm -rf tmp/atf-cache-$(id -u)/*
+    chmod 777 tmp/atf-cache-$(id -u)
+    atf_check -o match:'Atf_Shell is .*/fake-shell$' -e ignore \
+        "${ATF_SH}" -s auto tp tc
+    atf_check -o inline:'' ls tmp/atf-cache-$(id -u)
+}
+
+atf_test_case startup_benchmark
+startup_benchmark_head()
+{
+    atf_set "descr" "Verifies that the startup benchmark reports the time" \
+        "of every shell that can run the library"
+}
+startup_benchmark_body()
+{
+    cat >broken-shell <<EOF
+#! /bin/sh
+exit 1
+EOF
+    chmod +x broken-shell
+
+    benchmark="$(atf_get_srcdir)/startup_benchmark.sh"
+    export ATF_SH
+    atf_check -o save:report "${benchmark}" -t 1 missing-shell \
+        "$(pwd)/broken-shell" /bin/sh
+    atf_check -o inline:'3\n' -x 'wc -l <report | tr -d " "'
+    atf_check -o match:'^missing-shell: not found$' \
+        -o match:'broken-shell: cannot run the atf-sh library$' \
+        -o match:'^/bin/sh: [0-9]+\.[0-9] ms \(shell alone: [0-9.]+ ms\)$' \
+        cat report
+
+    atf_check -s exit:1 -o match:'missing-shell: not found' \
+        "${benchmark}" -t 1 missing-shell
+    atf_check -s exit:1 -e match:'Invalid number of seconds' \
+        "${benchmark}" -t 0 /bin/sh
+}
+
+atf_test_case batch
+batch_head()
+{
+    atf_set "descr" "Verifies that several test cases can be run from a" \
+        "single invocation and that they are isolated from each other"
+}
+batch_body()
+{
+    create_test_program tp <<'EOF'
+atf_test_case first cleanup
+first_body() {
+    atf_expect_fail "Known to fail"
+    export LEAKED_VAR=yes
+    touch leaked-file
+    umask 077
+    atf_fail "Failed as expected"
+}
+first_cleanup() {
+    [ -f leaked-file ] && echo "cleanup in the work directory"
+}
+
+atf_test_case second
+second_body() {
+    [ -z "${LEAKED_VAR}" ] || atf_fail "Variable leaked from first"
+    [ ! -f leaked-file ] || atf_fail "File leaked from first"
+    [ "$(umask)" != 0077 ] || atf_fail "umask leaked from first"
+    atf_check -o inline:'value\n' echo "$(atf_config_get the-var)"
+}
+
+atf_test_case third
+third_body() {
+    atf_fail "Failed for real"
+}
+
+atf_init_test_cases() {
+    atf_add_test_case first
+    atf_add_test_case second
+    atf_add_test_case third
+}
+EOF
+
+    mkdir results
+    atf_check -s exit:1 -o match:'cleanup in the work directory' -e ignore \
+        ./tp -v the-var=value -R results first first:cleanup second third
+    atf_check -o inline:'expected_failure: Known to fail: Failed as expected\n' \
+        cat results/first
+    atf_check -o inline:'passed\n' cat results/second
+    atf_check -o inline:'failed: Failed for real\n' cat results/third
+    # The work directories are gone once the test cases are done.
+    atf_check -o inline:'\n' -x 'echo $(ls -d first atf-batch.* 2>/dev/null)'
+
+    atf_check -s exit:0 -o ignore -e ignore ./tp -v the-var=value \
+        -R results first second
+    atf_check -s exit:1 -o empty -e match:'Unknown test case .fourth' \
+        ./tp -R results second fourth
+    atf_check -s exit:1 -o empty -e match:'Results directory .missing' \
+        ./tp -R missing first second
+    atf_check -s exit:1 -o empty -e match:'-r cannot be used with several' \
+        ./tp -r results first second
+}
+
+atf_test_case batch_forks
+batch_forks_head()
+{
+    atf_set "descr" "Benchmarks the number of processes spawned while" \
+        "running many test cases from a single invocation"
+}
+batch_forks_body()
+{
+    create_many_tcs_program tp 300
+
+    set --
+    i=0
+    while [ ${i} -lt 300 ]; do
+        set -- "${@}" tc${i}
+        i=$((${i} + 1))
+    done
+
+    mkdir results
+    count_forks ./tp -R results "${@}"
+    echo "Forks while running 300 test cases: ${Forks}"
+    atf_check -o inline:'passed\n' cat results/tc0
+    atf_check -o inline:'passed\n' cat results/tc299
+    # The test program, one subshell and one mkdir per test case, and the
+    # mktemp and rm of the directory holding the work directories.
+    [ ${Forks} -le 603 ] || atf_fail "Running spawned ${Forks} processes"
+}
+
+atf_test_case check_coprocess
+check_coprocess_head()
+{
+    atf_set "descr" "Verifies that atf_check calls delegated to the" \
+        "atf-check coprocess see the state of the shell"
+}
+check_coprocess_body()
+{
+    create_check_program tp
+
+    # The checked commands inherit the standard input of atf_check, which
+    # must be /dev/null for the nested test program to use its coprocess.
+    export ATF_CHECK_COPROCESS=yes
+    for shell in bash dash ksh mksh zsh sh; do
+        _atf_find_in_path_var path "${shell}" || continue
+        echo "Testing with ${path}"
+
+        atf_check -s exit:0 -o save:stdout \
+            -o match:'Executing command \[ pwd \]' -e ignore \
+            "${ATF_SH}" -s "${path}" tp -r "$(pwd)/result" checks </dev/null
+        atf_check -o inline:'passed\n' cat result
+        atf_check -o inline:'2\n' grep -c '^server: running$' stdout
+
+        atf_check -s exit:0 -o match:'^server: none$' -e ignore \
+            "${ATF_SH}" -s "${path}" tp -r "$(pwd)/result" busy_fds </dev/null
+        atf_check -o inline:'passed\n' cat result
+
+        atf_check -s exit:1 -o ignore -e match:'stdout does not match' \
+            "${ATF_SH}" -s "${path}" tp -r result failure
+        atf_check -o match:'^failed: atf-check failed' cat result
+    done
+}
+
+atf_test_case check_coprocess_disabled
+check_coprocess_disabled_head()
+{
+    atf_set "descr" "Verifies that the atf-check coprocess is disabled" \
+        "unless requested"
+}
+check_coprocess_disabled_body()
+{
+    create_check_program tp
+
+    unset ATF_CHECK_COPROCESS
+    atf_check -s exit:0 -o match:'^server: none$' -e ignore \
+        ./tp -r "$(pwd)/result" checks </dev/null
+    atf_check -o inline:'passed\n' cat result
+    ATF_CHECK_COPROCESS=no atf_check -s exit:0 -o match:'^server: none$' \
+        -e ignore ./tp -r "$(pwd)/result" checks
+    atf_check -o inline:'passed\n' cat result
+}
+
+atf_test_case check_coprocess_unavailable
+check_coprocess_unavailable_head()
+{
+    atf_set "descr" "Verifies that atf_check executes atf-check for every" \
+        "call if the coprocess cannot be started"
+    atf_set "timeout" "60"
+}
+check_coprocess_unavailable_body()
+{
+    create_check_program tp
+
+    mkdir libexec
+    cat >libexec/atf-check <<EOF
+#! /bin/sh
+[ "\${1}" != -C ] || exit 1
+exec "${Atf_Check}" "\${@}"
+EOF
+    chmod +x libexec/atf-check
+
+    export ATF_CHECK_COPROCESS=yes
+    export ATF_LIBEXECDIR="$(pwd)/libexec"
+    atf_check -s exit:0 -o match:'^server: none$' -e ignore \
+        ./tp -r "$(pwd)/result" checks </dev/null
+    atf_check -o inline:'passed\n' cat result
+}
+
+atf_test_case check_coprocess_benchmark
+check_coprocess_benchmark_head()
+{
+    atf_set "descr" "Benchmarks many atf_check calls with and without the" \
+        "atf-check coprocess"
+}
+check_coprocess_benchmark_body()
+{
+    create_test_program tp <<'EOF'
+atf_test_case many_checks
+many_checks_body() {
+    i=0
+    while [ ${i} -lt 200 ]; do
+        atf_check -o inline:"${i}\n" echo "${i}"
+        i=$((${i} + 1))
+    done
+}
+
+atf_init_test_cases() {
+    atf_add_test_case many_checks
+}
+EOF
+
+    for mode in yes no; do
+        echo "Running with ATF_CHECK_COPROCESS=${mode}"
+        ATF_CHECK_COPROCESS=${mode} atf_check -o ignore -e ignore -n 3 \
+            ./tp -r result many_checks
+        atf_check -o inline:'passed\n' cat result
+    done
+}
+
 atf_init_test_cases()
 {
     atf_add_test_case no_args
@@ -154,6 +671,18 @@ atf_init_test_cases()
     atf_add_test_case arguments
     atf_add_test_case custom_shell__command_line
     atf_add_test_case custom_shell__shebang
+    atf_add_test_case shell_probe
+    atf_add_test_case shell_auto
+    atf_add_test_case selection_cache
+    atf_add_test_case startup_benchmark
+    atf_add_test_case batch
+    atf_add_test_case batch_forks
+    atf_add_test_case check_coprocess
+    atf_add_test_case check_coprocess_disabled
+    atf_add_test_case check_coprocess_unavailable
+    atf_add_test_case check_coprocess_benchmark
+    atf_add_test_case list_forks
+    atf_add_test_case run_forks
     atf_add_test_case set_e
 }
 
@@ -215,6 +215,21 @@ config_get_body()
     fi
 }
 
+atf_test_case config_get_var
+config_get_var_head()
+{
+    atf_set "descr" "Helper test case for the t_config test program"
+}
+config_get_var_body()
+{
+    if atf_config_has ${TEST_VARIABLE}; then
+        atf_config_get_var value ${TEST_VARIABLE}
+        echo "${TEST_VARIABLE} = ${value}"
+    fi
+    atf_config_get_var value ${TEST_VARIABLE} "the default value"
+    echo "${TEST_VARIABLE} with default = ${value}"
+}
+
 atf_test_case config_has
 config_has_head()
 {
@@ -244,6 +259,11 @@ normalize_body()
 {
     echo "a.b: $(atf_get a.b)"
     echo "c-d: $(atf_get c-d)"
+
+    atf_get_var value a.b
+    echo "a.b var: ${value}"
+    atf_get_var value c-d
+    echo "c-d var: ${value}"
 }
 
 # -------------------------------------------------------------------------
@@ -337,6 +357,7 @@ atf_init_test_cases()
 
     # Add helper tests for t_config.
     atf_add_test_case config_get
+    atf_add_test_case config_get_var
     atf_add_test_case config_has
 
     # Add helper tests for t_normalize.
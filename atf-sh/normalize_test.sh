@@ -33,7 +33,8 @@ main_body()
 {
     h="$(atf_get_srcdir)/misc_helpers -s $(atf_get_srcdir)"
     atf_check -s eq:0 -o match:'a.b: test value 1' \
-        -o match:'c-d: test value 2' -e ignore ${h} normalize
+        -o match:'c-d: test value 2' -o match:'a.b var: test value 1' \
+        -o match:'c-d var: test value 2' -e ignore ${h} normalize
 }
 
 atf_init_test_cases()
@@ -0,0 +1,205 @@
+#! /bin/sh
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#
+# Measures the startup time of atf-sh test programs with every shell that
+# atf-sh can select.
+#
+# For each shell, a trivial test program is run once to verify that the
+# shell can run the atf-sh library, and is then asked to list its test
+# cases repeatedly for the given number of seconds.  The average time of
+# a run is reported together with the time it takes to start the shell
+# alone, so that the difference is the cost of loading the library.  Both
+# times include one call to date(1) per run.
+#
+# The shells are given as arguments and default to ATF_SHELL_CANDIDATES.
+# The atf-sh binary is looked up in the PATH unless ATF_SH is set.
+#
+
+Prog_Name=${0##*/}
+
+Atf_Sh=${ATF_SH:-atf-sh}
+Work_Dir=
+
+#
+# err message
+#
+err() {
+    echo "${Prog_Name}: ${@}" 1>&2
+    exit 1
+}
+
+#
+# usage
+#
+usage() {
+    echo "Usage: ${Prog_Name} [-t seconds] [shell ...]" 1>&2
+    exit 1
+}
+
+#
+# cleanup
+#
+# Removes the work directory, if any.
+#
+cleanup() {
+    [ -z "${Work_Dir}" ] || rm -rf "${Work_Dir}"
+}
+
+#
+# find_shell name
+#
+# Prints the path to the given shell, or nothing if it is not installed.
+#
+find_shell() {
+    case ${1} in
+        */*)
+            [ -x "${1}" ] && echo "${1}"
+            ;;
+        *)
+            command -v "${1}" 2>/dev/null | grep /
+            ;;
+    esac
+}
+
+#
+# time_command seconds command [arg1 .. argN]
+#
+# Runs the given command repeatedly for at least the given number of
+# seconds and prints the average wall time of a run in tenths of a
+# millisecond.  Fails if any run fails.
+#
+time_command() {
+    duration=${1}; shift
+
+    # Start right after the clock ticks so that whole seconds are measured.
+    now=$(date +%s)
+    start=${now}
+    while [ ${now} -eq ${start} ]; do
+        now=$(date +%s)
+    done
+
+    start=${now}
+    runs=0
+    while [ $((now - start)) -lt ${duration} ]; do
+        "${@}" >/dev/null 2>&1 </dev/null || return 1
+        runs=$((runs + 1))
+        now=$(date +%s)
+    done
+    echo $(((now - start) * 10000 / runs))
+}
+
+#
+# format_ms tenths
+#
+# Prints the given time, in tenths of a millisecond, in milliseconds.
+#
+format_ms() {
+    echo "$((${1} / 10)).$((${1} % 10)) ms"
+}
+
+#
+# benchmark seconds shell
+#
+# Measures the startup time of the test program with the given shell and
+# prints a line with the results.  Returns 0 only if the shell could be
+# measured.
+#
+benchmark() {
+    printf '%s: ' "${2}"
+    path=$(find_shell "${2}")
+    if [ -z "${path}" ]; then
+        echo "not found"
+        return 1
+    fi
+    [ "${path}" = "${2}" ] || printf '%s: ' "${path}"
+
+    rm -f "${Work_Dir}/result"
+    if ! "${Atf_Sh}" -s "${path}" "${Work_Dir}/tp" \
+        -r "${Work_Dir}/result" startup >/dev/null 2>&1 </dev/null || \
+        [ "$(cat "${Work_Dir}/result" 2>/dev/null)" != passed ]; then
+        echo "cannot run the atf-sh library"
+        return 1
+    fi
+
+    with_library=$(time_command "${1}" \
+        "${Atf_Sh}" -s "${path}" "${Work_Dir}/tp" -l) || \
+        { echo "failed to list the test cases"; return 1; }
+    alone=$(time_command "${1}" "${path}" -c :) || \
+        { echo "failed to start"; return 1; }
+    echo "$(format_ms ${with_library}) (shell alone: $(format_ms ${alone}))"
+}
+
+#
+# main [-t seconds] [shell1 .. shellN]
+#
+# Entry point.
+#
+main() {
+    seconds=2
+    while getopts ':t:' arg; do
+        case ${arg} in
+            t)
+                seconds=${OPTARG}
+                ;;
+            *)
+                usage
+                ;;
+        esac
+    done
+    shift $((OPTIND - 1))
+    case ${seconds} in
+        ''|*[!0-9]*|0)
+            err "Invalid number of seconds '${seconds}'"
+            ;;
+    esac
+
+    [ ${#} -gt 0 ] || set -- ${ATF_SHELL_CANDIDATES:-dash mksh ksh bash sh}
+
+    Work_Dir=$(mktemp -d "${TMPDIR:-/tmp}/${Prog_Name}.XXXXXX") || \
+        err "Cannot create a temporary directory"
+    trap cleanup EXIT
+    trap 'exit 1' HUP INT TERM
+    cat >"${Work_Dir}/tp" <<'EOT'
+atf_test_case startup
+startup_body() {
+    atf_check_equal a a
+}
+atf_init_test_cases() {
+    atf_add_test_case startup
+}
+EOT
+
+    ret=1
+    for shell in "${@}"; do
+        benchmark "${seconds}" "${shell}" && ret=0
+    done
+    return ${ret}
+}
+
+main "${@}"
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
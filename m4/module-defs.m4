@@ -23,6 +23,35 @@ dnl IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
 dnl OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 dnl IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+AC_DEFUN([ATF_ATTRIBUTE_COLD], [
+    AC_MSG_CHECKING(whether __attribute__((__cold__)) is supported)
+    AC_COMPILE_IFELSE(
+        [AC_LANG_PROGRAM([
+#if defined(__has_attribute)
+#   if !__has_attribute(__cold__)
+#       error "__cold__ is not supported"
+#   endif
+#elif !(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))
+#   error "__cold__ is not supported"
+#endif
+
+static void function(void) __attribute__((__cold__));
+
+static void
+function(void)
+{
+}], [
+    function();
+    return 0;
+])],
+        [AC_MSG_RESULT(yes)
+         value="__attribute__((__cold__))"],
+        [AC_MSG_RESULT(no)
+         value=""]
+    )
+    AC_SUBST([ATTRIBUTE_COLD], [${value}])
+])
+
 AC_DEFUN([ATF_ATTRIBUTE_FORMAT_PRINTF], [
     AC_MSG_CHECKING(
         [whether __attribute__((__format__(__printf__, a, b))) is supported])
@@ -101,8 +130,27 @@ function(int a __attribute__((__unused__)))
     AC_SUBST([ATTRIBUTE_UNUSED], [${value}])
 ])
 
+AC_DEFUN([ATF_BUILTIN_EXPECT], [
+    AC_MSG_CHECKING(whether __builtin_expect is supported)
+    AC_LINK_IFELSE(
+        [AC_LANG_PROGRAM([], [
+    int a = 3;
+    if (__builtin_expect(a != 3, 0))
+        return 1;
+    return 0;
+])],
+        [AC_MSG_RESULT(yes)
+         value="__builtin_expect(!!(x), 0)"],
+        [AC_MSG_RESULT(no)
+         value="(x)"]
+    )
+    AC_SUBST([BUILTIN_EXPECT_FALSE], [${value}])
+])
+
 AC_DEFUN([ATF_MODULE_DEFS], [
+    ATF_ATTRIBUTE_COLD
     ATF_ATTRIBUTE_FORMAT_PRINTF
     ATF_ATTRIBUTE_NORETURN
     ATF_ATTRIBUTE_UNUSED
+    ATF_BUILTIN_EXPECT
 ])
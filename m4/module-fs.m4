@@ -62,4 +62,9 @@ AC_DEFUN([ATF_MODULE_FS], [
         AC_DEFINE([HAVE_GETCWD_DYN], [1],
                   [Define to 1 if getcwd(NULL, 0) works])
     fi
+
+    AC_CHECK_HEADERS([linux/fs.h sys/sendfile.h])
+    AC_CHECK_FUNCS([copy_file_range memfd_create sendfile])
+    AC_CHECK_MEMBERS([struct stat.st_ctim.tv_nsec], [], [],
+                     [#include <sys/stat.h>])
 ])
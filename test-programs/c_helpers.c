@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <errno.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -447,6 +448,133 @@ ATF_TC_BODY(result_newlines_skip, tc)
     atf_tc_skip("First line\nSecond line");
 }
 
+/* ---------------------------------------------------------------------
+ * Helper tests for "t_fixture".
+ * --------------------------------------------------------------------- */
+
+static int fixture_runs = 0;
+
+ATF_TP_FIXTURE(fixture, tp)
+{
+    fixture_runs++;
+
+    if (atf_tp_has_config_var(tp, "fixture_log")) {
+        const char *path = atf_tp_get_config_var(tp, "fixture_log");
+        FILE *f = fopen(path, "a");
+        if (f == NULL)
+            return atf_libc_error(errno, "Cannot open %s", path);
+        fprintf(f, "fixture\n");
+        fclose(f);
+    }
+
+    if (atf_tp_has_config_var(tp, "fixture_fail"))
+        return atf_libc_error(EINVAL, "Fixture failed on purpose");
+    return atf_no_error();
+}
+
+ATF_TC_WITHOUT_HEAD(fixture_state);
+ATF_TC_BODY(fixture_state, tc)
+{
+    ATF_REQUIRE_EQ(1, fixture_runs);
+}
+
+/* ---------------------------------------------------------------------
+ * Helper tests for "t_param".
+ * --------------------------------------------------------------------- */
+
+struct sum_row {
+    atf_tc_row_t row;
+    int a, b, sum;
+    bool fatal;
+};
+
+static const struct sum_row sum_rows[] = {
+    { { "pass", NULL }, 1, 2, 3, true },
+    { { "fatal", "descr: A row that fails a requirement\n" }, 2, 2, 5, true },
+    { { "check", NULL }, 2, 2, 5, false },
+    { { "skip", NULL }, -1, 0, 0, true },
+    { { "crash", "X-isolated: true\n" }, 0, 0, -1, true },
+    { { "last", NULL }, 3, 4, 7, false },
+};
+
+ATF_TC_PARAM(param_sum, struct sum_row, sum_rows);
+ATF_TC_HEAD(param_sum, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_param test "
+                      "program");
+}
+ATF_TC_PARAM_BODY(param_sum, tc, row)
+{
+    printf("pid %d\n", (int)getpid());
+
+    if (row->a < 0)
+        atf_tc_skip("Negative operands are not supported");
+    if (row->sum < 0)
+        abort();
+
+    if (row->fatal)
+        ATF_REQUIRE_EQ(row->sum, row->a + row->b);
+    else
+        ATF_CHECK_EQ(row->sum, row->a + row->b);
+}
+
+/* ---------------------------------------------------------------------
+ * Helper tests for "t_output".
+ * --------------------------------------------------------------------- */
+
+ATF_TC(output_lines);
+ATF_TC_HEAD(output_lines, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_output test "
+                      "program");
+}
+ATF_TC_BODY(output_lines, tc)
+{
+    const char *result = atf_tc_get_config_var_wd(tc, "result", "pass");
+    const long lines = atf_tc_get_config_var_as_long_wd(tc, "lines", 10);
+    long i;
+
+    for (i = 1; i <= lines; i++) {
+        printf("stdout line %ld\n", i);
+        fprintf(stderr, "stderr line %ld\n", i);
+    }
+
+    if (strcmp(result, "fail") == 0)
+        atf_tc_fail("Failed on purpose");
+    else if (strcmp(result, "crash") == 0)
+        abort();
+    else if (strcmp(result, "exit") == 0)
+        exit(EXIT_SUCCESS);
+}
+
+/* ---------------------------------------------------------------------
+ * Helper tests for "t_require".
+ * --------------------------------------------------------------------- */
+
+ATF_TC(require_md);
+ATF_TC_HEAD(require_md, tc)
+{
+    static const char *const props[] = { "diskspace", "files", "memory",
+                                         "progs", NULL };
+    const char *const *prop;
+
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_require test "
+                      "program");
+    for (prop = props; *prop != NULL; prop++) {
+        if (atf_tc_has_config_var(tc, *prop)) {
+            char name[32];
+
+            snprintf(name, sizeof(name), "require.%s", *prop);
+            atf_tc_set_md_var(tc, name, "%s",
+                              atf_tc_get_config_var(tc, *prop));
+        }
+    }
+}
+ATF_TC_BODY(require_md, tc)
+{
+    atf_utils_create_file("ran", "%s", "");
+}
+
 /* ---------------------------------------------------------------------
  * Main.
  * --------------------------------------------------------------------- */
@@ -499,5 +627,18 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, result_newlines_fail);
     ATF_TP_ADD_TC(tp, result_newlines_skip);
 
+    /* Add helper tests for t_fixture. */
+    ATF_TP_ADD_FIXTURE(tp, fixture);
+    ATF_TP_ADD_TC(tp, fixture_state);
+
+    /* Add helper tests for t_param. */
+    ATF_TP_ADD_TC_PARAM(tp, param_sum);
+
+    /* Add helper tests for t_output. */
+    ATF_TP_ADD_TC(tp, output_lines);
+
+    /* Add helper tests for t_require. */
+    ATF_TP_ADD_TC(tp, require_md);
+
     return atf_no_error();
 }
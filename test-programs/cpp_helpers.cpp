@@ -307,6 +307,150 @@ ATF_TEST_CASE_BODY(result_exception)
     throw std::runtime_error("This is unhandled");
 }
 
+// ------------------------------------------------------------------------
+// Helper tests for "t_fixture".
+// ------------------------------------------------------------------------
+
+static int fixture_runs = 0;
+
+ATF_TP_FIXTURE(fixture, config)
+{
+    fixture_runs++;
+
+    const atf::tests::vars_map::const_iterator iter =
+        config.find("fixture_log");
+    if (iter != config.end()) {
+        std::ofstream os((*iter).second.c_str(), std::ios::app);
+        if (!os)
+            throw std::runtime_error("Cannot open " + (*iter).second);
+        os << "fixture\n";
+    }
+
+    if (config.find("fixture_fail") != config.end())
+        throw std::runtime_error("Fixture failed on purpose");
+}
+
+ATF_TEST_CASE_WITHOUT_HEAD(fixture_state);
+ATF_TEST_CASE_BODY(fixture_state)
+{
+    ATF_REQUIRE_EQ(1, fixture_runs);
+}
+
+// ------------------------------------------------------------------------
+// Helper tests for "t_param".
+// ------------------------------------------------------------------------
+
+struct sum_row {
+    atf::tests::tc_row row;
+    int a, b, sum;
+    bool fatal;
+};
+
+static const sum_row sum_rows[] = {
+    { { "pass", NULL }, 1, 2, 3, true },
+    { { "fatal", "descr: A row that fails a requirement\n" }, 2, 2, 5, true },
+    { { "check", NULL }, 2, 2, 5, false },
+    { { "skip", NULL }, -1, 0, 0, true },
+    { { "crash", "X-isolated: true\n" }, 0, 0, -1, true },
+    { { "last", NULL }, 3, 4, 7, false },
+};
+
+ATF_TEST_CASE_PARAM(param_sum, sum_row, sum_rows);
+ATF_TEST_CASE_HEAD(param_sum)
+{
+    set_md_var("descr", "Helper test case for the t_param test program");
+}
+ATF_TEST_CASE_PARAM_BODY(param_sum, row)
+{
+    std::cout << "pid " << ::getpid() << "\n";
+
+    if (row.a < 0)
+        ATF_SKIP("Negative operands are not supported");
+    if (row.sum < 0)
+        std::abort();
+
+    if (row.fatal)
+        ATF_REQUIRE_EQ(row.sum, row.a + row.b);
+    else if (row.sum != row.a + row.b)
+        fail_nonfatal("row.sum != row.a + row.b");
+}
+
+static const atf::tests::tc_row throw_rows[] = {
+    { "first", NULL },
+    { "second", NULL },
+};
+
+ATF_TEST_CASE_PARAM_WITHOUT_HEAD(param_throw, atf::tests::tc_row, throw_rows);
+ATF_TEST_CASE_PARAM_BODY(param_throw, row)
+{
+    if (std::string(row.id) == "first")
+        ATF_REQUIRE_THROW(std::runtime_error, ATF_REQUIRE(false));
+}
+
+static const atf::tests::tc_row swallow_rows[] = {
+    { "only", NULL },
+};
+
+ATF_TEST_CASE_PARAM_WITHOUT_HEAD(param_swallow, atf::tests::tc_row,
+                                 swallow_rows);
+ATF_TEST_CASE_PARAM_BODY(param_swallow, row)
+{
+    try {
+        ATF_FAIL(std::string("Failing on purpose in ") + row.id);
+    } catch (...) {
+    }
+    ATF_PASS();
+}
+
+// ------------------------------------------------------------------------
+// Helper tests for "t_output".
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE(output_lines);
+ATF_TEST_CASE_HEAD(output_lines)
+{
+    set_md_var("descr", "Helper test case for the t_output test program");
+}
+ATF_TEST_CASE_BODY(output_lines)
+{
+    const std::string result = get_config_var("result", "pass");
+    const long lines = std::atol(get_config_var("lines", "10").c_str());
+
+    for (long i = 1; i <= lines; i++) {
+        std::cout << "stdout line " << i << "\n";
+        std::cerr << "stderr line " << i << "\n";
+    }
+
+    if (result == "fail")
+        ATF_FAIL("Failed on purpose");
+    else if (result == "crash")
+        std::abort();
+    else if (result == "exit")
+        std::exit(EXIT_SUCCESS);
+}
+
+// ------------------------------------------------------------------------
+// Helper tests for "t_require".
+// ------------------------------------------------------------------------
+
+ATF_TEST_CASE(require_md);
+ATF_TEST_CASE_HEAD(require_md)
+{
+    static const char* const props[] = { "diskspace", "files", "memory",
+                                         "progs", NULL };
+
+    set_md_var("descr", "Helper test case for the t_require test program");
+    for (const char* const* prop = props; *prop != NULL; prop++) {
+        if (has_config_var(*prop))
+            set_md_var(std::string("require.") + *prop,
+                       get_config_var(*prop));
+    }
+}
+ATF_TEST_CASE_BODY(require_md)
+{
+    atf::utils::create_file("ran", "");
+}
+
 // ------------------------------------------------------------------------
 // Main.
 // ------------------------------------------------------------------------
@@ -352,4 +496,19 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, result_newlines_fail);
     ATF_ADD_TEST_CASE(tcs, result_newlines_skip);
     ATF_ADD_TEST_CASE(tcs, result_exception);
+
+    // Add helper tests for t_fixture.
+    ATF_ADD_FIXTURE(tcs, fixture);
+    ATF_ADD_TEST_CASE(tcs, fixture_state);
+
+    // Add helper tests for t_param.
+    ATF_ADD_TEST_CASE_PARAM(tcs, param_sum);
+    ATF_ADD_TEST_CASE_PARAM(tcs, param_throw);
+    ATF_ADD_TEST_CASE_PARAM(tcs, param_swallow);
+
+    // Add helper tests for t_output.
+    ATF_ADD_TEST_CASE(tcs, output_lines);
+
+    // Add helper tests for t_require.
+    ATF_ADD_TEST_CASE(tcs, require_md);
 }
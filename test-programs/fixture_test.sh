@@ -0,0 +1,151 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Checks that the fixture of the helpers ran the given number of times.
+check_runs()
+{
+    count=${1}
+
+    if [ ${count} -eq 0 ]; then
+        test ! -f log || atf_fail "The fixture ran"
+    else
+        atf_check -s eq:0 -o inline:"${count}\n" -e empty grep -c fixture log
+    fi
+}
+
+atf_test_case run
+run_head()
+{
+    atf_set "descr" "Checks that the fixture runs before the body of a" \
+                    "test case but not before its cleanup routine"
+}
+run_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -f log res
+        atf_check -s eq:0 -o ignore -e ignore \
+            "${h}" -r res -v fixture_log=$(pwd)/log fixture_state
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res
+        check_runs 1
+
+        atf_check -s eq:0 -o ignore -e ignore \
+            "${h}" -v fixture_log=$(pwd)/log fixture_state:cleanup
+        check_runs 1
+    done
+}
+
+atf_test_case list
+list_head()
+{
+    atf_set "descr" "Checks that listing the test cases does not run the" \
+                    "fixture and does not show it"
+}
+list_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:0 -o save:stdout -e empty \
+            "${h}" -l -v fixture_log=$(pwd)/log
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^ident: fixture_state$' stdout
+        atf_check -s eq:1 -o empty -e empty grep '^ident: fixture$' stdout
+        check_runs 0
+    done
+}
+
+atf_test_case shard
+shard_head()
+{
+    atf_set "descr" "Checks that running a shard runs the fixture once" \
+                    "and that all its test cases inherit its results"
+}
+shard_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -rf log work
+        mkdir -p work/res
+        atf_check -s ignore -o ignore -e ignore -x \
+            "cd work && ${h} -R res -v fixture_log=$(pwd)/log \
+             -v tmpfile=$(pwd)/tmpfile -S 1/1"
+        atf_check -s eq:0 -o inline:'passed\n' -e empty \
+            cat work/res/fixture_state
+        check_runs 1
+    done
+}
+
+atf_test_case server
+server_head()
+{
+    atf_set "descr" "Checks that a server runs the fixture once and that" \
+                    "all the test cases it runs inherit its results"
+}
+server_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -rf log res.* work
+        mkdir work
+        cat >requests <<EOF
+tc fixture_state
+resfile res.1
+workdir work
+
+tc fixture_state
+resfile res.2
+workdir work
+
+EOF
+        atf_check -s eq:0 -o ignore -e ignore -x \
+            "${h} -Z -v fixture_log=$(pwd)/log <requests"
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res.1
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res.2
+        check_runs 1
+    done
+}
+
+atf_test_case failure
+failure_head()
+{
+    atf_set "descr" "Checks that a failing fixture prevents the test case" \
+                    "from running"
+}
+failure_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -f res
+        atf_check -s eq:1 -o empty -e match:'Fixture failed on purpose' \
+            "${h}" -r res -v fixture_fail=yes fixture_state
+        test ! -f res || atf_fail "The test case ran"
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case run
+    atf_add_test_case list
+    atf_add_test_case shard
+    atf_add_test_case server
+    atf_add_test_case failure
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
@@ -0,0 +1,82 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+atf_test_case record
+record_head()
+{
+    atf_set "descr" "Checks that the duration of the test cases is" \
+                    "recorded and reported as a hint when listing them"
+}
+record_body()
+{
+    for h in $(get_helpers); do
+        rm -f history
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -l
+        test ! -f history || atf_fail "History created while listing"
+
+        export ATF_HISTORY_FILE=history
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -r res result_pass
+        atf_check -s eq:1 -o ignore -e ignore "${h}" -r res result_fail
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -r res \
+            result_skip:cleanup
+        test -f history || atf_fail "History not created"
+
+        atf_check -s eq:0 -o save:list -e ignore "${h}" -l
+        atf_check -s eq:0 -o inline:'2\n' -e empty \
+            grep -c '^X-duration-hint-ms: [0-9][0-9]*$' list
+        atf_check -s eq:0 -o match:'^result_pass$' -o match:'^result_fail$' \
+            -e empty awk '/^ident: / { ident = $2 }
+                /^X-duration-hint-ms: / { print ident }' list
+
+        unset ATF_HISTORY_FILE
+        atf_check -s eq:0 -o save:list -e ignore "${h}" -l
+        atf_check -s eq:1 -o empty -e empty grep X-duration-hint-ms list
+    done
+}
+
+atf_test_case separate_programs
+separate_programs_head()
+{
+    atf_set "descr" "Checks that the durations of different test programs" \
+                    "are kept apart"
+}
+separate_programs_body()
+{
+    export ATF_HISTORY_FILE=$(pwd)/history
+    for h in $(get_helpers); do
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -r res result_pass
+        atf_check -s eq:0 -o save:list -e ignore "${h}" -l
+        atf_check -s eq:0 -o inline:'1\n' -e empty \
+            grep -c '^X-duration-hint-ms: ' list
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case record
+    atf_add_test_case separate_programs
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
@@ -0,0 +1,148 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+atf_test_case pass
+pass_head()
+{
+    atf_set "descr" "Checks that the output of a passing test case is" \
+                    "discarded and that its size is reported"
+}
+pass_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:0 -o empty -e save:stderr \
+            env ATF_OUTPUT_BUFFER=1m "${h}" -r result output_lines
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat result
+        atf_check -s eq:0 -o ignore -e empty grep \
+            '^\*\*\* Discarded 282 bytes of output of output_lines (passed)$' \
+            stderr
+        atf_check -s eq:1 -o empty -e empty grep 'line [0-9]' stderr
+    done
+}
+
+atf_test_case fail
+fail_head()
+{
+    atf_set "descr" "Checks that the output of a failing test case is" \
+                    "printed to stderr tagged with its result"
+}
+fail_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:1 -o empty -e save:stderr \
+            env ATF_OUTPUT_BUFFER=1m "${h}" -r result -v result=fail \
+            output_lines
+        atf_check -s eq:0 -o ignore -e empty grep \
+            '^\*\*\* Output of output_lines (failed: Failed on purpose); 0 bytes discarded$' \
+            stderr
+        atf_check -s eq:0 -o inline:'10\n' -e empty \
+            grep -c '^stdout line' stderr
+        atf_check -s eq:0 -o inline:'10\n' -e empty \
+            grep -c '^stderr line' stderr
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^\*\*\* End of output of output_lines$' stderr
+    done
+}
+
+atf_test_case overflow
+overflow_head()
+{
+    atf_set "descr" "Checks that only the most recent output is kept and" \
+                    "that the discarded bytes are reported"
+}
+overflow_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:1 -o empty -e save:stderr \
+            env ATF_OUTPUT_BUFFER=1k "${h}" -r result -v result=fail \
+            -v lines=1000 output_lines
+        atf_check -s eq:0 -o ignore -e empty grep \
+            '^\*\*\* Output of output_lines (failed: .*); 30762 bytes discarded$' \
+            stderr
+        atf_check -s eq:0 -o ignore -e empty grep 'line 1000$' stderr
+        atf_check -s eq:1 -o empty -e empty grep 'line 1$' stderr
+    done
+}
+
+atf_test_case crash
+crash_head()
+{
+    atf_set "descr" "Checks that the output of a crashing test case is" \
+                    "printed and that the crash is preserved"
+}
+crash_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -f result
+        atf_check -s signal:6 -o empty -e save:stderr \
+            env ATF_OUTPUT_BUFFER=1m "${h}" -r result -v result=crash \
+            output_lines
+        atf_check -s eq:0 -o ignore -e empty grep \
+            '^\*\*\* Output of output_lines (no result; received signal 6)' \
+            stderr
+        atf_check -s eq:0 -o ignore -e empty grep '^stderr line 10$' stderr
+
+        atf_check -s eq:0 -o empty -e save:stderr \
+            env ATF_OUTPUT_BUFFER=1m "${h}" -r result -v result=exit \
+            output_lines
+        atf_check -s eq:0 -o ignore -e empty grep \
+            '^\*\*\* Output of output_lines (no result); 0 bytes discarded$' \
+            stderr
+    done
+}
+
+atf_test_case disabled
+disabled_head()
+{
+    atf_set "descr" "Checks that the output is left alone unless a valid" \
+                    "size is set and the result goes to a file"
+}
+disabled_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:0 -o match:'^stdout line 10$' \
+            -e match:'^stderr line 10$' "${h}" -r result output_lines
+        atf_check -s eq:0 -o match:'^stdout line 10$' \
+            -e match:'^stderr line 10$' \
+            env ATF_OUTPUT_BUFFER=0 "${h}" -r result output_lines
+        atf_check -s eq:0 -o match:'^stdout line 10$' \
+            -e match:'^stderr line 10$' \
+            env ATF_OUTPUT_BUFFER=1m "${h}" output_lines
+        atf_check -s eq:0 -o match:'^stdout line 10$' \
+            -e match:"Not buffering the output of output_lines: .*size \`foo'" \
+            env ATF_OUTPUT_BUFFER=foo "${h}" -r result output_lines
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case pass
+    atf_add_test_case fail
+    atf_add_test_case overflow
+    atf_add_test_case crash
+    atf_add_test_case disabled
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
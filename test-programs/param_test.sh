@@ -0,0 +1,174 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+atf_test_case list
+list_head()
+{
+    atf_set "descr" "Checks that every row of a table is listed as a test" \
+                    "case with its own meta-data"
+}
+list_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:0 -o save:stdout -e empty "${h}" -l
+        for row in pass fatal check skip crash last; do
+            atf_check -s eq:0 -o ignore -e empty \
+                grep "^ident: param_sum/${row}$" stdout
+        done
+        atf_check -s eq:1 -o empty -e empty grep '^ident: param_sum$' stdout
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^descr: A row that fails a requirement$' stdout
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^X-isolated: true$' stdout
+    done
+}
+
+atf_test_case row
+row_head()
+{
+    atf_set "descr" "Checks that a single row can be run by its name"
+}
+row_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -f res
+        atf_check -s eq:0 -o match:'^pid ' -e ignore \
+            "${h}" -r res param_sum/pass
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res
+
+        atf_check -s eq:1 -o ignore -e ignore "${h}" -r res param_sum/fatal
+        atf_check -s eq:0 -o match:'^failed: ' -e empty cat res
+
+        atf_check -s eq:1 -o empty -e match:"Unknown test case" \
+            "${h}" -r res param_sum/unknown
+    done
+}
+
+atf_test_case table
+table_head()
+{
+    atf_set "descr" "Checks that naming a table runs all its rows in a" \
+                    "single process except for the isolated ones"
+}
+table_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -rf rows
+        mkdir rows
+        atf_check -s eq:1 -o save:stdout -e save:stderr \
+            "${h}" -R rows param_sum
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat rows/pass
+        atf_check -s eq:0 -o match:'^failed: ' -e empty cat rows/fatal
+        atf_check -s eq:0 -o match:'^failed: 1 checks failed' -e empty \
+            cat rows/check
+        atf_check -s eq:0 -o match:'^skipped: ' -e empty cat rows/skip
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat rows/last
+        test ! -f rows/crash || atf_fail "The isolated row left a result"
+
+        atf_check -s eq:1 -o empty -e match:'-r cannot be used with' \
+            "${h}" -r rows param_sum
+
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '3 of 6 rows of param_sum failed' stderr
+        atf_check -s eq:0 -o ignore -e empty \
+            grep 'Check failed in param_sum/check' stderr
+        atf_check -s eq:0 -o inline:'5\n' -e empty grep -c '^pid ' stdout
+        atf_check -s eq:0 -o inline:'1\n' -e empty -x \
+            "grep '^pid ' stdout | sort -u | wc -l | tr -d ' '"
+    done
+}
+
+atf_test_case stdout
+stdout_head()
+{
+    atf_set "descr" "Checks that the results of a table go to stdout," \
+                    "prefixed by the row names, when no -R is given"
+}
+stdout_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:1 -o save:stdout -e ignore "${h}" param_sum
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^param_sum/pass: passed$' stdout
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^param_sum/skip: skipped: ' stdout
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^param_sum/last: passed$' stdout
+    done
+}
+
+atf_test_case swallowed_stop
+swallowed_stop_head()
+{
+    atf_set "descr" "Checks that the exception that stops a C++ row is" \
+                    "not swallowed by ATF_REQUIRE_THROW and that rows" \
+                    "that swallow it abort instead of crashing"
+}
+swallowed_stop_body()
+{
+    h="$(atf_get_srcdir)/cpp_helpers"
+
+    atf_check -s eq:1 -o save:stdout -e ignore "${h}" param_throw
+    atf_check -s eq:0 -o match:'^param_throw/first: failed: ' -e empty \
+        cat stdout
+    atf_check -s eq:0 -o match:'^param_throw/second: passed$' -e empty \
+        cat stdout
+
+    atf_check -s signal:abrt -o ignore \
+        -e match:'row continued after its result was written' \
+        "${h}" param_swallow
+}
+
+atf_test_case shard
+shard_head()
+{
+    atf_set "descr" "Checks that the rows of a shard get their own result" \
+                    "files within a directory named after their table"
+}
+shard_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -rf work
+        mkdir -p work/res
+        atf_check -s ignore -o ignore -e ignore -x \
+            "cd work && ${h} -R res -v tmpfile=$(pwd)/tmpfile -S 1/1"
+        atf_check -s eq:0 -o inline:'passed\n' -e empty \
+            cat work/res/param_sum/pass
+        atf_check -s eq:0 -o match:'^failed: ' -e empty \
+            cat work/res/param_sum/fatal
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case list
+    atf_add_test_case row
+    atf_add_test_case table
+    atf_add_test_case stdout
+    atf_add_test_case swallowed_stop
+    atf_add_test_case shard
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
@@ -0,0 +1,154 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Runs the require_md helper with the given configuration variables and
+# checks that its result matches the given regular expression.  The body
+# must only have run if the test case passed.  The helper is run as if by
+# hand unless INSIDE_ATF_RUN is set to yes.
+check_result()
+{
+    h=${1}; exp=${2}; shift; shift
+
+    rm -f ran res
+    if [ "${INSIDE_ATF_RUN:-no}" = yes ]; then
+        __RUNNING_INSIDE_ATF_RUN=internal-yes-value
+        export __RUNNING_INSIDE_ATF_RUN
+    else
+        unset __RUNNING_INSIDE_ATF_RUN
+    fi
+    atf_check -s eq:0 -o ignore -e ignore "${h}" -r res "${@}" require_md
+    atf_check -s eq:0 -o match:"${exp}" -e empty cat res
+    case ${exp} in
+    passed) test -f ran || atf_fail "The body did not run" ;;
+    *) test ! -f ran || atf_fail "The body ran" ;;
+    esac
+}
+
+atf_test_case files
+files_head()
+{
+    atf_set "descr" "Checks that test programs skip test cases whose" \
+                    "require.files are missing"
+}
+files_body()
+{
+    touch present
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        check_result "${h}" passed -v files="$(pwd)/present /bin/sh"
+        check_result "${h}" \
+            "^skipped: Required file '$(pwd)/missing' not found$" \
+            -v files="$(pwd)/present $(pwd)/missing"
+        check_result "${h}" \
+            "^skipped: Relative path 'present' not allowed in require.files$" \
+            -v files="present"
+    done
+}
+
+atf_test_case progs
+progs_head()
+{
+    atf_set "descr" "Checks that test programs skip test cases whose" \
+                    "require.progs are missing"
+}
+progs_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        check_result "${h}" passed -v progs="sh /bin/sh"
+        check_result "${h}" \
+            "^skipped: Required program 'non-existent' not found in the PATH$" \
+            -v progs="sh non-existent"
+        check_result "${h}" \
+            "^skipped: Required program '/non-existent' not found$" \
+            -v progs="/non-existent"
+        check_result "${h}" \
+            "^skipped: Relative path 'bin/sh' not allowed in require.progs$" \
+            -v progs="bin/sh"
+    done
+}
+
+atf_test_case inside_atf_run
+inside_atf_run_head()
+{
+    atf_set "descr" "Checks that test programs leave the require.files" \
+                    "and require.progs checks to atf-run when run by it"
+}
+inside_atf_run_body()
+{
+    INSIDE_ATF_RUN=yes
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        check_result "${h}" passed \
+            -v files="$(pwd)/missing" -v progs="non-existent"
+        check_result "${h}" \
+            "^skipped: Requires 1099511627776000 bytes of physical memory" \
+            -v memory=1000t
+    done
+}
+
+atf_test_case memory
+memory_head()
+{
+    atf_set "descr" "Checks that test programs skip test cases whose" \
+                    "require.memory exceeds the physical memory"
+}
+memory_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        check_result "${h}" passed -v memory=1k
+        check_result "${h}" \
+            "^skipped: Requires 1099511627776000 bytes of physical memory" \
+            -v memory=1000t
+        atf_check -s signal -o ignore \
+            -e match:'Invalid value for require.memory: Unknown size unit' \
+            "${h}" -r res -v memory=12d require_md
+    done
+}
+
+atf_test_case diskspace
+diskspace_head()
+{
+    atf_set "descr" "Checks that test programs skip test cases whose" \
+                    "require.diskspace exceeds the free space of the work" \
+                    "directory"
+}
+diskspace_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        check_result "${h}" passed -v diskspace=1k
+        check_result "${h}" \
+            "^skipped: Requires 1099511627776000 bytes of free disk space" \
+            -v diskspace=1000T
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case files
+    atf_add_test_case progs
+    atf_add_test_case inside_atf_run
+    atf_add_test_case memory
+    atf_add_test_case diskspace
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
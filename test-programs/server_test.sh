@@ -0,0 +1,207 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Feeds the requests in the given file to a helper in server mode and
+# saves its responses in the file 'responses'.
+serve()
+{
+    h=${1}; requests=${2}; shift; shift
+
+    atf_check -s eq:0 -o save:responses -e ignore -x \
+        "${h} -Z -s $(atf_get_srcdir) ${*} <${requests}"
+    atf_check -s eq:0 -o inline:'ready\n' -e empty sed -n 1p responses
+}
+
+# Checks that the server started and finished the given number of
+# subprocesses.
+check_counts()
+{
+    count=${1}
+
+    atf_check -s eq:0 -o inline:"${count}\n" -e empty \
+        grep -c '^started [0-9]*$' responses
+    atf_check -s eq:0 -o inline:"${count}\n" -e empty \
+        grep -c '^done [0-9]* [0-9]*$' responses
+}
+
+atf_test_case run
+run_head()
+{
+    atf_set "descr" "Checks that a test program in server mode runs the" \
+                    "requested test cases"
+}
+run_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -rf work res.* body.*
+        mkdir work
+
+        cat >requests <<EOF
+tc result_pass
+resfile res.pass
+workdir work
+stdout body.stdout
+
+tc result_fail
+resfile res.fail
+workdir work
+
+EOF
+        serve "${h}" requests
+        check_counts 2
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res.pass
+        atf_check -s eq:0 -o match:'^failed: Failure reason$' -e empty \
+            cat res.fail
+    done
+}
+
+atf_test_case cleanup
+cleanup_head()
+{
+    atf_set "descr" "Checks that a test program in server mode runs the" \
+                    "cleanup routine in the work directory of the body"
+}
+cleanup_body()
+{
+    # Only the C helpers have a test case with a cleanup routine that
+    # looks at its work directory.
+    for h in $(get_helpers c_helpers); do
+        rm -rf work res.* cleanup.*
+        mkdir work
+
+        cat >requests <<EOF
+tc cleanup_curdir
+resfile res.curdir
+workdir work
+
+EOF
+        serve "${h}" requests
+        check_counts 1
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res.curdir
+        test -f work/oldvalue || atf_fail "The body did not run in work"
+
+        cat >requests <<EOF
+tc cleanup_curdir:cleanup
+workdir work
+stdout cleanup.stdout
+
+EOF
+        serve "${h}" requests
+        check_counts 1
+        atf_check -s eq:0 -o match:'Old value: 1234' -e empty \
+            cat cleanup.stdout
+    done
+}
+
+atf_test_case config
+config_head()
+{
+    atf_set "descr" "Checks that requests can override the configuration" \
+                    "variables given to the server"
+}
+config_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -f res.*
+        mkdir -p work
+
+        cat >requests <<EOF
+tc config_value
+resfile res.default
+workdir work
+
+tc config_value
+resfile res.override
+workdir work
+var test=foo
+
+EOF
+        serve "${h}" requests -v test=bar
+        check_counts 2
+        atf_check -s eq:0 -o match:'^failed: ' -e empty cat res.default
+        atf_check -s eq:0 -o inline:'passed\n' -e empty cat res.override
+    done
+}
+
+atf_test_case errors
+errors_head()
+{
+    atf_set "descr" "Checks that invalid requests are reported without" \
+                    "stopping the server"
+}
+errors_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        mkdir -p work
+
+        cat >requests <<EOF
+tc result_pass
+bogus field
+
+tc unknown
+workdir work
+stderr unknown.stderr
+
+EOF
+        serve "${h}" requests
+        check_counts 1
+        atf_check -s eq:0 -o ignore -e empty \
+            grep "^error Unknown request field \`bogus'$" responses
+        atf_check -s eq:0 -o ignore -e empty \
+            grep '^done [0-9]* 256$' responses
+        atf_check -s eq:0 -o ignore -e empty \
+            grep "Unknown test case \`unknown'" unknown.stderr
+    done
+}
+
+atf_test_case usage_errors
+usage_errors_head()
+{
+    atf_set "descr" "Checks the validation of the -Z flag"
+}
+usage_errors_body()
+{
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        for flag in -l '-r res' '-R res' '-S 1/2'; do
+            atf_check -s eq:1 -o empty \
+                -e match:'-Z cannot be combined with -l, -r, -R or -S' \
+                ${h} -Z ${flag}
+        done
+        atf_check -s eq:1 -o empty \
+            -e match:'Cannot provide test case names with -Z' \
+            "${h}" -Z result_pass
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case run
+    atf_add_test_case cleanup
+    atf_add_test_case config
+    atf_add_test_case errors
+    atf_add_test_case usage_errors
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
@@ -0,0 +1,262 @@
+# Copyright (c) 2026 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+: ${ATF_SH:="__ATF_SH__"}
+
+# Prints the test cases of a helper listed with the given arguments.
+list_idents()
+{
+    "${@}" -l | sed -n 's/^ident: //p'
+}
+
+# Checks that the shards of a helper form a partition of its test cases.
+check_partition()
+{
+    h=${1}; count=${2}
+
+    list_idents "${h}" | sort >all
+    for i in $(seq ${count}); do
+        list_idents "${h}" -S ${i}/${count}
+    done | sort >union
+    atf_check -s eq:0 -o empty -e empty uniq -d union
+    atf_check -s eq:0 -o empty -e empty cmp all union
+}
+
+atf_test_case list
+list_head()
+{
+    atf_set "descr" "Checks that the shards of a test program contain" \
+                    "every test case exactly once"
+}
+list_body()
+{
+    for h in $(get_helpers); do
+        for count in 1 2 3 7; do
+            check_partition "${h}" ${count}
+        done
+    done
+
+    atf_check -s eq:0 -o inline:'0\n' -e empty -x \
+        "$(get_helpers c_helpers) -l -S 1/1000 | grep -c '^ident:' || true"
+}
+
+atf_test_case list_hints
+list_hints_head()
+{
+    atf_set "descr" "Checks that the shards of a test program contain" \
+                    "every test case exactly once when the test cases" \
+                    "have duration hints"
+}
+list_hints_body()
+{
+    export ATF_HISTORY_FILE=$(pwd)/history
+    for h in $(get_helpers); do
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -r res result_pass
+        atf_check -s eq:1 -o ignore -e ignore "${h}" -r res result_fail
+        for count in 2 3; do
+            check_partition "${h}" ${count}
+        done
+    done
+}
+
+atf_test_case same_selection
+same_selection_head()
+{
+    atf_set "descr" "Checks that all bindings assign a test case to the" \
+                    "same shard"
+}
+same_selection_body()
+{
+    for h in $(get_helpers); do
+        for i in 1 2 3; do
+            list_idents "${h}" -S ${i}/3 | sed "s/\$/ ${i}/"
+        done | sort >"${h##*/}.shards"
+    done
+
+    for other in cpp_helpers sh_helpers; do
+        join c_helpers.shards ${other}.shards >joined
+        test -s joined || atf_fail "No test cases in common"
+        atf_check -s eq:0 -o empty -e empty awk '$2 != $3' joined
+    done
+}
+
+atf_test_case same_selection_shells
+same_selection_shells_head()
+{
+    atf_set "descr" "Checks that atf-sh test programs assign a test case" \
+                    "to the same shard as the atf-c ones whatever the" \
+                    "shell, including for names whose hash has the high" \
+                    "bit set, which overflow 32-bit shell arithmetic"
+}
+same_selection_shells_body()
+{
+    c=$(get_helpers c_helpers)
+    sh=$(get_helpers sh_helpers)
+
+    for count in 3 7; do
+        for i in $(seq ${count}); do
+            list_idents "${c}" -S ${i}/${count} | sed "s/\$/ ${i}/"
+        done | sort >c.shards
+
+        for shell in bash dash ksh mksh zsh sh; do
+            path=$(command -v ${shell}) || continue
+            echo "Testing with ${path} and ${count} shards"
+            for i in $(seq ${count}); do
+                list_idents "${ATF_SH}" -s "${path}" "${sh}" \
+                    -S ${i}/${count} | sed "s/\$/ ${i}/"
+            done | sort >sh.shards
+
+            join c.shards sh.shards >joined
+            atf_check -s eq:0 -o empty -e empty awk '$2 != $3' joined
+            # The FNV-1a hashes of these names are 2^31 or more.
+            for ident in result_pass result_fail cleanup_pass; do
+                atf_check -s eq:0 -o ignore -e empty \
+                    grep "^${ident} " joined
+            done
+        done
+    done
+}
+
+atf_test_case run
+run_head()
+{
+    atf_set "descr" "Checks that running a shard runs the body and the" \
+                    "cleanup routine of all its test cases"
+}
+run_body()
+{
+    # The atf-sh helpers cannot run in a single process because some of
+    # them kill the shell; see run_sh.
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        rm -rf work
+        mkdir -p work/res
+        for i in 1 2; do
+            atf_check -s ignore -o save:stdout${i} -e ignore -x \
+                "cd work && ${h} -R res -v tmpfile=$(pwd)/tmpfile -S ${i}/2"
+        done
+
+        for tc in $(list_idents "${h}"); do
+            # These die before they can write their results, either on
+            # purpose or because they miss their configuration variables.
+            case "${tc}" in
+                cleanup_sigterm|config_*|result_exception|*/crash) continue ;;
+            esac
+            test -f "work/res/${tc}" || echo "${tc}" >>missing
+        done
+        test ! -f missing || atf_fail "$(cat missing | tr '\n' ' ')did not run"
+        # The work directories are gone once the test cases are done.
+        atf_check -s eq:0 -o inline:'res\n' -e empty ls work
+        atf_check -s eq:0 -o inline:'passed\n' -e empty \
+            cat work/res/result_pass
+        atf_check -s eq:0 -o match:'^failed: Failure reason$' -e empty \
+            cat work/res/result_fail
+        case "${h}" in
+            */c_helpers)
+                atf_check -s eq:0 -o ignore -e empty \
+                    grep 'Old value: 1234' stdout1 stdout2
+                ;;
+        esac
+    done
+}
+
+atf_test_case run_sh
+run_sh_head()
+{
+    atf_set "descr" "Checks that running a shard of an atf-sh test" \
+                    "program runs the body and the cleanup routine of" \
+                    "all its test cases"
+}
+run_sh_body()
+{
+    cat >tp <<EOF
+#! ${ATF_SH}
+atf_test_case pass
+pass_body() { :; }
+atf_test_case fail
+fail_body() { atf_fail "Failure reason"; }
+atf_test_case curdir cleanup
+curdir_body() { echo 1234 >oldvalue; }
+curdir_cleanup() { echo "Old value: \$(cat oldvalue)"; }
+atf_test_case other
+other_body() { :; }
+atf_init_test_cases() {
+    for tc in pass fail curdir other; do
+        atf_add_test_case \${tc}
+    done
+}
+EOF
+    chmod +x tp
+
+    mkdir -p work/res
+    for i in 1 2; do
+        atf_check -s ignore -o save:stdout${i} -e ignore -x \
+            "cd work && ../tp -R res -S ${i}/2"
+    done
+    for tc in pass fail curdir other; do
+        test -f "work/res/${tc}" || atf_fail "${tc} did not run"
+    done
+    atf_check -s eq:0 -o inline:'res\n' -e empty ls work
+    atf_check -s eq:0 -o inline:'passed\n' -e empty cat work/res/pass
+    atf_check -s eq:0 -o inline:'failed: Failure reason\n' -e empty \
+        cat work/res/fail
+    atf_check -s eq:0 -o ignore -e empty \
+        grep 'Old value: 1234' stdout1 stdout2
+}
+
+atf_test_case usage_errors
+usage_errors_head()
+{
+    atf_set "descr" "Checks the validation of the -S and -R flags"
+}
+usage_errors_body()
+{
+    for h in $(get_helpers); do
+        for spec in 0/2 3/2 1 1/ /1 a/2 1/b 1/2/3 1/32768 \
+                     99999999999/2; do
+            atf_check -s eq:1 -o empty -e match:"Invalid shard \`${spec}'" \
+                "${h}" -S "${spec}"
+        done
+        atf_check -s eq:1 -o empty \
+            -e match:'Cannot provide test case names with -S' \
+            "${h}" -S 1/2 result_pass
+        atf_check -s eq:1 -o empty -e match:'-r cannot be combined with -S' \
+            "${h}" -r res -S 1/2
+        atf_check -s eq:1 -o empty -e match:'-R can only be used with -S' \
+            "${h}" -R res result_pass
+    done
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case list
+    atf_add_test_case list_hints
+    atf_add_test_case same_selection
+    atf_add_test_case same_selection_shells
+    atf_add_test_case run
+    atf_add_test_case run_sh
+    atf_add_test_case usage_errors
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4